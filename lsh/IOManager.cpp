@@ -122,9 +122,9 @@ namespace lsh {
         int rt = epoll_ctl(m_epoll_fd, op, fd, &epevent);
 
         if (rt) {
-            LSH_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epoll_fd << ", "
-                                    << op << ", " << fd << ", " << epevent.events
-                                    << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
+            LSH_LOG_ERROR_EVERY_MS(g_logger, 1000) << "epoll_ctl(" << m_epoll_fd << ", "
+                                                   << op << ", " << fd << ", " << epevent.events
+                                                   << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
             return -1;
         }
 
@@ -171,9 +171,9 @@ namespace lsh {
         // 注册事件
         int rt = epoll_ctl(m_epoll_fd, op, fd, &epevent);
         if (rt) {
-            LSH_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epoll_fd << ", "
-                                    << op << ", " << fd << ", " << epevent.events
-                                    << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
+            LSH_LOG_ERROR_EVERY_MS(g_logger, 1000) << "epoll_ctl(" << m_epoll_fd << ", "
+                                                   << op << ", " << fd << ", " << epevent.events
+                                                   << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
             return false;
         }
         // 等待执行的事件数量-1
@@ -210,9 +210,9 @@ namespace lsh {
         epevent.data.ptr = fd_ctx;
         int rt = epoll_ctl(m_epoll_fd, op, fd, &epevent);
         if (rt) {
-            LSH_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epoll_fd << ", "
-                                    << op << ", " << fd << ", " << epevent.events
-                                    << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
+            LSH_LOG_ERROR_EVERY_MS(g_logger, 1000) << "epoll_ctl(" << m_epoll_fd << ", "
+                                                   << op << ", " << fd << ", " << epevent.events
+                                                   << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
             return false;
         }
         // 触发要取消的事件
@@ -245,9 +245,9 @@ namespace lsh {
         epevent.data.ptr = fd_ctx;
         int rt = epoll_ctl(m_epoll_fd, op, fd, &epevent);
         if (rt) {
-            LSH_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epoll_fd << ", "
-                                    << op << ", " << fd << ", " << epevent.events
-                                    << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
+            LSH_LOG_ERROR_EVERY_MS(g_logger, 1000) << "epoll_ctl(" << m_epoll_fd << ", "
+                                                   << op << ", " << fd << ", " << epevent.events
+                                                   << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
             return false;
         }
 
@@ -384,9 +384,9 @@ namespace lsh {
                 // 重新注册事件
                 int rt2 = epoll_ctl(m_epoll_fd, op, fd_ctx->fd, &event);
                 if (rt2) {
-                    LSH_LOG_INFO(g_logger) << "epoll_ctl(" << m_epoll_fd << ","
-                                           << op << ", " << fd_ctx->fd << ", " << event.events << ") :"
-                                           << rt2 << " (" << errno << ") (" << strerror(errno) << ")";
+                    LSH_LOG_INFO_EVERY_MS(g_logger, 1000) << "epoll_ctl(" << m_epoll_fd << ","
+                                                          << op << ", " << fd_ctx->fd << ", " << event.events << ") :"
+                                                          << rt2 << " (" << errno << ") (" << strerror(errno) << ")";
                     continue;
                 }
 
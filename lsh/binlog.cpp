@@ -0,0 +1,584 @@
+#include "binlog.h"
+#include "config.h"
+#include <cctype>
+#include <cstdio>
+
+namespace lsh {
+    static lsh::ConfigVar<std::string>::ptr g_binlog_file =
+        lsh::Config::Creat("log.binary.file", std::string(""), "binary log file, empty means formatting in background");
+    static lsh::ConfigVar<uint32_t>::ptr g_binlog_ring_size =
+        lsh::Config::Creat("log.binary.ring_size", (uint32_t)(1024 * 1024), "binary log per thread ring size");
+    static lsh::ConfigVar<uint32_t>::ptr g_binlog_flush_interval =
+        lsh::Config::Creat("log.binary.flush_interval", (uint32_t)100, "binary log flush interval ms");
+
+    static const char s_binlog_magic[8] = {'L', 'S', 'H', 'B', 'L', 'O', 'G', '1'};
+
+    //=============== BinLogRing =================
+    BinLogRing::BinLogRing(size_t capacity, uint32_t thread_id) : m_thread_id(thread_id) {
+        m_capacity = 4096;
+        while (m_capacity < capacity) {
+            m_capacity <<= 1;
+        }
+        m_buf.reset(new char[m_capacity]);
+    }
+
+    void BinLogRing::consume(uint64_t end, const std::function<void(const char *, size_t)> &cb) {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        while (tail < end) {
+            size_t pos = tail & (m_capacity - 1);
+            uint32_t size;
+            memcpy(&size, m_buf.get() + pos, sizeof(size));
+            if (size == 0) {
+                // 回绕标记
+                tail += m_capacity - pos;
+                continue;
+            }
+            cb(m_buf.get() + pos, size);
+            tail += size;
+        }
+        m_tail.store(tail, std::memory_order_release);
+    }
+
+    //=============== 编码辅助 =================
+    static void AppendU32(std::string &out, uint32_t v) {
+        out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+    }
+
+    static void AppendString(std::string &out, const char *s, size_t len) {
+        AppendU32(out, len);
+        out.append(s, len);
+    }
+
+    // 以 BinEntryHeader 开始一条字典记录，返回其起始位置
+    static size_t BeginEntry(std::string &out, BinEntryType type) {
+        size_t begin = out.size();
+        BinEntryHeader header{};
+        header.type = type;
+        out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+        return begin;
+    }
+
+    // 补齐到 8 字节并回填 size
+    static void EndEntry(std::string &out, size_t begin) {
+        out.append((8 - (out.size() - begin) % 8) % 8, '\0');
+        uint32_t size = out.size() - begin;
+        memcpy(&out[begin], &size, sizeof(size));
+    }
+
+    static bool ReadU32(const char *&p, const char *end, uint32_t &v) {
+        if (end - p < (ptrdiff_t)sizeof(v)) {
+            return false;
+        }
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return true;
+    }
+
+    static bool ReadString(const char *&p, const char *end, std::string &s) {
+        uint32_t len;
+        if (!ReadU32(p, end, len) || end - p < (ptrdiff_t)len) {
+            return false;
+        }
+        s.assign(p, len);
+        p += len;
+        return true;
+    }
+
+    //=============== BinLogDecoder =================
+    BinLogDecoder::BinLogDecoder() {
+        m_factory = [](const std::string &name) {
+            return std::make_shared<Logger>(name);
+        };
+    }
+
+    std::shared_ptr<LogEvent> BinLogDecoder::decode(const char *data, size_t size) {
+        if (size < sizeof(BinEntryHeader)) {
+            return nullptr;
+        }
+        BinEntryHeader header;
+        memcpy(&header, data, sizeof(header));
+        const char *p = data + sizeof(header);
+        const char *end = data + size;
+
+        switch (header.type) {
+        case BIN_ENTRY_FORMAT: {
+            uint32_t id, line;
+            FormatInfo info;
+            if (ReadU32(p, end, id) && ReadU32(p, end, line) &&
+                ReadString(p, end, info.file) && ReadString(p, end, info.fmt)) {
+                info.line = line;
+                m_formats[id] = std::move(info);
+            }
+            return nullptr;
+        }
+        case BIN_ENTRY_LOGGER: {
+            uint32_t id;
+            std::string name;
+            if (ReadU32(p, end, id) && ReadString(p, end, name)) {
+                m_loggers[id] = m_factory(name);
+            }
+            return nullptr;
+        }
+        case BIN_ENTRY_THREAD: {
+            uint32_t tid;
+            std::string name;
+            if (ReadU32(p, end, tid) && ReadString(p, end, name)) {
+                m_threads[tid] = std::move(name);
+            }
+            return nullptr;
+        }
+        case BIN_ENTRY_RECORD:
+            break;
+        default:
+            return nullptr;
+        }
+
+        if (size < sizeof(BinRecordHeader)) {
+            return nullptr;
+        }
+        BinRecordHeader record;
+        memcpy(&record, data, sizeof(record));
+        p = data + sizeof(record);
+
+        m_args.resize(record.argc);
+        for (auto &arg : m_args) {
+            if (p >= end) {
+                return nullptr;
+            }
+            arg.type = *p++;
+            if (arg.type == BIN_ARG_STRING) {
+                if (!ReadString(p, end, arg.s)) {
+                    return nullptr;
+                }
+            } else {
+                if (end - p < (ptrdiff_t)sizeof(uint64_t)) {
+                    return nullptr;
+                }
+                memcpy(&arg.u, p, sizeof(uint64_t));
+                p += sizeof(uint64_t);
+            }
+        }
+
+        auto fit = m_formats.find(record.format_id);
+        auto lit = m_loggers.find(record.logger_id);
+        if (lit == m_loggers.end()) {
+            lit = m_loggers.emplace(record.logger_id, m_factory("unknown")).first;
+        }
+        auto tit = m_threads.find(record.thread_id);
+        static const std::string s_empty;
+
+        LogEvent::ptr event = std::make_shared<LogEvent>(
+            fit != m_formats.end() ? fit->second.file.c_str() : "unknown",
+            fit != m_formats.end() ? fit->second.line : 0, 0,
+            record.thread_id, record.fiber_id, record.time, lit->second,
+            (LogLevel::Level)record.level, tit != m_threads.end() ? tit->second : s_empty);
+        event->setMicroSecond(record.usec);
+
+        std::string message;
+        if (fit != m_formats.end()) {
+            FormatMessage(message, fit->second.fmt.c_str(), m_args);
+        } else {
+            message = "<unknown format id " + std::to_string(record.format_id) + ">";
+        }
+        event->getSS().write(message.data(), message.size());
+        return event;
+    }
+
+    // 把 printf 的一个转换说明套用到一个参数上
+    template <class T>
+    static void AppendSpec(std::string &out, const std::string &spec, T value) {
+        char buf[128];
+        int n = snprintf(buf, sizeof(buf), spec.c_str(), value);
+        if (n < 0) {
+            return;
+        }
+        if ((size_t)n < sizeof(buf)) {
+            out.append(buf, n);
+            return;
+        }
+        size_t old = out.size();
+        out.resize(old + n + 1);
+        snprintf(&out[old], n + 1, spec.c_str(), value);
+        out.resize(old + n);
+    }
+
+    void BinLogDecoder::FormatMessage(std::string &out, const char *fmt, const std::vector<BinArg> &args) {
+        size_t next = 0;
+        auto take = [&]() -> const BinArg * {
+            return next < args.size() ? &args[next++] : nullptr;
+        };
+        // 宽度/精度里的 *
+        auto star = [&](std::string &spec) {
+            const BinArg *arg = take();
+            spec += std::to_string(arg ? (int)arg->i : 0);
+        };
+
+        std::string spec;
+        const char *p = fmt;
+        while (*p) {
+            if (*p != '%') {
+                const char *begin = p;
+                while (*p && *p != '%') {
+                    ++p;
+                }
+                out.append(begin, p - begin);
+                continue;
+            }
+            if (p[1] == '%') {
+                out.push_back('%');
+                p += 2;
+                continue;
+            }
+
+            spec.assign(1, '%');
+            ++p;
+            while (*p && strchr("-+ #0'", *p)) {
+                spec.push_back(*p++);
+            }
+            if (*p == '*') {
+                star(spec);
+                ++p;
+            } else {
+                while (isdigit((unsigned char)*p)) {
+                    spec.push_back(*p++);
+                }
+            }
+            if (*p == '.') {
+                spec.push_back(*p++);
+                if (*p == '*') {
+                    star(spec);
+                    ++p;
+                } else {
+                    while (isdigit((unsigned char)*p)) {
+                        spec.push_back(*p++);
+                    }
+                }
+            }
+            // 长度修饰：0 无，1 hh，2 h，3 l/ll/j/z/t/L
+            int length = 0;
+            while (*p && strchr("hlLqjzt", *p)) {
+                if (*p == 'h') {
+                    length = length == 2 ? 1 : 2;
+                } else {
+                    length = 3;
+                }
+                ++p;
+            }
+            char conv = *p;
+            if (!conv) {
+                break;
+            }
+            ++p;
+
+            const BinArg *arg = take();
+            if (!arg) {
+                continue;
+            }
+            if (arg->type == BIN_ARG_STRING && conv != 's') {
+                out += arg->s;
+                continue;
+            }
+            switch (conv) {
+            case 'd':
+            case 'i': {
+                long long v = arg->i;
+                if (length == 0) {
+                    v = (int)v;
+                } else if (length == 1) {
+                    v = (signed char)v;
+                } else if (length == 2) {
+                    v = (short)v;
+                }
+                AppendSpec(out, spec + "ll" + conv, v);
+                break;
+            }
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X': {
+                unsigned long long v = arg->u;
+                if (length == 0) {
+                    v = (unsigned int)v;
+                } else if (length == 1) {
+                    v = (unsigned char)v;
+                } else if (length == 2) {
+                    v = (unsigned short)v;
+                }
+                AppendSpec(out, spec + "ll" + conv, v);
+                break;
+            }
+            case 'c':
+                AppendSpec(out, spec + conv, (int)arg->i);
+                break;
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                AppendSpec(out, spec + conv, arg->type == BIN_ARG_DOUBLE ? arg->d : (double)arg->i);
+                break;
+            case 's':
+                AppendSpec(out, spec + conv, arg->type == BIN_ARG_STRING ? arg->s.c_str() : "(null)");
+                break;
+            case 'p':
+                AppendSpec(out, spec + conv, (void *)(uintptr_t)arg->u);
+                break;
+            case 'n':
+                break;
+            default:
+                out += spec;
+                out.push_back(conv);
+                break;
+            }
+        }
+    }
+
+    //=============== BinLog =================
+    bool BinLog::CheckFormat(const char *fmt, const uint8_t *types, size_t count) {
+        size_t next = 0;
+        // 取下一个参数，C 字符串只能给 %s
+        auto take = [&](char conv) {
+            size_t i = next++;
+            return i >= count || types[i] != BIN_ARG_STRING || conv == 's';
+        };
+        const char *p = fmt;
+        while (*p) {
+            if (*p != '%') {
+                ++p;
+                continue;
+            }
+            if (p[1] == '%') {
+                p += 2;
+                continue;
+            }
+            ++p;
+            while (*p && strchr("-+ #0'", *p)) {
+                ++p;
+            }
+            if (*p == '*') {
+                if (!take('*')) {
+                    return false;
+                }
+                ++p;
+            }
+            while (isdigit((unsigned char)*p)) {
+                ++p;
+            }
+            if (*p == '.') {
+                ++p;
+                if (*p == '*') {
+                    if (!take('*')) {
+                        return false;
+                    }
+                    ++p;
+                }
+                while (isdigit((unsigned char)*p)) {
+                    ++p;
+                }
+            }
+            while (*p && strchr("hlLqjzt", *p)) {
+                ++p;
+            }
+            if (!*p) {
+                break;
+            }
+            if (!take(*p++)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    char *BinLog::ScratchBuffer(size_t size) {
+        static thread_local std::string t_scratch;
+        if (t_scratch.size() < size) {
+            t_scratch.resize(size);
+        }
+        return &t_scratch[0];
+    }
+
+    //=============== BinLogWriter =================
+    BinLogWriter::BinLogWriter() {
+        m_decoder.setLoggerFactory([this](const std::string &name) {
+            std::shared_ptr<Logger> logger;
+            {
+                MutexType::Lock lock(m_mutex);
+                auto it = m_loggers.find(name);
+                if (it != m_loggers.end()) {
+                    logger = it->second.second.lock();
+                }
+            }
+            return logger ? logger : LSH_LOG_NAME(name);
+        });
+        m_thread = std::make_shared<Thread>(std::bind(&BinLogWriter::run, this), "binlog");
+    }
+
+    BinLogWriter::~BinLogWriter() {
+        stop();
+    }
+
+    void BinLogWriter::addEntry(const std::string &entry) {
+        m_pending += entry;
+        m_dictionary += entry;
+    }
+
+    uint32_t BinLogWriter::registerFormat(const char *fmt, const char *file, int32_t line) {
+        MutexType::Lock lock(m_mutex);
+        uint32_t id = m_format_count++;
+        std::string entry;
+        size_t begin = BeginEntry(entry, BIN_ENTRY_FORMAT);
+        AppendU32(entry, id);
+        AppendU32(entry, line);
+        AppendString(entry, file, strlen(file));
+        AppendString(entry, fmt, strlen(fmt));
+        EndEntry(entry, begin);
+        addEntry(entry);
+        FlightRecorder::RegisterFormat(id, fmt, file, line);
+        return id;
+    }
+
+    int32_t BinLogWriter::registerLogger(const std::shared_ptr<Logger> &logger) {
+        const std::string &name = logger->getName();
+        MutexType::Lock lock(m_mutex);
+        auto it = m_loggers.find(name);
+        if (it != m_loggers.end()) {
+            it->second.second = logger;
+            return it->second.first;
+        }
+        int32_t id = m_loggers.size();
+        m_loggers[name] = std::make_pair(id, logger);
+        std::string entry;
+        size_t begin = BeginEntry(entry, BIN_ENTRY_LOGGER);
+        AppendU32(entry, id);
+        AppendString(entry, name.data(), name.size());
+        EndEntry(entry, begin);
+        addEntry(entry);
+        return id;
+    }
+
+    BinLogRing *BinLogWriter::getThreadRing() {
+        static thread_local BinLogRing::ptr t_ring;
+        if (!t_ring) {
+            t_ring = std::make_shared<BinLogRing>(g_binlog_ring_size->getValue(), GetThreadId());
+            MutexType::Lock lock(m_mutex);
+            m_rings.push_back(t_ring);
+        }
+        return t_ring.get();
+    }
+
+    void BinLogWriter::registerThread(BinLogRing *ring) {
+        const std::string &name = Thread::GetName();
+        ring->getThreadName() = name;
+        MutexType::Lock lock(m_mutex);
+        std::string entry;
+        size_t begin = BeginEntry(entry, BIN_ENTRY_THREAD);
+        AppendU32(entry, ring->getThreadId());
+        AppendString(entry, name.data(), name.size());
+        EndEntry(entry, begin);
+        addEntry(entry);
+    }
+
+    bool BinLogWriter::openFile(const std::string &file_name) {
+        if (m_file_stream.is_open() && m_file_name == file_name) {
+            return true;
+        }
+        if (m_file_stream.is_open()) {
+            m_file_stream.close();
+        }
+        m_file_name = file_name;
+        m_file_stream.open(file_name, std::ios::app | std::ios::binary);
+        if (!m_file_stream) {
+            std::cout << "BinLogWriter open file " << file_name << " failed" << std::endl;
+            return false;
+        }
+        if (m_file_stream.tellp() == 0) {
+            m_file_stream.write(s_binlog_magic, sizeof(s_binlog_magic));
+        }
+        // 新文件里之前的字典都不存在，整个重写一遍（重复的字典记录解码时会覆盖）
+        std::string dictionary;
+        {
+            MutexType::Lock lock(m_mutex);
+            dictionary = m_dictionary;
+        }
+        m_file_stream.write(dictionary.data(), dictionary.size());
+        return true;
+    }
+
+    void BinLogWriter::flush() {
+        MutexType::Lock drain_lock(m_drain_mutex);
+
+        // 先在锁内记下各缓冲区已发布的位置，再取走字典：
+        // 登记字典发生在发布记录之前，看得到的记录，其字典一定已经在 m_pending 里
+        std::vector<std::pair<BinLogRing::ptr, uint64_t>> rings;
+        std::string pending;
+        {
+            MutexType::Lock lock(m_mutex);
+            rings.reserve(m_rings.size());
+            for (auto &ring : m_rings) {
+                rings.emplace_back(ring, ring->head());
+            }
+            pending.swap(m_pending);
+        }
+
+        for (size_t i = 0; i < pending.size();) {
+            uint32_t size;
+            memcpy(&size, pending.data() + i, sizeof(size));
+            m_decoder.decode(pending.data() + i, size);
+            i += size;
+        }
+
+        std::string file_name = g_binlog_file->getValue();
+        if (!file_name.empty() && openFile(file_name)) {
+            m_file_stream.write(pending.data(), pending.size());
+            for (auto &i : rings) {
+                i.first->consume(i.second, [this](const char *data, size_t size) {
+                    m_file_stream.write(data, size);
+                });
+            }
+            m_file_stream.flush();
+        } else {
+            if (file_name.empty() && m_file_stream.is_open()) {
+                m_file_stream.close();
+            }
+            for (auto &i : rings) {
+                i.first->consume(i.second, [this](const char *data, size_t size) {
+                    LogEvent::ptr event = m_decoder.decode(data, size);
+                    if (event) {
+                        // 调用线程写入环时已经记录到它的飞行记录仪里
+                        event->getLogger()->output(event->getLevel(), event);
+                    }
+                });
+            }
+        }
+
+        // 线程已经退出（只剩这里持有）且没有剩余记录的缓冲区可以回收
+        rings.clear();
+        MutexType::Lock lock(m_mutex);
+        std::erase_if(m_rings, [](const BinLogRing::ptr &ring) {
+            return ring.use_count() == 1 && ring->empty();
+        });
+    }
+
+    void BinLogWriter::run() {
+        while (true) {
+            m_notify.waitFor(g_binlog_flush_interval->getValue());
+            m_wakeup.store(false);
+            bool stopping = m_stopping;
+            flush();
+            if (stopping) {
+                break;
+            }
+        }
+    }
+
+    void BinLogWriter::stop() {
+        if (m_stopping.exchange(true)) {
+            return;
+        }
+        m_notify.notify();
+        m_thread->join();
+    }
+}
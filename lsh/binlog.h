@@ -0,0 +1,430 @@
+#ifndef __LSH_BINLOG_H__
+#define __LSH_BINLOG_H__
+
+#include "log.h"
+#include "noncopyable.h"
+#include "singleton.h"
+#include "thread.h"
+#include "util.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * 二进制日志（延迟格式化）
+ *
+ * 打开了 binary 的 logger，LSH_LOG_FMT_* 在调用点不再做 printf：
+ * 只把格式串的静态 id、级别、时间等固定字段和参数的原始字节 memcpy 进当前线程的环形缓冲区。
+ * 后台线程 "binlog" 定期把这些记录取走：
+ *   - log.binary.file 为空时，在后台线程里还原成 LogEvent，交给 logger 原有的 appender
+ *   - 否则原样追加到该文件，之后用 log_decoder 离线还原成文本
+ *
+ * 文件格式：8 字节魔数 "LSHBLOG1"，之后是一条条以 BinEntryHeader 开头、按 8 字节对齐的记录。
+ * 字典记录（格式串、logger、线程名）总是出现在引用它们的日志记录之前。
+ *
+ * 流式的 LSH_LOG_* 不受影响，仍然走文本路径。
+ * 各线程的记录按批写出，跨线程之间不保证按时间排序。
+ */
+
+namespace lsh {
+    class Logger;
+
+    enum BinEntryType : uint8_t {
+        BIN_ENTRY_FORMAT = 1, // 格式串字典：id, line, file, fmt
+        BIN_ENTRY_LOGGER = 2, // logger 字典：id, name
+        BIN_ENTRY_THREAD = 3, // 线程名：tid, name
+        BIN_ENTRY_RECORD = 4  // 日志记录：BinRecordHeader + 参数
+    };
+
+    enum BinArgType : uint8_t {
+        BIN_ARG_INT = 1,    // 有符号整数（含 bool、枚举），扩展为 int64
+        BIN_ARG_UINT = 2,   // 无符号整数，扩展为 uint64
+        BIN_ARG_DOUBLE = 3, // 浮点数
+        BIN_ARG_STRING = 4, // 字符串：uint32 长度 + 内容（不含 '\0'）
+        BIN_ARG_POINTER = 5 // 指针，按 uint64 存放
+    };
+
+    struct BinEntryHeader {
+        uint32_t size; // 整条记录的字节数（含头部和对齐填充）
+        uint8_t type;  // BinEntryType
+        uint8_t reserved[3];
+    };
+
+    struct BinRecordHeader {
+        uint32_t size;
+        uint8_t type;
+        uint8_t level;
+        uint8_t argc; // 参数个数，每个参数是 1 字节 BinArgType + 值
+        uint8_t reserved;
+        uint32_t format_id;
+        uint32_t logger_id;
+        uint32_t thread_id;
+        uint32_t fiber_id;
+        uint64_t time; // 秒
+        uint32_t usec; // 微秒部分
+        uint32_t reserved2;
+    };
+
+    // 解码出来的一个参数
+    struct BinArg {
+        uint8_t type;
+        union {
+            int64_t i;
+            uint64_t u;
+            double d;
+        };
+        std::string s;
+    };
+
+    //=============== BinLogRing =================
+    /**
+     * @brief 单生产者单消费者的字节环形缓冲区
+     *
+     * 生产者是所属线程，消费者是 binlog 后台线程。
+     * 记录总是连续存放，放不下时在尾部写一个 size 为 0 的回绕标记，从头开始。
+     * 空间不足时直接丢弃，打日志的线程永远不会被后台线程拖住。
+     */
+    class BinLogRing : Noncopyable {
+    public:
+        typedef std::shared_ptr<BinLogRing> ptr;
+
+        // capacity 会向上取整到 2 的幂
+        BinLogRing(size_t capacity, uint32_t thread_id);
+
+        /**
+         * @brief 生产者：预留 n 字节（n 为 8 的倍数）
+         * @return 空间不足返回 nullptr
+         */
+        char *reserve(size_t n) {
+            uint64_t head = m_head.load(std::memory_order_relaxed);
+            size_t pos = head & (m_capacity - 1);
+            size_t contiguous = m_capacity - pos;
+            size_t need = contiguous < n ? contiguous + n : n;
+            if (head + need - m_cached_tail > m_capacity) {
+                m_cached_tail = m_tail.load(std::memory_order_acquire);
+                if (head + need - m_cached_tail > m_capacity) {
+                    return nullptr;
+                }
+            }
+            if (contiguous < n) {
+                uint32_t wrap = 0;
+                memcpy(m_buf.get() + pos, &wrap, sizeof(wrap));
+                head += contiguous;
+                pos = 0;
+            }
+            m_reserved = head;
+            return m_buf.get() + pos;
+        }
+
+        // 生产者：发布 reserve 得到的 n 字节
+        void commit(size_t n) { m_head.store(m_reserved + n, std::memory_order_release); }
+
+        // 生产者视角下已占用的字节数（可能偏大）
+        size_t used() const { return m_reserved - m_cached_tail; }
+        size_t capacity() const { return m_capacity; }
+
+        // 消费者：当前已发布的位置
+        uint64_t head() const { return m_head.load(std::memory_order_acquire); }
+        bool empty() const { return head() == m_tail.load(std::memory_order_relaxed); }
+
+        // 消费者：依次处理 end 之前的所有记录，然后把空间还给生产者
+        void consume(uint64_t end, const std::function<void(const char *, size_t)> &cb);
+
+        uint32_t getThreadId() const { return m_thread_id; }
+        // 上一次登记的线程名，只在生产者线程中访问
+        std::string &getThreadName() { return m_thread_name; }
+
+    private:
+        std::unique_ptr<char[]> m_buf;
+        size_t m_capacity;
+        uint32_t m_thread_id;
+        std::string m_thread_name;
+
+        alignas(64) std::atomic<uint64_t> m_head{0}; // 生产者发布的位置
+        uint64_t m_reserved{0};                      // 生产者：本次记录的起点（已跳过回绕）
+        uint64_t m_cached_tail{0};                   // 生产者：缓存的 m_tail，减少跨核读取
+        alignas(64) std::atomic<uint64_t> m_tail{0}; // 消费者释放的位置
+    };
+
+    //=============== BinLogDecoder =================
+    /**
+     * @brief 把二进制记录还原成 LogEvent
+     *
+     * 字典记录只更新内部的表；日志记录按 printf 的规则重新格式化消息，
+     * 得到的 LogEvent 可以直接交给 LogFormatter / Logger，输出与文本路径一致。
+     */
+    class BinLogDecoder {
+    public:
+        typedef std::function<std::shared_ptr<Logger>(const std::string &)> LoggerFactory;
+
+        // 默认为每个 logger 名字 new 一个同名的 Logger（离线解码用）
+        BinLogDecoder();
+
+        void setLoggerFactory(LoggerFactory cb) { m_factory = std::move(cb); }
+
+        /**
+         * @brief 解析一条以 BinEntryHeader 开头的记录
+         * @return 日志记录返回还原的 LogEvent，字典记录或数据不完整返回 nullptr
+         */
+        std::shared_ptr<LogEvent> decode(const char *data, size_t size);
+
+        /**
+         * @brief 用解码出的参数按 printf 的规则格式化 fmt，追加到 out
+         *
+         * 整数按转换说明里的长度修饰截断，和 printf 从变参中读取的位宽一致。
+         */
+        static void FormatMessage(std::string &out, const char *fmt, const std::vector<BinArg> &args);
+
+    private:
+        struct FormatInfo {
+            std::string file;
+            int32_t line;
+            std::string fmt;
+        };
+
+        LoggerFactory m_factory;
+        // 用节点容器，LogEvent 里保存的是 file 的 c_str()
+        std::unordered_map<uint32_t, FormatInfo> m_formats;
+        std::unordered_map<uint32_t, std::shared_ptr<Logger>> m_loggers;
+        std::unordered_map<uint32_t, std::string> m_threads;
+        std::vector<BinArg> m_args;
+    };
+
+    //=============== BinLogWriter =================
+    /**
+     * @brief 二进制日志的注册表和后台线程
+     *
+     * 格式串、logger、线程名在第一次使用时登记为字典记录；
+     * 后台线程每隔 log.binary.flush_interval 毫秒（或某个缓冲区用掉一半时）取走所有记录。
+     */
+    class BinLogWriter : Noncopyable {
+    public:
+        typedef Mutex MutexType;
+
+        BinLogWriter();
+        ~BinLogWriter();
+
+        // 登记一个调用点的格式串，返回其 id（每个调用点只调用一次）
+        uint32_t registerFormat(const char *fmt, const char *file, int32_t line);
+        // 登记 logger，同名的 logger 返回同一个 id
+        int32_t registerLogger(const std::shared_ptr<Logger> &logger);
+        // 当前线程的环形缓冲区，第一次调用时创建
+        BinLogRing *getThreadRing();
+        // 当前线程名和缓冲区上次登记的不同时调用，登记新的名字
+        void registerThread(BinLogRing *ring);
+
+        // 缓冲区用掉一半时由生产者调用，提前唤醒后台线程
+        void wakeup() {
+            if (!m_wakeup.load(std::memory_order_relaxed) && !m_wakeup.exchange(true)) {
+                m_notify.notify();
+            }
+        }
+
+        // 在调用线程中立即处理掉所有已发布的记录
+        void flush();
+        // 处理完剩余记录并停止后台线程，可重复调用
+        void stop();
+
+        void addDropped() { m_dropped.fetch_add(1, std::memory_order_relaxed); }
+        uint64_t getDropped() const { return m_dropped; }
+
+    private:
+        void run();
+        // 追加一条字典记录，调用者持有 m_mutex
+        void addEntry(const std::string &entry);
+        // 按需打开 log.binary.file，新打开时写入魔数和完整的字典
+        bool openFile(const std::string &file_name);
+
+    private:
+        MutexType m_mutex; // 保护下面的注册表
+        std::vector<BinLogRing::ptr> m_rings;
+        uint32_t m_format_count{0};
+        // 名字 -> (id, logger)，后台格式化时交还给登记的那个 logger
+        std::unordered_map<std::string, std::pair<int32_t, std::weak_ptr<Logger>>> m_loggers;
+        std::string m_pending;    // 还没被后台线程取走的字典记录
+        std::string m_dictionary; // 所有字典记录，换文件时重新写一遍
+
+        MutexType m_drain_mutex; // 同一时刻只有一个线程在处理记录
+        BinLogDecoder m_decoder;
+        std::string m_file_name;
+        std::ofstream m_file_stream;
+
+        std::atomic<bool> m_wakeup{false};
+        std::atomic<bool> m_stopping{false};
+        std::atomic<uint64_t> m_dropped{0};
+        Semaphore m_notify;
+        Thread::ptr m_thread;
+    };
+
+    typedef Singleton<BinLogWriter> BinLogMgr;
+
+    //=============== BinLog =================
+    /**
+     * @brief 日志宏调用的入口
+     */
+    class BinLog {
+    public:
+        // 格式串和参数类型对不上，这个调用点不能走二进制路径
+        static const uint32_t INVALID_FORMAT = UINT32_MAX;
+
+        template <class... Args>
+        struct ArgTypes {};
+
+        // 只用在 decltype 里取参数类型，不会求值
+        template <class... Args>
+        static ArgTypes<Args...> ArgTypesOf(const Args &...);
+
+        /**
+         * @brief 登记调用点的格式串
+         *
+         * C 字符串参数在二进制记录里只保存内容，只能对应 %s；对应其它转换（比如 %p）时
+         * 无法还原出文本路径的输出，返回 INVALID_FORMAT，这个调用点总是走文本路径。
+         */
+        template <class... Args>
+        static uint32_t RegisterFormat(const char *fmt, const char *file, int32_t line, ArgTypes<Args...>) {
+            static const uint8_t types[] = {ArgType<Args>()..., 0};
+            if (!CheckFormat(fmt, types, sizeof...(Args))) {
+                return INVALID_FORMAT;
+            }
+            return BinLogMgr::GetInstance()->registerFormat(fmt, file, line);
+        }
+
+        /**
+         * @brief 把一条日志写入当前线程的环形缓冲区
+         *
+         * 参数只支持 printf 能接受的类型：整数、枚举、浮点数、C 字符串和指针。
+         * 缓冲区满时丢弃这条日志并计数。级别够时同时写入当前线程的飞行记录仪（缓冲区满时也写）。
+         * @return format_id 为 INVALID_FORMAT 时什么都不写，返回 false，调用者改走文本路径
+         */
+        template <class... Args>
+        static bool Write(int32_t logger_id, LogLevel::Level level, uint32_t format_id, const Args &...args) {
+            static_assert(sizeof...(Args) < 256, "too many binary log arguments");
+            if (format_id == INVALID_FORMAT) {
+                return false;
+            }
+            BinLogWriter *writer = BinLogMgr::GetInstance();
+            BinLogRing *ring = writer->getThreadRing();
+            if (ring->getThreadName() != Thread::GetName()) {
+                writer->registerThread(ring);
+            }
+
+            size_t size = sizeof(BinRecordHeader) + (size_t(0) + ... + ArgSize(args));
+            size = (size + 7) & ~size_t(7);
+            bool record = level >= FlightRecorder::GetLevel();
+            char *p = ring->reserve(size);
+            bool dropped = !p;
+            if (dropped) {
+                writer->addDropped();
+                if (!record) {
+                    return true;
+                }
+                // 缓冲区满了也要留在飞行记录仪里
+                p = ScratchBuffer(size);
+            }
+
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            BinRecordHeader header{};
+            header.size = size;
+            header.type = BIN_ENTRY_RECORD;
+            header.level = level;
+            header.argc = sizeof...(Args);
+            header.format_id = format_id;
+            header.logger_id = logger_id;
+            header.thread_id = ring->getThreadId();
+            header.fiber_id = GetFiberId();
+            header.time = ts.tv_sec;
+            header.usec = ts.tv_nsec / 1000;
+            memcpy(p, &header, sizeof(header));
+            char *cur = p + sizeof(header);
+            (EncodeArg(cur, args), ...);
+            if (record) {
+                FlightRecorder::RecordBinary(level, ts.tv_sec * 1000000ull + header.usec, format_id,
+                                             p + sizeof(header), cur - p - sizeof(header));
+            }
+            if (dropped) {
+                return true;
+            }
+            ring->commit(size);
+
+            if (ring->used() > ring->capacity() / 2) {
+                writer->wakeup();
+            }
+            return true;
+        }
+
+    private:
+        // 当前线程的临时缓冲区，环满时在这里编码要交给飞行记录仪的记录
+        static char *ScratchBuffer(size_t size);
+
+        // types 是各参数的 BinArgType，检查 C 字符串参数都对应 %s
+        static bool CheckFormat(const char *fmt, const uint8_t *types, size_t count);
+
+        template <class T>
+        static constexpr uint8_t ArgType() {
+            typedef std::decay_t<T> U;
+            if constexpr (std::is_same_v<U, const char *> || std::is_same_v<U, char *>) {
+                return BIN_ARG_STRING;
+            } else if constexpr (std::is_pointer_v<U> || std::is_null_pointer_v<U>) {
+                return BIN_ARG_POINTER;
+            } else if constexpr (std::is_floating_point_v<U>) {
+                return BIN_ARG_DOUBLE;
+            } else if constexpr (std::is_enum_v<U> || (std::is_integral_v<U> && std::is_signed_v<U>) ||
+                                 std::is_same_v<U, bool>) {
+                return BIN_ARG_INT;
+            } else if constexpr (std::is_integral_v<U>) {
+                return BIN_ARG_UINT;
+            } else {
+                static_assert(std::is_integral_v<U>, "binary log argument must be printf compatible");
+                return 0;
+            }
+        }
+
+        static const char *ArgString(const char *s) { return s ? s : "(null)"; }
+
+        template <class T>
+        static size_t ArgSize(const T &v) {
+            if constexpr (ArgType<T>() == BIN_ARG_STRING) {
+                return 1 + sizeof(uint32_t) + strlen(ArgString(v));
+            } else {
+                return 1 + sizeof(uint64_t);
+            }
+        }
+
+        template <class T>
+        static void EncodeArg(char *&cur, const T &v) {
+            constexpr uint8_t type = ArgType<T>();
+            *cur++ = type;
+            if constexpr (type == BIN_ARG_STRING) {
+                const char *s = ArgString(v);
+                uint32_t len = strlen(s);
+                memcpy(cur, &len, sizeof(len));
+                memcpy(cur + sizeof(len), s, len);
+                cur += sizeof(len) + len;
+                return;
+            } else if constexpr (type == BIN_ARG_POINTER) {
+                uint64_t u = reinterpret_cast<uintptr_t>(static_cast<const void *>(v));
+                memcpy(cur, &u, sizeof(u));
+            } else if constexpr (type == BIN_ARG_DOUBLE) {
+                double d = v;
+                memcpy(cur, &d, sizeof(d));
+            } else if constexpr (type == BIN_ARG_INT) {
+                int64_t i = static_cast<int64_t>(v);
+                memcpy(cur, &i, sizeof(i));
+            } else {
+                uint64_t u = static_cast<uint64_t>(v);
+                memcpy(cur, &u, sizeof(u));
+            }
+            cur += sizeof(uint64_t);
+        }
+    };
+}
+
+#endif
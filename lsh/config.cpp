@@ -1,5 +1,7 @@
 #include "config.h"
-#include <list>
+#include <deque>
+#include <unordered_set>
+#include <vector>
 
 namespace lsh {
     // 静态成员变量 s_datas 需要在 .cpp 文件 中定义
@@ -19,72 +21,300 @@ namespace lsh {
     //         level: "DEBUG"
     //         path: "/var/log/server.log"
     //
-    // ListAllMember 将嵌套结构转为键值对列表
-    // ("system.port", 8080)
-    // ("system.name", "MyServer")
-    // ("system.ports", {{"level" : "DEBUG"},{"path","/var/log/server.log"}})
-    // ("system.logs.level", "DEBUG")
-    // ("system.logs.path", "/var/log/server.log")
-    static void ListAllMember(const std::string &prefix,
-                              const YAML::Node &node,
-                              std::list<std::pair<std::string, const YAML::Node>> &output) {
-        // 如果 key 含有非法字符，则报错并返回
-        if (prefix.find_first_not_of("abcdefghigklmnopqrstuvwxyz._0123456789") != std::string::npos) {
-            LSH_LOG_ERROR(LSH_LOG_ROOT) << "Config invalid name: " << prefix << " : " << node;
-            return;
-        }
+    // 键名由路径拼接而成：system.port、system.name、system.logs、system.logs.level ...
+    // 只遍历一遍文档：
+    //  - 键名是已注册的配置项时，把这个节点直接交给它（ConfigVarBase::fromNode，不再序列化成字符串）
+    //  - 键名是某个配置项的前缀时才继续往下走，其它子树整棵跳过
 
-        // 将当前 (键名, 对应的 YAML 节点) 存入 output 列表
-        output.push_back(std::make_pair(prefix, node));
+    namespace {
+        struct YamlWalker {
+            const Config::ConfigVarMap &vars;
+            const std::unordered_set<std::string> &prefixes;
+            std::vector<std::pair<ConfigVarBase::ptr, YAML::Node>> &matched;
 
-        // 如果当前节点是一个 Map（即它包含子键值对）
-        if (node.IsMap()) {
-            for (auto it = node.begin(); it != node.end(); ++it) {
-                // 递归调用 ListAllMember，将 key 进行拼接形成 "A.B.C" 形式的键名
-                ListAllMember(prefix.empty() ? it->first.Scalar()
-                                             : prefix + "." + it->first.Scalar(),
-                              it->second, output);
+            void walk(const std::string &prefix, const YAML::Node &node) {
+                if (!node.IsMap()) {
+                    return;
+                }
+                std::string key;
+                for (auto it = node.begin(); it != node.end(); ++it) {
+                    key = prefix;
+                    if (!key.empty()) {
+                        key += '.';
+                    }
+                    key += it->first.Scalar();
+                    // 统一转换 key 为小写，确保大小写不敏感
+                    std::transform(key.begin() + prefix.size(), key.end(), key.begin() + prefix.size(), ::tolower);
+                    // 如果 key 含有非法字符，则报错并跳过这棵子树
+                    if (key.find_first_not_of("abcdefghijklmnopqrstuvwxyz._0123456789", prefix.size()) != std::string::npos) {
+                        LSH_LOG_ERROR(LSH_LOG_ROOT) << "Config invalid name: " << key << " : " << it->second;
+                        continue;
+                    }
+                    auto var = vars.find(key);
+                    if (var != vars.end()) {
+                        matched.emplace_back(var->second, it->second);
+                    }
+                    if (prefixes.count(key)) {
+                        walk(key, it->second);
+                    }
+                }
             }
+        };
+    }
+
+    void Config::MatchAll(const std::vector<YAML::Node> &roots,
+                          std::vector<std::pair<ConfigVarBase::ptr, YAML::Node>> &matched) {
+        RWMutexType::ReadLock lock(GetMutex());
+        ConfigVarMap &vars = GetDatas();
+        // 所有配置项名字的真前缀（以 '.' 为界），决定哪些子树需要往下走
+        std::unordered_set<std::string> prefixes;
+        for (auto &i : vars) {
+            const std::string &name = i.first;
+            for (size_t pos = name.find('.'); pos != std::string::npos; pos = name.find('.', pos + 1)) {
+                prefixes.insert(name.substr(0, pos));
+            }
+        }
+        YamlWalker walker{vars, prefixes, matched};
+        for (auto &root : roots) {
+            walker.walk("", root);
         }
     }
 
     void Config::LoadFromYaml(const YAML::Node &root) {
-        // 存储所有 (键名, YAML 节点)
-        std::list<std::pair<std::string, const YAML::Node>> all_nodes;
-
-        // 递归解析 YAML 文件，存入 all_nodes
-        // 传入 "" 作为初始前缀，表示从根节点开始，确保最上层的 key 没有前缀
-        ListAllMember("", root, all_nodes);
-        // for (auto [a, b] : all_nodes) {
-        //     std::cout << a << " ";
-        // }
-        // std::cout << std::endl;
-        // std::cout << all_nodes.size() << std::endl;
-        // 遍历所有解析出的 (键名, YAML 节点)
-        for (auto &i : all_nodes) {
-            std::string key = i.first;
-
-            // 如果 key 为空，则跳过
-            if (key.empty()) {
+        // 不持有全局锁提交，变更回调里可以再查找或创建配置项
+        Transaction trx(false);
+        trx.load({root});
+        trx.commit();
+    }
+
+    bool Config::LoadFromYamlAtomic(const std::vector<YAML::Node> &roots) {
+        Transaction trx;
+        trx.load(roots);
+        return trx.commit();
+    }
+
+    bool Config::Transaction::stage(ConfigVarBase::ptr var, ConfigVarBase::Pending::ptr pending) {
+        if (!pending) {
+            if (m_atomic) {
+                m_failed = true;
+            }
+            LSH_LOG_ERROR(LSH_LOG_ROOT) << "Config::Transaction invalid value for "
+                                        << (var ? var->getName() : std::string("<unknown>"))
+                                        << (m_atomic ? ", transaction aborted" : ", skipped");
+            return false;
+        }
+        auto it = m_index.find(var.get());
+        if (it != m_index.end()) {
+            m_changes[it->second] = pending;
+            return true;
+        }
+        m_index[var.get()] = m_changes.size();
+        m_vars.push_back(var);
+        m_changes.push_back(pending);
+        return true;
+    }
+
+    bool Config::Transaction::setString(const std::string &name, const std::string &str) {
+        ConfigVarBase::ptr var = LookupBase(name);
+        return stage(var, var ? var->prepareString(str) : nullptr);
+    }
+
+    bool Config::Transaction::setNode(const std::string &name, const YAML::Node &node) {
+        return setNode(LookupBase(name), node);
+    }
+
+    bool Config::Transaction::setNode(ConfigVarBase::ptr var, const YAML::Node &node) {
+        return stage(var, var ? var->prepareNode(node) : nullptr);
+    }
+
+    bool Config::Transaction::load(const std::vector<YAML::Node> &roots) {
+        std::vector<std::pair<ConfigVarBase::ptr, YAML::Node>> matched;
+        MatchAll(roots, matched);
+        bool ok = true;
+        for (auto &i : matched) {
+            ok = setNode(i.first, i.second) && ok;
+        }
+        return ok;
+    }
+
+    bool Config::Transaction::commit() {
+        if (m_failed) {
+            LSH_LOG_ERROR(LSH_LOG_ROOT) << "Config::Transaction commit rejected, " << m_changes.size()
+                                        << " staged change(s) dropped";
+            rollback();
+            return false;
+        }
+        std::vector<ConfigVarBase::Pending::ptr> changes;
+        changes.swap(m_changes);
+        std::vector<ConfigVarBase::ptr> vars;
+        vars.swap(m_vars);
+        m_index.clear();
+        ConfigVarBase::Commit(changes);
+        return true;
+    }
+
+    void Config::Transaction::rollback() {
+        m_failed = false;
+        m_vars.clear();
+        m_changes.clear();
+        m_index.clear();
+    }
+
+    namespace {
+        struct BatchListener {
+            std::string prefix;
+            Config::on_batch_change_call_back cb;
+            Scheduler *scheduler;
+        };
+
+        typedef std::map<uint64_t, BatchListener> BatchListenerMap;
+
+        BatchListenerMap &GetBatchListeners() {
+            static BatchListenerMap s_listeners;
+            return s_listeners;
+        }
+
+        RWMutex &GetBatchMutex() {
+            static RWMutex s_mutex;
+            return s_mutex;
+        }
+
+        /**
+         * 提交分两段：发布新值在 mutex 里完成，所有提交按这个顺序生效；
+         * 通知不持有任何锁，按发布顺序逐批执行，同一时刻只有一个提交者在通知（draining）。
+         * 回调里再次提交，或者回调让出协程时同一线程上的其它协程提交，都只是发布后排队，
+         * 由正在通知的提交者接着通知，不会重入也不会在另一个线程上释放锁。
+         * 其它线程上的提交者排队后等自己这一批通知完再返回（done），和没人在通知时一样是同步的。
+         */
+        struct CommitBatch {
+            std::vector<ConfigVarBase::Pending::ptr> changes;
+            Semaphore *done = nullptr; // 非空时通知完这一批后 notify
+        };
+
+        struct CommitQueue {
+            Mutex mutex;
+            std::deque<CommitBatch> batches;
+            bool draining = false;
+            pid_t drainer = 0; // 正在通知的线程
+        };
+
+        CommitQueue &GetCommitQueue() {
+            static CommitQueue s_queue;
+            return s_queue;
+        }
+    }
+
+    void Config::AddBatchListener(uint64_t key, const std::string &prefix,
+                                  on_batch_change_call_back cb, Scheduler *scheduler) {
+        RWMutex::WriteLock lock(GetBatchMutex());
+        GetBatchListeners()[key] = {prefix, cb, scheduler};
+    }
+
+    void Config::DelBatchListener(uint64_t key) {
+        RWMutex::WriteLock lock(GetBatchMutex());
+        GetBatchListeners().erase(key);
+    }
+
+    void Config::NotifyBatch(const std::vector<std::string> &changed) {
+        std::vector<BatchListener> listeners;
+        {
+            RWMutex::ReadLock lock(GetBatchMutex());
+            for (auto &i : GetBatchListeners()) {
+                listeners.push_back(i.second);
+            }
+        }
+        for (auto &i : listeners) {
+            std::vector<std::string> names;
+            for (auto &name : changed) {
+                if (name.compare(0, i.prefix.size(), i.prefix) == 0) {
+                    names.push_back(name);
+                }
+            }
+            if (names.empty()) {
                 continue;
             }
+            if (i.scheduler) {
+                on_batch_change_call_back cb = i.cb;
+                i.scheduler->schedule(std::function<void()>([cb, names]() { cb(names); }));
+            } else {
+                i.cb(names);
+            }
+        }
+    }
+
+    void ConfigVarBase::Commit(const std::vector<Pending::ptr> &changes) {
+        CommitQueue &queue = GetCommitQueue();
+        Semaphore done;
+        bool wait = false;
+        {
+            Mutex::Lock lock(queue.mutex);
+            // 先发布全部新值：回调里读到的都是这一批提交之后的值
+            std::vector<Pending::ptr> published;
+            published.reserve(changes.size());
+            for (auto &i : changes) {
+                if (i->publish()) {
+                    published.push_back(i);
+                }
+            }
+            if (published.empty()) {
+                return;
+            }
+            if (queue.draining) {
+                // 通知的线程就是自己（回调里再次提交，或者同一线程上的另一个协程）：等它会死锁，排队就返回
+                if (queue.drainer == GetThreadId()) {
+                    queue.batches.push_back({std::move(published), nullptr});
+                    return;
+                }
+                queue.batches.push_back({std::move(published), &done});
+                wait = true;
+            } else {
+                queue.batches.push_back({std::move(published), nullptr});
+                queue.draining = true;
+                queue.drainer = GetThreadId();
+            }
+        }
+        if (wait) {
+            done.wait();
+            return;
+        }
 
-            // 统一转换 key 为小写，确保大小写不敏感
-            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-
-            // 查找是否已存在该配置项
-            ConfigVarBase::ptr var = LookupBase(key);
-            if (var) {
-                // 如果是简单值（标量类型），直接解析并赋值
-                if (i.second.IsScalar()) {
-                    var->fromString(i.second.Scalar());
-                } else {
-                    // 如果是复杂结构（如列表、Map），转换为字符串再赋值
-                    std::stringstream ss;
-                    ss << i.second;
-                    var->fromString(ss.str());
+        while (true) {
+            CommitBatch batch;
+            {
+                Mutex::Lock lock(queue.mutex);
+                if (queue.batches.empty()) {
+                    queue.draining = false;
+                    queue.drainer = 0;
+                    return;
                 }
+                batch = std::move(queue.batches.front());
+                queue.batches.pop_front();
+            }
+            std::vector<std::string> names;
+            names.reserve(batch.changes.size());
+            for (auto &i : batch.changes) {
+                // 一个回调抛异常不影响其它配置项的通知
+                try {
+                    i->notify();
+                } catch (const std::exception &e) {
+                    LSH_LOG_ERROR(LSH_LOG_ROOT) << "Config listener of " << i->getVar()->getName()
+                                                << " exception: " << e.what();
+                } catch (...) {
+                    LSH_LOG_ERROR(LSH_LOG_ROOT) << "Config listener of " << i->getVar()->getName()
+                                                << " unknown exception";
+                }
+                names.push_back(i->getVar()->getName());
+            }
+            try {
+                Config::NotifyBatch(names);
+            } catch (const std::exception &e) {
+                LSH_LOG_ERROR(LSH_LOG_ROOT) << "Config batch listener exception: " << e.what();
+            } catch (...) {
+                LSH_LOG_ERROR(LSH_LOG_ROOT) << "Config batch listener unknown exception";
+            }
+            if (batch.done) {
+                batch.done->notify();
             }
         }
     }
-}
\ No newline at end of file
+}
@@ -2,16 +2,21 @@
 #define __LSH_CONFIG_H__
 
 #include "log.h"
+#include "scheduler.h"
 #include "singleton.h"
 #include "thread.h"
 #include <algorithm>
+#include <atomic>
 #include <boost/lexical_cast.hpp>
+#include <cstring>
 #include <functional>
 #include <list>
 #include <map>
 #include <memory>
 #include <set>
 #include <sstream>
+#include <stdexcept>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -22,14 +27,51 @@
 //  = lsh::Config::Creat("system.port", (int)8000, "system port");
 // 通过 yaml 文件加载配置，在解析过程中，查找约定过的配置进行覆盖
 
+/**
+ * @brief 编译期哈希的配置项名字，用于快速查找
+ *
+ *   auto &timeout = lsh::Config::Lookup<int>(LSH_CONFIG_KEY("tcp.connect.timeout"));
+ *
+ * 名字只能包含 [a-z0-9._]，否则编译失败。
+ */
+#define LSH_CONFIG_KEY(name) ::lsh::ConfigKey<::lsh::ConfigKeyCheck(name)> { name }
+
 namespace lsh {
 
+    // 配置项名字的哈希（FNV-1a 64 位），编译期和运行时结果一致
+    constexpr uint64_t ConfigKeyHash(const char *str) {
+        uint64_t hash = 14695981039346656037ull;
+        for (; *str; ++str) {
+            hash ^= static_cast<uint8_t>(*str);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // LSH_CONFIG_KEY 使用：名字非法时在编译期报错
+    consteval uint64_t ConfigKeyCheck(const char *name) {
+        for (const char *p = name; *p; ++p) {
+            if (!((*p >= 'a' && *p <= 'z') || (*p >= '0' && *p <= '9') || *p == '.' || *p == '_')) {
+                throw "config key must only contain [a-z0-9._]";
+            }
+        }
+        return ConfigKeyHash(name);
+    }
+
+    // 编译期确定的配置项名字，哈希值是类型的一部分
+    template <uint64_t Hash>
+    struct ConfigKey {
+        static constexpr uint64_t hash = Hash;
+        const char *name;
+    };
+
     // 配置基本信息
     class ConfigVarBase {
     public:
         typedef std::shared_ptr<ConfigVarBase> ptr;
         ConfigVarBase(const std::string &name, const std::string &description = "")
-            : m_name(name), m_description(description) {
+            : m_name(name), m_description(description),
+              m_cache_id(s_next_cache_id.fetch_add(1, std::memory_order_relaxed)) {
             // 转换为小写
             std::transform(m_name.begin(), m_name.end(), m_name.begin(), ::tolower);
         }
@@ -43,9 +85,78 @@ namespace lsh {
         virtual bool fromString(const std::string &str) = 0; // 反序列化
         virtual std::string getTypeName() const = 0;
 
+        /**
+         * @brief 一个已经转换、校验好，等待提交的新值
+         *
+         * 提交分两步：先 publish() 发布同一批的所有新值，全部发布完之后再逐个 notify()，
+         * 回调里读到的其它配置项已经是这一批的新值。
+         */
+        class Pending {
+        public:
+            typedef std::shared_ptr<Pending> ptr;
+            virtual ~Pending() {}
+
+            virtual ConfigVarBase *getVar() const = 0;
+            // 发布新值，和当前值相同时返回 false（不需要通知）
+            virtual bool publish() = 0;
+            // 以发布前的值为旧值通知监听器
+            virtual void notify() = 0;
+        };
+
+        /**
+         * @brief 只转换不赋值：成功时返回待提交的新值，转换或校验失败返回 nullptr
+         *
+         * ConfigVar 按类型直接转换节点，不再重新解析文本。
+         * 分成两步是为了整体提交：所有配置项都转换成功后才开始赋值（见 Config::Transaction）。
+         */
+        virtual Pending::ptr prepareNode(const YAML::Node &node) = 0;
+        virtual Pending::ptr prepareString(const std::string &str) = 0;
+
+        /**
+         * @brief 配置快照使用的二进制序列化（见 Config::SaveSnapshot）
+         */
+        virtual void toBinary(std::string &out) = 0;
+        virtual Pending::ptr prepareBinary(const char *data, size_t len) = 0;
+
+        /**
+         * @brief 直接从 YAML 节点反序列化并提交
+         */
+        bool fromNode(const YAML::Node &node) {
+            Pending::ptr pending = prepareNode(node);
+            if (!pending) {
+                return false;
+            }
+            Commit({pending});
+            return true;
+        }
+
+        /**
+         * @brief 提交一批新值
+         *
+         * 发布新值全局串行；发布后按提交顺序通知各配置项的监听器，再通知批量监听器
+         * （Config::AddBatchListener），通知时不持有锁。回调里可以再次提交（嵌套提交）：
+         * 新值立即发布，通知排在当前这一批之后。已有提交在通知时，其它提交只发布、排队，
+         * 由正在通知的提交者代为通知：别的线程上的提交者等自己这一批通知完再返回，
+         * 通知者所在线程上的提交（嵌套提交、同一线程上的其它协程）不等，否则会死锁。
+         * 因此监听器里不要等待别的线程上的 setValue/commit。
+         */
+        static void Commit(const std::vector<Pending::ptr> &changes);
+
+    protected:
+        // 线程局部缓存中的一项：持有某个版本的值快照，类型由 ConfigVar<T> 自己还原
+        struct CacheSlot {
+            uint64_t version{0};
+            std::shared_ptr<const void> value;
+        };
+
+        // 每个线程按 m_cache_id 下标缓存各配置变量最近读到的快照
+        static inline thread_local std::vector<CacheSlot> t_cache;
+        static inline std::atomic<uint32_t> s_next_cache_id{0};
+
     protected:
         std::string m_name;        // 配置变量的名称
         std::string m_description; // 配置变量的描述信息
+        uint32_t m_cache_id;       // 在线程局部缓存中的下标
     };
 
     // FromType -> ToType
@@ -59,6 +170,23 @@ namespace lsh {
         }
     };
 
+    // string -> bool：boost::lexical_cast 只认 "0"/"1"，这里再接受 YAML 的 true/false、yes/no、on/off
+    template <>
+    class LexicalCast<std::string, bool> {
+    public:
+        bool operator()(const std::string &v) {
+            std::string s(v);
+            std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+            if (s == "true" || s == "yes" || s == "on" || s == "y") {
+                return true;
+            }
+            if (s == "false" || s == "no" || s == "off" || s == "n") {
+                return false;
+            }
+            return boost::lexical_cast<bool>(v);
+        }
+    };
+
     // 对 vector 进行偏特化，支持 string -> vector
     template <class T>
     class LexicalCast<std::string, std::vector<T>> {
@@ -303,8 +431,267 @@ namespace lsh {
         }
     };
 
+    // YAML::Node -> T
+    // 容器按子节点递归转换，整个过程不把节点序列化成字符串再 YAML::Load；
+    // 其它类型默认交给 LexicalCast<std::string, T>（复杂类型需要先序列化一次），
+    // 自定义类型可以特化 NodeCast 直接读取节点
+    template <class T>
+    class NodeCast {
+    public:
+        T operator()(const YAML::Node &node) {
+            if (node.IsScalar()) {
+                return LexicalCast<std::string, T>()(node.Scalar());
+            }
+            std::stringstream ss;
+            ss << node;
+            return LexicalCast<std::string, T>()(ss.str());
+        }
+    };
+
+    template <>
+    class NodeCast<std::string> {
+    public:
+        std::string operator()(const YAML::Node &node) {
+            if (node.IsScalar()) {
+                return node.Scalar();
+            }
+            std::stringstream ss;
+            ss << node;
+            return ss.str();
+        }
+    };
+
+    template <class T>
+    class NodeCast<std::vector<T>> {
+    public:
+        std::vector<T> operator()(const YAML::Node &node) {
+            // 和 LexicalCast 一致：标量对应只有一个元素的 vector
+            if (node.IsScalar()) {
+                return {NodeCast<T>()(node)};
+            }
+            std::vector<T> vec;
+            vec.reserve(node.size());
+            for (auto it = node.begin(); it != node.end(); ++it) {
+                vec.push_back(NodeCast<T>()(*it));
+            }
+            return vec;
+        }
+    };
+
+    template <class T>
+    class NodeCast<std::list<T>> {
+    public:
+        std::list<T> operator()(const YAML::Node &node) {
+            if (node.IsScalar()) {
+                return {NodeCast<T>()(node)};
+            }
+            std::list<T> vec;
+            for (auto it = node.begin(); it != node.end(); ++it) {
+                vec.push_back(NodeCast<T>()(*it));
+            }
+            return vec;
+        }
+    };
+
+    template <class T>
+    class NodeCast<std::set<T>> {
+    public:
+        std::set<T> operator()(const YAML::Node &node) {
+            if (node.IsScalar()) {
+                return {NodeCast<T>()(node)};
+            }
+            std::set<T> vec;
+            for (auto it = node.begin(); it != node.end(); ++it) {
+                vec.emplace(NodeCast<T>()(*it));
+            }
+            return vec;
+        }
+    };
+
+    template <class T>
+    class NodeCast<std::unordered_set<T>> {
+    public:
+        std::unordered_set<T> operator()(const YAML::Node &node) {
+            if (node.IsScalar()) {
+                return {NodeCast<T>()(node)};
+            }
+            std::unordered_set<T> vec;
+            for (auto it = node.begin(); it != node.end(); ++it) {
+                vec.emplace(NodeCast<T>()(*it));
+            }
+            return vec;
+        }
+    };
+
+    template <class T>
+    class NodeCast<std::map<std::string, T>> {
+    public:
+        std::map<std::string, T> operator()(const YAML::Node &node) {
+            std::map<std::string, T> vec;
+            if (node.IsMap()) {
+                for (auto it = node.begin(); it != node.end(); ++it) {
+                    vec.emplace(it->first.Scalar(), NodeCast<T>()(it->second));
+                }
+            }
+            return vec;
+        }
+    };
+
+    template <class T>
+    class NodeCast<std::unordered_map<std::string, T>> {
+    public:
+        std::unordered_map<std::string, T> operator()(const YAML::Node &node) {
+            std::unordered_map<std::string, T> vec;
+            if (node.IsMap()) {
+                for (auto it = node.begin(); it != node.end(); ++it) {
+                    vec.emplace(it->first.Scalar(), NodeCast<T>()(it->second));
+                }
+            }
+            return vec;
+        }
+    };
+
+    // 读取二进制快照的游标，数据不够时抛 std::out_of_range
+    struct BinaryReader {
+        const char *pos;
+        const char *end;
+
+        void read(void *dst, size_t len) {
+            if (static_cast<size_t>(end - pos) < len) {
+                throw std::out_of_range("config snapshot truncated");
+            }
+            memcpy(dst, pos, len);
+            pos += len;
+        }
+
+        uint32_t readSize() {
+            uint32_t len = 0;
+            read(&len, sizeof(len));
+            return len;
+        }
+
+        std::string readString() {
+            uint32_t len = readSize();
+            if (static_cast<size_t>(end - pos) < len) {
+                throw std::out_of_range("config snapshot truncated");
+            }
+            std::string str(pos, len);
+            pos += len;
+            return str;
+        }
+    };
+
+    // 二进制快照里的长度和字符串：uint32 长度 + 内容（本机字节序）
+    inline void BinaryWriteSize(std::string &out, size_t len) {
+        uint32_t v = static_cast<uint32_t>(len);
+        out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+    }
+
+    inline void BinaryWriteString(std::string &out, const std::string &str) {
+        BinaryWriteSize(out, str.size());
+        out.append(str);
+    }
+
+    // T <-> 二进制（配置快照使用）
+    // 算术类型按字节保存，字符串和容器递归保存，启动时不需要再经过 YAML 和 LexicalCast；
+    // 其它类型默认保存 LexicalCast 的文本，自定义类型可以特化 BinaryCast
+    template <class T, class Enable = void>
+    class BinaryCast {
+    public:
+        void encode(const T &v, std::string &out) {
+            BinaryWriteString(out, LexicalCast<T, std::string>()(v));
+        }
+        T decode(BinaryReader &in) {
+            return LexicalCast<std::string, T>()(in.readString());
+        }
+    };
+
+    template <class T>
+    class BinaryCast<T, std::enable_if_t<std::is_arithmetic_v<T>>> {
+    public:
+        void encode(const T &v, std::string &out) {
+            out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+        }
+        T decode(BinaryReader &in) {
+            T v;
+            in.read(&v, sizeof(v));
+            return v;
+        }
+    };
+
+    template <>
+    class BinaryCast<std::string> {
+    public:
+        void encode(const std::string &v, std::string &out) {
+            BinaryWriteString(out, v);
+        }
+        std::string decode(BinaryReader &in) {
+            return in.readString();
+        }
+    };
+
+    // 顺序容器：元素个数 + 逐个元素
+    template <class C>
+    class BinarySequenceCast {
+    public:
+        void encode(const C &v, std::string &out) {
+            BinaryWriteSize(out, v.size());
+            for (auto &i : v) {
+                BinaryCast<typename C::value_type>().encode(i, out);
+            }
+        }
+        C decode(BinaryReader &in) {
+            C c;
+            uint32_t n = in.readSize();
+            for (uint32_t i = 0; i < n; i++) {
+                c.insert(c.end(), BinaryCast<typename C::value_type>().decode(in));
+            }
+            return c;
+        }
+    };
+
+    // string 为键的 map：元素个数 + 逐个 (键, 值)
+    template <class M>
+    class BinaryMapCast {
+    public:
+        void encode(const M &v, std::string &out) {
+            BinaryWriteSize(out, v.size());
+            for (auto &[key, value] : v) {
+                BinaryWriteString(out, key);
+                BinaryCast<typename M::mapped_type>().encode(value, out);
+            }
+        }
+        M decode(BinaryReader &in) {
+            M m;
+            uint32_t n = in.readSize();
+            for (uint32_t i = 0; i < n; i++) {
+                std::string key = in.readString();
+                m.emplace(std::move(key), BinaryCast<typename M::mapped_type>().decode(in));
+            }
+            return m;
+        }
+    };
+
+    template <class T>
+    class BinaryCast<std::vector<T>> : public BinarySequenceCast<std::vector<T>> {};
+    template <class T>
+    class BinaryCast<std::list<T>> : public BinarySequenceCast<std::list<T>> {};
+    template <class T>
+    class BinaryCast<std::set<T>> : public BinarySequenceCast<std::set<T>> {};
+    template <class T>
+    class BinaryCast<std::unordered_set<T>> : public BinarySequenceCast<std::unordered_set<T>> {};
+    template <class T>
+    class BinaryCast<std::map<std::string, T>> : public BinaryMapCast<std::map<std::string, T>> {};
+    template <class T>
+    class BinaryCast<std::unordered_map<std::string, T>> : public BinaryMapCast<std::unordered_map<std::string, T>> {};
+
     // FromStr: T operator()(const std::string&)
     // ToSTr: std:string operator()(const T&)
+    //
+    // 值以不可变的 shared_ptr<const T> 快照保存（RCU）：提交时构造新快照后原子替换并递增版本号，
+    // 读取不加锁。get() 先比较版本号和当前线程缓存的版本，没变时直接返回缓存快照的引用，
+    // 快路径只有一次原子读；版本变化后才重新 load 一次快照。
+    // 旧快照在最后一个缓存它的线程刷新（或退出）之后释放。
     template <class T, class FromStr = LexicalCast<std::string, T>,
               class ToStr = LexicalCast<T, std::string>>
     class ConfigVar : public ConfigVarBase {
@@ -314,65 +701,179 @@ namespace lsh {
 
         // 当一个配置更改时，需要返回到代码层面知道原来的值和新值
         typedef std::function<void(const T &old_value, const T &new_value)> on_change_call_back;
+        typedef std::function<bool(const T &value)> validator;
 
         ConfigVar(const std::string &name, const T &default_value, const std::string &description = "")
-            : ConfigVarBase(name, description), m_value(default_value) {}
+            : ConfigVarBase(name, description), m_value(std::make_shared<const T>(default_value)) {}
 
         // 把 m_value 转换为 std::string，用于存储或显示配置值
         std::string toString() override {
             try {
                 // return boost::lexical_cast<std::string>(m_value);
-                RWMutexType::ReadLock lock(m_mutex);
-                return ToStr()(m_value); // 适用通用类型
+                return ToStr()(*getSnapshot()); // 适用通用类型
             } catch (const std::exception &e) {
                 LSH_LOG_ERROR(LoggerMgr::GetInstance()->getRoot())
                     << "ConfigVar::toString exception"
                     << e.what() << " convert: "
-                    << typeid(m_value).name() << " to string";
+                    << typeid(T).name() << " to string";
             }
             return "";
         }
 
         // 从 std::string 解析 m_value，用于读取和设置配置
         bool fromString(const std::string &str) override {
+            Pending::ptr pending = prepareString(str);
+            if (!pending) {
+                return false;
+            }
+            Commit({pending});
+            return true;
+        }
+
+        Pending::ptr prepareString(const std::string &str) override {
             try {
                 // m_value = boost::lexical_cast<T>(str);
-                setValue(FromStr()(str)); // // 适用通用类型
-                return true;
+                return prepare(FromStr()(str)); // // 适用通用类型
             } catch (const std::exception &e) {
                 LSH_LOG_ERROR(LoggerMgr::GetInstance()->getRoot())
                     << "ConfigVar::fromString exception "
                     << e.what() << " convert: string to "
-                    << typeid(m_value).name();
+                    << typeid(T).name();
             }
-            return false;
+            return nullptr;
         }
 
-        const T getValue() const {
-            RWMutexType::ReadLock lock(m_mutex);
-            return m_value;
+        // 使用默认的 FromStr 时按节点直接转换；自定义了 FromStr 的把节点转成字符串交给它
+        Pending::ptr prepareNode(const YAML::Node &node) override {
+            try {
+                if constexpr (std::is_same_v<FromStr, LexicalCast<std::string, T>>) {
+                    return prepare(NodeCast<T>()(node));
+                } else if (node.IsScalar()) {
+                    return prepare(FromStr()(node.Scalar()));
+                } else {
+                    std::stringstream ss;
+                    ss << node;
+                    return prepare(FromStr()(ss.str()));
+                }
+            } catch (const std::exception &e) {
+                LSH_LOG_ERROR(LoggerMgr::GetInstance()->getRoot())
+                    << "ConfigVar::prepareNode exception "
+                    << e.what() << " name=" << m_name << " convert: node to "
+                    << typeid(T).name();
+            }
+            return nullptr;
         }
 
-        std::string getTypeName() const override { return typeid(T).name(); }
+        // 使用默认的 FromStr/ToStr 时按 BinaryCast 保存，否则保存 ToStr 的文本
+        void toBinary(std::string &out) override {
+            if constexpr (std::is_same_v<FromStr, LexicalCast<std::string, T>> &&
+                          std::is_same_v<ToStr, LexicalCast<T, std::string>>) {
+                BinaryCast<T>().encode(*getSnapshot(), out);
+            } else {
+                BinaryWriteString(out, ToStr()(*getSnapshot()));
+            }
+        }
+
+        Pending::ptr prepareBinary(const char *data, size_t len) override {
+            try {
+                BinaryReader in{data, data + len};
+                Pending::ptr pending;
+                if constexpr (std::is_same_v<FromStr, LexicalCast<std::string, T>> &&
+                              std::is_same_v<ToStr, LexicalCast<T, std::string>>) {
+                    pending = prepare(BinaryCast<T>().decode(in));
+                } else {
+                    pending = prepare(FromStr()(in.readString()));
+                }
+                if (in.pos != in.end) {
+                    throw std::length_error("trailing bytes");
+                }
+                return pending;
+            } catch (const std::exception &e) {
+                LSH_LOG_ERROR(LoggerMgr::GetInstance()->getRoot())
+                    << "ConfigVar::prepareBinary exception "
+                    << e.what() << " name=" << m_name << " convert: binary to "
+                    << typeid(T).name();
+            }
+            return nullptr;
+        }
 
-        void setValue(const T &val) {
+        /**
+         * @brief 校验并生成待提交的新值，没有通过 setValidator 的校验时返回 nullptr
+         */
+        Pending::ptr prepare(const T &val) {
             {
                 RWMutexType::ReadLock lock(m_mutex);
-                if (val == m_value) {
-                    return;
+                if (m_validator && !m_validator(val)) {
+                    LSH_LOG_ERROR(LoggerMgr::GetInstance()->getRoot())
+                        << "ConfigVar::prepare name=" << m_name << " rejected by validator";
+                    return nullptr;
                 }
-                for (auto &i : m_call_back_s) {
-                    i.second(m_value, val);
+            }
+            return std::make_shared<PendingValue>(this, std::make_shared<const T>(val));
+        }
+
+        const T getValue() const {
+            return get();
+        }
+
+        /**
+         * @brief 不拷贝地读取当前值
+         *
+         * 返回的引用指向当前线程缓存的快照，在当前线程下一次调用 get()/getValue()
+         * 发现值已经变化之前一直有效；需要长期持有请用 getSnapshot()。
+         */
+        const T &get() const {
+            uint64_t version = m_version.load(std::memory_order_acquire);
+            if (__builtin_expect(m_cache_id < t_cache.size(), 1)) {
+                CacheSlot &slot = t_cache[m_cache_id];
+                if (__builtin_expect(slot.version == version, 1)) {
+                    return *static_cast<const T *>(slot.value.get());
                 }
+            } else {
+                t_cache.resize(std::max<size_t>(m_cache_id + 1, s_next_cache_id.load(std::memory_order_relaxed)));
             }
+            CacheSlot &slot = t_cache[m_cache_id];
+            slot.value = getSnapshot();
+            slot.version = version;
+            return *static_cast<const T *>(slot.value.get());
+        }
+
+        // 当前值的不可变快照，可以跨线程长期持有
+        std::shared_ptr<const T> getSnapshot() const {
+            return m_value.load(std::memory_order_acquire);
+        }
+
+        std::string getTypeName() const override { return typeid(T).name(); }
+
+        /**
+         * @brief 修改值：相当于只有一个配置项的事务
+         *
+         * 新值返回前就已经发布，同步监听器返回前已经调用完：通常在本线程上调用；
+         * 另一个线程正在分发之前的提交时，排在它后面由那个线程调用，这里等它调用完再返回。
+         * 例外是在监听器里再次 setValue（或者同一线程上的协程在监听器让出时 setValue）：
+         * 通知排在当前这一批之后，这里不等就返回。
+         * @return 被校验器拒绝时返回 false
+         */
+        bool setValue(const T &val) {
+            Pending::ptr pending = prepare(val);
+            if (!pending) {
+                return false;
+            }
+            Commit({pending});
+            return true;
+        }
+
+        // 新值的校验函数，返回 false 时拒绝这次修改（所在的事务整体作废）
+        void setValidator(validator cb) {
             RWMutexType::WriteLock lock(m_mutex);
-            m_value = val;
+            m_validator = cb;
         }
 
         // 回调事件相关函数
-        void addListener(uint64_t key, on_change_call_back cb) {
+        // scheduler 不为空时，回调被放到该调度器上异步执行，不阻塞提交者
+        void addListener(uint64_t key, on_change_call_back cb, Scheduler *scheduler = nullptr) {
             RWMutexType::WriteLock lock(m_mutex);
-            m_call_back_s[key] = cb;
+            m_call_back_s[key] = {cb, scheduler};
         }
 
         void deleteListener(uint64_t key) {
@@ -388,15 +889,74 @@ namespace lsh {
         on_change_call_back getListener(uint64_t key) {
             RWMutexType::ReadLock lock(m_mutex);
             auto it = m_call_back_s.find(key);
-            return key == m_call_back_s.end() ? nullptr : it->second;
+            return it == m_call_back_s.end() ? nullptr : it->second.cb;
+        }
+
+    private:
+        struct Listener {
+            on_change_call_back cb;
+            Scheduler *scheduler;
+        };
+
+        class PendingValue : public Pending {
+        public:
+            PendingValue(ConfigVar *var, std::shared_ptr<const T> value)
+                : m_var(var), m_new(std::move(value)) {}
+
+            ConfigVarBase *getVar() const override { return m_var; }
+            bool publish() override { return m_var->exchange(m_new, m_old); }
+            void notify() override { m_var->notify(m_old, m_new); }
+
+        private:
+            ConfigVar *m_var;
+            std::shared_ptr<const T> m_new;
+            std::shared_ptr<const T> m_old; // publish 时记录的旧值
+        };
+
+        // 写者已经由 Commit 串行，读者不受影响
+        bool exchange(const std::shared_ptr<const T> &value, std::shared_ptr<const T> &old_value) {
+            old_value = getSnapshot();
+            if (*value == *old_value) {
+                return false;
+            }
+            m_value.store(value, std::memory_order_release);
+            // 先发布快照再递增版本，读者看到新版本时一定能 load 到新快照
+            m_version.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+
+        void notify(const std::shared_ptr<const T> &old_value, const std::shared_ptr<const T> &new_value) {
+            // 先拷贝出来再调用，回调里可以增删监听器
+            std::vector<Listener> listeners;
+            {
+                RWMutexType::ReadLock lock(m_mutex);
+                listeners.reserve(m_call_back_s.size());
+                for (auto &i : m_call_back_s) {
+                    listeners.push_back(i.second);
+                }
+            }
+            for (auto &i : listeners) {
+                if (i.scheduler) {
+                    // 快照不可变，异步回调持有它们即可
+                    on_change_call_back cb = i.cb;
+                    i.scheduler->schedule(std::function<void()>([cb, old_value, new_value]() {
+                        cb(*old_value, *new_value);
+                    }));
+                } else {
+                    i.cb(*old_value, *new_value);
+                }
+            }
         }
 
     private:
-        T m_value;
+        std::atomic<std::shared_ptr<const T>> m_value;
+        // 从 1 开始，线程缓存初始的 0 一定不匹配
+        std::atomic<uint64_t> m_version{1};
 
         // 变更回调函数组, uint64_t key, 要求唯一
-        std::map<uint64_t, on_change_call_back> m_call_back_s;
-        mutable RWMutexType m_mutex;
+        std::map<uint64_t, Listener> m_call_back_s;
+        validator m_validator;
+        mutable RWMutexType m_mutex; // 保护 m_call_back_s 和 m_validator
     };
 
     class Config {
@@ -460,11 +1020,29 @@ namespace lsh {
                 throw std::invalid_argument(name);
             }
 
+            // 名字的哈希也要唯一，LSH_CONFIG_KEY 按哈希查找
+            uint64_t hash = ConfigKeyHash(name.c_str());
+            auto collision = GetHashes().find(hash);
+            if (collision != GetHashes().end()) {
+                LSH_LOG_ERROR(LSH_LOG_ROOT) << "Config name " << name << " has the same hash as "
+                                            << collision->second->getName();
+                throw std::runtime_error("Config key hash collision: " + name + " and " +
+                                         collision->second->getName());
+            }
+
             typename ConfigVar<T>::ptr v = std::make_shared<ConfigVar<T>>(name, default_value, description);
             GetDatas()[name] = v;
+            GetHashes()[hash] = v;
             return v;
         }
 
+        template <class T, uint64_t Hash>
+        static typename ConfigVar<T>::ptr Creat(ConfigKey<Hash> key,
+                                                const T &default_value,
+                                                const std::string &description = "") {
+            return Creat(std::string(key.name), default_value, description);
+        }
+
         template <class T>
         static typename ConfigVar<T>::ptr Lookup(const std::string &name) {
             // // 转换为小写
@@ -477,10 +1055,144 @@ namespace lsh {
             return std::dynamic_pointer_cast<ConfigVar<T>>(it->second);
         }
 
+        /**
+         * @brief 按编译期哈希的名字查找（LSH_CONFIG_KEY）
+         *
+         * 每个 (T, 名字) 对应一个静态槽，第一次查找成功后缓存在槽里，
+         * 之后只有一次原子读：不计算字符串哈希、不加锁、不做 dynamic_pointer_cast。
+         * 配置项不存在或者类型不是 T 时返回空指针，下次调用重新查找。
+         */
+        template <class T, uint64_t Hash>
+        static const typename ConfigVar<T>::ptr &Lookup(ConfigKey<Hash> key) {
+            typedef KeySlot<T, Hash> Slot;
+            if (__builtin_expect(Slot::s_ready.load(std::memory_order_acquire), 1)) {
+                return Slot::s_var;
+            }
+            return Resolve<T>(key);
+        }
+
+        /**
+         * @brief 配置事务：暂存多个修改，全部校验通过后一次提交
+         *
+         * set 时就完成类型转换和 setValidator 的校验；atomic 模式下任何一项失败整个事务作废，
+         * commit 什么都不改并返回 false。提交时先发布所有新值再通知：
+         * 同一个配置项在事务里改了多次只通知一次（旧值是提交前的值），
+         * 批量监听器（AddBatchListener）每次提交最多通知一次。
+         * 没有 commit 就析构的事务被丢弃。
+         *
+         *   Config::Transaction trx;
+         *   trx.set(g_port, 8080);
+         *   trx.set("server.name", std::string("lsh"));
+         *   trx.setNode("server.hosts", node);
+         *   if (!trx.commit()) { ... }
+         */
+        class Transaction : Noncopyable {
+        public:
+            /**
+             * @param atomic 为 false 时失败的项只是被跳过，其余照常提交（LoadFromYaml 的语义）
+             */
+            Transaction(bool atomic = true) : m_atomic(atomic) {}
+
+            template <class Var, class T>
+            bool set(const std::shared_ptr<Var> &var, const T &value) {
+                return stage(var, var ? var->prepare(value) : nullptr);
+            }
+
+            // 按名字修改，配置项不存在或者类型不是 T 时失败
+            template <class T>
+            bool set(const std::string &name, const T &value) {
+                return set(Lookup<T>(name), value);
+            }
+
+            bool setString(const std::string &name, const std::string &str);
+            bool setNode(const std::string &name, const YAML::Node &node);
+            bool setNode(ConfigVarBase::ptr var, const YAML::Node &node);
+
+            // 暂存多个 YAML 文档中所有已注册的配置项（按顺序，后面的覆盖前面的）
+            bool load(const std::vector<YAML::Node> &roots);
+
+            /**
+             * @brief 提交并清空事务；atomic 模式下有失败的项时什么都不改，返回 false
+             *
+             * 和 setValue 一样：返回时新值已经可见，同步监听器已经执行完
+             * （在监听器里 commit 时例外，通知排在当前这一批之后）。
+             */
+            bool commit();
+            // 放弃所有暂存的修改
+            void rollback();
+
+            bool failed() const { return m_failed; }
+            size_t size() const { return m_changes.size(); }
+            // 暂存了修改的配置项，提交后清空
+            const std::vector<ConfigVarBase::ptr> &getVars() const { return m_vars; }
+
+        private:
+            bool stage(ConfigVarBase::ptr var, ConfigVarBase::Pending::ptr pending);
+
+        private:
+            bool m_atomic;
+            bool m_failed{false};
+            std::vector<ConfigVarBase::ptr> m_vars; // 保证提交前配置项不被释放
+            std::vector<ConfigVarBase::Pending::ptr> m_changes;
+            std::unordered_map<ConfigVarBase *, size_t> m_index; // 同一个配置项只保留最后一次修改
+        };
+
+        // 一次提交中发生变化、且名字以 prefix 开头的配置项名字（按提交顺序）
+        typedef std::function<void(const std::vector<std::string> &changed)> on_batch_change_call_back;
+
+        /**
+         * @brief 注册批量监听器：一次提交改了多个相关配置项时只回调一次
+         * @param prefix 关心的配置项名字前缀，空串表示全部
+         * @param scheduler 不为空时回调放到该调度器上异步执行
+         */
+        static void AddBatchListener(uint64_t key, const std::string &prefix,
+                                     on_batch_change_call_back cb, Scheduler *scheduler = nullptr);
+        static void DelBatchListener(uint64_t key);
+
         // 为了 Yaml 与 config.h 整合
-        // 解析 YAML 配置，并加载到 ConfigVar 实例中
+        // 解析 YAML 配置，并加载到 ConfigVar 实例中；转换失败的配置项被跳过，其余作为一个事务提交
         static void LoadFromYaml(const YAML::Node &root);
 
+        /**
+         * @brief 整体加载多个 YAML 文档（按顺序，后面的覆盖前面的）
+         *
+         * 作为一个 atomic 事务：任何一个配置项转换失败就什么都不改并返回 false；
+         * 全部成功后一次提交（触发 addListener 注册的回调）。配置热加载使用。
+         */
+        static bool LoadFromYamlAtomic(const std::vector<YAML::Node> &roots);
+
+        /**
+         * @brief 把 vars 的当前值保存为二进制快照
+         *
+         * 只应保存由配置源决定的配置项：其它配置项的值（默认值、命令行覆盖等）不受 source_hash 约束，
+         * 存进快照后换了默认值的新程序也会读回旧值。
+         * 格式：头部（magic、格式版本、source_hash、已注册配置项的名字和类型的哈希、项数），
+         * 之后每项是 名字、类型名、值（BinaryCast），长度都是 uint32，本机字节序。
+         * 先写临时文件再 rename，读者不会看到写了一半的快照。
+         * @param source_hash 生成这些值的配置源（例如 YAML 文件内容）的哈希，加载时用来判断快照是否过期
+         */
+        static bool SaveSnapshot(const std::string &path, uint64_t source_hash,
+                                 const std::vector<ConfigVarBase::ptr> &vars);
+
+        /**
+         * @brief mmap 快照并作为一个 atomic 事务整体加载
+         *
+         * 文件不存在、格式版本或 source_hash 不一致、注册的配置项有变化、任何一项解码失败时
+         * 什么都不改，返回 false。
+         */
+        static bool LoadSnapshot(const std::string &path, uint64_t source_hash);
+
+        /**
+         * @brief 加载 YAML 文件，用快照加速冷启动
+         *
+         * 按文件内容算哈希：和快照匹配时直接加载快照，不解析 YAML；
+         * 否则按顺序完整解析所有文件（同 LoadFromYaml），再用 YAML 中出现的配置项重新生成快照。
+         * @param from_snapshot 不为空时返回这次是否来自快照
+         * @return 文件读取或者 YAML 解析失败时返回 false
+         */
+        static bool LoadFromYamlCached(const std::vector<std::string> &files, const std::string &snapshot_path,
+                                       bool *from_snapshot = nullptr);
+
         static ConfigVarBase::ptr LookupBase(const std::string &name);
 
         static void Visit(std::function<void(ConfigVarBase::ptr)> cb) {
@@ -492,6 +1204,15 @@ namespace lsh {
         }
 
     private:
+        friend class ConfigVarBase;
+
+        // 找出文档中所有已注册配置项对应的节点，按文档顺序追加到 matched
+        static void MatchAll(const std::vector<YAML::Node> &roots,
+                             std::vector<std::pair<ConfigVarBase::ptr, YAML::Node>> &matched);
+
+        // 提交结束后通知批量监听器，changed 为这次提交中发生变化的配置项
+        static void NotifyBatch(const std::vector<std::string> &changed);
+
         // 多态
         // 在 creat 方法中向里边添加配置
         // 实际指向 ConfigVar<T> 类型，其中 T 在调用 creat 是被确定
@@ -507,6 +1228,43 @@ namespace lsh {
             return s_datas;
         }
 
+        // 名字哈希 -> 配置项，LSH_CONFIG_KEY 的慢路径使用
+        static std::unordered_map<uint64_t, ConfigVarBase::ptr> &GetHashes() {
+            static std::unordered_map<uint64_t, ConfigVarBase::ptr> s_hashes;
+            return s_hashes;
+        }
+
+        // 配置项只增不删，槽一旦填上就不再改变
+        template <class T, uint64_t Hash>
+        struct KeySlot {
+            static inline std::atomic<bool> s_ready{false};
+            static inline typename ConfigVar<T>::ptr s_var;
+        };
+
+        template <class T, uint64_t Hash>
+        static const typename ConfigVar<T>::ptr &Resolve(ConfigKey<Hash> key) {
+            typedef KeySlot<T, Hash> Slot;
+            static const typename ConfigVar<T>::ptr s_null;
+            RWMutexType::WriteLock lock(GetMutex());
+            if (Slot::s_ready.load(std::memory_order_relaxed)) {
+                return Slot::s_var;
+            }
+            auto it = GetHashes().find(Hash);
+            if (it == GetHashes().end()) {
+                return s_null;
+            }
+            typename ConfigVar<T>::ptr var = std::dynamic_pointer_cast<ConfigVar<T>>(it->second);
+            if (!var) {
+                LSH_LOG_ERROR(LSH_LOG_ROOT) << "Lookup name = " << key.name << " exists but type is not "
+                                            << typeid(T).name() << "! The real type is "
+                                            << it->second->getTypeName();
+                return s_null;
+            }
+            Slot::s_var = var;
+            Slot::s_ready.store(true, std::memory_order_release);
+            return Slot::s_var;
+        }
+
         static RWMutexType &GetMutex() {
             static RWMutexType s_mutex;
             return s_mutex;
@@ -0,0 +1,212 @@
+#include "config.h"
+#include "log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lsh {
+    static std::shared_ptr<Logger> g_logger = LSH_LOG_NAME("system");
+
+    static const char s_snapshot_magic[8] = {'L', 'S', 'H', 'C', 'O', 'N', 'F', '\0'};
+    // 格式有变化时递增，旧快照自动失效
+    // 2：只保存配置源中出现的配置项（1 保存了所有配置项，包括默认值）
+    static const uint32_t s_snapshot_version = 2;
+
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t count;        // 保存的配置项个数
+        uint64_t source_hash;  // 配置源的哈希
+        uint64_t schema_hash;  // 已注册配置项（名字 + 类型）的哈希
+    };
+
+    // FNV-1a 64，可以分段累加
+    static uint64_t HashBytes(const void *data, size_t len, uint64_t hash = 14695981039346656037ull) {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < len; i++) {
+            hash ^= p[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static void SortByName(std::vector<ConfigVarBase::ptr> &vars) {
+        std::sort(vars.begin(), vars.end(), [](const ConfigVarBase::ptr &a, const ConfigVarBase::ptr &b) {
+            return a->getName() < b->getName();
+        });
+    }
+
+    // 按名字排序的所有配置项
+    static std::vector<ConfigVarBase::ptr> SortedVars() {
+        std::vector<ConfigVarBase::ptr> vars;
+        Config::Visit([&vars](ConfigVarBase::ptr var) { vars.push_back(var); });
+        SortByName(vars);
+        return vars;
+    }
+
+    // 新增、删除配置项或者改了类型，旧快照就不能再用
+    static uint64_t SchemaHash(const std::vector<ConfigVarBase::ptr> &vars) {
+        uint64_t hash = HashBytes(nullptr, 0);
+        for (auto &var : vars) {
+            std::string type = var->getTypeName();
+            hash = HashBytes(var->getName().c_str(), var->getName().size() + 1, hash);
+            hash = HashBytes(type.c_str(), type.size() + 1, hash);
+        }
+        return hash;
+    }
+
+    bool Config::SaveSnapshot(const std::string &path, uint64_t source_hash,
+                              const std::vector<ConfigVarBase::ptr> &saved) {
+        std::vector<ConfigVarBase::ptr> vars = saved;
+        SortByName(vars);
+        SnapshotHeader header;
+        memcpy(header.magic, s_snapshot_magic, sizeof(header.magic));
+        header.version = s_snapshot_version;
+        header.count = vars.size();
+        header.source_hash = source_hash;
+        // 注册的配置项有变化（比如 YAML 里原来没有对应配置项的键现在有了）快照就过期
+        header.schema_hash = SchemaHash(SortedVars());
+
+        std::string data(reinterpret_cast<const char *>(&header), sizeof(header));
+        std::string value;
+        for (auto &var : vars) {
+            value.clear();
+            var->toBinary(value);
+            BinaryWriteString(data, var->getName());
+            BinaryWriteString(data, var->getTypeName());
+            BinaryWriteString(data, value);
+        }
+
+        std::string tmp = path + ".tmp." + std::to_string(getpid());
+        {
+            std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+            if (!ofs || !ofs.write(data.data(), data.size())) {
+                LSH_LOG_ERROR(g_logger) << "Config::SaveSnapshot write " << tmp << " failed errno="
+                                        << errno << " " << strerror(errno);
+                unlink(tmp.c_str());
+                return false;
+            }
+        }
+        if (rename(tmp.c_str(), path.c_str()) != 0) {
+            LSH_LOG_ERROR(g_logger) << "Config::SaveSnapshot rename " << tmp << " failed errno="
+                                    << errno << " " << strerror(errno);
+            unlink(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool Config::LoadSnapshot(const std::string &path, uint64_t source_hash) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+            close(fd);
+            return false;
+        }
+        size_t size = st.st_size;
+        void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) {
+            LSH_LOG_ERROR(g_logger) << "Config::LoadSnapshot mmap " << path << " failed errno="
+                                    << errno << " " << strerror(errno);
+            return false;
+        }
+
+        const char *begin = static_cast<const char *>(addr);
+        SnapshotHeader header;
+        memcpy(&header, begin, sizeof(header));
+        std::vector<ConfigVarBase::Pending::ptr> changes;
+        bool ok = memcmp(header.magic, s_snapshot_magic, sizeof(header.magic)) == 0 &&
+                  header.version == s_snapshot_version && header.source_hash == source_hash;
+        ok = ok && header.schema_hash == SchemaHash(SortedVars());
+        if (ok) {
+            // 先全部解码，任何一项失败都不提交
+            try {
+                BinaryReader in{begin + sizeof(header), begin + size};
+                changes.reserve(header.count);
+                for (uint32_t i = 0; ok && i < header.count; i++) {
+                    std::string name = in.readString();
+                    std::string type = in.readString();
+                    uint32_t len = in.readSize();
+                    if (static_cast<size_t>(in.end - in.pos) < len) {
+                        throw std::out_of_range("config snapshot truncated");
+                    }
+                    ConfigVarBase::ptr var = LookupBase(name);
+                    ConfigVarBase::Pending::ptr pending;
+                    if (var && var->getTypeName() == type) {
+                        pending = var->prepareBinary(in.pos, len);
+                    }
+                    in.pos += len;
+                    ok = pending != nullptr;
+                    changes.push_back(pending);
+                }
+                ok = ok && in.pos == in.end;
+            } catch (const std::exception &e) {
+                LSH_LOG_ERROR(g_logger) << "Config::LoadSnapshot " << path << " corrupted: " << e.what();
+                ok = false;
+            }
+        }
+        munmap(addr, size);
+
+        if (!ok) {
+            LSH_LOG_INFO(g_logger) << "Config::LoadSnapshot " << path << " is stale or invalid, ignored";
+            return false;
+        }
+        ConfigVarBase::Commit(changes);
+        return true;
+    }
+
+    bool Config::LoadFromYamlCached(const std::vector<std::string> &files, const std::string &snapshot_path,
+                                    bool *from_snapshot) {
+        if (from_snapshot) {
+            *from_snapshot = false;
+        }
+        std::vector<std::string> contents;
+        uint64_t hash = HashBytes(nullptr, 0);
+        for (auto &file : files) {
+            std::ifstream ifs(file, std::ios::binary);
+            if (!ifs) {
+                LSH_LOG_ERROR(g_logger) << "Config::LoadFromYamlCached open " << file << " failed";
+                return false;
+            }
+            contents.emplace_back(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+            uint64_t len = contents.back().size();
+            hash = HashBytes(&len, sizeof(len), hash);
+            hash = HashBytes(contents.back().data(), contents.back().size(), hash);
+        }
+
+        if (LoadSnapshot(snapshot_path, hash)) {
+            if (from_snapshot) {
+                *from_snapshot = true;
+            }
+            return true;
+        }
+
+        std::vector<YAML::Node> roots;
+        for (size_t i = 0; i < contents.size(); i++) {
+            try {
+                roots.push_back(YAML::Load(contents[i]));
+            } catch (const std::exception &e) {
+                LSH_LOG_ERROR(g_logger) << "Config::LoadFromYamlCached parse " << files[i] << " failed: " << e.what();
+                return false;
+            }
+        }
+        Transaction trx(false);
+        trx.load(roots);
+        // 只保存 YAML 决定的配置项，默认值和加载前的覆盖不进快照
+        std::vector<ConfigVarBase::ptr> vars = trx.getVars();
+        trx.commit();
+        if (!SaveSnapshot(snapshot_path, hash, vars)) {
+            LSH_LOG_WARN(g_logger) << "Config::LoadFromYamlCached save snapshot " << snapshot_path << " failed";
+        }
+        return true;
+    }
+}
@@ -0,0 +1,236 @@
+#include "config_watcher.h"
+#include "config.h"
+#include "log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace lsh {
+    static std::shared_ptr<Logger> g_logger = LSH_LOG_NAME("system");
+
+    // 会改变文件内容的事件；IN_CLOSE_WRITE 而不是 IN_MODIFY，写到一半不会触发
+    static const uint32_t s_watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE;
+
+    static bool IsYamlFile(const std::string &name) {
+        auto ends_with = [&name](const char *suffix) {
+            size_t n = strlen(suffix);
+            return name.size() > n && name.compare(name.size() - n, n, suffix) == 0;
+        };
+        return ends_with(".yml") || ends_with(".yaml");
+    }
+
+    ConfigWatcher::ConfigWatcher(IOManager *iom, uint64_t debounce_ms)
+        : m_iom(iom), m_debounce_ms(debounce_ms) {
+        m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_fd < 0) {
+            LSH_LOG_ERROR(g_logger) << "ConfigWatcher inotify_init1 failed errno=" << errno << " " << strerror(errno);
+        }
+    }
+
+    ConfigWatcher::~ConfigWatcher() {
+        stop();
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    bool ConfigWatcher::watchDir(const std::string &dir) {
+        int wd = inotify_add_watch(m_fd, dir.c_str(), s_watch_mask);
+        if (wd < 0) {
+            LSH_LOG_ERROR(g_logger) << "ConfigWatcher inotify_add_watch " << dir << " failed errno="
+                                    << errno << " " << strerror(errno);
+            return false;
+        }
+        m_watches[wd] = dir;
+        return true;
+    }
+
+    bool ConfigWatcher::addPath(const std::string &path) {
+        if (m_fd < 0) {
+            return false;
+        }
+        std::error_code ec;
+        std::filesystem::path p = std::filesystem::absolute(path, ec).lexically_normal();
+        if (ec) {
+            return false;
+        }
+        bool is_dir = std::filesystem::is_directory(p, ec);
+        std::string dir = is_dir ? p.string() : p.parent_path().string();
+        if (!dir.empty() && dir.size() > 1 && dir.back() == '/') {
+            dir.pop_back();
+        }
+
+        MutexType::Lock lock(m_mutex);
+        if (!watchDir(dir)) {
+            return false;
+        }
+        if (is_dir) {
+            m_dirs.insert(dir);
+            m_paths.push_back(dir);
+        } else {
+            m_files.insert(p.string());
+            m_paths.push_back(p.string());
+        }
+        return true;
+    }
+
+    bool ConfigWatcher::start() {
+        MutexType::Lock lock(m_mutex);
+        if (m_fd < 0 || m_started) {
+            return m_started;
+        }
+        m_started = true;
+        m_stopping = false;
+        // addEvent 记录的是当前线程的调度器，要在 IOManager 的线程里注册
+        std::weak_ptr<ConfigWatcher> weak = shared_from_this();
+        m_iom->schedule(std::function<void()>([weak]() {
+            if (auto self = weak.lock()) {
+                MutexType::Lock lock(self->m_mutex);
+                self->arm();
+            }
+        }));
+        return true;
+    }
+
+    void ConfigWatcher::arm() {
+        if (m_stopping) {
+            m_started = false;
+            return;
+        }
+        std::weak_ptr<ConfigWatcher> weak = shared_from_this();
+        if (m_iom->addEvent(m_fd, IOManager::READ, [weak]() {
+                if (auto self = weak.lock()) {
+                    self->onReadable();
+                }
+            }) != 0) {
+            LSH_LOG_ERROR(g_logger) << "ConfigWatcher addEvent fd=" << m_fd << " failed";
+            m_started = false;
+        }
+    }
+
+    void ConfigWatcher::stop() {
+        MutexType::Lock lock(m_mutex);
+        m_stopping = true;
+        if (m_started) {
+            m_iom->delEvent(m_fd, IOManager::READ);
+            m_started = false;
+        }
+        if (m_timer) {
+            m_timer->cancel();
+            m_timer.reset();
+        }
+    }
+
+    bool ConfigWatcher::isRelevant(int wd, const char *name) {
+        auto it = m_watches.find(wd);
+        if (it == m_watches.end()) {
+            return false;
+        }
+        std::string file = it->second + "/" + name;
+        return m_files.count(file) || (m_dirs.count(it->second) && IsYamlFile(name));
+    }
+
+    void ConfigWatcher::onReadable() {
+        // 事件是一次性的：读完之后重新注册
+        alignas(struct inotify_event) char buf[4096];
+        bool changed = false;
+        while (true) {
+            ssize_t n = ::read(m_fd, buf, sizeof(buf));
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            MutexType::Lock lock(m_mutex);
+            for (char *p = buf; p < buf + n;) {
+                struct inotify_event *event = reinterpret_cast<struct inotify_event *>(p);
+                if (event->mask & IN_Q_OVERFLOW) {
+                    changed = true;
+                } else if (event->len && isRelevant(event->wd, event->name)) {
+                    changed = true;
+                }
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        if (changed) {
+            scheduleReload();
+        }
+
+        MutexType::Lock lock(m_mutex);
+        arm();
+    }
+
+    void ConfigWatcher::scheduleReload() {
+        MutexType::Lock lock(m_mutex);
+        if (m_stopping) {
+            return;
+        }
+        // 定时器还没到期就往后推，连续保存多次只加载一次
+        if (m_timer && m_timer->reset(m_debounce_ms, true)) {
+            return;
+        }
+        std::weak_ptr<ConfigWatcher> weak = shared_from_this();
+        m_timer = m_iom->addContionTimer(m_debounce_ms, [weak]() {
+            auto self = weak.lock();
+            if (!self) {
+                return;
+            }
+            {
+                MutexType::Lock lock(self->m_mutex);
+                self->m_timer.reset();
+            }
+            self->reload(); }, weak);
+    }
+
+    std::vector<std::string> ConfigWatcher::listFiles() {
+        MutexType::Lock lock(m_mutex);
+        std::vector<std::string> files;
+        for (auto &path : m_paths) {
+            if (!m_dirs.count(path)) {
+                files.push_back(path);
+                continue;
+            }
+            std::vector<std::string> entries;
+            std::error_code ec;
+            for (auto &entry : std::filesystem::directory_iterator(path, ec)) {
+                if (entry.is_regular_file(ec) && IsYamlFile(entry.path().filename().string())) {
+                    entries.push_back(entry.path().string());
+                }
+            }
+            std::sort(entries.begin(), entries.end());
+            files.insert(files.end(), entries.begin(), entries.end());
+        }
+        return files;
+    }
+
+    bool ConfigWatcher::reload() {
+        MutexType::Lock lock(m_reload_mutex);
+        std::vector<YAML::Node> roots;
+        for (auto &file : listFiles()) {
+            if (access(file.c_str(), F_OK) != 0) {
+                // 被删除或者正在被替换：跳过，替换完成后还会再触发一次
+                LSH_LOG_WARN(g_logger) << "ConfigWatcher skip missing file " << file;
+                continue;
+            }
+            try {
+                roots.push_back(YAML::LoadFile(file));
+            } catch (const std::exception &e) {
+                LSH_LOG_ERROR(g_logger) << "ConfigWatcher reload rejected: parse " << file << " failed: " << e.what();
+                ++m_rejects;
+                return false;
+            }
+        }
+        if (!Config::LoadFromYamlAtomic(roots)) {
+            LSH_LOG_ERROR(g_logger) << "ConfigWatcher reload rejected, config unchanged";
+            ++m_rejects;
+            return false;
+        }
+        ++m_reloads;
+        LSH_LOG_INFO(g_logger) << "ConfigWatcher reloaded " << roots.size() << " file(s)";
+        return true;
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef __LSH_CONFIG_WATCHER_H__
+#define __LSH_CONFIG_WATCHER_H__
+
+#include "IOManager.h"
+#include "noncopyable.h"
+#include "thread.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace lsh {
+    /**
+     * @brief 用 inotify 监视配置文件，变化后自动重新加载（热加载）
+     *
+     * inotify 的 fd 通过 IOManager::addEvent(READ) 注册，事件回调在 IOManager 的协程里执行，
+     * 只读出事件、(重新)设置一个防抖定时器；定时器到期后在工作协程里解析所有文件，
+     * 用 Config::LoadFromYamlAtomic 整体加载：任何一个配置项转换失败就整批放弃，
+     * 成功时照常触发 addListener 注册的回调。
+     *
+     * 监视文件时实际监视它所在的目录，编辑器"写临时文件再 rename"的保存方式也能发现。
+     * 监视目录时加载其中所有 .yml/.yaml 文件（按文件名排序，后面的覆盖前面的）。
+     *
+     * 使用：
+     *   ConfigWatcher::ptr watcher(new ConfigWatcher(iom));
+     *   watcher->addPath("conf/");
+     *   watcher->start();
+     *   ...
+     *   watcher->stop(); // 在 iom 停止之前，否则注册着的读事件会让 IOManager::stop 一直等待
+     */
+    class ConfigWatcher : public std::enable_shared_from_this<ConfigWatcher>, Noncopyable {
+    public:
+        typedef std::shared_ptr<ConfigWatcher> ptr;
+        typedef Mutex MutexType;
+
+        ConfigWatcher(IOManager *iom, uint64_t debounce_ms = 200);
+        ~ConfigWatcher();
+
+        /**
+         * @brief 增加一个要监视的文件或目录
+         */
+        bool addPath(const std::string &path);
+
+        /**
+         * @brief 把 inotify fd 注册到 IOManager，开始监视
+         */
+        bool start();
+
+        /**
+         * @brief 取消读事件和未到期的防抖定时器
+         */
+        void stop();
+
+        /**
+         * @brief 立即在当前线程整体加载一次所有文件，被拒绝时返回 false
+         */
+        bool reload();
+
+        // 成功加载的次数
+        uint64_t getReloadCount() const { return m_reloads.load(std::memory_order_relaxed); }
+        // 因为 YAML 解析失败或者配置项转换失败被整体拒绝的次数
+        uint64_t getRejectCount() const { return m_rejects.load(std::memory_order_relaxed); }
+
+    private:
+        // 在 IOManager 的线程里注册读事件（事件触发一次后就失效，需要重新注册），调用时持有 m_mutex
+        void arm();
+        // inotify fd 可读：读出所有事件，有相关文件变化就安排一次重新加载
+        void onReadable();
+        // 防抖：在 debounce_ms 内没有新的变化才加载
+        void scheduleReload();
+        // 需要加载的文件，按加载顺序
+        std::vector<std::string> listFiles();
+        bool isRelevant(int wd, const char *name);
+        bool watchDir(const std::string &dir);
+
+    private:
+        IOManager *m_iom;
+        uint64_t m_debounce_ms;
+        int m_fd{-1};
+        bool m_started{false};
+        bool m_stopping{false};
+        std::vector<std::string> m_paths;    // addPath 的顺序
+        std::set<std::string> m_files;       // 单独监视的文件（完整路径）
+        std::set<std::string> m_dirs;        // 整个监视的目录
+        std::map<int, std::string> m_watches; // inotify wd -> 目录
+        Timer::ptr m_timer;
+        MutexType m_mutex;        // 保护以上状态
+        MutexType m_reload_mutex; // 串行化加载
+        std::atomic<uint64_t> m_reloads{0};
+        std::atomic<uint64_t> m_rejects{0};
+    };
+}
+
+#endif
@@ -0,0 +1,205 @@
+#include "fiber_mutex.h"
+#include "IOManager.h"
+#include "log.h"
+#include "macro.h"
+
+namespace lsh {
+    struct FiberWaitQueue::Waiter {
+        enum State {
+            WAITING,
+            WOKEN,
+            TIMED_OUT
+        };
+
+        Scheduler *scheduler;
+        Fiber::ptr fiber;
+        // notify 和超时定时器用 CAS 抢着把 WAITING 改掉，抢到的一方负责重新调度协程
+        std::atomic<int> state{WAITING};
+
+        Waiter(Scheduler *s, Fiber::ptr f) : scheduler(s), fiber(std::move(f)) {}
+
+        // 调用前已经赢得 CAS，其它人不会再碰 fiber
+        void wake() {
+            Fiber::ptr f;
+            f.swap(fiber);
+            scheduler->schedule(f);
+        }
+    };
+
+    bool FiberWaitQueue::wait(Spinlock &lock, uint64_t timeout_ms) {
+        Scheduler *scheduler = Scheduler::GetThis();
+        LSH_ASSERT_MSG(scheduler, "fiber sync primitives must wait inside a Scheduler fiber");
+        std::shared_ptr<Waiter> waiter = std::make_shared<Waiter>(scheduler, Fiber::GetThis());
+        m_waiters.push_back(waiter);
+
+        Timer::ptr timer;
+        if (timeout_ms != INFINITE) {
+            IOManager *iom = IOManager::GetThis();
+            LSH_ASSERT_MSG(iom, "fiber sync primitives need an IOManager for timeouts");
+            Spinlock *plock = &lock;
+            timer = iom->addTimer(timeout_ms, [waiter, plock, this]() {
+                int expected = Waiter::WAITING;
+                if (!waiter->state.compare_exchange_strong(expected, Waiter::TIMED_OUT)) {
+                    // 已经被 notify 唤醒，原语可能已经不在了，什么都不碰
+                    return;
+                }
+                // 协程还挂在队列里，原语一定还在；拿到锁时协程一定已经挂起
+                {
+                    Spinlock::Lock lock(*plock);
+                    m_waiters.remove(waiter);
+                }
+                waiter->wake();
+            });
+        }
+
+        Scheduler::Park([&lock]() { lock.unlock(); });
+
+        if (timer) {
+            timer->cancel();
+        }
+        return waiter->state.load() == Waiter::WOKEN;
+    }
+
+    bool FiberWaitQueue::notifyOne() {
+        while (!m_waiters.empty()) {
+            std::shared_ptr<Waiter> waiter = m_waiters.front();
+            m_waiters.pop_front();
+            int expected = Waiter::WAITING;
+            // 失败说明刚刚超时，超时的一方会负责调度它，换下一个
+            if (waiter->state.compare_exchange_strong(expected, Waiter::WOKEN)) {
+                waiter->wake();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t FiberWaitQueue::notifyAll() {
+        size_t n = 0;
+        while (notifyOne()) {
+            ++n;
+        }
+        return n;
+    }
+
+    bool FiberMutex::tryLock() {
+        Spinlock::Lock lock(m_lock);
+        if (m_locked) {
+            return false;
+        }
+        m_locked = true;
+        return true;
+    }
+
+    bool FiberMutex::timedLock(uint64_t timeout_ms) {
+        m_lock.lock();
+        if (!m_locked) {
+            m_locked = true;
+            m_lock.unlock();
+            return true;
+        }
+        // 被唤醒时锁已经移交给自己（m_locked 保持 true）
+        return m_waiters.wait(m_lock, timeout_ms);
+    }
+
+    void FiberMutex::unlock() {
+        Spinlock::Lock lock(m_lock);
+        if (!m_waiters.notifyOne()) {
+            m_locked = false;
+        }
+    }
+
+    bool FiberRWMutex::timedRlock(uint64_t timeout_ms) {
+        m_lock.lock();
+        if (!m_writer && m_write_waiters.empty()) {
+            ++m_readers;
+            m_lock.unlock();
+            return true;
+        }
+        // 被唤醒时 m_readers 已经由唤醒者加上
+        return m_read_waiters.wait(m_lock, timeout_ms);
+    }
+
+    bool FiberRWMutex::timedWlock(uint64_t timeout_ms) {
+        m_lock.lock();
+        if (!m_writer && m_readers == 0) {
+            m_writer = true;
+            m_lock.unlock();
+            return true;
+        }
+        if (m_write_waiters.wait(m_lock, timeout_ms)) {
+            return true;
+        }
+        // 超时：如果是因为自己在排队才挡住的读者，放它们进来
+        Spinlock::Lock lock(m_lock);
+        if (!m_writer && m_write_waiters.empty()) {
+            m_readers += m_read_waiters.notifyAll();
+        }
+        return false;
+    }
+
+    void FiberRWMutex::unlock() {
+        Spinlock::Lock lock(m_lock);
+        if (m_writer) {
+            // 写者释放：先放进所有等着的读者，没有读者再交给下一个写者
+            size_t n = m_read_waiters.notifyAll();
+            if (n > 0) {
+                m_writer = false;
+                m_readers += n;
+            } else if (!m_write_waiters.notifyOne()) {
+                m_writer = false;
+            }
+            return;
+        }
+        LSH_ASSERT(m_readers > 0);
+        if (--m_readers == 0 && m_write_waiters.notifyOne()) {
+            m_writer = true;
+        }
+    }
+
+    bool FiberCondition::wait(FiberMutex &mutex, uint64_t timeout_ms) {
+        m_lock.lock();
+        // 持有 m_lock 时释放 mutex：notify 要先拿 m_lock，不会在进入队列之前丢失
+        mutex.unlock();
+        bool notified = m_waiters.wait(m_lock, timeout_ms);
+        mutex.lock();
+        return notified;
+    }
+
+    void FiberCondition::notifyOne() {
+        Spinlock::Lock lock(m_lock);
+        m_waiters.notifyOne();
+    }
+
+    void FiberCondition::notifyAll() {
+        Spinlock::Lock lock(m_lock);
+        m_waiters.notifyAll();
+    }
+
+    bool FiberSemaphore::tryWait() {
+        Spinlock::Lock lock(m_lock);
+        if (m_count == 0) {
+            return false;
+        }
+        --m_count;
+        return true;
+    }
+
+    bool FiberSemaphore::timedWait(uint64_t timeout_ms) {
+        m_lock.lock();
+        if (m_count > 0) {
+            --m_count;
+            m_lock.unlock();
+            return true;
+        }
+        // 被唤醒时 notify 把计数直接交给了自己
+        return m_waiters.wait(m_lock, timeout_ms);
+    }
+
+    void FiberSemaphore::notify() {
+        Spinlock::Lock lock(m_lock);
+        if (!m_waiters.notifyOne()) {
+            ++m_count;
+        }
+    }
+}
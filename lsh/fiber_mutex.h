@@ -0,0 +1,132 @@
+#ifndef __LSH_FIBER_MUTEX_H__
+#define __LSH_FIBER_MUTEX_H__
+
+#include "fiber.h"
+#include "noncopyable.h"
+#include "scheduler.h"
+#include "thread.h"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+
+// 协程同步原语
+//
+// thread.h 里的 Mutex/RWMutex/Spinlock/Semaphore 会阻塞整个线程，一个协程等锁时
+// 同一个线程上的其它协程也跑不了。这里的锁等待时把协程挂起（Fiber::YieldToHold）放进等待队列，
+// 释放时把它重新放回它原来的 Scheduler（可能在该调度器的另一个线程上恢复）。
+// 阻塞的操作只能在调度器的工作协程里调用；unlock/notify 可以在任何线程调用。
+// 带超时的操作依赖当前线程的 IOManager（TimerManager）。
+
+namespace lsh {
+    /**
+     * @brief 协程等待队列，以下原语的公共部分
+     *
+     * 所有操作都要求调用者持有 lock（各原语内部保护自己状态的 Spinlock）。
+     */
+    class FiberWaitQueue : Noncopyable {
+    public:
+        static const uint64_t INFINITE = ~0ull;
+
+        /**
+         * @brief 把当前协程放进队列并挂起，lock 在协程挂起之后才释放
+         * @return 被 notify 唤醒返回 true，超时返回 false；返回时不持有 lock
+         */
+        bool wait(Spinlock &lock, uint64_t timeout_ms = INFINITE);
+
+        // 唤醒最早的一个等待者，队列为空返回 false
+        bool notifyOne();
+        // 唤醒全部等待者，返回唤醒的个数
+        size_t notifyAll();
+
+        bool empty() const { return m_waiters.empty(); }
+
+    private:
+        struct Waiter;
+        std::list<std::shared_ptr<Waiter>> m_waiters;
+    };
+
+    /**
+     * @brief 协程互斥锁
+     *
+     * unlock 时有等待者就直接把锁交给最早的等待者，不会有协程一直抢不到。
+     */
+    class FiberMutex : Noncopyable {
+    public:
+        typedef ScopedLockImpl<FiberMutex> Lock;
+
+        void lock() { timedLock(FiberWaitQueue::INFINITE); }
+        bool tryLock();
+        // 超时返回 false
+        bool timedLock(uint64_t timeout_ms);
+        void unlock();
+
+    private:
+        Spinlock m_lock;
+        bool m_locked{false};
+        FiberWaitQueue m_waiters;
+    };
+
+    /**
+     * @brief 协程读写锁，写优先：有写者在等时新的读者也要等
+     */
+    class FiberRWMutex : Noncopyable {
+    public:
+        typedef ReadScopedLockImpl<FiberRWMutex> ReadLock;
+        typedef WriteScopedLockImpl<FiberRWMutex> WriteLock;
+
+        void rlock() { timedRlock(FiberWaitQueue::INFINITE); }
+        void wlock() { timedWlock(FiberWaitQueue::INFINITE); }
+        bool timedRlock(uint64_t timeout_ms);
+        bool timedWlock(uint64_t timeout_ms);
+        void unlock();
+
+    private:
+        Spinlock m_lock;
+        uint32_t m_readers{0};
+        bool m_writer{false};
+        FiberWaitQueue m_read_waiters;
+        FiberWaitQueue m_write_waiters;
+    };
+
+    /**
+     * @brief 协程条件变量，配合 FiberMutex 使用
+     */
+    class FiberCondition : Noncopyable {
+    public:
+        /**
+         * @brief 释放 mutex 并等待，返回前重新持有 mutex
+         * @return 被 notify 唤醒返回 true，超时返回 false
+         */
+        bool wait(FiberMutex &mutex, uint64_t timeout_ms = FiberWaitQueue::INFINITE);
+
+        void notifyOne();
+        void notifyAll();
+
+    private:
+        Spinlock m_lock;
+        FiberWaitQueue m_waiters;
+    };
+
+    /**
+     * @brief 协程信号量
+     */
+    class FiberSemaphore : Noncopyable {
+    public:
+        FiberSemaphore(uint32_t count = 0) : m_count(count) {}
+
+        void wait() { timedWait(FiberWaitQueue::INFINITE); }
+        bool tryWait();
+        bool timedWait(uint64_t timeout_ms);
+        void notify();
+
+        uint32_t getCount() const { return m_count; }
+
+    private:
+        Spinlock m_lock;
+        uint32_t m_count;
+        FiberWaitQueue m_waiters;
+    };
+}
+
+#endif
@@ -0,0 +1,766 @@
+#include "flight_recorder.h"
+#include "binlog.h"
+#include "thread.h"
+#include "util.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <execinfo.h>
+
+namespace lsh {
+    namespace {
+        struct FlightRecord {
+            uint64_t time_us;
+            const char *file; // __FILE__ 字面量，崩溃时直接读取
+            int32_t line;     // 二进制记录：格式串 id
+            uint16_t len;
+            uint8_t level;
+            uint8_t binary;   // text 里是 BinLog 编码的参数，不是文本
+            char text[FlightRecorder::RECORD_SIZE - 24];
+        };
+        static_assert(sizeof(FlightRecord) == FlightRecorder::RECORD_SIZE, "flight record size mismatch");
+
+        // 一个线程的环；创建后永远不释放，崩溃时可以无锁遍历
+        struct FlightBuffer {
+            FlightBuffer *next{nullptr};
+            std::atomic<bool> in_use{true};
+            uint32_t thread_id{0};
+            char thread_name[16]{};
+            uint32_t capacity{0}; // 2 的幂
+            std::atomic<uint64_t> count{0};
+            FlightRecord *records{nullptr};
+        };
+
+        // 二进制日志的格式串，按 id 分块存放；块和登记过的项都不释放，崩溃时可以无锁读取
+        struct BinaryFormat {
+            const char *file;
+            int32_t line;
+            std::atomic<const char *> fmt; // 最后写入，非空表示这一项可用
+        };
+        constexpr size_t FORMAT_CHUNK_SIZE = 1024;
+        constexpr size_t FORMAT_CHUNKS = 1024;
+        std::atomic<BinaryFormat *> s_formats[FORMAT_CHUNKS];
+
+        std::atomic<FlightBuffer *> s_buffers{nullptr};
+        std::atomic<uint32_t> s_capacity{256};
+        int s_crash_fd = STDERR_FILENO;
+        std::atomic<bool> s_crashing{false};
+        std::atomic<bool> s_crash_installed{false};
+        const int s_crash_signals[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+        struct sigaction s_old_actions[sizeof(s_crash_signals) / sizeof(s_crash_signals[0])];
+
+        // 备用信号栈：栈溢出时信号处理函数没法用原来的栈
+        struct AltStack {
+            void *stack{nullptr};
+            ~AltStack() {
+                if (stack) {
+                    stack_t ss;
+                    memset(&ss, 0, sizeof(ss));
+                    ss.ss_flags = SS_DISABLE;
+                    sigaltstack(&ss, nullptr);
+                    free(stack);
+                }
+            }
+        };
+
+        thread_local AltStack t_alt_stack;
+
+        // 线程退出时把环交还，等待新线程复用
+        struct FlightBufferHolder {
+            FlightBuffer *buffer{nullptr};
+            ~FlightBufferHolder() {
+                if (buffer) {
+                    buffer->in_use.store(false, std::memory_order_release);
+                }
+            }
+        };
+
+        FlightBuffer *AcquireBuffer() {
+            uint32_t capacity = s_capacity.load(std::memory_order_relaxed);
+            FlightBuffer *buffer = nullptr;
+            for (FlightBuffer *b = s_buffers.load(std::memory_order_acquire); b; b = b->next) {
+                bool expected = false;
+                if (b->capacity == capacity && !b->in_use.load(std::memory_order_relaxed) &&
+                    b->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                    buffer = b;
+                    break;
+                }
+            }
+            if (!buffer) {
+                buffer = new FlightBuffer();
+                buffer->capacity = capacity;
+                buffer->records = static_cast<FlightRecord *>(calloc(capacity, sizeof(FlightRecord)));
+                FlightBuffer *head = s_buffers.load(std::memory_order_relaxed);
+                do {
+                    buffer->next = head;
+                } while (!s_buffers.compare_exchange_weak(head, buffer, std::memory_order_release, std::memory_order_relaxed));
+            } else {
+                buffer->count.store(0, std::memory_order_relaxed);
+            }
+            buffer->thread_id = GetThreadId();
+            const std::string &name = Thread::GetName();
+            size_t n = std::min(name.size(), sizeof(buffer->thread_name) - 1);
+            memcpy(buffer->thread_name, name.data(), n);
+            buffer->thread_name[n] = '\0';
+            return buffer;
+        }
+
+        FlightBuffer *GetThreadBuffer() {
+            static thread_local FlightBufferHolder t_holder;
+            if (__builtin_expect(!t_holder.buffer, 0)) {
+                t_holder.buffer = AcquireBuffer();
+            }
+            return t_holder.buffer;
+        }
+
+        const BinaryFormat *FindFormat(uint32_t id) {
+            if (id / FORMAT_CHUNK_SIZE >= FORMAT_CHUNKS) {
+                return nullptr;
+            }
+            BinaryFormat *chunk = s_formats[id / FORMAT_CHUNK_SIZE].load(std::memory_order_acquire);
+            if (!chunk) {
+                return nullptr;
+            }
+            const BinaryFormat *format = &chunk[id % FORMAT_CHUNK_SIZE];
+            return format->fmt.load(std::memory_order_acquire) ? format : nullptr;
+        }
+
+        //====== 以下函数在信号处理函数中使用，只能调用异步信号安全的接口 ======
+
+        void WriteAll(int fd, const char *data, size_t len) {
+            while (len > 0) {
+                ssize_t n = ::write(fd, data, len);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return;
+                }
+                data += n;
+                len -= n;
+            }
+        }
+
+        void WriteStr(int fd, const char *str) {
+            WriteAll(fd, str, strlen(str));
+        }
+
+        // 把无符号整数写成十进制，width 不足时前面补 0，返回写入的字节数
+        size_t FormatUInt(char *out, uint64_t v, int width = 0) {
+            char tmp[24];
+            int n = 0;
+            do {
+                tmp[n++] = '0' + v % 10;
+                v /= 10;
+            } while (v);
+            while (n < width) {
+                tmp[n++] = '0';
+            }
+            for (int i = 0; i < n; i++) {
+                out[i] = tmp[n - 1 - i];
+            }
+            return n;
+        }
+
+        void WriteUInt(int fd, uint64_t v) {
+            char buf[24];
+            WriteAll(fd, buf, FormatUInt(buf, v));
+        }
+
+        const char *LevelName(int level) {
+            static const char *names[] = {"UNKNOWN", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
+            return level >= 0 && level <= 5 ? names[level] : "UNKNOWN";
+        }
+
+        const char *SignalName(int sig) {
+            switch (sig) {
+            case SIGSEGV:
+                return "SIGSEGV";
+            case SIGABRT:
+                return "SIGABRT";
+            case SIGBUS:
+                return "SIGBUS";
+            case SIGFPE:
+                return "SIGFPE";
+            case SIGILL:
+                return "SIGILL";
+            default:
+                return "signal";
+            }
+        }
+
+        // 往定长缓冲区里追加，写满后丢弃多出的部分
+        struct FixedOut {
+            char *data;
+            size_t cap;
+            size_t size{0};
+
+            void put(char c) {
+                if (size < cap) {
+                    data[size++] = c;
+                }
+            }
+            void put(const char *s, size_t n) {
+                for (size_t i = 0; i < n; i++) {
+                    put(s[i]);
+                }
+            }
+            void fill(char c, int n) {
+                for (int i = 0; i < n; i++) {
+                    put(c);
+                }
+            }
+        };
+
+        // printf 转换说明里影响输出的部分
+        struct FormatSpec {
+            bool left{false};
+            bool zero{false};
+            bool plus{false};
+            bool space{false};
+            bool alt{false};
+            int width{0};
+            int precision{-1};
+        };
+
+        // 按宽度和对齐输出 body；prefix（符号、0x）在补 0 时放在 0 的前面
+        void PutPadded(FixedOut &out, const FormatSpec &spec, const char *prefix, size_t prefix_len,
+                       const char *body, size_t body_len) {
+            int pad = spec.width - (int)(prefix_len + body_len);
+            if (pad > 0 && !spec.left && !spec.zero) {
+                out.fill(' ', pad);
+            }
+            out.put(prefix, prefix_len);
+            if (pad > 0 && !spec.left && spec.zero) {
+                out.fill('0', pad);
+            }
+            out.put(body, body_len);
+            if (pad > 0 && spec.left) {
+                out.fill(' ', pad);
+            }
+        }
+
+        size_t FormatDigits(char *out, uint64_t v, unsigned base, bool upper) {
+            const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+            char tmp[64];
+            size_t n = 0;
+            do {
+                tmp[n++] = digits[v % base];
+                v /= base;
+            } while (v);
+            for (size_t i = 0; i < n; i++) {
+                out[i] = tmp[n - 1 - i];
+            }
+            return n;
+        }
+
+        void PutSigned(FixedOut &out, const FormatSpec &spec, bool negative, uint64_t magnitude) {
+            char body[64];
+            size_t n = FormatDigits(body, magnitude, 10, false);
+            const char *sign = negative ? "-" : (spec.plus ? "+" : (spec.space ? " " : ""));
+            PutPadded(out, spec, sign, strlen(sign), body, n);
+        }
+
+        // 浮点数一律按定点小数输出（%e/%g 也是），精度最多 9 位；太大的数输出为 尾数e+指数
+        void PutDouble(FixedOut &out, const FormatSpec &spec, double v) {
+            bool negative = std::signbit(v);
+            const char *sign = negative ? "-" : (spec.plus ? "+" : (spec.space ? " " : ""));
+            FormatSpec plain = spec;
+            if (std::isnan(v) || std::isinf(v)) {
+                plain.zero = false;
+                PutPadded(out, plain, sign, strlen(sign), std::isnan(v) ? "nan" : "inf", 3);
+                return;
+            }
+            v = negative ? -v : v;
+            int exponent = 0;
+            while (v >= 1e18) {
+                v /= 10;
+                ++exponent;
+            }
+            int precision = spec.precision < 0 ? 6 : std::min(spec.precision, 9);
+            uint64_t scale = 1;
+            for (int i = 0; i < precision; i++) {
+                scale *= 10;
+            }
+            uint64_t integer = (uint64_t)v;
+            uint64_t fraction = (uint64_t)((v - (double)integer) * scale + 0.5);
+            if (fraction >= scale) {
+                ++integer;
+                fraction -= scale;
+            }
+            char body[96];
+            size_t n = FormatDigits(body, integer, 10, false);
+            if (precision > 0) {
+                body[n++] = '.';
+                n += FormatUInt(body + n, fraction, precision);
+            }
+            if (exponent) {
+                body[n++] = 'e';
+                body[n++] = '+';
+                n += FormatUInt(body + n, exponent, 2);
+            }
+            PutPadded(out, spec, sign, strlen(sign), body, n);
+        }
+
+        // 依次读出 BinLog 编码的参数；数据被截断时返回 false
+        struct BinaryArgReader {
+            const char *p;
+            const char *end;
+            bool cut{false}; // 有字符串只剩下一部分
+
+            bool next(uint8_t &type, uint64_t &value, const char *&str, uint32_t &str_len) {
+                if (p >= end || *p == 0) {
+                    return false;
+                }
+                type = *p++;
+                if (type == BIN_ARG_STRING) {
+                    if (end - p < (ptrdiff_t)sizeof(str_len)) {
+                        return false;
+                    }
+                    memcpy(&str_len, p, sizeof(str_len));
+                    p += sizeof(str_len);
+                    str = p;
+                    // 截断的字符串输出剩下的部分
+                    if (str_len > end - p) {
+                        str_len = end - p;
+                        cut = true;
+                    }
+                    p += str_len;
+                    return true;
+                }
+                if (end - p < (ptrdiff_t)sizeof(value)) {
+                    return false;
+                }
+                memcpy(&value, p, sizeof(value));
+                p += sizeof(value);
+                return true;
+            }
+        };
+
+        /**
+         * @brief 按 printf 的规则把二进制参数格式化到 out，只使用异步信号安全的操作
+         *
+         * 和 BinLogDecoder::FormatMessage 的规则一致（整数按长度修饰截断，字符串只对应 %s），
+         * 但浮点数只输出定点小数；参数被截断时在末尾加上 "..."。
+         */
+        void FormatBinary(FixedOut &out, const char *fmt, const char *args, size_t len) {
+            BinaryArgReader reader{args, args + len};
+            bool truncated = false;
+            const char *p = fmt;
+            while (*p && !truncated) {
+                if (*p != '%') {
+                    out.put(*p++);
+                    continue;
+                }
+                if (p[1] == '%') {
+                    out.put('%');
+                    p += 2;
+                    continue;
+                }
+                ++p;
+                FormatSpec spec;
+                uint8_t type = 0;
+                uint64_t value = 0;
+                const char *str = nullptr;
+                uint32_t str_len = 0;
+                for (; *p && strchr("-+ #0'", *p); ++p) {
+                    spec.left |= *p == '-';
+                    spec.zero |= *p == '0';
+                    spec.plus |= *p == '+';
+                    spec.space |= *p == ' ';
+                    spec.alt |= *p == '#';
+                }
+                if (*p == '*') {
+                    truncated = !reader.next(type, value, str, str_len);
+                    spec.width = (int)(int64_t)value;
+                    if (spec.width < 0) {
+                        spec.left = true;
+                        spec.width = -spec.width;
+                    }
+                    ++p;
+                }
+                for (; isdigit((unsigned char)*p); ++p) {
+                    spec.width = spec.width * 10 + (*p - '0');
+                }
+                if (*p == '.') {
+                    ++p;
+                    spec.precision = 0;
+                    if (*p == '*') {
+                        truncated = truncated || !reader.next(type, value, str, str_len);
+                        spec.precision = std::max((int)(int64_t)value, -1);
+                        ++p;
+                    }
+                    for (; isdigit((unsigned char)*p); ++p) {
+                        spec.precision = spec.precision * 10 + (*p - '0');
+                    }
+                }
+                // 长度修饰：0 无，1 hh，2 h，3 l/ll/j/z/t/L
+                int length = 0;
+                for (; *p && strchr("hlLqjzt", *p); ++p) {
+                    length = *p == 'h' ? (length == 2 ? 1 : 2) : 3;
+                }
+                char conv = *p;
+                if (!conv || truncated) {
+                    break;
+                }
+                ++p;
+                if (conv == 'n') {
+                    continue;
+                }
+                if (!reader.next(type, value, str, str_len)) {
+                    truncated = true;
+                    break;
+                }
+                if (spec.left) {
+                    spec.zero = false;
+                }
+                if (type == BIN_ARG_STRING) {
+                    // C 字符串只会对应 %s（见 BinLog::CheckFormat）
+                    size_t n = spec.precision >= 0 ? std::min<size_t>(str_len, spec.precision) : str_len;
+                    spec.zero = false;
+                    PutPadded(out, spec, "", 0, str, n);
+                    continue;
+                }
+                switch (conv) {
+                case 'd':
+                case 'i': {
+                    int64_t v = (int64_t)value;
+                    if (length == 0) {
+                        v = (int)v;
+                    } else if (length == 1) {
+                        v = (signed char)v;
+                    } else if (length == 2) {
+                        v = (short)v;
+                    }
+                    PutSigned(out, spec, v < 0, v < 0 ? 0 - (uint64_t)v : (uint64_t)v);
+                    break;
+                }
+                case 'u':
+                case 'o':
+                case 'x':
+                case 'X': {
+                    uint64_t v = value;
+                    if (length == 0) {
+                        v = (unsigned int)v;
+                    } else if (length == 1) {
+                        v = (unsigned char)v;
+                    } else if (length == 2) {
+                        v = (unsigned short)v;
+                    }
+                    char body[64];
+                    size_t n = FormatDigits(body, v, conv == 'u' ? 10 : (conv == 'o' ? 8 : 16), conv == 'X');
+                    const char *prefix = spec.alt && v ? (conv == 'x' ? "0x" : (conv == 'X' ? "0X" : (conv == 'o' ? "0" : ""))) : "";
+                    PutPadded(out, spec, prefix, strlen(prefix), body, n);
+                    break;
+                }
+                case 'c': {
+                    char c = (char)value;
+                    spec.zero = false;
+                    PutPadded(out, spec, "", 0, &c, 1);
+                    break;
+                }
+                case 'p': {
+                    char body[64];
+                    size_t n = FormatDigits(body, value, 16, false);
+                    spec.zero = false;
+                    PutPadded(out, spec, "0x", 2, body, n);
+                    break;
+                }
+                case 'e':
+                case 'E':
+                case 'f':
+                case 'F':
+                case 'g':
+                case 'G':
+                case 'a':
+                case 'A': {
+                    double d;
+                    if (type == BIN_ARG_DOUBLE) {
+                        memcpy(&d, &value, sizeof(d));
+                    } else {
+                        d = (double)(int64_t)value;
+                    }
+                    PutDouble(out, spec, d);
+                    break;
+                }
+                case 's':
+                    spec.zero = false;
+                    PutPadded(out, spec, "", 0, "(null)", 6);
+                    break;
+                default:
+                    out.put('%');
+                    out.put(conv);
+                    break;
+                }
+            }
+            if (truncated || reader.cut) {
+                out.put("...", 3);
+            }
+        }
+
+        // 一条记录一行：秒.微秒 [级别] 文件:行号 内容
+        void WriteRecord(int fd, const FlightRecord &r) {
+            // 二进制记录格式化之后可能比槽还长，多留一些
+            char buf[FlightRecorder::RECORD_SIZE * 2 + 128];
+            size_t n = FormatUInt(buf, r.time_us / 1000000);
+            buf[n++] = '.';
+            n += FormatUInt(buf + n, r.time_us % 1000000, 6);
+            buf[n++] = ' ';
+            buf[n++] = '[';
+            const char *level = LevelName(r.level);
+            size_t level_len = strlen(level);
+            memcpy(buf + n, level, level_len);
+            n += level_len;
+            buf[n++] = ']';
+            buf[n++] = ' ';
+            const char *file = r.file;
+            int32_t line = r.line;
+            const BinaryFormat *format = nullptr;
+            if (r.binary) {
+                format = FindFormat(r.line);
+                file = format ? format->file : nullptr;
+                line = format ? format->line : 0;
+            }
+            if (file) {
+                size_t file_len = strlen(file);
+                if (file_len > 64) {
+                    file += file_len - 64;
+                    file_len = 64;
+                }
+                memcpy(buf + n, file, file_len);
+                n += file_len;
+                buf[n++] = ':';
+                n += FormatUInt(buf + n, line > 0 ? line : 0);
+                buf[n++] = ' ';
+            }
+            size_t len = std::min<size_t>(r.len, sizeof(r.text));
+            if (r.binary) {
+                FixedOut out{buf + n, sizeof(buf) - n - 1};
+                if (format) {
+                    FormatBinary(out, format->fmt.load(std::memory_order_acquire), r.text, len);
+                } else {
+                    out.put("<unknown format id ", 19);
+                    char id[24];
+                    out.put(id, FormatUInt(id, (uint32_t)r.line));
+                    out.put('>');
+                }
+                n += out.size;
+            } else {
+                memcpy(buf + n, r.text, len);
+                n += len;
+            }
+            if (n == 0 || buf[n - 1] != '\n') {
+                buf[n++] = '\n';
+            }
+            WriteAll(fd, buf, n);
+        }
+
+        void CrashHandler(int sig, siginfo_t *info, void *context) {
+            int fd = s_crash_fd;
+            if (s_crashing.exchange(true)) {
+                // 其它线程已经在导出了，等它结束进程
+                while (true) {
+                    pause();
+                }
+            }
+            WriteStr(fd, "*** ");
+            WriteStr(fd, SignalName(sig));
+            WriteStr(fd, " (");
+            WriteUInt(fd, sig);
+            WriteStr(fd, ") pid ");
+            WriteUInt(fd, getpid());
+            WriteStr(fd, " tid ");
+            WriteUInt(fd, GetThreadId());
+            if (sig == SIGSEGV || sig == SIGBUS) {
+                WriteStr(fd, " addr 0x");
+                char hex[16];
+                uintptr_t addr = (uintptr_t)info->si_addr;
+                int n = 0;
+                do {
+                    hex[15 - n++] = "0123456789abcdef"[addr & 0xf];
+                    addr >>= 4;
+                } while (addr && n < 16);
+                WriteAll(fd, hex + 16 - n, n);
+            }
+            WriteStr(fd, " ***\nbacktrace:\n");
+            void *frames[64];
+            int depth = ::backtrace(frames, 64);
+            // backtrace_symbols_fd 不分配内存，可以在信号处理函数中使用
+            backtrace_symbols_fd(frames, depth, fd);
+            WriteStr(fd, "flight recorder:\n");
+            FlightRecorder::Dump(fd);
+            WriteStr(fd, "*** end of flight recorder ***\n");
+
+            // 安装前已经有处理函数：恢复它并交给它处理（它可能自己退出，也可能再次触发信号）
+            for (size_t i = 0; i < sizeof(s_crash_signals) / sizeof(s_crash_signals[0]); i++) {
+                const struct sigaction &old = s_old_actions[i];
+                if (s_crash_signals[i] != sig || old.sa_handler == SIG_DFL || old.sa_handler == SIG_IGN) {
+                    continue;
+                }
+                sigaction(sig, &old, nullptr);
+                if (old.sa_flags & SA_SIGINFO) {
+                    old.sa_sigaction(sig, info, context);
+                } else {
+                    old.sa_handler(sig);
+                }
+            }
+
+            // 恢复默认动作再触发一次，照常退出并生成 core
+            signal(sig, SIG_DFL);
+            raise(sig);
+        }
+    }
+
+    void FlightRecorder::SetCapacity(uint32_t records) {
+        uint32_t n = 2;
+        while (n < records && n < (1u << 20)) {
+            n <<= 1;
+        }
+        s_capacity.store(n, std::memory_order_relaxed);
+    }
+
+    uint32_t FlightRecorder::GetCapacity() {
+        return s_capacity.load(std::memory_order_relaxed);
+    }
+
+    void FlightRecorder::Record(int level, uint64_t time_us, const char *file, int32_t line,
+                                const char *data, size_t len) {
+        FlightBuffer *buffer = GetThreadBuffer();
+        uint64_t index = buffer->count.load(std::memory_order_relaxed);
+        FlightRecord &r = buffer->records[index & (buffer->capacity - 1)];
+        r.time_us = time_us;
+        r.file = file;
+        r.line = line;
+        r.level = level;
+        r.binary = 0;
+        len = std::min(len, sizeof(r.text));
+        memcpy(r.text, data, len);
+        r.len = len;
+        buffer->count.store(index + 1, std::memory_order_release);
+    }
+
+    void FlightRecorder::RecordBinary(int level, uint64_t time_us, uint32_t format_id,
+                                      const char *args, size_t len) {
+        FlightBuffer *buffer = GetThreadBuffer();
+        uint64_t index = buffer->count.load(std::memory_order_relaxed);
+        FlightRecord &r = buffer->records[index & (buffer->capacity - 1)];
+        r.time_us = time_us;
+        r.file = nullptr;
+        r.line = format_id;
+        r.level = level;
+        r.binary = 1;
+        len = std::min(len, sizeof(r.text));
+        memcpy(r.text, args, len);
+        r.len = len;
+        buffer->count.store(index + 1, std::memory_order_release);
+    }
+
+    void FlightRecorder::RegisterFormat(uint32_t format_id, const char *fmt, const char *file, int32_t line) {
+        size_t index = format_id / FORMAT_CHUNK_SIZE;
+        if (index >= FORMAT_CHUNKS) {
+            return;
+        }
+        BinaryFormat *chunk = s_formats[index].load(std::memory_order_acquire);
+        if (!chunk) {
+            BinaryFormat *created = static_cast<BinaryFormat *>(calloc(FORMAT_CHUNK_SIZE, sizeof(BinaryFormat)));
+            if (!created) {
+                return;
+            }
+            if (s_formats[index].compare_exchange_strong(chunk, created, std::memory_order_acq_rel)) {
+                chunk = created;
+            } else {
+                free(created);
+            }
+        }
+        BinaryFormat &format = chunk[format_id % FORMAT_CHUNK_SIZE];
+        format.file = file;
+        format.line = line;
+        format.fmt.store(strdup(fmt), std::memory_order_release);
+    }
+
+    void FlightRecorder::Dump(int fd) {
+        for (FlightBuffer *b = s_buffers.load(std::memory_order_acquire); b; b = b->next) {
+            uint64_t count = b->count.load(std::memory_order_acquire);
+            if (count == 0) {
+                continue;
+            }
+            uint64_t begin = count > b->capacity ? count - b->capacity : 0;
+            WriteStr(fd, "--- thread ");
+            WriteUInt(fd, b->thread_id);
+            WriteStr(fd, " ");
+            WriteStr(fd, b->thread_name);
+            if (!b->in_use.load(std::memory_order_relaxed)) {
+                WriteStr(fd, " (exited)");
+            }
+            WriteStr(fd, ", last ");
+            WriteUInt(fd, count - begin);
+            WriteStr(fd, " of ");
+            WriteUInt(fd, count);
+            WriteStr(fd, " records ---\n");
+            for (uint64_t i = begin; i < count; i++) {
+                WriteRecord(fd, b->records[i & (b->capacity - 1)]);
+            }
+        }
+    }
+
+    void FlightRecorder::InstallCrashHandler(int fd) {
+        s_crash_fd = fd;
+        // 第一次调用 backtrace 会加载 libgcc，不能放到信号处理函数里
+        void *frames[1];
+        ::backtrace(frames, 1);
+
+        InstallAltStack();
+
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = CrashHandler;
+        sa.sa_flags = SA_SIGINFO | SA_RESETHAND | SA_ONSTACK;
+        sigemptyset(&sa.sa_mask);
+        // 重复安装时只换输出的 fd，保留第一次安装前的处理函数
+        bool installed = s_crash_installed;
+        for (size_t i = 0; i < sizeof(s_crash_signals) / sizeof(s_crash_signals[0]); i++) {
+            sigaction(s_crash_signals[i], &sa, installed ? nullptr : &s_old_actions[i]);
+        }
+        s_crash_installed = true;
+    }
+
+    void FlightRecorder::UninstallCrashHandler() {
+        if (!s_crash_installed) {
+            return;
+        }
+        for (size_t i = 0; i < sizeof(s_crash_signals) / sizeof(s_crash_signals[0]); i++) {
+            sigaction(s_crash_signals[i], &s_old_actions[i], nullptr);
+        }
+        s_crash_installed = false;
+    }
+
+    void FlightRecorder::InstallAltStack() {
+        AltStack &alt = t_alt_stack;
+        if (alt.stack) {
+            return;
+        }
+        // backtrace 和 Dump 都在这个栈上执行，留足空间
+        size_t size = std::max<size_t>(SIGSTKSZ, 64 * 1024);
+        void *stack = malloc(size);
+        if (!stack) {
+            return;
+        }
+        stack_t ss;
+        memset(&ss, 0, sizeof(ss));
+        ss.ss_sp = stack;
+        ss.ss_size = size;
+        if (sigaltstack(&ss, nullptr) != 0) {
+            free(stack);
+            return;
+        }
+        alt.stack = stack;
+    }
+
+    bool FlightRecorder::CrashHandlerInstalled() {
+        return s_crash_installed;
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef __LSH_FLIGHT_RECORDER_H__
+#define __LSH_FLIGHT_RECORDER_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <unistd.h>
+
+namespace lsh {
+    /**
+     * @brief 崩溃现场的飞行记录仪：每个线程一个固定大小的环，始终保存最近的若干条日志
+     *
+     * 级别不低于记录级别（默认 DEBUG，见 SetLevel 和 log.flight_recorder.level）的日志即使被
+     * logger 的级别过滤掉，也会写入当前线程的环（只写环，不交给 appender）。
+     * 这样线上可以把 logger 设成 WARN，崩溃时仍然能看到最近的 DEBUG 日志。
+     *
+     * 每条记录占一个固定大小的槽，内容超长时截断；写入只有一次 memcpy，没有锁和系统调用。
+     * 二进制模式（见 binlog.h）的日志在调用线程上只记录格式串 id 和参数的原始字节，导出时再格式化。
+     * 线程退出后它的环保留在全局链表里，内容在被新线程复用之前仍然可以导出。
+     * Dump 和崩溃处理函数只使用异步信号安全的操作（write、backtrace_symbols_fd）。
+     */
+    class FlightRecorder {
+    public:
+        // 记录级别取这个值时表示关闭（比 FATAL 还高）
+        static constexpr int OFF = 6;
+        // 默认记录级别：LogLevel::DEBUG。被 logger 过滤掉的 DEBUG 日志也要构造事件写进环，
+        // 嫌这点开销大可以把 log.flight_recorder.level 调高或设成 OFF
+        static constexpr int DEFAULT_LEVEL = 1;
+        // 每个槽的字节数，其中记录头之外的部分存放日志内容
+        static constexpr size_t RECORD_SIZE = 256;
+
+        static int GetLevel() { return s_level.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief 设置记录级别（LogLevel::Level 的值），OFF 关闭
+         */
+        static void SetLevel(int level) { s_level.store(level, std::memory_order_relaxed); }
+
+        /**
+         * @brief 每个线程保存的记录条数（向上取 2 的幂），只影响之后新建的环
+         */
+        static void SetCapacity(uint32_t records);
+        static uint32_t GetCapacity();
+
+        /**
+         * @brief 写入当前线程的环
+         */
+        static void Record(int level, uint64_t time_us, const char *file, int32_t line, const char *data, size_t len);
+
+        /**
+         * @brief 写入一条二进制日志：args 是 BinLog 编码的参数（每个参数 1 字节 BinArgType + 值）
+         *
+         * 超过槽大小的参数被截断，导出时格式化到截断处为止。
+         */
+        static void RecordBinary(int level, uint64_t time_us, uint32_t format_id, const char *args, size_t len);
+
+        /**
+         * @brief 登记二进制日志的格式串，导出 RecordBinary 的记录时使用
+         *
+         * fmt 会被复制，file 必须一直有效（__FILE__ 字面量）。
+         */
+        static void RegisterFormat(uint32_t format_id, const char *fmt, const char *file, int32_t line);
+
+        /**
+         * @brief 把所有线程环里的记录按线程、从旧到新写到 fd，异步信号安全
+         */
+        static void Dump(int fd);
+
+        /**
+         * @brief 安装 SIGSEGV/SIGABRT/SIGBUS/SIGFPE/SIGILL 的处理函数：
+         *        把调用栈和飞行记录写到 fd，然后按默认动作重新触发信号（照常生成 core）
+         *
+         * 安装前已经有别的处理函数（比如其它崩溃上报工具）时，导出后恢复并调用它，它返回了再按默认动作处理。
+         * 处理函数跑在备用信号栈上（SA_ONSTACK），栈溢出时也能导出。备用栈是线程私有的：
+         * 这里给调用线程装上，之后启动的 lsh::Thread 自动装；其它线程自己调用 InstallAltStack。
+         * 配置项 log.flight_recorder.crash_handler 为 true（默认）且记录仪打开时会自动安装到 stderr。
+         */
+        static void InstallCrashHandler(int fd = STDERR_FILENO);
+
+        /**
+         * @brief 恢复安装之前的信号处理函数
+         */
+        static void UninstallCrashHandler();
+
+        /**
+         * @brief 给当前线程装备用信号栈，重复调用无效果，线程退出时释放
+         */
+        static void InstallAltStack();
+
+        // 是否已经安装了崩溃处理函数
+        static bool CrashHandlerInstalled();
+
+    private:
+        // 不等配置项的监听器，静态初始化期间的日志也会被记录
+        static inline std::atomic<int> s_level{DEFAULT_LEVEL};
+    };
+}
+
+#endif
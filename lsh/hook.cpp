@@ -12,7 +12,7 @@
 namespace lsh {
     std::shared_ptr<Logger> g_logger = LSH_LOG_NAME("system");
     static lsh::ConfigVar<int>::ptr g_tcp_connect_timeout =
-        lsh::Config::Creat("tcp.connect.timeout", (int)5000, "tcp connect timeout");
+        lsh::Config::Creat(LSH_CONFIG_KEY("tcp.connect.timeout"), (int)5000, "tcp connect timeout");
     static thread_local bool t_hook_enbale = false;
 
 #define HOOK_FUNC(XX) \
@@ -84,7 +84,7 @@ static ssize_t do_io(int fd, OrignName func, const char *hook_func_name,
         return func(fd, std::forward<Args>(args)...);
     }
 
-    LSH_LOG_DEBUG(lsh::g_logger) << "do_io<" << hook_func_name << "> fd=" << fd;
+    LSH_LOG_FMT_DEBUG(lsh::g_logger, "do_io<%s> fd=%d", hook_func_name, fd);
     lsh::FdCtx::ptr ctx = lsh::fdMgr::GetInstance()->get(fd);
     if (!ctx) {
         return func(fd, std::forward<Args>(args)...);
@@ -109,7 +109,7 @@ retry:
     }
 
     if (n == -1 && errno == EAGAIN) {
-        LSH_LOG_DEBUG(lsh::g_logger) << "do_io<" << hook_func_name << "> EAGAIN fd=" << fd;
+        LSH_LOG_FMT_DEBUG(lsh::g_logger, "do_io<%s> EAGAIN fd=%d", hook_func_name, fd);
         lsh::IOManager *iom = lsh::IOManager::GetThis();
         lsh::Timer::ptr timer;
         std::weak_ptr<timer_info> winfo(tinfo);
@@ -129,16 +129,16 @@ retry:
 
         int rt = iom->addEvent(fd, (lsh::IOManager::Event)(event));
         if (rt) {
-            LSH_LOG_ERROR(lsh::g_logger) << hook_func_name << " addEvent(" << fd
-                                         << ", " << event << ")";
+            LSH_LOG_ERROR_EVERY_MS(lsh::g_logger, 1000) << hook_func_name << " addEvent(" << fd
+                                                        << ", " << event << ")";
             if (timer) {
                 timer->cancel();
             }
             return -1;
         } else {
-            LSH_LOG_DEBUG(lsh::g_logger) << "do_io<" << hook_func_name << "> EAGAIN fd=" << fd;
+            LSH_LOG_FMT_DEBUG(lsh::g_logger, "do_io<%s> EAGAIN fd=%d", hook_func_name, fd);
             lsh::Fiber::YieldToHold();
-            LSH_LOG_DEBUG(lsh::g_logger) << "do_io<" << hook_func_name << "> EAGAIN fd=" << fd;
+            LSH_LOG_FMT_DEBUG(lsh::g_logger, "do_io<%s> EAGAIN fd=%d", hook_func_name, fd);
             if (timer) {
                 timer->cancel();
             }
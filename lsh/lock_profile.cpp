@@ -0,0 +1,263 @@
+#include "lock_profile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace lsh {
+    namespace {
+        // 每个线程表的槽位数（2 的幂），一个槽对应一个 (锁, 调用点, 类型)
+        static const size_t TABLE_SIZE = 1024;
+
+        struct Entry {
+            // 非空表示槽位已被占用；file/line/kind 在它之前写好，用 release 发布
+            std::atomic<const void *> lock{nullptr};
+            const char *file{nullptr};
+            int line{0};
+            int kind{0};
+            // 计数只由拥有这张表的线程写，Dump/Reset 在别的线程读或清零
+            std::atomic<uint64_t> count{0};
+            std::atomic<uint64_t> contended{0};
+            std::atomic<uint64_t> wait_ns{0};
+            std::atomic<uint64_t> hold_ns{0};
+            std::atomic<uint64_t> max_wait_ns{0};
+            std::atomic<uint64_t> max_hold_ns{0};
+        };
+
+        /**
+         * @brief 线程私有的统计表
+         *
+         * 表只追加不释放，串在全局链表上供 Dump 遍历；线程退出后表交还，
+         * 被后来的线程复用（统计按锁和调用点汇总，与线程无关）。
+         */
+        struct Table {
+            Entry entries[TABLE_SIZE];
+            std::atomic<bool> in_use{true};
+            std::atomic<uint64_t> dropped{0};
+            Table *next{nullptr};
+        };
+
+        static std::atomic<Table *> s_tables{nullptr};
+
+        // 只有所有者线程写：不需要原子的读-改-写
+        inline void Add(std::atomic<uint64_t> &v, uint64_t n) {
+            v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        inline void Max(std::atomic<uint64_t> &v, uint64_t n) {
+            if (n > v.load(std::memory_order_relaxed)) {
+                v.store(n, std::memory_order_relaxed);
+            }
+        }
+
+        Table *AcquireTable() {
+            for (Table *t = s_tables.load(std::memory_order_acquire); t; t = t->next) {
+                bool expected = false;
+                if (t->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                    return t;
+                }
+            }
+            Table *t = new Table;
+            t->next = s_tables.load(std::memory_order_relaxed);
+            while (!s_tables.compare_exchange_weak(t->next, t, std::memory_order_release,
+                                                   std::memory_order_relaxed)) {
+            }
+            return t;
+        }
+
+        // 线程退出时把表交还；之后这个线程上的记录直接丢弃
+        struct TableHolder {
+            Table *table{nullptr};
+            bool exited{false};
+
+            ~TableHolder() {
+                exited = true;
+                if (table) {
+                    table->in_use.store(false, std::memory_order_release);
+                    table = nullptr;
+                }
+            }
+        };
+
+        static thread_local TableHolder t_holder;
+
+        inline size_t Hash(const void *lock, const char *file, int line, int kind) {
+            uint64_t h = reinterpret_cast<uintptr_t>(lock) * 0x9E3779B97F4A7C15ull;
+            h ^= reinterpret_cast<uintptr_t>(file) + 0x7F4A7C15ull + (h << 6) + (h >> 2);
+            h ^= static_cast<uint64_t>(line) * 31 + kind;
+            return static_cast<size_t>(h ^ (h >> 29));
+        }
+
+        const char *BaseName(const char *file) {
+            const char *p = strrchr(file, '/');
+            return p ? p + 1 : file;
+        }
+
+        const char *KindName(int kind) {
+            switch (kind) {
+            case LockProfiler::READ:
+                return "read";
+            case LockProfiler::WRITE:
+                return "write";
+            default:
+                return "mutex";
+            }
+        }
+
+        struct Stat {
+            uint64_t count{0};
+            uint64_t contended{0};
+            uint64_t wait_ns{0};
+            uint64_t hold_ns{0};
+            uint64_t max_wait_ns{0};
+            uint64_t max_hold_ns{0};
+
+            void merge(const Stat &o) {
+                count += o.count;
+                contended += o.contended;
+                wait_ns += o.wait_ns;
+                hold_ns += o.hold_ns;
+                max_wait_ns = std::max(max_wait_ns, o.max_wait_ns);
+                max_hold_ns = std::max(max_hold_ns, o.max_hold_ns);
+            }
+        };
+
+        void PrintStat(std::ostream &os, const Stat &s) {
+            os << " count=" << s.count << " contended=" << s.contended << " ("
+               << std::fixed << std::setprecision(1) << (s.count ? 100.0 * s.contended / s.count : 0.0) << "%)"
+               << " wait_us=" << s.wait_ns / 1000 << " avg_wait_ns=" << (s.count ? s.wait_ns / s.count : 0)
+               << " max_wait_us=" << s.max_wait_ns / 1000
+               << " hold_us=" << s.hold_ns / 1000 << " avg_hold_ns=" << (s.count ? s.hold_ns / s.count : 0)
+               << " max_hold_us=" << s.max_hold_ns / 1000;
+        }
+    }
+
+    void LockProfiler::Record(const void *lock, const char *file, int line, Kind kind,
+                              uint64_t wait_ns, uint64_t hold_ns, bool contended) {
+        TableHolder &holder = t_holder;
+        if (!holder.table) {
+            if (holder.exited) {
+                return;
+            }
+            holder.table = AcquireTable();
+        }
+        Table *table = holder.table;
+        size_t mask = TABLE_SIZE - 1;
+        size_t idx = Hash(lock, file, line, kind) & mask;
+        for (size_t i = 0; i < TABLE_SIZE; ++i, idx = (idx + 1) & mask) {
+            Entry &e = table->entries[idx];
+            const void *key = e.lock.load(std::memory_order_relaxed);
+            if (!key) {
+                e.file = file;
+                e.line = line;
+                e.kind = kind;
+                e.lock.store(lock, std::memory_order_release);
+            } else if (key != lock || e.file != file || e.line != line || e.kind != kind) {
+                continue;
+            }
+            Add(e.count, 1);
+            if (contended) {
+                Add(e.contended, 1);
+            }
+            Add(e.wait_ns, wait_ns);
+            Add(e.hold_ns, hold_ns);
+            Max(e.max_wait_ns, wait_ns);
+            Max(e.max_hold_ns, hold_ns);
+            return;
+        }
+        Add(table->dropped, 1);
+    }
+
+    void LockProfiler::Dump(std::ostream &os, size_t top_n) {
+        // 同一个头文件在不同编译单元里的 __builtin_FILE 指针不同，按内容合并
+        typedef std::tuple<std::string, int, int> Site;
+        struct LockStat {
+            Stat total;
+            std::map<Site, Stat> sites;
+        };
+        std::map<const void *, LockStat> locks;
+        for (Table *t = s_tables.load(std::memory_order_acquire); t; t = t->next) {
+            for (size_t i = 0; i < TABLE_SIZE; ++i) {
+                Entry &e = t->entries[i];
+                const void *lock = e.lock.load(std::memory_order_acquire);
+                if (!lock) {
+                    continue;
+                }
+                Stat s;
+                s.count = e.count.load(std::memory_order_relaxed);
+                if (s.count == 0) {
+                    continue;
+                }
+                s.contended = e.contended.load(std::memory_order_relaxed);
+                s.wait_ns = e.wait_ns.load(std::memory_order_relaxed);
+                s.hold_ns = e.hold_ns.load(std::memory_order_relaxed);
+                s.max_wait_ns = e.max_wait_ns.load(std::memory_order_relaxed);
+                s.max_hold_ns = e.max_hold_ns.load(std::memory_order_relaxed);
+                LockStat &ls = locks[lock];
+                ls.total.merge(s);
+                ls.sites[Site(e.file, e.line, e.kind)].merge(s);
+            }
+        }
+
+        // 按总等待时间排序，等待相同时按争用次数
+        std::vector<std::pair<const void *, LockStat *>> sorted;
+        for (auto &i : locks) {
+            sorted.emplace_back(i.first, &i.second);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+            if (a.second->total.wait_ns != b.second->total.wait_ns) {
+                return a.second->total.wait_ns > b.second->total.wait_ns;
+            }
+            return a.second->total.contended > b.second->total.contended;
+        });
+
+        os << "lock profile: " << locks.size() << " locks, dropped=" << GetDropped()
+           << (Enabled() ? "" : " (built without LSH_LOCK_PROFILE)") << "\n";
+        for (size_t i = 0; i < sorted.size() && i < top_n; ++i) {
+            LockStat &ls = *sorted[i].second;
+            os << "#" << i + 1 << " lock=" << sorted[i].first;
+            PrintStat(os, ls.total);
+            os << "\n";
+
+            std::vector<std::pair<Site, Stat>> sites(ls.sites.begin(), ls.sites.end());
+            std::sort(sites.begin(), sites.end(), [](const auto &a, const auto &b) {
+                return a.second.wait_ns > b.second.wait_ns;
+            });
+            for (auto &s : sites) {
+                os << "    " << BaseName(std::get<0>(s.first).c_str()) << ":" << std::get<1>(s.first)
+                   << " " << KindName(std::get<2>(s.first));
+                PrintStat(os, s.second);
+                os << "\n";
+            }
+        }
+        os << std::flush;
+    }
+
+    void LockProfiler::Reset() {
+        for (Table *t = s_tables.load(std::memory_order_acquire); t; t = t->next) {
+            for (size_t i = 0; i < TABLE_SIZE; ++i) {
+                Entry &e = t->entries[i];
+                e.count.store(0, std::memory_order_relaxed);
+                e.contended.store(0, std::memory_order_relaxed);
+                e.wait_ns.store(0, std::memory_order_relaxed);
+                e.hold_ns.store(0, std::memory_order_relaxed);
+                e.max_wait_ns.store(0, std::memory_order_relaxed);
+                e.max_hold_ns.store(0, std::memory_order_relaxed);
+            }
+            t->dropped.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t LockProfiler::GetDropped() {
+        uint64_t n = 0;
+        for (Table *t = s_tables.load(std::memory_order_acquire); t; t = t->next) {
+            n += t->dropped.load(std::memory_order_relaxed);
+        }
+        return n;
+    }
+}
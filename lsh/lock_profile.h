@@ -0,0 +1,141 @@
+#ifndef __LSH_LOCK_PROFILE_H__
+#define __LSH_LOCK_PROFILE_H__
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <time.h>
+#include <type_traits>
+
+// 锁争用分析（可选）
+//
+// 用 -DLSH_LOCK_PROFILE=ON 构建时，thread.h 中的 ScopedLockImpl / ReadScopedLockImpl / WriteScopedLockImpl
+// 记录每个锁在每个调用点（构造 Lock 的文件和行号）的加锁次数、争用次数、等待时间和持有时间。
+// 数据写在每个线程自己的表里，记录时不加锁、不分配内存；LockProfiler::Dump 汇总后打印最热的锁。
+// 直接调用 mutex.lock()/unlock() 的地方不在统计范围内。
+// 整个工程（库和使用它的程序）必须用同样的开关编译。
+
+namespace lsh {
+    class LockProfiler {
+    public:
+        enum Kind {
+            MUTEX = 0, // 互斥锁
+            READ = 1,  // 读锁
+            WRITE = 2  // 写锁
+        };
+
+        // 编译时是否打开了统计
+        static constexpr bool Enabled() {
+#ifdef LSH_LOCK_PROFILE
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        static uint64_t Now() {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+        }
+
+        /**
+         * @brief 记录一次加锁到解锁（ScopedLockImpl 等调用）
+         * @param contended 第一次尝试没有拿到锁
+         */
+        static void Record(const void *lock, const char *file, int line, Kind kind,
+                           uint64_t wait_ns, uint64_t hold_ns, bool contended);
+
+        /**
+         * @brief 汇总所有线程的数据，按总等待时间打印最热的 top_n 个锁和调用点
+         */
+        static void Dump(std::ostream &os, size_t top_n = 10);
+
+        // 清零所有统计（和正在进行的记录并发时结果是近似的）
+        static void Reset();
+
+        // 线程表满了丢弃的记录数
+        static uint64_t GetDropped();
+    };
+
+    // 锁类型是否提供 try 版本：有的话先 try，失败才算一次争用
+    template <class T>
+    concept HasTryLock = requires(T &m) { { m.tryLock() } -> std::same_as<bool>; };
+    template <class T>
+    concept HasTryRlock = requires(T &m) { { m.tryRlock() } -> std::same_as<bool>; };
+    template <class T>
+    concept HasTryWlock = requires(T &m) { { m.tryWlock() } -> std::same_as<bool>; };
+
+    /**
+     * @brief 一个 Lock 对象的统计状态（只在 LSH_LOCK_PROFILE 构建中使用）
+     */
+    struct LockSite {
+        // 没有 try 版本的锁等待超过这个时间算一次争用
+        static const uint64_t CONTENDED_NS = 1000;
+
+        const char *file;
+        int line;
+        uint64_t wait_ns{0};
+        uint64_t acquired_ns{0};
+        bool contended{false};
+
+        template <class T>
+        void lock(T &m) {
+            if constexpr (HasTryLock<T>) {
+                acquire([&m]() { return m.tryLock(); }, [&m]() { m.lock(); });
+            } else {
+                acquire(nullptr, [&m]() { m.lock(); });
+            }
+        }
+
+        template <class T>
+        void rlock(T &m) {
+            if constexpr (HasTryRlock<T>) {
+                acquire([&m]() { return m.tryRlock(); }, [&m]() { m.rlock(); });
+            } else {
+                acquire(nullptr, [&m]() { m.rlock(); });
+            }
+        }
+
+        template <class T>
+        void wlock(T &m) {
+            if constexpr (HasTryWlock<T>) {
+                acquire([&m]() { return m.tryWlock(); }, [&m]() { m.wlock(); });
+            } else {
+                acquire(nullptr, [&m]() { m.wlock(); });
+            }
+        }
+
+        template <class T>
+        void unlock(T &m, LockProfiler::Kind kind) {
+            uint64_t hold_ns = LockProfiler::Now() - acquired_ns;
+            m.unlock();
+            LockProfiler::Record(&m, file, line, kind, wait_ns, hold_ns, contended);
+        }
+
+    private:
+        template <class TryF, class LockF>
+        void acquire(TryF try_lock, LockF do_lock) {
+            if constexpr (!std::is_same_v<TryF, std::nullptr_t>) {
+                if (try_lock()) {
+                    wait_ns = 0;
+                    contended = false;
+                    acquired_ns = LockProfiler::Now();
+                    return;
+                }
+            }
+            uint64_t begin = LockProfiler::Now();
+            do_lock();
+            acquired_ns = LockProfiler::Now();
+            wait_ns = acquired_ns - begin;
+            if constexpr (!std::is_same_v<TryF, std::nullptr_t>) {
+                contended = true;
+            } else {
+                contended = wait_ns > CONTENDED_NS;
+            }
+        }
+    };
+}
+
+#endif
@@ -1,11 +1,25 @@
 #include "log.h"
 #include "config.h"
+#include "shm_log.h"
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
 #include <cstdarg>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
+#include <fcntl.h>
+#include <filesystem>
 #include <functional>
 #include <map>
+#include <sched.h>
 #include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tuple>
+#include <unistd.h>
 
 namespace lsh {
     std::string LogLevel::toString(Level level) {
@@ -33,12 +47,293 @@ namespace lsh {
         return it == strToLevel.end() ? UNKNOWN : it->second;
     }
 
+    LogStreamBuf::LogStreamBuf() {
+        setp(m_inline, m_inline + INLINE_SIZE);
+    }
+
+    static uint64_t MonotonicUS() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
+    }
+
+    bool LogRateLimiter::everyMS(uint64_t ms, uint64_t &suppressed) {
+        uint64_t count = m_count.fetch_add(1, std::memory_order_relaxed);
+        // +1 让第一次调用的时间不为 0，0 表示还没有放行过
+        uint64_t now = MonotonicUS() / 1000 + 1;
+        uint64_t last = m_time.load(std::memory_order_relaxed);
+        if ((last == 0 || now - last >= ms) &&
+            m_time.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+            suppressed = passed(count);
+            return true;
+        }
+        return false;
+    }
+
+    bool LogRateLimiter::tokenBucket(uint64_t rate, uint64_t burst, uint64_t &suppressed) {
+        uint64_t count = m_count.fetch_add(1, std::memory_order_relaxed);
+        uint64_t interval = 1000000 / (rate ? rate : 1);
+        uint64_t tolerance = interval * (burst ? burst - 1 : 0);
+        uint64_t now = MonotonicUS();
+        uint64_t tat = m_time.load(std::memory_order_relaxed);
+        while (true) {
+            uint64_t t = std::max(tat, now);
+            // 理论到达时间比现在超前太多：桶里没有令牌了
+            if (t - now > tolerance) {
+                return false;
+            }
+            if (m_time.compare_exchange_weak(tat, t + interval, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        suppressed = passed(count);
+        return true;
+    }
+
+    //=============== LogCallSite =================
+    namespace {
+        struct LogSiteRule {
+            std::string file; // 空串匹配所有文件
+            int32_t line = 0; // 0 匹配所有行
+            uint8_t state = LogCallSite::FORCE_ON;
+        };
+
+        struct LogSiteRegistry {
+            Mutex mutex;
+            std::vector<LogCallSite *> sites;
+            std::vector<LogSiteRule> rules;
+        };
+
+        LogSiteRegistry &GetSiteRegistry() {
+            static LogSiteRegistry s_registry;
+            return s_registry;
+        }
+
+        // path 以 suffix 结尾，并且 suffix 前面是路径分隔符或开头
+        bool MatchFile(const char *path, const std::string &suffix) {
+            if (suffix.empty()) {
+                return true;
+            }
+            size_t len = strlen(path);
+            if (len < suffix.size() || memcmp(path + len - suffix.size(), suffix.data(), suffix.size()) != 0) {
+                return false;
+            }
+            return len == suffix.size() || path[len - suffix.size() - 1] == '/';
+        }
+
+        uint8_t EvalRules(const std::vector<LogSiteRule> &rules, const LogCallSite *site) {
+            uint8_t state = LogCallSite::DEFAULT;
+            for (auto &rule : rules) {
+                if ((rule.line == 0 || rule.line == site->getLine()) && MatchFile(site->getFile(), rule.file)) {
+                    state = rule.state;
+                }
+            }
+            return state;
+        }
+    }
+
+    uint8_t LogCallSite::registerSite() {
+        LogSiteRegistry &registry = GetSiteRegistry();
+        Mutex::Lock lock(registry.mutex);
+        // 可能有别的线程同时执行到同一个调用点
+        uint8_t s = m_state.load(std::memory_order_relaxed);
+        if (s == UNREGISTERED) {
+            registry.sites.push_back(this);
+            s = EvalRules(registry.rules, this);
+            m_state.store(s, std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+    void LogCallSite::SetRules(const std::vector<std::string> &rules) {
+        std::vector<LogSiteRule> parsed;
+        for (auto &str : rules) {
+            LogSiteRule rule;
+            std::string spec = str;
+            if (!spec.empty() && (spec[0] == '+' || spec[0] == '-')) {
+                rule.state = spec[0] == '+' ? FORCE_ON : FORCE_OFF;
+                spec.erase(0, 1);
+            }
+            size_t pos = spec.rfind(':');
+            if (pos != std::string::npos) {
+                rule.line = atoi(spec.c_str() + pos + 1);
+                spec.erase(pos);
+            }
+            rule.file = spec == "*" ? std::string() : spec;
+            parsed.push_back(std::move(rule));
+        }
+
+        LogSiteRegistry &registry = GetSiteRegistry();
+        Mutex::Lock lock(registry.mutex);
+        registry.rules.swap(parsed);
+        for (auto site : registry.sites) {
+            site->m_state.store(EvalRules(registry.rules, site), std::memory_order_relaxed);
+        }
+    }
+
+    size_t LogCallSite::GetSiteCount() {
+        LogSiteRegistry &registry = GetSiteRegistry();
+        Mutex::Lock lock(registry.mutex);
+        return registry.sites.size();
+    }
+
+    void LogStreamBuf::reset() {
+        // 回到内部数组；堆上的内存保留，下次超长时不必重新分配
+        setp(m_inline, m_inline + INLINE_SIZE);
+    }
+
+    void LogStreamBuf::reserve(size_t n) {
+        size_t used = size();
+        size_t cap = epptr() - pbase();
+        if (used + n <= cap) {
+            return;
+        }
+        size_t new_cap = cap * 2;
+        while (new_cap < used + n) {
+            new_cap *= 2;
+        }
+        if (pbase() == m_inline) {
+            // 第一次超出内部数组，把已有内容搬到堆上
+            if (m_heap.size() < new_cap) {
+                m_heap.resize(new_cap);
+            }
+            memcpy(m_heap.data(), m_inline, used);
+        } else {
+            m_heap.resize(new_cap);
+        }
+        setp(m_heap.data(), m_heap.data() + m_heap.size());
+        pbump((int)used);
+    }
+
+    LogStreamBuf::int_type LogStreamBuf::overflow(int_type ch) {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) {
+            return traits_type::not_eof(ch);
+        }
+        reserve(1);
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+        return ch;
+    }
+
+    std::streamsize LogStreamBuf::xsputn(const char *s, std::streamsize n) {
+        reserve(n);
+        memcpy(pptr(), s, n);
+        pbump((int)n);
+        return n;
+    }
+
+    void LogStreamBuf::appendf(const char *fmt, va_list al) {
+        va_list copy;
+        va_copy(copy, al);
+        size_t left = epptr() - pptr();
+        int len = vsnprintf(pptr(), left, fmt, al);
+        if (len >= 0 && (size_t)len >= left) {
+            // 剩余空间不够，扩容后重新格式化一次
+            reserve(len + 1);
+            len = vsnprintf(pptr(), len + 1, fmt, copy);
+        }
+        va_end(copy);
+        if (len > 0) {
+            pbump(len);
+        }
+    }
+
+    void LogStream::reset() {
+        m_buf.reset();
+        m_fields.clear();
+        clear();
+        flags(std::ios_base::skipws | std::ios_base::dec);
+        precision(6);
+        width(0);
+        fill(' ');
+    }
+
+    void LogStream::assign(const LogStream &other) {
+        reset();
+        write(other.data(), other.size());
+        m_fields.assign(other.m_fields);
+    }
+
+    void LogStream::addField(FieldType type, std::string_view key, uint64_t bits) {
+        key = key.substr(0, 255);
+        m_fields.push_back((char)type);
+        m_fields.push_back((char)key.size());
+        m_fields.append(key);
+        m_fields.append((const char *)&bits, sizeof(bits));
+    }
+
+    void LogStream::addDouble(std::string_view key, double value) {
+        addField(FIELD_DOUBLE, key, std::bit_cast<uint64_t>(value));
+    }
+
+    void LogStream::addString(std::string_view key, std::string_view value) {
+        key = key.substr(0, 255);
+        uint32_t len = value.size();
+        m_fields.push_back((char)FIELD_STRING);
+        m_fields.push_back((char)key.size());
+        m_fields.append(key);
+        m_fields.append((const char *)&len, sizeof(len));
+        m_fields.append(value);
+    }
+
+    bool LogStream::nextField(size_t &pos, Field &field) const {
+        if (pos + 2 > m_fields.size()) {
+            return false;
+        }
+        const char *p = m_fields.data() + pos;
+        field.type = (FieldType)p[0];
+        uint8_t key_len = p[1];
+        field.key = std::string_view(p + 2, key_len);
+        p += 2 + key_len;
+        if (field.type == FIELD_STRING) {
+            uint32_t len;
+            memcpy(&len, p, sizeof(len));
+            field.s = std::string_view(p + sizeof(len), len);
+            p += sizeof(len) + len;
+        } else {
+            memcpy(&field.u, p, sizeof(field.u));
+            p += sizeof(field.u);
+        }
+        pos = p - m_fields.data();
+        return true;
+    }
+
     LogEvent::LogEvent(const char *file, int32_t line, uint32_t elapse,
                        uint32_t threadId, uint32_t fiberId, uint64_t time,
-                       std::shared_ptr<Logger> logger, LogLevel::Level level, std::string threadName)
+                       std::shared_ptr<Logger> logger, LogLevel::Level level, const std::string &threadName)
         : m_file(file), m_line(line), m_elapse(elapse),
           m_threadId(threadId), m_fiberId(fiberId), m_time(time), m_logger(logger), m_level(level), m_threadName(threadName) {}
 
+    LogEvent::ptr LogEvent::Acquire(const char *file, int32_t line,
+                                    const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                                    bool forced) {
+        static thread_local LogEvent::ptr t_event;
+        if (!t_event || t_event.use_count() != 1) {
+            // 还被别人持有（嵌套打日志或被 appender 保留），换一个新的，旧的由持有者释放
+            t_event = std::make_shared<LogEvent>();
+        } else {
+            // 保证其他线程对这个事件的读取都已经结束
+            std::atomic_thread_fence(std::memory_order_acquire);
+            t_event->m_stream.reset();
+        }
+        LogEvent *event = t_event.get();
+        event->m_file = file;
+        event->m_line = line;
+        event->m_elapse = 0;
+        event->m_threadId = GetThreadId();
+        event->m_fiberId = GetFiberId();
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        event->m_time = ts.tv_sec;
+        event->m_usec = ts.tv_nsec / 1000;
+        event->m_logger = logger;
+        event->m_level = level;
+        event->m_forced = forced;
+        // 同一个线程复用同一个事件，容量保留，这里只是拷贝几个字节
+        event->m_threadName = Thread::GetName();
+        return t_event;
+    }
+
     void LogEvent::format(const char *fmt, ...) {
         va_list al;
         va_start(al, fmt);
@@ -47,240 +342,1577 @@ namespace lsh {
     }
 
     void LogEvent::format(const char *fmt, va_list al) {
-        char *buf = nullptr;
-        int len = vasprintf(&buf, fmt, al);
-        if (len != -1) {
-            m_stringStream << std::string(buf, len);
-            free(buf);
-        }
+        // 直接格式化到日志内容的缓冲区，不再 vasprintf + 拷贝
+        m_stream.appendf(fmt, al);
     }
 
-    LogEventWrap::LogEventWrap(std::shared_ptr<LogEvent> event) { m_event = event; }
+    void LogEvent::assign(const LogEvent &other) {
+        m_file = other.m_file;
+        m_line = other.m_line;
+        m_elapse = other.m_elapse;
+        m_threadId = other.m_threadId;
+        m_fiberId = other.m_fiberId;
+        m_time = other.m_time;
+        m_usec = other.m_usec;
+        m_logger = other.m_logger;
+        m_level = other.m_level;
+        m_forced = other.m_forced;
+        m_threadName = other.m_threadName;
+        m_stream.assign(other.m_stream);
+    }
+
+    LogEventWrap::LogEventWrap(std::shared_ptr<LogEvent> event) : m_event(std::move(event)) {}
 
     LogEventWrap::~LogEventWrap() {
         m_event->getLogger()->log(m_event->getLevel(), m_event);
     }
 
-    std::stringstream &LogEventWrap::getSS() {
-        return m_event->getSS();
+    LogStream &LogEventWrap::getSS() {
+        return m_event->getSS();
+    }
+
+    std::shared_ptr<LogEvent> LogEventWrap::getEvent() {
+        return m_event;
+    }
+
+    LogFormatter::LogFormatter(const std::string &pattern) : m_pattern(pattern) {
+        this->init(); // 初始化
+    }
+
+    // 将日志输出对象格式化
+    auto LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::Level level,
+                              std::shared_ptr<LogEvent> event) -> std::string {
+        std::string str;
+        format(str, logger, level, event);
+        return str;
+    }
+
+    // 整数直接转成字符追加，不经过 iostream
+    template <class T>
+    static void AppendInt(std::string &out, T v) {
+        char buf[24];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        out.append(buf, res.ptr - buf);
+    }
+
+    static const char *LevelToCString(LogLevel::Level level) {
+        static const char *s_names[] = {"UNKNOWN", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
+        return (level >= LogLevel::UNKNOWN && level <= LogLevel::FATAL) ? s_names[level] : "UNKNOWN";
+    }
+
+    static void AppendDouble(std::string &out, double v) {
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        out.append(buf, res.ptr - buf);
+    }
+
+    // 8 个字节里是否有需要 JSON 转义的字节（< 0x20、'"'、'\\'），一次检查一个字
+    static inline bool JsonNeedEscape8(uint64_t x) {
+        const uint64_t ones = 0x0101010101010101ull;
+        const uint64_t highs = 0x8080808080808080ull;
+        uint64_t quote = x ^ (ones * '"');
+        uint64_t slash = x ^ (ones * '\\');
+        uint64_t r = ((x - ones * 0x20) | (quote - ones) | (slash - ones)) & ~x & highs;
+        return r != 0;
+    }
+
+    /**
+     * @brief JSON 输出先攒在栈上的小缓冲区里，满了或析构时整段追加到 out
+     *
+     * 一条日志的十几个键、数字和短字符串只需要一两次 std::string::append。
+     */
+    class JsonWriter {
+    public:
+        static const size_t CAPACITY = 512;
+
+        explicit JsonWriter(std::string &out) : m_out(out) {}
+        ~JsonWriter() { flush(); }
+
+        void flush() {
+            m_out.append(m_buf, m_pos);
+            m_pos = 0;
+        }
+
+        void raw(const char *s, size_t n) {
+            if (n > CAPACITY - m_pos) {
+                flush();
+                if (n > CAPACITY) {
+                    m_out.append(s, n);
+                    return;
+                }
+            }
+            memcpy(m_buf + m_pos, s, n);
+            m_pos += n;
+        }
+
+        template <size_t N>
+        void literal(const char (&s)[N]) { raw(s, N - 1); }
+
+        void put(char c) {
+            if (m_pos == CAPACITY) {
+                flush();
+            }
+            m_buf[m_pos++] = c;
+        }
+
+        template <class T>
+        void number(T v) {
+            if (CAPACITY - m_pos < 32) {
+                flush();
+            }
+            auto res = std::to_chars(m_buf + m_pos, m_buf + CAPACITY, v);
+            m_pos = res.ptr - m_buf;
+        }
+
+        // 加上引号并按 JSON 规则转义，不需要转义的部分整段拷贝；非 ASCII 字节原样输出
+        void string(const char *s, size_t n) {
+            static const char s_hex[] = "0123456789abcdef";
+            put('"');
+            size_t start = 0;
+            size_t i = 0;
+            while (i < n) {
+                while (i + 8 <= n) {
+                    uint64_t x;
+                    memcpy(&x, s + i, sizeof(x));
+                    if (JsonNeedEscape8(x)) {
+                        break;
+                    }
+                    i += 8;
+                }
+                if (i >= n) {
+                    break;
+                }
+                unsigned char c = s[i++];
+                if (c >= 0x20 && c != '"' && c != '\\') {
+                    continue;
+                }
+                raw(s + start, i - 1 - start);
+                start = i;
+                switch (c) {
+                case '"':
+                    literal("\\\"");
+                    break;
+                case '\\':
+                    literal("\\\\");
+                    break;
+                case '\n':
+                    literal("\\n");
+                    break;
+                case '\r':
+                    literal("\\r");
+                    break;
+                case '\t':
+                    literal("\\t");
+                    break;
+                default: {
+                    char buf[6] = {'\\', 'u', '0', '0', s_hex[c >> 4], s_hex[c & 0xf]};
+                    raw(buf, sizeof(buf));
+                    break;
+                }
+                }
+            }
+            raw(s + start, n - start);
+            put('"');
+        }
+
+        void string(std::string_view s) { string(s.data(), s.size()); }
+
+    private:
+        std::string &m_out;
+        size_t m_pos{0};
+        char m_buf[CAPACITY];
+    };
+
+    // 文本格式下的字段：" key=value"
+    static void AppendTextFields(std::string &out, const LogStream &stream) {
+        LogStream::Field field;
+        size_t pos = 0;
+        while (stream.nextField(pos, field)) {
+            out.push_back(' ');
+            out.append(field.key);
+            out.push_back('=');
+            switch (field.type) {
+            case LogStream::FIELD_INT:
+                AppendInt(out, field.i);
+                break;
+            case LogStream::FIELD_UINT:
+                AppendInt(out, field.u);
+                break;
+            case LogStream::FIELD_DOUBLE:
+                AppendDouble(out, field.d);
+                break;
+            case LogStream::FIELD_BOOL:
+                out.append(field.b ? "true" : "false");
+                break;
+            case LogStream::FIELD_STRING:
+                out.append(field.s);
+                break;
+            }
+        }
+    }
+
+    void LogFormatter::format(std::string &out, const std::shared_ptr<Logger> &logger,
+                              LogLevel::Level level, const std::shared_ptr<LogEvent> &event) {
+        if (m_json) {
+            formatJson(out, level, event);
+            return;
+        }
+        for (auto &op : m_ops) {
+            switch (op.code) {
+            case OP_STRING:
+                out.append(m_strings.data() + op.offset, op.length);
+                break;
+            case OP_MESSAGE:
+                out.append(event->getContentData(), event->getContentSize());
+                if (event->getStream().hasFields()) {
+                    AppendTextFields(out, event->getStream());
+                }
+                break;
+            case OP_LEVEL:
+                out.append(LevelToCString(level));
+                break;
+            case OP_ELAPSE:
+                AppendInt(out, event->getElapse());
+                break;
+            case OP_LOGGER_NAME:
+                if (event->getLogger()) {
+                    out.append(event->getLogger()->getName());
+                }
+                break;
+            case OP_THREAD_ID:
+                AppendInt(out, event->getThreadId());
+                break;
+            case OP_NEWLINE:
+                // 只追加换行符，不像 std::endl 那样强制刷新
+                out.push_back('\n');
+                break;
+            case OP_DATETIME:
+                appendDateTime(out, op, event->getTime(), event->getMicroSecond());
+                break;
+            case OP_FILE:
+                if (event->getFile()) {
+                    out.append(event->getFile());
+                }
+                break;
+            case OP_LINE:
+                AppendInt(out, event->getLine());
+                break;
+            case OP_TAB:
+                out.push_back('\t');
+                break;
+            case OP_FIBER_ID:
+                AppendInt(out, event->getFiberId());
+                break;
+            case OP_THREAD_NAME:
+                out.append(event->getThreadName());
+                break;
+            }
+        }
+    }
+
+    void LogFormatter::formatJson(std::string &out, LogLevel::Level level, const std::shared_ptr<LogEvent> &event) {
+        out.append("{\"time\":\"");
+        appendDateTime(out, m_ops[0], event->getTime(), event->getMicroSecond());
+
+        JsonWriter w(out);
+        w.literal("\",\"level\":\"");
+        w.raw(LevelToCString(level), strlen(LevelToCString(level)));
+        w.literal("\",\"logger\":");
+        w.string(event->getLogger() ? std::string_view(event->getLogger()->getName()) : std::string_view());
+        w.literal(",\"thread_id\":");
+        w.number(event->getThreadId());
+        w.literal(",\"thread_name\":");
+        w.string(event->getThreadName());
+        w.literal(",\"fiber_id\":");
+        w.number(event->getFiberId());
+        w.literal(",\"file\":");
+        w.string(event->getFile() ? std::string_view(event->getFile()) : std::string_view());
+        w.literal(",\"line\":");
+        w.number(event->getLine());
+        w.literal(",\"message\":");
+        w.string(event->getContentData(), event->getContentSize());
+
+        LogStream::Field field;
+        size_t pos = 0;
+        while (event->getStream().nextField(pos, field)) {
+            w.put(',');
+            w.string(field.key);
+            w.put(':');
+            switch (field.type) {
+            case LogStream::FIELD_INT:
+                w.number(field.i);
+                break;
+            case LogStream::FIELD_UINT:
+                w.number(field.u);
+                break;
+            case LogStream::FIELD_DOUBLE:
+                // JSON 没有 NaN/Inf
+                if (std::isfinite(field.d)) {
+                    w.number(field.d);
+                } else {
+                    w.literal("null");
+                }
+                break;
+            case LogStream::FIELD_BOOL:
+                if (field.b) {
+                    w.literal("true");
+                } else {
+                    w.literal("false");
+                }
+                break;
+            case LogStream::FIELD_STRING:
+                w.string(field.s);
+                break;
+            }
+        }
+        w.literal("}\n");
+    }
+
+    // 线程内的 %d 渲染缓存，按 (时间格式 id, 秒) 命中
+    struct DateTimeCache {
+        static const size_t MAX_TEXT = 256;
+        static const size_t MAX_HOLES = 8;
+
+        uint64_t id{0};
+        time_t sec{-1};
+        char text[MAX_TEXT]; // 不含亚秒部分的文本
+        uint32_t len{0};
+        uint32_t hole_pos[MAX_HOLES]; // 亚秒数字插入到 text 中的位置
+        uint8_t hole_digits[MAX_HOLES];
+        uint32_t holes{0};
+    };
+
+    static const size_t DATE_CACHE_SLOTS = 8;
+    static std::atomic<uint64_t> s_date_format_id{0};
+
+    // 写入 digits 位亚秒数字（3 位毫秒 / 6 位微秒），不足补 0
+    static void AppendSubSecond(std::string &out, uint32_t usec, uint8_t digits) {
+        uint32_t v = digits == 3 ? usec / 1000 : usec;
+        char buf[6];
+        for (int i = digits - 1; i >= 0; --i) {
+            buf[i] = '0' + v % 10;
+            v /= 10;
+        }
+        out.append(buf, digits);
+    }
+
+    void LogFormatter::appendDateTime(std::string &out, const Op &op, time_t timestamp, uint32_t usec) {
+        static thread_local DateTimeCache t_cache[DATE_CACHE_SLOTS];
+        const DateFormat &df = m_dates[op.offset];
+        DateTimeCache &c = t_cache[df.id % DATE_CACHE_SLOTS];
+
+        if (c.id != df.id || c.sec != timestamp) {
+            // 未命中：这一秒第一次渲染，调用一次 localtime_r，再逐段 strftime
+            struct tm localTime;
+            localtime_r(&timestamp, &localTime);
+            c.id = df.id;
+            c.sec = timestamp;
+            c.len = 0;
+            c.holes = 0;
+            bool error = false;
+            for (size_t i = 0; i < df.pieces.size(); ++i) {
+                const std::string &piece = df.pieces[i];
+                if (!piece.empty()) {
+                    size_t n = strftime(c.text + c.len, DateTimeCache::MAX_TEXT - c.len, piece.c_str(), &localTime);
+                    if (n == 0) {
+                        error = true;
+                        break;
+                    }
+                    c.len += n;
+                }
+                if (df.digits[i]) {
+                    if (c.holes == DateTimeCache::MAX_HOLES) {
+                        error = true;
+                        break;
+                    }
+                    c.hole_pos[c.holes] = c.len;
+                    c.hole_digits[c.holes] = df.digits[i];
+                    ++c.holes;
+                }
+            }
+            if (error) {
+                // 处理格式化失败的情况
+                static const char s_error[] = "<<time_format_error>>";
+                memcpy(c.text, s_error, sizeof(s_error) - 1);
+                c.len = sizeof(s_error) - 1;
+                c.holes = 0;
+            }
+        }
+
+        uint32_t pos = 0;
+        for (uint32_t i = 0; i < c.holes; ++i) {
+            out.append(c.text + pos, c.hole_pos[i] - pos);
+            AppendSubSecond(out, usec, c.hole_digits[i]);
+            pos = c.hole_pos[i];
+        }
+        out.append(c.text + pos, c.len - pos);
+    }
+
+    LogFormatter::Op LogFormatter::makeOp(OpCode code, const std::string &arg) {
+        Op op;
+        op.code = code;
+        if (code == OP_DATETIME) {
+            // 在 %3N/%6N 处切开格式串，"%%" 原样保留给 strftime
+            DateFormat df;
+            df.id = ++s_date_format_id;
+            std::string piece;
+            for (size_t i = 0; i < arg.size(); ++i) {
+                if (arg[i] == '%' && i + 1 < arg.size()) {
+                    if (arg[i + 1] == '%') {
+                        piece.append("%%");
+                        ++i;
+                        continue;
+                    }
+                    if ((arg[i + 1] == '3' || arg[i + 1] == '6') && i + 2 < arg.size() && arg[i + 2] == 'N') {
+                        df.pieces.push_back(piece);
+                        df.digits.push_back(arg[i + 1] - '0');
+                        piece.clear();
+                        i += 2;
+                        continue;
+                    }
+                }
+                piece.push_back(arg[i]);
+            }
+            df.pieces.push_back(piece);
+            df.digits.push_back(0);
+            op.offset = m_dates.size();
+            m_dates.push_back(std::move(df));
+            return op;
+        }
+        if (code != OP_STRING) {
+            return op;
+        }
+        op.offset = m_strings.size();
+        op.length = arg.size();
+        m_strings.append(arg);
+        m_strings.push_back('\0');
+        return op;
+    }
+
+    void LogFormatter::init() {
+        // json / json{时间格式}
+        if (m_pattern.compare(0, 4, "json") == 0 &&
+            (m_pattern.size() == 4 || (m_pattern[4] == '{' && m_pattern.back() == '}'))) {
+            m_json = true;
+            m_ops.clear();
+            m_strings.clear();
+            m_dates.clear();
+            std::string date = m_pattern.size() > 6 ? m_pattern.substr(5, m_pattern.size() - 6) : "%Y-%m-%dT%H:%M:%S.%6N%z";
+            m_ops.push_back(makeOp(OP_DATETIME, date));
+            return;
+        }
+        m_json = false;
+        std::vector<std::tuple<std::string, std::string, int>> vec;
+        std::string nstr;
+        for (size_t i = 0; i < m_pattern.size(); ++i) {
+            if (m_pattern[i] != '%') {
+                nstr.append(1, m_pattern[i]);
+                continue;
+            }
+
+            if ((i + 1) < m_pattern.size()) {
+                if (m_pattern[i + 1] == '%') {
+                    nstr.append(1, '%');
+                    continue;
+                }
+            }
+
+            size_t n = i + 1;
+            int fmt_status = 0;
+            size_t fmt_begin = 0;
+
+            std::string str;
+            std::string fmt;
+            while (n < m_pattern.size()) {
+                if (!fmt_status && (!isalpha(m_pattern[n]) && m_pattern[n] != '{' && m_pattern[n] != '}')) {
+                    str = m_pattern.substr(i + 1, n - i - 1);
+                    break;
+                }
+                if (fmt_status == 0) {
+                    if (m_pattern[n] == '{') {
+                        str = m_pattern.substr(i + 1, n - i - 1);
+                        // std::cout << "*" << str << std::endl;
+                        fmt_status = 1; // 解析格式
+                        fmt_begin = n;
+                        ++n;
+                        continue;
+                    }
+                } else if (fmt_status == 1) {
+                    if (m_pattern[n] == '}') {
+                        fmt = m_pattern.substr(fmt_begin + 1, n - fmt_begin - 1);
+                        // std::cout << "#" << fmt << std::endl;
+                        fmt_status = 0;
+                        ++n;
+                        break;
+                    }
+                }
+                ++n;
+                if (n == m_pattern.size()) {
+                    if (str.empty()) {
+                        str = m_pattern.substr(i + 1);
+                    }
+                }
+            }
+
+            if (fmt_status == 0) {
+                if (!nstr.empty()) {
+                    vec.push_back(std::make_tuple(nstr, std::string(), 0));
+                    nstr.clear();
+                }
+                vec.push_back(std::make_tuple(str, fmt, 1));
+                i = n - 1;
+            } else if (fmt_status == 1) {
+                std::cout << "pattern parse error: " << m_pattern << " - " << m_pattern.substr(i) << std::endl;
+                m_error = true;
+                vec.push_back(std::make_tuple("<<pattern_error>>", fmt, 0));
+            }
+        }
+
+        if (!nstr.empty()) {
+            vec.push_back(std::make_tuple(nstr, "", 0));
+        }
+        static const std::map<std::string, OpCode> s_format_ops = {
+            {"m", OP_MESSAGE},     // m:消息
+            {"p", OP_LEVEL},       // p:日志级别
+            {"r", OP_ELAPSE},      // r:累计毫秒数
+            {"c", OP_LOGGER_NAME}, // c:日志名称
+            {"t", OP_THREAD_ID},   // t:线程id
+            {"n", OP_NEWLINE},     // n:换行
+            {"d", OP_DATETIME},    // d:时间
+            {"f", OP_FILE},        // f:文件名
+            {"l", OP_LINE},        // l:行号
+            {"T", OP_TAB},         // T:Tab
+            {"F", OP_FIBER_ID},    // F:协程id
+            {"N", OP_THREAD_NAME}, // N:线程名称
+        };
+
+        m_ops.clear();
+        m_strings.clear();
+        m_dates.clear();
+        for (auto &i : vec) {
+            if (std::get<2>(i) == 0) {
+                m_ops.push_back(makeOp(OP_STRING, std::get<0>(i)));
+                continue;
+            }
+            auto it = s_format_ops.find(std::get<0>(i));
+            if (it == s_format_ops.end()) {
+                m_ops.push_back(makeOp(OP_STRING, "<<error_format %" + std::get<0>(i) + ">>"));
+                m_error = true;
+            } else if (it->second == OP_DATETIME) {
+                m_ops.push_back(makeOp(OP_DATETIME, std::get<1>(i).empty() ? "%Y-%m-%d %H:%M:%S" : std::get<1>(i)));
+            } else {
+                m_ops.push_back(makeOp(it->second));
+            }
+        }
+
+        // 相邻的字面量合并成一个操作
+        std::vector<Op> merged;
+        std::string strings;
+        for (auto &op : m_ops) {
+            if (op.code != OP_STRING) {
+                merged.push_back(op);
+                continue;
+            }
+            std::string arg(m_strings.data() + op.offset, op.length);
+            if (!merged.empty() && merged.back().code == OP_STRING) {
+                strings.pop_back();
+                strings.append(arg);
+                strings.push_back('\0');
+                merged.back().length += op.length;
+                continue;
+            }
+            Op n = op;
+            n.offset = strings.size();
+            strings.append(arg);
+            strings.push_back('\0');
+            merged.push_back(n);
+        }
+        m_ops.swap(merged);
+        m_strings.swap(strings);
+    }
+
+    AsyncLogWriter::AsyncLogWriter(const std::string &file_name, size_t buffer_size,
+                                   size_t max_buffers, OverflowPolicy policy,
+                                   uint64_t flush_interval_ms)
+        : m_file_name(file_name),
+          m_buffer_size(buffer_size ? buffer_size : 4 * 1024 * 1024),
+          m_max_buffers(max_buffers < 2 ? 2 : max_buffers),
+          m_policy(policy),
+          m_flush_interval(flush_interval_ms ? flush_interval_ms : 1000) {
+        openFile();
+        m_current.reserve(m_buffer_size);
+        m_thread.reset(new Thread(std::bind(&AsyncLogWriter::run, this), "log_writer"));
+    }
+
+    AsyncLogWriter::~AsyncLogWriter() {
+        stop();
+    }
+
+    bool AsyncLogWriter::append(const char *data, size_t len) {
+        MutexType::Lock lock(m_mutex);
+        while (!m_stopping) {
+            // 单条日志比缓冲区还大时，允许它独占一个空缓冲区
+            if (m_current.size() + len <= m_buffer_size || m_current.empty()) {
+                m_current.append(data, len);
+                return true;
+            }
+
+            // 前台缓冲区满了，还有配额就换一块新的
+            if (m_queued + 1 < m_max_buffers) {
+                m_full.push_back(std::move(m_current));
+                ++m_queued;
+                if (!m_spare.empty()) {
+                    m_current = std::move(m_spare.back());
+                    m_spare.pop_back();
+                } else {
+                    m_current = std::string();
+                    m_current.reserve(m_buffer_size);
+                }
+                m_notify.notify();
+                continue;
+            }
+
+            if (m_policy == DROP) {
+                ++m_dropped;
+                return false;
+            }
+
+            // BLOCK：等后台线程写完一批再重试
+            ++m_waiters;
+            lock.unlock();
+            m_notify.notify();
+            m_space.wait();
+            lock.lock();
+        }
+        return false;
+    }
+
+    void AsyncLogWriter::reopen() {
+        {
+            MutexType::Lock lock(m_mutex);
+            m_reopen = true;
+        }
+        m_notify.notify();
+    }
+
+    void AsyncLogWriter::stop() {
+        {
+            MutexType::Lock lock(m_mutex);
+            if (m_stopping) {
+                return;
+            }
+            m_stopping = true;
+        }
+        m_notify.notify();
+        m_thread->join();
+    }
+
+    void AsyncLogWriter::setRotate(uint64_t max_size, uint64_t interval, uint32_t max_files) {
+        m_rotate_size = max_size;
+        m_rotate_interval = interval;
+        m_max_files = max_files;
+        // 让后台线程按新的间隔重新计算下一次滚动的时刻
+        reopen();
+    }
+
+    void AsyncLogWriter::reportError(const char *what, int err) {
+        uint64_t suppressed = 0;
+        if (!m_error_limiter.everyMS(1000, suppressed)) {
+            return;
+        }
+        std::cout << "AsyncLogWriter " << what << " " << m_file_name << " failed errno=" << err;
+        if (suppressed) {
+            std::cout << " [suppressed " << suppressed << " messages]";
+        }
+        std::cout << std::endl;
+    }
+
+    bool AsyncLogWriter::openFile() {
+        if (m_file_stream.is_open()) {
+            m_file_stream.close();
+        }
+        m_file_stream.clear();
+        errno = 0;
+        m_file_stream.open(m_file_name, std::ios::app);
+        if (!m_file_stream.is_open()) {
+            reportError("open", errno);
+            m_file_size = 0;
+            return false;
+        }
+        std::error_code ec;
+        m_file_size = std::filesystem::file_size(m_file_name, ec);
+        if (ec) {
+            m_file_size = 0;
+        }
+        m_file_time = time(0);
+        updateNextRotate();
+        return true;
+    }
+
+    void AsyncLogWriter::updateNextRotate() {
+        m_next_rotate = 0;
+        uint64_t interval = m_rotate_interval;
+        if (interval) {
+            // 按本地时间对齐：interval 为 86400 时在本地零点滚动
+            time_t now = time(0);
+            struct tm tm;
+            localtime_r(&now, &tm);
+            time_t local = now + tm.tm_gmtoff;
+            m_next_rotate = local - local % interval + interval - tm.tm_gmtoff;
+        }
+    }
+
+    void AsyncLogWriter::write(const char *data, size_t len) {
+        if (m_next_rotate && time(0) >= m_next_rotate) {
+            // 空文件不滚动，只往后推下一次的时刻
+            if (m_file_size > 0) {
+                rotate();
+            } else {
+                updateNextRotate();
+            }
+        }
+        while (len > 0) {
+            if (!m_file_stream.is_open()) {
+                // 滚动后没能打开新文件，剩下的整行计入丢弃
+                m_dropped += std::count(data, data + len, '\n');
+                return;
+            }
+            size_t n = len;
+            uint64_t max_size = m_rotate_size;
+            if (max_size && m_file_size + len > max_size) {
+                // 当前文件还能放下的部分，截到最后一个换行，保证一行日志不会被拆到两个文件
+                size_t room = m_file_size < max_size ? max_size - m_file_size : 0;
+                const char *nl = room ? (const char *)memrchr(data, '\n', std::min<size_t>(room, len)) : nullptr;
+                if (nl) {
+                    n = nl - data + 1;
+                } else if (m_file_size > 0) {
+                    rotate();
+                    continue;
+                } else {
+                    // 单行就超过上限，让它独占一个文件
+                    nl = (const char *)memchr(data, '\n', len);
+                    n = nl ? nl - data + 1 : len;
+                }
+            }
+            m_file_stream.write(data, n);
+            m_file_size += n;
+            data += n;
+            len -= n;
+        }
+    }
+
+    void AsyncLogWriter::rotate() {
+        m_file_stream.close();
+        struct tm tm;
+        localtime_r(&m_file_time, &tm);
+        char buf[32];
+        strftime(buf, sizeof(buf), ".%Y%m%d-%H%M%S", &tm);
+        std::string target = m_file_name + buf;
+        // 同一秒内滚动多次时加序号区分
+        std::error_code ec;
+        for (int i = 1; std::filesystem::exists(target, ec); ++i) {
+            target = m_file_name + buf + "." + std::to_string(i);
+        }
+        if (::rename(m_file_name.c_str(), target.c_str()) != 0) {
+            std::cout << "AsyncLogWriter rotate " << m_file_name << " to " << target
+                      << " failed errno=" << errno << std::endl;
+        }
+        openFile();
+        prune();
+    }
+
+    void AsyncLogWriter::prune() {
+        uint32_t max_files = m_max_files;
+        if (!max_files) {
+            return;
+        }
+        std::filesystem::path path(m_file_name);
+        std::filesystem::path dir = path.parent_path();
+        if (dir.empty()) {
+            dir = ".";
+        }
+        std::string prefix = path.filename().string() + ".";
+        // (时间戳, 同一秒内的序号, 文件名)
+        std::vector<std::tuple<std::string, int, std::string>> files;
+        std::error_code ec;
+        for (auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+            std::string name = entry.path().filename().string();
+            // 只认 file_name.YYYYmmdd-HHMMSS[.n]，不碰其他同前缀的文件
+            if (name.size() >= prefix.size() + 15 && name.compare(0, prefix.size(), prefix) == 0 &&
+                name[prefix.size() + 8] == '-' && isdigit((unsigned char)name[prefix.size()])) {
+                std::string stamp = name.substr(prefix.size(), 15);
+                int seq = 0;
+                if (name.size() > prefix.size() + 16 && name[prefix.size() + 15] == '.') {
+                    seq = atoi(name.c_str() + prefix.size() + 16);
+                }
+                files.emplace_back(stamp, seq, name);
+            }
+        }
+        if (files.size() <= max_files) {
+            return;
+        }
+        // 时间戳定长，字典序即时间顺序；同一秒内再按序号
+        std::sort(files.begin(), files.end());
+        for (size_t i = 0; i + max_files < files.size(); ++i) {
+            std::filesystem::remove(dir / std::get<2>(files[i]), ec);
+        }
+    }
+
+    void AsyncLogWriter::run() {
+        std::vector<std::string> buffers;
+        while (true) {
+            m_notify.waitFor(m_flush_interval);
+
+            bool reopen = false;
+            bool stopping = false;
+            {
+                MutexType::Lock lock(m_mutex);
+                buffers.swap(m_full);
+                if (!m_current.empty()) {
+                    buffers.push_back(std::move(m_current));
+                    ++m_queued;
+                    if (!m_spare.empty()) {
+                        m_current = std::move(m_spare.back());
+                        m_spare.pop_back();
+                    } else {
+                        m_current = std::string();
+                        m_current.reserve(m_buffer_size);
+                    }
+                }
+                reopen = m_reopen;
+                m_reopen = false;
+                stopping = m_stopping;
+            }
+
+            // 上次没能打开文件的，每次刷盘时重试
+            if (reopen || (!buffers.empty() && !m_file_stream.is_open())) {
+                openFile();
+            }
+
+            // 不持有锁，整块顺序写入（需要时在其中滚动文件）
+            for (auto &buf : buffers) {
+                write(buf.data(), buf.size());
+            }
+            if (!buffers.empty()) {
+                m_file_stream.flush();
+            }
+
+            size_t waiters = 0;
+            {
+                MutexType::Lock lock(m_mutex);
+                m_queued -= buffers.size();
+                // 只留两块备用，其余的归还给系统
+                for (auto &buf : buffers) {
+                    if (m_spare.size() < 2) {
+                        buf.clear();
+                        m_spare.push_back(std::move(buf));
+                    }
+                }
+                waiters = m_waiters;
+                m_waiters = 0;
+            }
+            buffers.clear();
+            for (size_t i = 0; i < waiters; ++i) {
+                m_space.notify();
+            }
+
+            if (stopping) {
+                break;
+            }
+        }
+        m_file_stream.close();
+    }
+
+    AsyncLogWriter::OverflowPolicy AsyncLogWriter::PolicyFromString(const std::string &str) {
+        std::string s = str;
+        std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+        return s == "drop" ? DROP : BLOCK;
+    }
+
+    std::string AsyncLogWriter::PolicyToString(OverflowPolicy policy) {
+        return policy == DROP ? "drop" : "block";
+    }
+
+    // 每个线程复用一块格式化缓冲区，容量保留，稳定后格式化不再分配内存
+    static std::string &GetFormatBuffer() {
+        static thread_local std::string t_buffer;
+        t_buffer.clear();
+        return t_buffer;
+    }
+
+    //=============== MmapFileLogAppender =================
+    // 每个线程一个 hazard 槽，记录它正在写的 mmap 段；槽独占一条缓存行，写者只写自己的槽
+    struct alignas(64) MmapHazard {
+        std::atomic<const void *> segment{nullptr};
+        std::atomic<bool> in_use{true};
+        MmapHazard *next{nullptr};
+    };
+
+    static std::atomic<MmapHazard *> s_mmap_hazards{nullptr};
+
+    static MmapHazard *AcquireMmapHazard() {
+        for (MmapHazard *h = s_mmap_hazards.load(std::memory_order_acquire); h; h = h->next) {
+            bool expected = false;
+            if (h->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return h;
+            }
+        }
+        MmapHazard *h = new MmapHazard;
+        h->next = s_mmap_hazards.load(std::memory_order_relaxed);
+        while (!s_mmap_hazards.compare_exchange_weak(h->next, h, std::memory_order_release,
+                                                     std::memory_order_relaxed)) {
+        }
+        return h;
+    }
+
+    // 线程退出时把槽交还；之后这个线程的写入改为持锁
+    struct MmapHazardHolder {
+        MmapHazard *hazard{nullptr};
+        bool exited{false};
+
+        ~MmapHazardHolder() {
+            exited = true;
+            if (hazard) {
+                hazard->in_use.store(false, std::memory_order_release);
+                hazard = nullptr;
+            }
+        }
+    };
+
+    static MmapHazard *GetMmapHazard() {
+        static thread_local MmapHazardHolder t_holder;
+        if (!t_holder.hazard && !t_holder.exited) {
+            t_holder.hazard = AcquireMmapHazard();
+        }
+        return t_holder.hazard;
+    }
+
+    // 等所有线程都不再写 segment（它已经不是当前段，不会有新的写者进来）
+    static void WaitMmapHazards(const void *segment) {
+        for (MmapHazard *h = s_mmap_hazards.load(std::memory_order_acquire); h; h = h->next) {
+            while (h->segment.load() == segment) {
+                sched_yield();
+            }
+        }
+    }
+
+    MmapFileLogAppender::MmapFileLogAppender(const std::string &file_name, size_t segment_size,
+                                             SyncPolicy sync, AdvisePolicy advise)
+        : m_file_name(file_name), m_sync(sync), m_advise(advise) {
+        long page = sysconf(_SC_PAGESIZE);
+        m_segment_size = std::max(segment_size, MIN_SEGMENT_SIZE);
+        m_segment_size = (m_segment_size + page - 1) / page * page;
+        SwitchMutexType::Lock lock(m_switch_mutex);
+        m_retry_ms = GetCurrentMS();
+        openFile();
+    }
+
+    MmapFileLogAppender::~MmapFileLogAppender() {
+        SwitchMutexType::Lock lock(m_switch_mutex);
+        closeFile();
+    }
+
+    void MmapFileLogAppender::reportError(const char *what, int err) {
+        uint64_t suppressed = 0;
+        if (!m_error_limiter.everyMS(RETRY_INTERVAL_MS, suppressed)) {
+            return;
+        }
+        std::cout << "MmapFileLogAppender " << what << " " << m_file_name << " failed errno=" << err;
+        if (suppressed) {
+            std::cout << " [suppressed " << suppressed << " messages]";
+        }
+        std::cout << std::endl;
+    }
+
+    bool MmapFileLogAppender::openFile() {
+        m_fd = ::open(m_file_name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (m_fd < 0) {
+            reportError("open", errno);
+            return false;
+        }
+        struct stat st;
+        if (fstat(m_fd, &st) != 0) {
+            st.st_size = 0;
+        }
+
+        // 上次没有正常关闭（崩溃）时，文件末尾是预分配的 '\0'，只可能出现在最后一段里
+        uint64_t end = st.st_size;
+        uint64_t begin = end > m_segment_size ? end - m_segment_size : 0;
+        char buf[64 * 1024];
+        while (end > begin) {
+            size_t n = std::min<uint64_t>(sizeof(buf), end - begin);
+            if (pread(m_fd, buf, n, end - n) != (ssize_t)n) {
+                break;
+            }
+            size_t i = n;
+            while (i > 0 && buf[i - 1] == '\0') {
+                --i;
+            }
+            end -= n - i;
+            if (i > 0) {
+                break;
+            }
+        }
+        m_end = end;
+        return mapSegment(end);
+    }
+
+    bool MmapFileLogAppender::mapSegment(uint64_t end) {
+        long page = sysconf(_SC_PAGESIZE);
+        uint64_t base = end - end % page;
+        if (ftruncate(m_fd, base + m_segment_size) != 0) {
+            reportError("ftruncate", errno);
+            return false;
+        }
+        void *data = mmap(nullptr, m_segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, base);
+        if (data == MAP_FAILED) {
+            reportError("mmap", errno);
+            ftruncate(m_fd, end);
+            return false;
+        }
+        if (m_advise == ADVISE_SEQUENTIAL) {
+            madvise(data, m_segment_size, MADV_SEQUENTIAL);
+        } else if (m_advise == ADVISE_WILLNEED) {
+            madvise(data, m_segment_size, MADV_WILLNEED);
+        }
+        Segment *seg = new Segment;
+        seg->data = (char *)data;
+        seg->base = base;
+        seg->generation = ++m_generation;
+        seg->tail = end - base;
+        m_segment.store(seg);
+        return true;
+    }
+
+    uint64_t MmapFileLogAppender::retireSegment() {
+        Segment *seg = m_segment.load(std::memory_order_relaxed);
+        if (!seg) {
+            return m_end;
+        }
+        // 先摘下再等：之后登记这个段的写者都会发现它不再是当前段
+        m_segment.store(nullptr);
+        WaitMmapHazards(seg);
+
+        uint64_t used = std::min<uint64_t>(seg->tail, seg->fail);
+        used = std::min<uint64_t>(used, m_segment_size);
+        if (m_sync != SYNC_NONE) {
+            long page = sysconf(_SC_PAGESIZE);
+            uint64_t synced = (used + page - 1) / page * page;
+            msync(seg->data, std::min<uint64_t>(synced, m_segment_size), m_sync == SYNC_SYNC ? MS_SYNC : MS_ASYNC);
+        }
+        munmap(seg->data, m_segment_size);
+        m_end = seg->base + used;
+        delete seg;
+        return m_end;
+    }
+
+    void MmapFileLogAppender::switchSegment(uint64_t generation) {
+        Segment *seg = m_segment.load(std::memory_order_relaxed);
+        if (!seg || seg->generation != generation) {
+            return;
+        }
+        mapSegment(retireSegment());
+    }
+
+    void MmapFileLogAppender::closeFile() {
+        if (m_fd < 0) {
+            return;
+        }
+        // 去掉预分配的部分
+        ftruncate(m_fd, retireSegment());
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+    bool MmapFileLogAppender::writeFallback(const char *data, size_t len) {
+        if (m_segment.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        uint64_t now = GetCurrentMS();
+        if (now - m_retry_ms >= RETRY_INTERVAL_MS) {
+            m_retry_ms = now;
+            if (m_fd < 0 ? openFile() : mapSegment(m_end)) {
+                return false;
+            }
+        }
+        if (m_fd < 0) {
+            return true;
+        }
+        while (len > 0) {
+            ssize_t n = pwrite(m_fd, data, len, m_end);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                reportError("pwrite", n < 0 ? errno : ENOSPC);
+                break;
+            }
+            data += n;
+            len -= n;
+            m_end += n;
+        }
+        return true;
+    }
+
+    bool MmapFileLogAppender::writeSegment(Segment *seg, const char *data, size_t len, bool newline) {
+        uint64_t offset = seg->tail.fetch_add(len, std::memory_order_relaxed);
+        if (offset + len <= m_segment_size) {
+            memcpy(seg->data + offset, data, len - newline);
+            if (newline) {
+                seg->data[offset + len - 1] = '\n';
+            }
+            return true;
+        }
+        // 段满了：记下最小的失败位置，之后的写者都会失败，这里就是本段有效数据的末尾
+        uint64_t fail = seg->fail.load(std::memory_order_relaxed);
+        while (offset < fail && !seg->fail.compare_exchange_weak(fail, offset)) {
+        }
+        return false;
+    }
+
+    void MmapFileLogAppender::append(const char *data, size_t len) {
+        if (len == 0) {
+            return;
+        }
+        // 新段从页对齐的位置映射，开头最多已经用掉不到一页；
+        // 超过 m_segment_size - page 的日志只保留这么多（末尾的换行保留），否则换段后仍然放不下，会一直换段
+        long page = sysconf(_SC_PAGESIZE);
+        size_t n = std::min<size_t>(len, m_segment_size - page);
+        bool newline = n < len && data[len - 1] == '\n';
+
+        MmapHazard *hazard = GetMmapHazard();
+        if (!hazard) {
+            // 线程正在退出，没有 hazard 槽：持锁写，期间不会换段
+            SwitchMutexType::Lock lock(m_switch_mutex);
+            while (true) {
+                Segment *seg = m_segment.load(std::memory_order_relaxed);
+                if (!seg) {
+                    if (writeFallback(data, len)) {
+                        return;
+                    }
+                } else if (writeSegment(seg, data, n, newline)) {
+                    return;
+                } else {
+                    switchSegment(seg->generation);
+                }
+            }
+        }
+
+        while (true) {
+            Segment *seg = m_segment.load(std::memory_order_acquire);
+            if (seg) {
+                // 先登记再确认：和 retireSegment 的“先摘下再等”配对，两边都是 seq_cst
+                hazard->segment.store(seg);
+                if (m_segment.load() != seg) {
+                    hazard->segment.store(nullptr, std::memory_order_release);
+                    continue;
+                }
+                bool ok = writeSegment(seg, data, n, newline);
+                uint64_t generation = seg->generation;
+                hazard->segment.store(nullptr, std::memory_order_release);
+                if (ok) {
+                    return;
+                }
+                SwitchMutexType::Lock lock(m_switch_mutex);
+                switchSegment(generation);
+            } else {
+                SwitchMutexType::Lock lock(m_switch_mutex);
+                if (writeFallback(data, len)) {
+                    return;
+                }
+            }
+        }
+    }
+
+    void MmapFileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level,
+                                  std::shared_ptr<LogEvent> event) {
+        if (level < m_level) {
+            return;
+        }
+        std::shared_ptr<LogFormatter> formatter;
+        {
+            MutexType::Lock lock(m_mutex);
+            formatter = m_formatter;
+        }
+        std::string &buf = GetFormatBuffer();
+        formatter->format(buf, logger, level, event);
+        append(buf.data(), buf.size());
+    }
+
+    bool MmapFileLogAppender::reopen() {
+        SwitchMutexType::Lock lock(m_switch_mutex);
+        closeFile();
+        return openFile();
+    }
+
+    std::string MmapFileLogAppender::toYamlString() {
+        MutexType::Lock lock(m_mutex);
+        YAML::Node node;
+        node["type"] = "MmapFileLogAppender";
+        node["file"] = m_file_name;
+        node["segment_size"] = m_segment_size;
+        node["msync"] = SyncToString(m_sync);
+        node["advise"] = AdviseToString(m_advise);
+        if (m_level != LogLevel::UNKNOWN) {
+            node["level"] = LogLevel::toString(m_level);
+        }
+        if (m_formatter && m_hasFormatter) {
+            node["formatter"] = m_formatter->getPattern();
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+
+    MmapFileLogAppender::SyncPolicy MmapFileLogAppender::SyncFromString(const std::string &str) {
+        std::string s = str;
+        std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+        if (s == "sync") {
+            return SYNC_SYNC;
+        }
+        return s == "async" ? SYNC_ASYNC : SYNC_NONE;
+    }
+
+    std::string MmapFileLogAppender::SyncToString(SyncPolicy policy) {
+        return policy == SYNC_SYNC ? "sync" : (policy == SYNC_ASYNC ? "async" : "none");
     }
 
-    std::shared_ptr<LogEvent> LogEventWrap::getEvent() {
-        return m_event;
+    MmapFileLogAppender::AdvisePolicy MmapFileLogAppender::AdviseFromString(const std::string &str) {
+        std::string s = str;
+        std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+        if (s == "willneed") {
+            return ADVISE_WILLNEED;
+        }
+        return s == "normal" ? ADVISE_NORMAL : ADVISE_SEQUENTIAL;
     }
 
-    LogFormatter::LogFormatter(const std::string &pattern) : m_pattern(pattern) {
-        this->init(); // 初始化
+    std::string MmapFileLogAppender::AdviseToString(AdvisePolicy policy) {
+        return policy == ADVISE_WILLNEED ? "willneed" : (policy == ADVISE_NORMAL ? "normal" : "sequential");
     }
 
-    // 将日志输出对象格式化
-    auto LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::Level level,
-                              std::shared_ptr<LogEvent> event) -> std::string {
-        std::ostringstream str_stream;
-        for (auto &item : m_items) {
-            item->format(str_stream, logger, level, event);
+    //=============== ShmLogAppender =================
+    ShmLogAppender::ShmLogAppender(const std::string &name, size_t size)
+        : m_name(name), m_size(size), m_ring(ShmLogRing::Create(name, size)) {}
+
+    void ShmLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level,
+                             std::shared_ptr<LogEvent> event) {
+        if (level < m_level || !m_ring) {
+            return;
+        }
+        std::shared_ptr<LogFormatter> formatter;
+        {
+            MutexType::Lock lock(m_mutex);
+            formatter = m_formatter;
         }
-        return str_stream.str();
+        std::string &buf = GetFormatBuffer();
+        formatter->format(buf, logger, level, event);
+        m_ring->write(buf.data(), buf.size());
     }
 
-    void LogFormatter::init() {
-        std::vector<std::tuple<std::string, std::string, int>> vec;
-        std::string nstr;
-        for (size_t i = 0; i < m_pattern.size(); ++i) {
-            if (m_pattern[i] != '%') {
-                nstr.append(1, m_pattern[i]);
-                continue;
-            }
+    uint64_t ShmLogAppender::getDropped() const {
+        return m_ring ? m_ring->getDropped() : 0;
+    }
 
-            if ((i + 1) < m_pattern.size()) {
-                if (m_pattern[i + 1] == '%') {
-                    nstr.append(1, '%');
-                    continue;
-                }
-            }
+    std::string ShmLogAppender::toYamlString() {
+        MutexType::Lock lock(m_mutex);
+        YAML::Node node;
+        node["type"] = "ShmLogAppender";
+        node["file"] = m_name;
+        node["shm_size"] = m_ring ? m_ring->getCapacity() : m_size;
+        if (m_level != LogLevel::UNKNOWN) {
+            node["level"] = LogLevel::toString(m_level);
+        }
+        if (m_formatter && m_hasFormatter) {
+            node["formatter"] = m_formatter->getPattern();
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
 
-            size_t n = i + 1;
-            int fmt_status = 0;
-            size_t fmt_begin = 0;
+    //=============== LogRing =================
+    static lsh::ConfigVar<uint32_t>::ptr g_log_ring_capacity =
+        lsh::Config::Creat("log.ring.capacity", (uint32_t)1024, "log ring slots per thread");
+    static lsh::ConfigVar<uint32_t>::ptr g_log_ring_flush_interval =
+        lsh::Config::Creat("log.ring.flush_interval", (uint32_t)100, "log collector idle wait ms");
 
-            std::string str;
-            std::string fmt;
-            while (n < m_pattern.size()) {
-                if (!fmt_status && (!isalpha(m_pattern[n]) && m_pattern[n] != '{' && m_pattern[n] != '}')) {
-                    str = m_pattern.substr(i + 1, n - i - 1);
-                    break;
-                }
-                if (fmt_status == 0) {
-                    if (m_pattern[n] == '{') {
-                        str = m_pattern.substr(i + 1, n - i - 1);
-                        // std::cout << "*" << str << std::endl;
-                        fmt_status = 1; // 解析格式
-                        fmt_begin = n;
-                        ++n;
-                        continue;
-                    }
-                } else if (fmt_status == 1) {
-                    if (m_pattern[n] == '}') {
-                        fmt = m_pattern.substr(fmt_begin + 1, n - fmt_begin - 1);
-                        // std::cout << "#" << fmt << std::endl;
-                        fmt_status = 0;
-                        ++n;
-                        break;
-                    }
-                }
-                ++n;
-                if (n == m_pattern.size()) {
-                    if (str.empty()) {
-                        str = m_pattern.substr(i + 1);
-                    }
-                }
-            }
+    LogRing::LogRing(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) {
+            n <<= 1;
+        }
+        m_slots.resize(n);
+        for (auto &slot : m_slots) {
+            slot.event = std::make_shared<LogEvent>();
+        }
+    }
 
-            if (fmt_status == 0) {
-                if (!nstr.empty()) {
-                    vec.push_back(std::make_tuple(nstr, std::string(), 0));
-                    nstr.clear();
-                }
-                vec.push_back(std::make_tuple(str, fmt, 1));
-                i = n - 1;
-            } else if (fmt_status == 1) {
-                std::cout << "pattern parse error: " << m_pattern << " - " << m_pattern.substr(i) << std::endl;
-                m_error = true;
-                vec.push_back(std::make_tuple("<<pattern_error>>", fmt, 0));
+    bool LogRing::push(const std::shared_ptr<Logger> &logger, LogLevel::Level level, const LogEvent &event) {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_cached_tail >= m_slots.size()) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head - m_cached_tail >= m_slots.size()) {
+                return false;
             }
         }
+        Slot &s = slot(head);
+        s.logger = logger;
+        s.level = level;
+        s.event->assign(event);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
 
-        if (!nstr.empty()) {
-            vec.push_back(std::make_tuple(nstr, "", 0));
+    void LogRing::pop() {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        Slot &s = slot(tail);
+        s.logger.reset();
+        // appender 保留了这个事件就换一个新的，不能让生产者覆盖它
+        if (s.event.use_count() != 1) {
+            s.event = std::make_shared<LogEvent>();
         }
-        static std::map<std::string, std::function<std::shared_ptr<FormatItem>(const std::string &str)>> s_format_items = {
-#define XX(str, C) \
-    {#str, [](const std::string &fmt) { return std::shared_ptr<FormatItem>(new C(fmt)); }}
-
-            XX(m, MessageFormatItem),    // m:消息
-            XX(p, LevelFormatItem),      // p:日志级别
-            XX(r, ElapseFormatItem),     // r:累计毫秒数
-            XX(c, LoggerNameFormatItem), // c:日志名称
-            XX(t, ThreadIdFormatItem),   // t:线程id
-            XX(n, NewLineFormatItem),    // n:换行
-            XX(d, DateTimeFormatItem),   // d:时间
-            XX(f, FileNameFormatItem),   // f:文件名
-            XX(l, LineFormatItem),       // l:行号
-            XX(T, TabFormatItem),        // T:Tab
-            XX(F, FiberIdFormatItem),    // F:协程id
-            XX(N, ThreadNameFormatItem), // N:线程名称
-#undef XX
+        m_tail.store(tail + 1, std::memory_order_release);
+    }
+
+    //=============== LogCollector =================
+    static thread_local bool t_is_collector = false;
+    static std::atomic<uint64_t> s_collector_id{0};
+
+    // 当前线程在各个 collector 上的队列，按 collector 的 id 区分（地址会被复用）。
+    // 线程退出时放掉引用，collector 取空后发现只剩自己持有就回收
+    struct LogRingHolder {
+        struct Entry {
+            uint64_t collector;
+            LogRing::ptr ring;
         };
+        std::vector<Entry> entries;
+        bool exited{false};
 
-        for (auto &i : vec) {
-            if (std::get<2>(i) == 0) {
-                m_items.push_back(std::shared_ptr<FormatItem>(new StringFormatItem(std::get<0>(i))));
-            } else {
-                auto it = s_format_items.find(std::get<0>(i));
-                if (it == s_format_items.end()) {
-                    m_items.push_back(std::shared_ptr<FormatItem>(new StringFormatItem("<<error_format %" + std::get<0>(i) + ">>")));
-                    m_error = true;
-                } else {
-                    m_items.push_back(it->second(std::get<1>(i)));
-                }
-            }
+        ~LogRingHolder() {
+            exited = true;
+            entries.clear();
         }
-    }
+    };
 
-    void MessageFormatItem::format(std::ostream &os, std::shared_ptr<Logger> logger,
-                                   LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        os << event->getContent();
-    }
+    static thread_local LogRingHolder t_ring_holder;
 
-    void ElapseFormatItem::format(std::ostream &os, std::shared_ptr<Logger> logger,
-                                  LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        os << event->getElapse();
+    LogCollector::LogCollector() : m_id(s_collector_id.fetch_add(1, std::memory_order_relaxed)) {
+        m_thread.reset(new Thread(std::bind(&LogCollector::run, this), "log_collector"));
     }
 
-    void ThreadIdFormatItem::format(std::ostream &os, std::shared_ptr<Logger> logger,
-                                    LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        os << event->getThreadId();
+    LogCollector::~LogCollector() {
+        stop();
     }
 
-    void ThreadNameFormatItem::format(std::ostream &os, std::shared_ptr<Logger> logger,
-                                      LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        os << event->getThreadName();
+    LogRing *LogCollector::getThreadRing() {
+        if (t_ring_holder.exited) {
+            return nullptr;
+        }
+        auto &entries = t_ring_holder.entries;
+        for (auto &entry : entries) {
+            if (entry.collector == m_id) {
+                return entry.ring.get();
+            }
+        }
+        // 已经销毁的 collector 的队列只剩这里持有，顺便丢掉
+        std::erase_if(entries, [](const LogRingHolder::Entry &entry) {
+            return entry.ring.use_count() == 1;
+        });
+        LogRing::ptr ring = std::make_shared<LogRing>(g_log_ring_capacity->getValue());
+        {
+            MutexType::Lock lock(m_mutex);
+            m_rings.push_back(ring);
+        }
+        entries.push_back({m_id, ring});
+        return ring.get();
     }
 
-    void FiberIdFormatItem::format(std::ostream &os, std::shared_ptr<Logger> logger,
-                                   LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        os << event->getFiberId();
+    size_t LogCollector::getRingCount() {
+        MutexType::Lock lock(m_mutex);
+        return m_rings.size();
     }
 
-    void DateTimeFormatItem::format(std::ostream &os, std::shared_ptr<Logger> logger,
-                                    LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        time_t timestamp = event->getTime();
-        struct tm localTime;
-        localtime_r(&timestamp, &localTime);
-
-        std::ostringstream oss;
-        char buffer[256];
-        size_t result = strftime(buffer, sizeof(buffer), m_format.c_str(), &localTime);
-        if (result == 0) {
-            // 处理格式化失败的情况
-            oss << "<<time_format_error>>";
-        } else {
-            oss << buffer;
+    void LogCollector::push(const std::shared_ptr<Logger> &logger, LogLevel::Level level, const LogEvent &event) {
+        // 后台线程自己（比如 appender 里）打的日志直接输出，否则可能等自己腾空间
+        if (t_is_collector) {
+            dispatchInline(logger, level, event);
+            return;
+        }
+        // 先登记再看 m_stopping：stop 之后的最后一次 flush 要等所有已登记的生产者离开
+        m_pushing.fetch_add(1);
+        if (m_stopping) {
+            m_pushing.fetch_sub(1);
+            dispatchInline(logger, level, event);
+            return;
+        }
+        LogRing *ring = getThreadRing();
+        if (!ring) {
+            // 线程正在退出，线程局部的队列表已经析构
+            m_pushing.fetch_sub(1);
+            dispatchInline(logger, level, event);
+            return;
         }
-        // oss << buffer;
-        os << oss.str();
+        bool woken = false;
+        while (!ring->push(logger, level, event)) {
+            if (m_stopping) {
+                // 后台线程在退出，不能指望它再腾出空间
+                m_pushing.fetch_sub(1);
+                dispatchInline(logger, level, event);
+                return;
+            }
+            // 队列满了：只叫醒后台线程一次，然后睡到它取完一轮再重试；
+            // 超时只是兜底，防止错过通知或 stop 时一直睡着
+            if (!woken) {
+                m_sleeping.store(true);
+                wakeup();
+                woken = true;
+            }
+            m_space_waiters.fetch_add(1);
+            m_space.waitFor(1);
+        }
+        m_pushing.fetch_sub(1);
+        wakeup();
     }
 
-    void LineFormatItem::format(std::ostream &os, std::shared_ptr<Logger> logger,
-                                LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        os << event->getLine();
+    void LogCollector::dispatchInline(const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                                      const LogEvent &event) {
+        std::shared_ptr<LogEvent> copy = std::make_shared<LogEvent>();
+        copy->assign(event);
+        logger->dispatch(level, copy);
     }
 
-    void FileNameFormatItem::format(std::ostream &os, std::shared_ptr<Logger> logger,
-                                    LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        os << event->getFile();
-    }
+    void LogCollector::flush() {
+        MutexType::Lock drain_lock(m_drain_mutex);
 
-    void LevelFormatItem::format(std::ostream &os, std::shared_ptr<Logger> logger,
-                                 LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        os << LogLevel::toString(level);
-    }
+        struct Cursor {
+            LogRing::ptr ring;
+            uint64_t end;
+        };
+        std::vector<Cursor> cursors;
+        {
+            MutexType::Lock lock(m_mutex);
+            for (auto &ring : m_rings) {
+                uint64_t end = ring->head();
+                if (end != ring->tail()) {
+                    cursors.push_back({ring, end});
+                }
+            }
+        }
 
-    void LoggerNameFormatItem::format(std::ostream &os, std::shared_ptr<Logger> logger,
-                                      LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        os << event->getLogger()->getName();
-    }
+        // 多路归并：每次取各队列队首中时间戳最小的一条
+        auto key = [](Cursor &c) {
+            const LogEvent::ptr &event = c.ring->slot(c.ring->tail()).event;
+            return event->getTime() * 1000000 + event->getMicroSecond();
+        };
+        while (!cursors.empty()) {
+            size_t min = 0;
+            uint64_t min_key = key(cursors[0]);
+            for (size_t i = 1; i < cursors.size(); ++i) {
+                uint64_t k = key(cursors[i]);
+                if (k < min_key) {
+                    min = i;
+                    min_key = k;
+                }
+            }
+            Cursor &c = cursors[min];
+            LogRing::Slot &slot = c.ring->slot(c.ring->tail());
+            slot.logger->dispatch(slot.level, slot.event);
+            c.ring->pop();
+            if (c.ring->tail() == c.end) {
+                cursors.erase(cursors.begin() + min);
+            }
+        }
 
-    void NewLineFormatItem::format(std::ostream &os, std::shared_ptr<Logger> logger,
-                                   LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        os << std::endl;
+        notifySpace();
+
+        // 线程已经退出（只剩这里持有）且已经取空的队列可以回收
+        MutexType::Lock lock(m_mutex);
+        std::erase_if(m_rings, [](const LogRing::ptr &ring) {
+            return ring.use_count() == 1 && ring->empty();
+        });
     }
 
-    void TabFormatItem::format(std::ostream &os, std::shared_ptr<Logger> logger,
-                               LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        os << '\t';
+    void LogCollector::run() {
+        t_is_collector = true;
+        while (true) {
+            flush();
+            if (m_stopping) {
+                // stop() 之后新的 push 不再进队列；等已经登记的生产者写完（或改为直接输出），
+                // 期间继续取，防止它们卡在满的队列上，最后再取一遍就结束
+                while (m_pushing.load() != 0) {
+                    flush();
+                    sched_yield();
+                }
+                flush();
+                break;
+            }
+            m_sleeping.store(true);
+            // 睡之前再看一眼，避免错过刚写入的日志；
+            // 生产者一侧没有加 fence，极端情况下漏掉的唤醒最多推迟一个 flush_interval
+            bool idle = true;
+            {
+                MutexType::Lock lock(m_mutex);
+                for (auto &ring : m_rings) {
+                    if (!ring->empty()) {
+                        idle = false;
+                        break;
+                    }
+                }
+            }
+            if (idle) {
+                m_notify.waitFor(g_log_ring_flush_interval->getValue());
+            }
+            m_sleeping.store(false);
+        }
     }
 
-    void StringFormatItem::format(std::ostream &os, std::shared_ptr<Logger> logger,
-                                  LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        os << m_string;
+    void LogCollector::stop() {
+        if (m_stopping.exchange(true)) {
+            return;
+        }
+        m_notify.notify();
+        m_thread->join();
     }
 
     FileLogAppender::FileLogAppender(const std::string &file_name) : m_file_name(file_name) {
         reopen();
     }
 
+    FileLogAppender::~FileLogAppender() {
+        if (m_async) {
+            // 析构时把缓冲区中剩余的日志全部写完
+            m_async->stop();
+        }
+    }
+
     void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level,
                               std::shared_ptr<LogEvent> event) {
-        if (m_file_stream) {
-            if (level >= m_level) {
+        if (level < m_level) {
+            return;
+        }
+        if (m_async) {
+            // 异步模式下这里只负责格式化，落盘交给后台线程，且不能持锁阻塞
+            std::string &buf = GetFormatBuffer();
+            {
                 MutexType::Lock lock(m_mutex);
-                m_file_stream << m_formatter->format(logger, level, event);
+                m_formatter->format(buf, logger, level, event);
             }
+            m_async->append(buf.data(), buf.size());
+            return;
+        }
+        if (m_file_stream) {
+            std::string &buf = GetFormatBuffer();
+            MutexType::Lock lock(m_mutex);
+            m_formatter->format(buf, logger, level, event);
+            m_file_stream.write(buf.data(), buf.size());
         }
     }
 
     auto FileLogAppender::reopen() -> bool {
+        if (m_async) {
+            m_async->reopen();
+            return true;
+        }
         MutexType::Lock lock(m_mutex);
         if (m_file_stream) {
             m_file_stream.close();
@@ -290,11 +1922,43 @@ namespace lsh {
         return m_file_stream.is_open();
     }
 
+    void FileLogAppender::setAsync(size_t buffer_size, size_t max_buffers,
+                                   AsyncLogWriter::OverflowPolicy policy, uint64_t flush_interval_ms) {
+        MutexType::Lock lock(m_mutex);
+        if (m_file_stream) {
+            m_file_stream.close();
+        }
+        m_async.reset(new AsyncLogWriter(m_file_name, buffer_size, max_buffers, policy, flush_interval_ms));
+    }
+
+    void FileLogAppender::setRotate(uint64_t max_size, uint64_t interval, uint32_t max_files) {
+        if (!m_async) {
+            setAsync(4 * 1024 * 1024, 16, AsyncLogWriter::BLOCK, 1000);
+        }
+        m_async->setRotate(max_size, interval, max_files);
+    }
+
     std::string FileLogAppender::toYamlString() {
         MutexType::Lock lock(m_mutex);
         YAML::Node node;
         node["type"] = "FileLogAppender";
         node["file"] = m_file_name;
+        if (m_async) {
+            node["async"] = true;
+            node["buffer_size"] = m_async->getBufferSize();
+            node["max_buffers"] = m_async->getMaxBuffers();
+            node["overflow"] = AsyncLogWriter::PolicyToString(m_async->getPolicy());
+            node["flush_interval"] = m_async->getFlushInterval();
+            if (m_async->getRotateSize()) {
+                node["rotate_size"] = m_async->getRotateSize();
+            }
+            if (m_async->getRotateInterval()) {
+                node["rotate_interval"] = m_async->getRotateInterval();
+            }
+            if (m_async->getMaxFiles()) {
+                node["max_files"] = m_async->getMaxFiles();
+            }
+        }
         if (m_level != LogLevel::UNKNOWN) {
             node["level"] = LogLevel::toString(m_level);
         }
@@ -324,8 +1988,10 @@ namespace lsh {
     void StdoutLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level,
                                 std::shared_ptr<LogEvent> event) {
         if (level >= m_level) {
+            std::string &buf = GetFormatBuffer();
             MutexType::Lock lock(m_mutex);
-            std::cout << m_formatter->format(logger, level, event);
+            m_formatter->format(buf, logger, level, event);
+            std::cout.write(buf.data(), buf.size());
         }
     }
 
@@ -334,15 +2000,33 @@ namespace lsh {
     }
 
     void Logger::log(LogLevel::Level level, std::shared_ptr<LogEvent> event) {
-        if (level >= m_level) {
-            MutexType::Lock lock(m_mutex);
-            if (!m_appenders.empty()) {
-                for (auto &appender : m_appenders) {
-                    appender->log(shared_from_this(), level, event);
-                }
-            } else if (m_root) {
-                m_root->log(level, event);
+        if (level >= FlightRecorder::GetLevel()) {
+            FlightRecorder::Record(level, event->getTime() * 1000000ull + event->getMicroSecond(),
+                                   event->getFile(), event->getLine(), event->getContentData(), event->getContentSize());
+        }
+        output(level, event);
+    }
+
+    void Logger::output(LogLevel::Level level, std::shared_ptr<LogEvent> event) {
+        if (level >= m_level || event->isForced()) {
+            if (m_ring) {
+                LogCollectorMgr::GetInstance()->push(shared_from_this(), level, *event);
+            } else {
+                dispatch(level, event);
+            }
+        }
+    }
+
+    void Logger::dispatch(LogLevel::Level level, const std::shared_ptr<LogEvent> &event) {
+        // 只读一次快照，appender 写 stdout/磁盘时不占用 logger 的锁
+        std::shared_ptr<const AppenderList> appenders = m_appenders.load(std::memory_order_acquire);
+        if (!appenders->empty()) {
+            std::shared_ptr<Logger> self = shared_from_this();
+            for (auto &appender : *appenders) {
+                appender->log(self, level, event);
             }
+        } else if (m_root && (level >= m_root->m_level || event->isForced())) {
+            m_root->dispatch(level, event);
         }
     }
 
@@ -358,17 +2042,32 @@ namespace lsh {
             MutexType::Lock lock(appender->m_mutex);
             appender->m_formatter = this->m_formatter;
         }
-        m_appenders.push_back(appender);
+        auto appenders = std::make_shared<AppenderList>(*m_appenders.load(std::memory_order_relaxed));
+        appenders->push_back(appender);
+        m_appenders.store(std::move(appenders), std::memory_order_release);
     }
 
     void Logger::deleteAppender(std::shared_ptr<LogAppender> appender) {
         MutexType::Lock lock(m_mutex);
-        std::erase(m_appenders, appender); // c++20
+        auto appenders = std::make_shared<AppenderList>(*m_appenders.load(std::memory_order_relaxed));
+        std::erase(*appenders, appender); // c++20
+        m_appenders.store(std::move(appenders), std::memory_order_release);
     }
 
     void Logger::clearAppenders() {
         MutexType::Lock lock(m_mutex);
-        m_appenders.clear();
+        m_appenders.store(std::make_shared<const AppenderList>(), std::memory_order_release);
+    }
+
+    void Logger::setAppenders(const AppenderList &appenders) {
+        MutexType::Lock lock(m_mutex);
+        for (auto &i : appenders) {
+            MutexType::Lock l(i->m_mutex);
+            if (!i->m_formatter) {
+                i->m_formatter = m_formatter;
+            }
+        }
+        m_appenders.store(std::make_shared<const AppenderList>(appenders), std::memory_order_release);
     }
 
     void Logger::setFormatter(std::shared_ptr<LogFormatter> val) {
@@ -376,7 +2075,7 @@ namespace lsh {
         m_formatter = val;
 
         // 如果 appender 继承 logger 的 formatter,需要改动 appender 的 formatter
-        for (auto &i : m_appenders) {
+        for (auto &i : *m_appenders.load(std::memory_order_relaxed)) {
             MutexType::Lock l(i->m_mutex);
             if (!i->m_hasFormatter) {
                 i->m_formatter = m_formatter;
@@ -393,15 +2092,25 @@ namespace lsh {
         this->setFormatter(new_val);
     }
 
+    void Logger::setBinary(bool v) {
+        m_binaryId = v ? BinLogMgr::GetInstance()->registerLogger(shared_from_this()) : -1;
+    }
+
     std::string Logger::toYamlString() {
         MutexType::Lock lock(m_mutex);
         YAML::Node node;
         node["name"] = m_name;
         node["level"] = LogLevel::toString(m_level);
+        if (isBinary()) {
+            node["binary"] = true;
+        }
+        if (m_ring) {
+            node["ring"] = true;
+        }
         if (m_formatter) {
             node["formatter"] = m_formatter->getPattern();
         }
-        for (auto &i : m_appenders) {
+        for (auto &i : *m_appenders.load(std::memory_order_relaxed)) {
             node["appender"].push_back(YAML::Load(i->toYamlString()));
         }
         std::stringstream ss;
@@ -433,13 +2142,34 @@ namespace lsh {
     // 跟配置模块结合起来
 
     struct LogAppenderDefine {
-        int type = 0; // 1 file 2 stdout
+        int type = 0; // 1 file 2 stdout 3 mmap file 4 shared memory
         LogLevel::Level level = LogLevel::UNKNOWN;
         std::string formatter;
         std::string file;
+        // 异步写入，仅对 FileLogAppender 有效
+        bool async = false;
+        uint64_t buffer_size = 4 * 1024 * 1024;
+        uint32_t max_buffers = 16;
+        int overflow = AsyncLogWriter::BLOCK;
+        uint64_t flush_interval = 1000;
+        // 文件滚动，设置任意一个都会切换为异步
+        uint64_t rotate_size = 0;     // 字节
+        uint64_t rotate_interval = 0; // 秒
+        uint32_t max_files = 0;       // 保留的历史文件个数，0 表示不清理
+        // MmapFileLogAppender
+        uint64_t segment_size = 16 * 1024 * 1024;
+        int msync = MmapFileLogAppender::SYNC_NONE;
+        int advise = MmapFileLogAppender::ADVISE_SEQUENTIAL;
+        // ShmLogAppender，file 为共享内存名（如 /lsh_server）
+        uint64_t shm_size = 8 * 1024 * 1024;
 
         bool operator==(const LogAppenderDefine &other) const {
-            return type == other.type && level == other.level && formatter == other.formatter && file == other.file;
+            return type == other.type && level == other.level && formatter == other.formatter && file == other.file &&
+                   async == other.async && buffer_size == other.buffer_size && max_buffers == other.max_buffers &&
+                   overflow == other.overflow && flush_interval == other.flush_interval &&
+                   rotate_size == other.rotate_size && rotate_interval == other.rotate_interval &&
+                   max_files == other.max_files && segment_size == other.segment_size &&
+                   msync == other.msync && advise == other.advise && shm_size == other.shm_size;
         }
     };
 
@@ -447,10 +2177,13 @@ namespace lsh {
         std::string name;
         LogLevel::Level level = LogLevel::UNKNOWN;
         std::string formatter;
+        bool binary = false; // LSH_LOG_FMT_* 走二进制路径
+        bool ring = false;   // 先进入线程的 LogRing，由 LogCollector 输出
         std::vector<LogAppenderDefine> appenders;
 
         bool operator==(const LogDefine &other) const {
-            return name == other.name && level == other.level && formatter == other.formatter && appenders == other.appenders;
+            return name == other.name && level == other.level && formatter == other.formatter &&
+                   binary == other.binary && ring == other.ring && appenders == other.appenders;
         }
 
         bool operator<(const LogDefine &other) const {
@@ -458,12 +2191,11 @@ namespace lsh {
         }
     };
 
-    // 对 LogDefine 进行偏特化，支持 string -> LogDefine
+    // 对 LogDefine 进行偏特化，直接从 YAML 节点解析（LoadFromYaml 走这里，不用再序列化成字符串）
     template <>
-    class LexicalCast<std::string, LogDefine> {
+    class NodeCast<LogDefine> {
     public:
-        LogDefine operator()(const std::string &str) {
-            YAML::Node node = YAML::Load(str);
+        LogDefine operator()(const YAML::Node &node) {
             LogDefine log;
             if (!node["name"].IsDefined()) {
                 std::cout << "log config ERROR: name is NULL" << std::endl;
@@ -474,6 +2206,12 @@ namespace lsh {
             if (node["formatter"].IsDefined()) {
                 log.formatter = node["formatter"].as<std::string>();
             }
+            if (node["binary"].IsDefined()) {
+                log.binary = node["binary"].as<bool>();
+            }
+            if (node["ring"].IsDefined()) {
+                log.ring = node["ring"].as<bool>();
+            }
             if (node["appender"].IsDefined()) {
                 for (const auto logappender : node["appender"]) {
                     LogAppenderDefine log_appender_define;
@@ -489,6 +2227,56 @@ namespace lsh {
                             continue;
                         }
                         log_appender_define.file = logappender["file"].as<std::string>();
+                        if (logappender["async"].IsDefined()) {
+                            log_appender_define.async = logappender["async"].as<bool>();
+                        }
+                        if (logappender["buffer_size"].IsDefined()) {
+                            log_appender_define.buffer_size = logappender["buffer_size"].as<uint64_t>();
+                        }
+                        if (logappender["max_buffers"].IsDefined()) {
+                            log_appender_define.max_buffers = logappender["max_buffers"].as<uint32_t>();
+                        }
+                        if (logappender["overflow"].IsDefined()) {
+                            log_appender_define.overflow = AsyncLogWriter::PolicyFromString(logappender["overflow"].as<std::string>());
+                        }
+                        if (logappender["flush_interval"].IsDefined()) {
+                            log_appender_define.flush_interval = logappender["flush_interval"].as<uint64_t>();
+                        }
+                        if (logappender["rotate_size"].IsDefined()) {
+                            log_appender_define.rotate_size = logappender["rotate_size"].as<uint64_t>();
+                        }
+                        if (logappender["rotate_interval"].IsDefined()) {
+                            log_appender_define.rotate_interval = logappender["rotate_interval"].as<uint64_t>();
+                        }
+                        if (logappender["max_files"].IsDefined()) {
+                            log_appender_define.max_files = logappender["max_files"].as<uint32_t>();
+                        }
+                    } else if (type == "MmapFileLogAppender") {
+                        log_appender_define.type = 3;
+                        if (!logappender["file"].IsDefined()) {
+                            std::cout << "log config ERROR: MmapFileLogAppender file is NULL" << std::endl;
+                            continue;
+                        }
+                        log_appender_define.file = logappender["file"].as<std::string>();
+                        if (logappender["segment_size"].IsDefined()) {
+                            log_appender_define.segment_size = logappender["segment_size"].as<uint64_t>();
+                        }
+                        if (logappender["msync"].IsDefined()) {
+                            log_appender_define.msync = MmapFileLogAppender::SyncFromString(logappender["msync"].as<std::string>());
+                        }
+                        if (logappender["advise"].IsDefined()) {
+                            log_appender_define.advise = MmapFileLogAppender::AdviseFromString(logappender["advise"].as<std::string>());
+                        }
+                    } else if (type == "ShmLogAppender") {
+                        log_appender_define.type = 4;
+                        if (!logappender["file"].IsDefined()) {
+                            std::cout << "log config ERROR: ShmLogAppender file is NULL" << std::endl;
+                            continue;
+                        }
+                        log_appender_define.file = logappender["file"].as<std::string>();
+                        if (logappender["shm_size"].IsDefined()) {
+                            log_appender_define.shm_size = logappender["shm_size"].as<uint64_t>();
+                        }
                     } else if (type == "StdoutLogAppender") {
                         log_appender_define.type = 2;
                     } else {
@@ -506,6 +2294,15 @@ namespace lsh {
         }
     };
 
+    // 对 LogDefine 进行偏特化，支持 string -> LogDefine
+    template <>
+    class LexicalCast<std::string, LogDefine> {
+    public:
+        LogDefine operator()(const std::string &str) {
+            return NodeCast<LogDefine>()(YAML::Load(str));
+        }
+    };
+
     // 对 LogDefine 进行偏特化，支持 LogDefine -> string
     template <>
     class LexicalCast<LogDefine, std::string> {
@@ -517,13 +2314,45 @@ namespace lsh {
             if (!v.formatter.empty()) {
                 node["formatter"] = v.formatter;
             }
+            if (v.binary) {
+                node["binary"] = true;
+            }
+            if (v.ring) {
+                node["ring"] = true;
+            }
             for (const auto &a : v.appenders) {
                 YAML::Node n;
                 if (a.type == 1) {
                     n["type"] = "FileLogAppender";
                     n["file"] = a.file;
+                    if (a.async || a.rotate_size || a.rotate_interval) {
+                        n["async"] = true;
+                        n["buffer_size"] = a.buffer_size;
+                        n["max_buffers"] = a.max_buffers;
+                        n["overflow"] = AsyncLogWriter::PolicyToString((AsyncLogWriter::OverflowPolicy)a.overflow);
+                        n["flush_interval"] = a.flush_interval;
+                    }
+                    if (a.rotate_size) {
+                        n["rotate_size"] = a.rotate_size;
+                    }
+                    if (a.rotate_interval) {
+                        n["rotate_interval"] = a.rotate_interval;
+                    }
+                    if (a.max_files) {
+                        n["max_files"] = a.max_files;
+                    }
                 } else if (a.type == 2) {
-                    n["type"] = "StdoutAppender";
+                    n["type"] = "StdoutLogAppender";
+                } else if (a.type == 3) {
+                    n["type"] = "MmapFileLogAppender";
+                    n["file"] = a.file;
+                    n["segment_size"] = a.segment_size;
+                    n["msync"] = MmapFileLogAppender::SyncToString((MmapFileLogAppender::SyncPolicy)a.msync);
+                    n["advise"] = MmapFileLogAppender::AdviseToString((MmapFileLogAppender::AdvisePolicy)a.advise);
+                } else if (a.type == 4) {
+                    n["type"] = "ShmLogAppender";
+                    n["file"] = a.file;
+                    n["shm_size"] = a.shm_size;
                 }
                 n["level"] = LogLevel::toString(a.level);
                 if (!a.formatter.empty()) {
@@ -557,36 +2386,50 @@ namespace lsh {
                 for (auto &i : new_value) {
                     // 仅按名字查找，因为重载了 operator<
                     auto it = old_value.find(i);
-                    std::shared_ptr<lsh::Logger> logger;
-                    if (it == old_value.end()) {
-                        // 新增 logger
-                        logger = LSH_LOG_NAME(i.name);
-                    } else {
-                        // 新的里边有，老的里边也有，需要判断是否变化
-                        if (!(i == *it)) {
-                            // 变化了，修改logger
-                            logger = LSH_LOG_NAME(i.name);
-                        }
+                    if (it != old_value.end() && i == *it) {
+                        // 新的里边有，老的里边也有，没有变化的 logger 不重建
+                        continue;
                     }
+                    // 新增或者变化了的 logger
+                    std::shared_ptr<lsh::Logger> logger = LSH_LOG_NAME(i.name);
                     logger->setLevel(i.level);
                     if (!i.formatter.empty()) {
                         logger->setFormatter(i.formatter);
                     }
-                    logger->clearAppenders();
+                    logger->setBinary(i.binary);
+                    logger->setRing(i.ring);
+                    // 先建好全部 appender 再一次性发布，重载期间写日志的线程不会看到半成品
+                    Logger::AppenderList appenders;
                     for (auto &a : i.appenders) {
                         std::shared_ptr<LogAppender> appender;
                         if (a.type == 1) {
-                            appender.reset(new FileLogAppender(a.file));
+                            std::shared_ptr<FileLogAppender> file_appender(new FileLogAppender(a.file));
+                            if (a.async || a.rotate_size || a.rotate_interval) {
+                                file_appender->setAsync(a.buffer_size, a.max_buffers,
+                                                        (AsyncLogWriter::OverflowPolicy)a.overflow,
+                                                        a.flush_interval);
+                            }
+                            if (a.rotate_size || a.rotate_interval) {
+                                file_appender->setRotate(a.rotate_size, a.rotate_interval, a.max_files);
+                            }
+                            appender = file_appender;
                         } else if (a.type == 2) {
                             appender.reset(new StdoutLogAppender);
+                        } else if (a.type == 3) {
+                            appender.reset(new MmapFileLogAppender(a.file, a.segment_size,
+                                                                   (MmapFileLogAppender::SyncPolicy)a.msync,
+                                                                   (MmapFileLogAppender::AdvisePolicy)a.advise));
+                        } else if (a.type == 4) {
+                            appender.reset(new ShmLogAppender(a.file, a.shm_size));
                         }
                         appender->setLevel(a.level);
                         // std::cout << a.formatter << std::endl;
                         if (!a.formatter.empty()) {
                             appender->setFormatter(std::make_shared<LogFormatter>(a.formatter));
                         }
-                        logger->addAppender(appender);
+                        appenders.push_back(appender);
                     }
+                    logger->setAppenders(appenders);
                 }
 
                 for (auto &i : old_value) {
@@ -596,6 +2439,8 @@ namespace lsh {
                         // 删除 Logger
                         auto logger = LSH_LOG_NAME(i.name);
                         logger->setLevel(static_cast<LogLevel::Level>(10000));
+                        logger->setBinary(false);
+                        logger->setRing(false);
                         logger->clearAppenders();
                     }
                 }
@@ -605,6 +2450,61 @@ namespace lsh {
 
     static LogIniter __log_init;
 
+    static lsh::ConfigVar<std::vector<std::string>>::ptr g_log_dynamic_debug =
+        lsh::Config::Creat("log.dynamic_debug", std::vector<std::string>(), "log call sites forced on/off, [+|-]file[:line]");
+
+    struct DynamicDebugIniter {
+        DynamicDebugIniter() {
+            g_log_dynamic_debug->addListener(0xD1D1, [](const std::vector<std::string> &, const std::vector<std::string> &new_value) {
+                LogCallSite::SetRules(new_value);
+            });
+        }
+    };
+
+    static DynamicDebugIniter __dynamic_debug_init;
+
+    static lsh::ConfigVar<std::string>::ptr g_log_flight_recorder_level =
+        lsh::Config::Creat("log.flight_recorder.level", LogLevel::toString((LogLevel::Level)FlightRecorder::DEFAULT_LEVEL),
+                           "lowest level kept in the per-thread crash flight recorder even when the logger filters it, OFF disables it");
+    static lsh::ConfigVar<uint32_t>::ptr g_log_flight_recorder_records =
+        lsh::Config::Creat("log.flight_recorder.records", (uint32_t)256, "flight recorder records kept per thread");
+    static lsh::ConfigVar<bool>::ptr g_log_flight_recorder_crash_handler =
+        lsh::Config::Creat("log.flight_recorder.crash_handler", true, "dump the flight recorder to stderr on SIGSEGV/SIGABRT/...");
+
+    struct FlightRecorderIniter {
+        FlightRecorderIniter() {
+            // 默认值不会触发监听器，先按默认配置生效一次
+            applyLevel(g_log_flight_recorder_level->getValue());
+            g_log_flight_recorder_level->addListener(0xF1F1, [](const std::string &, const std::string &new_value) {
+                applyLevel(new_value);
+            });
+            g_log_flight_recorder_records->addListener(0xF1F2, [](const uint32_t &, const uint32_t &new_value) {
+                FlightRecorder::SetCapacity(new_value);
+            });
+            g_log_flight_recorder_crash_handler->addListener(0xF1F3, [](const bool &, const bool &) {
+                updateCrashHandler();
+            });
+        }
+
+        static void applyLevel(const std::string &value) {
+            LogLevel::Level level = LogLevel::fromString(value);
+            FlightRecorder::SetLevel(level == LogLevel::UNKNOWN ? FlightRecorder::OFF : level);
+            updateCrashHandler();
+        }
+
+        // 记录仪第一次打开时安装崩溃处理函数（之后关掉记录仪也保留）；crash_handler 为 false 时卸载
+        static void updateCrashHandler() {
+            bool enabled = g_log_flight_recorder_crash_handler->getValue();
+            if (enabled && FlightRecorder::GetLevel() != FlightRecorder::OFF && !FlightRecorder::CrashHandlerInstalled()) {
+                FlightRecorder::InstallCrashHandler();
+            } else if (!enabled && FlightRecorder::CrashHandlerInstalled()) {
+                FlightRecorder::UninstallCrashHandler();
+            }
+        }
+    };
+
+    static FlightRecorderIniter __flight_recorder_init;
+
     std::string LoggerManager::toYamlString() {
         MutexType::Lock lock(m_mutex);
         YAML::Node node;
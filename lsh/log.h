@@ -1,9 +1,12 @@
 #ifndef __LSH_LOG_H__
 #define __LSH_LOG_H__
 
+#include "flight_recorder.h"
 #include "singleton.h"
 #include "thread.h"
 #include "util.h"
+#include <atomic>
+#include <cstdarg>
 #include <fstream>
 #include <iostream>
 #include <list>
@@ -11,46 +14,182 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
+/**
+ * @brief 编译期日志级别下限（LogLevel 的数值），低于它的 LSH_LOG_<LEVEL> 语句整条编译掉
+ *
+ * 由 CMake 选项 LSH_MIN_LOG_LEVEL 传入（DEBUG/INFO/WARN/ERROR/FATAL），默认全部保留。
+ * 被编译掉的语句不会生成任何代码，也不能再被动态调试打开。
+ */
+#ifndef LSH_MIN_LOG_LEVEL
+#define LSH_MIN_LOG_LEVEL 0
+#endif
+
+#define LSH_LOG_COMPILED(level) ((level) >= LSH_MIN_LOG_LEVEL)
+
+/**
+ * @brief 当前调用点的动态调试开关（见 LogCallSite）
+ *
+ * 每个调用点一个 constinit 的静态对象，第一次执行到时才登记到全局表里。
+ */
+#define LSH_LOG_SITE()                                                          \
+    ([]() -> lsh::LogCallSite & {                                               \
+        static constinit lsh::LogCallSite s_site(__FILE__, __LINE__);           \
+        return s_site; }())
+
 /**
  * @brief 使用流式方式将日志级别level的日志事件写入到logger
  *
  * 流式输入日志：使用 << 操作符简化日志记录。
  * 自动日志写入：通过 LogEventWrap 在析构时写入 logger,并调用 logger->log() 输出日志
+ * 快速路径：LogEvent::Acquire 复用当前线程缓存的 LogEvent，不再每条日志 make_shared，
+ *          线程 id、线程名称、协程 id 都从线程局部变量中读取
+ * 动态调试：调用点被 log.dynamic_debug 打开时无视 logger 的级别输出，被关闭时不输出
+ * 结构化字段：LSH_LOG_INFO(logger).kv("fd", fd).kv("op", "read") << "closed";（见 LogStream::kv）
+ * 展开后是一条完整的 if/else 语句，可以放在不带花括号的 if ... else 里。
  */
-#define LSH_LOG_LEVEL(logger, level)                                                              \
-    if (logger->getLevel() <= level)                                                              \
-    lsh::LogEventWrap(std::make_shared<lsh::LogEvent>(/*相对路径 lsh::getRelativePath(__FILE__)*/ \
-                                                      __FILE__, __LINE__, 0,                      \
-                                                      lsh::GetThreadId(),                         \
-                                                      lsh::GetFiberId(), time(0), logger, level,  \
-                                                      lsh::Thread::GetName()))                    \
-        .getSS()
-
-#define LSH_LOG_DEBUG(logger) LSH_LOG_LEVEL(logger, lsh::LogLevel::DEBUG)
-#define LSH_LOG_INFO(logger) LSH_LOG_LEVEL(logger, lsh::LogLevel::INFO)
-#define LSH_LOG_WARN(logger) LSH_LOG_LEVEL(logger, lsh::LogLevel::WARN)
-#define LSH_LOG_ERROR(logger) LSH_LOG_LEVEL(logger, lsh::LogLevel::ERROR)
-#define LSH_LOG_FATAL(logger) LSH_LOG_LEVEL(logger, lsh::LogLevel::FATAL)
+#define LSH_LOG_LEVEL(logger, level)                                                                          \
+    if (int lsh_site = LSH_LOG_SITE().state(); !lsh::LogCallSite::Pass(lsh_site, logger->getLevel(), level)) { \
+    } else                                                                                                     \
+        lsh::LogEventWrap(lsh::LogEvent::Acquire(/*相对路径 lsh::getRelativePath(__FILE__)*/                  \
+                                                 __FILE__, __LINE__, logger, level,                            \
+                                                 lsh_site == lsh::LogCallSite::FORCE_ON))                      \
+            .getSS()
+
+#define LSH_LOG_DEBUG(logger) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::DEBUG)) {} else LSH_LOG_LEVEL(logger, lsh::LogLevel::DEBUG)
+#define LSH_LOG_INFO(logger) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::INFO)) {} else LSH_LOG_LEVEL(logger, lsh::LogLevel::INFO)
+#define LSH_LOG_WARN(logger) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::WARN)) {} else LSH_LOG_LEVEL(logger, lsh::LogLevel::WARN)
+#define LSH_LOG_ERROR(logger) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::ERROR)) {} else LSH_LOG_LEVEL(logger, lsh::LogLevel::ERROR)
+#define LSH_LOG_FATAL(logger) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::FATAL)) {} else LSH_LOG_LEVEL(logger, lsh::LogLevel::FATAL)
 
 /**
  * @brief 使用格式化方式将日志级别level的日志事件写入到logger
+ *
+ * logger 打开 binary 时走二进制路径（见 binlog.h）：格式串在每个调用点只登记一次，
+ * 之后只拷贝参数的原始字节，所以同一个调用点的 fmt 应当是不变的（通常是字面量）。
+ * 被动态调试强制打开的调用点总是走文本路径，这样不受 logger 级别的过滤；
+ * 只因为飞行记录仪而生成的日志也走文本路径，不写入二进制日志。
+ * 走二进制路径的日志在调用线程上以格式串 id + 参数字节写入飞行记录仪，后台线程不再重复记录。
+ * C 字符串参数对应 %s 以外的转换（比如 %p）时，这个调用点也总是走文本路径。
+ * 展开后是一条完整的 if/else 语句，可以放在不带花括号的 if ... else 里。
+ */
+#define LSH_LOG_FMT_LEVEL(logger, level, fmt, ...)                                                               \
+    if (int lsh_site = LSH_LOG_SITE().state(); !lsh::LogCallSite::Pass(lsh_site, logger->getLevel(), level)) {   \
+    } else if (int32_t lsh_binary_id = logger->getBinaryId();                                                    \
+               lsh_binary_id >= 0 && lsh_site != lsh::LogCallSite::FORCE_ON && logger->getLevel() <= level &&   \
+               lsh::BinLog::Write(lsh_binary_id, level, [&]() {                                                  \
+                   static const uint32_t s_format_id = lsh::BinLog::RegisterFormat(                              \
+                       fmt, __FILE__, __LINE__, decltype(lsh::BinLog::ArgTypesOf(__VA_ARGS__)){});               \
+                   return s_format_id; }(), __VA_ARGS__)) {                                                      \
+    } else                                                                                                       \
+        lsh::LogEventWrap(lsh::LogEvent::Acquire(__FILE__, __LINE__, logger, level,                              \
+                                                 lsh_site == lsh::LogCallSite::FORCE_ON))                        \
+            .getEvent()->format(fmt, __VA_ARGS__)
+
+#define LSH_LOG_FMT_DEBUG(logger, fmt, ...) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::DEBUG)) {} else LSH_LOG_FMT_LEVEL(logger, lsh::LogLevel::DEBUG, fmt, __VA_ARGS__)
+#define LSH_LOG_FMT_INFO(logger, fmt, ...) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::INFO)) {} else LSH_LOG_FMT_LEVEL(logger, lsh::LogLevel::INFO, fmt, __VA_ARGS__)
+#define LSH_LOG_FMT_WARN(logger, fmt, ...) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::WARN)) {} else LSH_LOG_FMT_LEVEL(logger, lsh::LogLevel::WARN, fmt, __VA_ARGS__)
+#define LSH_LOG_FMT_ERROR(logger, fmt, ...) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::ERROR)) {} else LSH_LOG_FMT_LEVEL(logger, lsh::LogLevel::ERROR, fmt, __VA_ARGS__)
+#define LSH_LOG_FMT_FATAL(logger, fmt, ...) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::FATAL)) {} else LSH_LOG_FMT_LEVEL(logger, lsh::LogLevel::FATAL, fmt, __VA_ARGS__)
+
+/**
+ * @brief 使用 std::format 风格的 "{}" 格式串将日志写入到logger（见 log_format.h）
+ *
+ * 格式串和参数类型在编译期检查，参数直接格式化进事件的缓冲区，没有临时字符串。
+ * 总是走文本路径，logger 的 binary 模式对它不生效。展开后是日志流，可以继续 << 或 .kv()。
+ *  LSH_LOG_FMTX_INFO(logger, "accept fd={} addr={:>15}", fd, addr);
  */
-#define LSH_LOG_FMT_LEVEL(logger, level, fmt, ...)                                               \
-    if (logger->getLevel() <= level)                                                             \
-    lsh::LogEventWrap(std::make_shared<lsh::LogEvent>(__FILE__, __LINE__, 0,                     \
-                                                      lsh::GetThreadId(),                        \
-                                                      lsh::GetFiberId(), time(0), logger, level, \
-                                                      lsh::Thread::GetName()))                   \
-        .getEvent()                                                                              \
-        ->format(fmt, __VA_ARGS__)
-
-#define LSH_LOG_FMT_DEBUG(logger, fmt, ...) LSH_LOG_FMT_LEVEL(logger, lsh::LogLevel::DEBUG, fmt, __VA_ARGS__)
-#define LSH_LOG_FMT_INFO(logger, fmt, ...) LSH_LOG_FMT_LEVEL(logger, lsh::LogLevel::INFO, fmt, __VA_ARGS__)
-#define LSH_LOG_FMT_WARN(logger, fmt, ...) LSH_LOG_FMT_LEVEL(logger, lsh::LogLevel::WARN, fmt, __VA_ARGS__)
-#define LSH_LOG_FMT_ERROR(logger, fmt, ...) LSH_LOG_FMT_LEVEL(logger, lsh::LogLevel::ERROR, fmt, __VA_ARGS__)
-#define LSH_LOG_FMT_FATAL(logger, fmt, ...) LSH_LOG_FMT_LEVEL(logger, lsh::LogLevel::FATAL, fmt, __VA_ARGS__)
+#define LSH_LOG_FMTX(logger, level, fmt, ...)                                                                 \
+    if (int lsh_site = LSH_LOG_SITE().state(); !lsh::LogCallSite::Pass(lsh_site, logger->getLevel(), level)) { \
+    } else                                                                                                     \
+    lsh::LogFormatTo(lsh::LogEventWrap(lsh::LogEvent::Acquire(__FILE__, __LINE__, logger, level,             \
+                                                              lsh_site == lsh::LogCallSite::FORCE_ON))       \
+                         .getSS(),                                                                          \
+                     fmt __VA_OPT__(, ) __VA_ARGS__)
+
+#define LSH_LOG_FMTX_DEBUG(logger, fmt, ...) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::DEBUG)) {} else LSH_LOG_FMTX(logger, lsh::LogLevel::DEBUG, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LSH_LOG_FMTX_INFO(logger, fmt, ...) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::INFO)) {} else LSH_LOG_FMTX(logger, lsh::LogLevel::INFO, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LSH_LOG_FMTX_WARN(logger, fmt, ...) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::WARN)) {} else LSH_LOG_FMTX(logger, lsh::LogLevel::WARN, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LSH_LOG_FMTX_ERROR(logger, fmt, ...) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::ERROR)) {} else LSH_LOG_FMTX(logger, lsh::LogLevel::ERROR, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LSH_LOG_FMTX_FATAL(logger, fmt, ...) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::FATAL)) {} else LSH_LOG_FMTX(logger, lsh::LogLevel::FATAL, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+/**
+ * @brief 按调用点限流的流式日志
+ *
+ * 每个调用点有一个 constinit 的静态 LogRateLimiter（常量初始化，没有 guard 变量），
+ * 被限流时只多一次 relaxed 原子操作，不构造日志事件。
+ * 放行的那一条前面会带上 "[suppressed N messages] "，汇总这期间被丢掉的条数。
+ *
+ *  LSH_LOG_ERROR_EVERY_N(logger, 100)        每 100 条输出 1 条
+ *  LSH_LOG_ERROR_EVERY_MS(logger, 1000)      每秒最多输出 1 条
+ *  LSH_LOG_ERROR_RATE(logger, 10, 50)        令牌桶：平均每秒 10 条，允许 50 条突发
+ */
+#define LSH_LOG_LIMITED(logger, level, check)                                                                \
+    if (int lsh_site = LSH_LOG_SITE().state(); !lsh::LogCallSite::Pass(lsh_site, logger->getLevel(), level)) { \
+    } else if (uint64_t lsh_suppressed = 0; ![&]() {                                                           \
+                   static constinit lsh::LogRateLimiter s_limiter;                                             \
+                   return s_limiter.check; }()) {                                                              \
+    } else                                                                                                     \
+    lsh::LogSuppressed(lsh::LogEventWrap(lsh::LogEvent::Acquire(__FILE__, __LINE__, logger, level,          \
+                                                                lsh_site == lsh::LogCallSite::FORCE_ON))    \
+                           .getSS(),                                                                        \
+                       lsh_suppressed)
+
+#define LSH_LOG_LEVEL_EVERY_N(logger, level, n) LSH_LOG_LIMITED(logger, level, everyN(n, lsh_suppressed))
+#define LSH_LOG_LEVEL_EVERY_MS(logger, level, ms) LSH_LOG_LIMITED(logger, level, everyMS(ms, lsh_suppressed))
+#define LSH_LOG_LEVEL_RATE(logger, level, rate, burst) \
+    LSH_LOG_LIMITED(logger, level, tokenBucket(rate, burst, lsh_suppressed))
+
+#define LSH_LOG_DEBUG_EVERY_N(logger, n) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::DEBUG)) {} else LSH_LOG_LEVEL_EVERY_N(logger, lsh::LogLevel::DEBUG, n)
+#define LSH_LOG_INFO_EVERY_N(logger, n) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::INFO)) {} else LSH_LOG_LEVEL_EVERY_N(logger, lsh::LogLevel::INFO, n)
+#define LSH_LOG_WARN_EVERY_N(logger, n) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::WARN)) {} else LSH_LOG_LEVEL_EVERY_N(logger, lsh::LogLevel::WARN, n)
+#define LSH_LOG_ERROR_EVERY_N(logger, n) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::ERROR)) {} else LSH_LOG_LEVEL_EVERY_N(logger, lsh::LogLevel::ERROR, n)
+#define LSH_LOG_FATAL_EVERY_N(logger, n) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::FATAL)) {} else LSH_LOG_LEVEL_EVERY_N(logger, lsh::LogLevel::FATAL, n)
+
+#define LSH_LOG_DEBUG_EVERY_MS(logger, ms) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::DEBUG)) {} else LSH_LOG_LEVEL_EVERY_MS(logger, lsh::LogLevel::DEBUG, ms)
+#define LSH_LOG_INFO_EVERY_MS(logger, ms) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::INFO)) {} else LSH_LOG_LEVEL_EVERY_MS(logger, lsh::LogLevel::INFO, ms)
+#define LSH_LOG_WARN_EVERY_MS(logger, ms) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::WARN)) {} else LSH_LOG_LEVEL_EVERY_MS(logger, lsh::LogLevel::WARN, ms)
+#define LSH_LOG_ERROR_EVERY_MS(logger, ms) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::ERROR)) {} else LSH_LOG_LEVEL_EVERY_MS(logger, lsh::LogLevel::ERROR, ms)
+#define LSH_LOG_FATAL_EVERY_MS(logger, ms) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::FATAL)) {} else LSH_LOG_LEVEL_EVERY_MS(logger, lsh::LogLevel::FATAL, ms)
+
+#define LSH_LOG_DEBUG_RATE(logger, rate, burst) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::DEBUG)) {} else LSH_LOG_LEVEL_RATE(logger, lsh::LogLevel::DEBUG, rate, burst)
+#define LSH_LOG_INFO_RATE(logger, rate, burst) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::INFO)) {} else LSH_LOG_LEVEL_RATE(logger, lsh::LogLevel::INFO, rate, burst)
+#define LSH_LOG_WARN_RATE(logger, rate, burst) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::WARN)) {} else LSH_LOG_LEVEL_RATE(logger, lsh::LogLevel::WARN, rate, burst)
+#define LSH_LOG_ERROR_RATE(logger, rate, burst) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::ERROR)) {} else LSH_LOG_LEVEL_RATE(logger, lsh::LogLevel::ERROR, rate, burst)
+#define LSH_LOG_FATAL_RATE(logger, rate, burst) \
+    if constexpr (!LSH_LOG_COMPILED(lsh::LogLevel::FATAL)) {} else LSH_LOG_LEVEL_RATE(logger, lsh::LogLevel::FATAL, rate, burst)
 
 // 得到默认的 logger
 #define LSH_LOG_ROOT lsh::LoggerMgr::GetInstance()->getRoot()
@@ -81,15 +220,253 @@ namespace lsh {
         static LogLevel::Level fromString(const std::string &str);
     };
 
+    //=============== LogRateLimiter =================
+    /**
+     * @brief 单个调用点的限流状态，由 LSH_LOG_*_EVERY_N / _EVERY_MS / _RATE 使用
+     *
+     * 所有状态都是原子变量，构造函数是 constexpr，可以 constinit。
+     * suppressed 返回上次放行之后被丢掉的条数。
+     */
+    class LogRateLimiter {
+    public:
+        constexpr LogRateLimiter() = default;
+
+        // 第 1、n+1、2n+1... 次放行
+        bool everyN(uint64_t n, uint64_t &suppressed) {
+            uint64_t count = m_count.fetch_add(1, std::memory_order_relaxed);
+            if (n <= 1 || count % n == 0) {
+                suppressed = count ? (n > 1 ? n - 1 : 0) : 0;
+                return true;
+            }
+            return false;
+        }
+
+        // 距离上次放行超过 ms 毫秒才放行
+        bool everyMS(uint64_t ms, uint64_t &suppressed);
+
+        // 令牌桶（GCRA 实现，只用一个原子时间戳）：平均每秒 rate 条，最多 burst 条突发
+        bool tokenBucket(uint64_t rate, uint64_t burst, uint64_t &suppressed);
+
+    private:
+        // 放行：计算从上次放行到现在丢掉了多少条
+        uint64_t passed(uint64_t count) {
+            return count - m_passed.exchange(count + 1, std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> m_count{0};  // 调用次数
+        std::atomic<uint64_t> m_passed{0}; // 上次放行时的调用次数 + 1
+        std::atomic<uint64_t> m_time{0};   // everyMS: 上次放行的时间(ms)；tokenBucket: 理论到达时间(us)
+    };
+
+
+    //=============== LogCallSite =================
+    /**
+     * @brief 单个日志调用点的动态调试开关（类似内核的 dynamic debug）
+     *
+     * 配置项 log.dynamic_debug 是一组 "[+|-]file[:line]" 规则，按顺序匹配，后面的覆盖前面的：
+     *  "hook.cpp"          打开 hook.cpp 里的所有日志语句，无视 logger 的级别
+     *  "hook.cpp:120"      只打开 hook.cpp 第 120 行
+     *  "-IOManager.cpp"    关闭 IOManager.cpp 里的所有日志语句
+     *  "*"                 所有文件
+     * file 按路径后缀匹配（以 '/' 为边界）。
+     *
+     * 快速路径只有一次 relaxed 的单字节原子读；
+     * 调用点第一次执行时才登记到全局表里并按当前规则计算状态，之后规则变化时统一刷新。
+     */
+    class LogCallSite {
+    public:
+        enum State : uint8_t {
+            DEFAULT = 0,     // 由 logger 的级别决定
+            FORCE_ON = 1,    // 强制输出
+            FORCE_OFF = 2,   // 强制不输出
+            UNREGISTERED = 3 // 还没有登记
+        };
+
+        constexpr LogCallSite(const char *file, int32_t line) : m_file(file), m_line(line) {}
+
+        int state() {
+            uint8_t s = m_state.load(std::memory_order_relaxed);
+            if (__builtin_expect(s == UNREGISTERED, 0)) {
+                s = registerSite();
+            }
+            return s;
+        }
+
+        // 飞行记录仪打开时，低于 logger 级别的日志也要生成（只写入飞行记录仪）
+        static bool Pass(int state, int logger_level, int level) {
+            return state == FORCE_ON || (state == DEFAULT && (logger_level <= level || FlightRecorder::GetLevel() <= level));
+        }
+
+        const char *getFile() const { return m_file; }
+        int32_t getLine() const { return m_line; }
+
+        /**
+         * @brief 替换全部规则并刷新所有已登记的调用点（log.dynamic_debug 变化时调用）
+         */
+        static void SetRules(const std::vector<std::string> &rules);
+
+        // 已登记的调用点个数
+        static size_t GetSiteCount();
+
+    private:
+        uint8_t registerSite();
+
+    private:
+        const char *m_file;
+        int32_t m_line;
+        std::atomic<uint8_t> m_state{UNREGISTERED};
+    };
+
+    //=============== LogStream =================
+    /**
+     * @brief 日志内容的流缓冲区
+     *
+     * 先写入对象内部固定大小的 char 数组，写满后才转移到堆上继续增长，
+     * 一般长度的日志不会发生内存分配。reset() 之后回到内部数组，可以反复使用。
+     */
+    class LogStreamBuf : public std::streambuf {
+    public:
+        static const size_t INLINE_SIZE = 1024;
+
+        LogStreamBuf();
+
+        const char *data() const { return pbase(); }
+        size_t size() const { return pptr() - pbase(); }
+        void reset();
+
+        // printf 风格格式化，直接写入缓冲区
+        void appendf(const char *fmt, va_list al);
+
+    protected:
+        int_type overflow(int_type ch) override;
+        std::streamsize xsputn(const char *s, std::streamsize n) override;
+
+    private:
+        // 保证还能写入 n 个字节
+        void reserve(size_t n);
+
+    private:
+        char m_inline[INLINE_SIZE];
+        std::vector<char> m_heap;
+    };
+
+    /**
+     * @brief 日志内容流，对外仍是 std::ostream，原有的 << 写法不变
+     */
+    class LogStream : public std::ostream {
+    public:
+        // 结构化字段的类型
+        enum FieldType : uint8_t {
+            FIELD_INT = 1,
+            FIELD_UINT,
+            FIELD_DOUBLE,
+            FIELD_BOOL,
+            FIELD_STRING
+        };
+
+        // nextField 读出的一个字段，key 和 s 指向字段缓冲区，不拷贝
+        struct Field {
+            FieldType type;
+            std::string_view key;
+            union {
+                int64_t i;
+                uint64_t u;
+                double d;
+                bool b;
+            };
+            std::string_view s;
+        };
+
+        LogStream() : std::ostream(&m_buf) {}
+
+        const char *data() const { return m_buf.data(); }
+        size_t size() const { return m_buf.size(); }
+
+        // 清空内容、字段并恢复默认的格式状态（进制、精度等）
+        void reset();
+
+        // 拷贝另一个流的内容和字段，保留自己已分配的缓冲区
+        void assign(const LogStream &other);
+
+        void appendf(const char *fmt, va_list al) { m_buf.appendf(fmt, al); }
+
+        // 直接写入缓冲区，不经过 ostream 的 sentry
+        void append(const char *s, size_t n) { m_buf.sputn(s, n); }
+
+        /**
+         * @brief 附加一个带类型的键值字段：LSH_LOG_INFO(logger).kv("fd", fd) << "closed";
+         *
+         * 字段按类型编码追加到可复用的缓冲区（不生成中间字符串），由 formatter 渲染：
+         * json 格式输出为独立的键，文本格式以 " key=value" 追加在 %m 后面。
+         * 支持整数、枚举、浮点数、bool 和字符串；key 超过 255 字节会被截断。
+         */
+        template <class T>
+        LogStream &kv(std::string_view key, const T &value) {
+            if constexpr (std::is_same_v<T, bool>) {
+                addField(FIELD_BOOL, key, value ? 1 : 0);
+            } else if constexpr (std::is_enum_v<T> || (std::is_integral_v<T> && std::is_signed_v<T>)) {
+                addField(FIELD_INT, key, (uint64_t)(int64_t)value);
+            } else if constexpr (std::is_integral_v<T>) {
+                addField(FIELD_UINT, key, (uint64_t)value);
+            } else if constexpr (std::is_floating_point_v<T>) {
+                addDouble(key, value);
+            } else if constexpr (std::is_pointer_v<T>) {
+                addString(key, value ? std::string_view(value) : std::string_view("(null)"));
+            } else {
+                addString(key, std::string_view(value));
+            }
+            return *this;
+        }
+
+        bool hasFields() const { return !m_fields.empty(); }
+
+        /**
+         * @brief 从 pos 开始读取下一个字段，没有更多字段时返回 false
+         */
+        bool nextField(size_t &pos, Field &field) const;
+
+    private:
+        void addField(FieldType type, std::string_view key, uint64_t bits);
+        void addDouble(std::string_view key, double value);
+        void addString(std::string_view key, std::string_view value);
+
+    private:
+        LogStreamBuf m_buf;
+        // 编码后的字段：[类型 1B][key 长度 1B][key][值 8B | 长度 4B + 字符串]
+        std::string m_fields;
+    };
+
+    // 有被丢掉的日志时先写一段汇总
+    inline LogStream &LogSuppressed(LogStream &os, uint64_t suppressed) {
+        if (suppressed) {
+            os << "[suppressed " << suppressed << " messages] ";
+        }
+        return os;
+    }
+
     //=============== LogEvent =================
     /**
      * @brief 表示单个日志事件，存储日志的详细信息
      */
     class LogEvent {
     public:
+        typedef std::shared_ptr<LogEvent> ptr;
+
+        LogEvent() = default;
         LogEvent(const char *file, int32_t line, uint32_t elapse,
                  uint32_t threadId, uint32_t fiberId, uint64_t time,
-                 std::shared_ptr<Logger> logger, LogLevel::Level level, std::string threadName);
+                 std::shared_ptr<Logger> logger, LogLevel::Level level, const std::string &threadName);
+
+        /**
+         * @brief 获取当前线程可复用的 LogEvent 并填好基本信息（日志宏的快速路径）
+         *
+         * 线程局部缓存的 LogEvent 没有被其他人持有时直接复用，
+         * 否则（嵌套打日志、被 appender 保留）换一个新的。
+         */
+        static LogEvent::ptr Acquire(const char *file, int32_t line,
+                                     const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                                     bool forced = false);
 
         auto getFile() const -> const char * { return m_file; }
         auto getLine() const -> int32_t { return m_line; }
@@ -97,11 +474,19 @@ namespace lsh {
         auto getThreadId() const -> uint32_t { return m_threadId; }
         auto getFiberId() const -> uint32_t { return m_fiberId; }
         auto getTime() const -> uint64_t { return m_time; }
-        std::stringstream &getSS() { return m_stringStream; }
-        std::string getContent() const { return m_stringStream.str(); }
-        std::shared_ptr<Logger> getLogger() const { return m_logger; };
+        auto getMicroSecond() const -> uint32_t { return m_usec; }
+        void setMicroSecond(uint32_t usec) { m_usec = usec; }
+        LogStream &getSS() { return m_stream; }
+        const LogStream &getStream() const { return m_stream; }
+        std::string getContent() const { return std::string(m_stream.data(), m_stream.size()); }
+        const char *getContentData() const { return m_stream.data(); }
+        size_t getContentSize() const { return m_stream.size(); }
+        const std::shared_ptr<Logger> &getLogger() const { return m_logger; };
         LogLevel::Level getLevel() const { return m_level; }
         const std::string &getThreadName() const { return m_threadName; }
+        // 被动态调试强制打开的事件不受 logger 级别的过滤
+        bool isForced() const { return m_forced; }
+        void setForced(bool forced) { m_forced = forced; }
 
         /**
          * @brief 格式化写入日志内容
@@ -112,16 +497,21 @@ namespace lsh {
 
         void format(const char *fmt, va_list al);
 
+        // 拷贝另一个事件的全部字段和内容，保留自己已分配的缓冲区
+        void assign(const LogEvent &other);
+
     private:
-        const char *m_file;               // 文件名
-        int32_t m_line;                   // 行号
-        uint32_t m_elapse;                // 运行毫秒数
-        uint32_t m_threadId;              // 线程 ID
-        uint32_t m_fiberId;               // 协程 ID
-        uint64_t m_time;                  // 时间戳
-        std::stringstream m_stringStream; // 日志内容流
+        const char *m_file{nullptr}; // 文件名
+        int32_t m_line{0};           // 行号
+        uint32_t m_elapse{0};        // 运行毫秒数
+        uint32_t m_threadId{0};      // 线程 ID
+        uint32_t m_fiberId{0};       // 协程 ID
+        uint64_t m_time{0};          // 时间戳（秒）
+        uint32_t m_usec{0};          // 时间戳的微秒部分
+        LogStream m_stream;          // 日志内容流
         std::shared_ptr<Logger> m_logger;
-        LogLevel::Level m_level;
+        LogLevel::Level m_level{LogLevel::UNKNOWN};
+        bool m_forced{false};
         std::string m_threadName;
     };
 
@@ -130,7 +520,7 @@ namespace lsh {
         LogEventWrap(std::shared_ptr<LogEvent> event);
         ~LogEventWrap();
 
-        std::stringstream &getSS();
+        LogStream &getSS();
         std::shared_ptr<LogEvent> getEvent();
 
     private:
@@ -147,7 +537,8 @@ namespace lsh {
      *  %c 日志名称
      *  %t 线程id
      *  %n 换行
-     *  %d 时间
+     *  %d 时间，可以带 strftime 格式，如 %d{%H:%M:%S}
+     *     格式中额外支持 %3N（毫秒）和 %6N（微秒），如 %d{%H:%M:%S.%3N}
      *  %f 文件名
      *  %l 行号
      *  %T 制表符
@@ -155,143 +546,317 @@ namespace lsh {
      *  %N 线程名称
      *
      *  默认格式 "%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"
+     *
+     *  构造时把 pattern 编译成一段紧凑的操作码序列（字面量统一存放在 m_strings 中），
+     *  format 时按顺序 switch 执行，直接追加到调用者提供的缓冲区：
+     *  没有虚函数调用、没有 iostream、也没有每一项一个的 shared_ptr。
+     *
+     *  %d 的渲染按线程缓存：同一秒内只在第一次调用 localtime_r/strftime，
+     *  之后直接拷贝缓存的文本，毫秒/微秒部分用整数运算填进去。
      */
     class LogFormatter {
     public:
+        typedef std::shared_ptr<LogFormatter> ptr;
+
+        /**
+         * @brief pattern 为 "json" 或 "json{时间格式}" 时输出 JSON Lines：
+         *  {"time":"...","level":"INFO","logger":"root","thread_id":1,"thread_name":"main",
+         *   "fiber_id":0,"file":"...","line":10,"message":"...",<kv 字段>}
+         * 时间格式默认 %Y-%m-%dT%H:%M:%S.%6N%z，字符串按 JSON 规则转义，非 ASCII 字节原样输出。
+         */
         LogFormatter(const std::string &pattern);
+
+        /**
+         * @brief 把日志格式化后追加到 out 的末尾
+         *
+         * out 由调用者提供并复用（例如线程局部的 std::string），容量保留后不再分配内存
+         */
+        void format(std::string &out, const std::shared_ptr<Logger> &logger,
+                    LogLevel::Level level, const std::shared_ptr<LogEvent> &event);
+
         // 将日志输出对象格式化
         std::string format(std::shared_ptr<Logger> logger, LogLevel::Level level,
                            std::shared_ptr<LogEvent> event);
 
-    public:
-        class FormatItem {
-        public:
-            FormatItem(const std::string &format = "") {};
-
-            virtual ~FormatItem() {}
-
-            virtual void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                                LogLevel::Level level, std::shared_ptr<LogEvent> event) = 0;
-        };
-
         // 解析日志格式
         void init();
 
-        auto getFormatterSize() -> size_t { return m_items.size(); }
+        auto getFormatterSize() -> size_t { return m_ops.size(); }
 
         bool isError() const { return m_error; }
 
+        bool isJson() const { return m_json; }
+
         const std::string getPattern() const { return m_pattern; }
 
     private:
-        std::string m_pattern;                            // 日志格式化字符串
-        bool m_error{false};                              // 用于标记是否有解析错误
-        std::vector<std::shared_ptr<FormatItem>> m_items; // 格式化字符串解析后的解析器列表
-    };
+        enum OpCode : uint8_t {
+            OP_STRING,      // 字面量
+            OP_MESSAGE,     // %m
+            OP_LEVEL,       // %p
+            OP_ELAPSE,      // %r
+            OP_LOGGER_NAME, // %c
+            OP_THREAD_ID,   // %t
+            OP_NEWLINE,     // %n
+            OP_DATETIME,    // %d
+            OP_FILE,        // %f
+            OP_LINE,        // %l
+            OP_TAB,         // %T
+            OP_FIBER_ID,    // %F
+            OP_THREAD_NAME  // %N
+        };
 
-    class MessageFormatItem : public LogFormatter::FormatItem {
-    public:
-        MessageFormatItem(const std::string &str = "") {}
-        void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                    LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
-    };
+        struct Op {
+            OpCode code;
+            uint32_t offset{0}; // OP_STRING: 在 m_strings 中的位置；OP_DATETIME: 在 m_dates 中的下标
+            uint32_t length{0};
+        };
 
-    class ElapseFormatItem : public LogFormatter::FormatItem {
-    public:
-        ElapseFormatItem(const std::string &str = "") {}
-        void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                    LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
-    };
+        /**
+         * @brief 编译后的时间格式
+         *
+         * 格式串在 %3N/%6N 处切开：pieces[i] 交给 strftime，digits[i] 为其后紧跟的
+         * 亚秒位数（0 表示没有）。id 全局唯一，作为线程缓存的键，formatter 析构后也不会复用。
+         */
+        struct DateFormat {
+            uint64_t id;
+            std::vector<std::string> pieces;
+            std::vector<uint8_t> digits;
+        };
 
-    class ThreadIdFormatItem : public LogFormatter::FormatItem {
-    public:
-        ThreadIdFormatItem(const std::string &str = "") {}
-        void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                    LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
-    };
+        // 把字符串参数存入 m_strings（时间格式存入 m_dates），返回带位置信息的操作
+        Op makeOp(OpCode code, const std::string &arg = "");
 
-    class ThreadNameFormatItem : public LogFormatter::FormatItem {
-    public:
-        ThreadNameFormatItem(const std::string &str = "") {}
-        void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                    LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
-    };
+        void appendDateTime(std::string &out, const Op &op, time_t time, uint32_t usec);
 
-    class FiberIdFormatItem : public LogFormatter::FormatItem {
-    public:
-        FiberIdFormatItem(const std::string &str = "") {}
-        void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                    LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
+        // json 模式：m_ops 里只有一个 OP_DATETIME
+        void formatJson(std::string &out, LogLevel::Level level, const std::shared_ptr<LogEvent> &event);
+
+    private:
+        std::string m_pattern;  // 日志格式化字符串
+        bool m_error{false};    // 用于标记是否有解析错误
+        bool m_json{false};     // 输出 JSON Lines
+        std::vector<Op> m_ops;  // 编译后的操作码序列
+        std::string m_strings;  // 所有操作的字符串参数，每段以 '\0' 结尾
+        std::vector<DateFormat> m_dates; // %d 编译后的时间格式
     };
 
-    class DateTimeFormatItem : public LogFormatter::FormatItem {
+    //=============== AsyncLogWriter =================
+    /**
+     * @brief 双缓冲的异步文件写入器
+     *
+     * 调用者只把格式化好的字节追加到前台缓冲区（一次 memcpy），
+     * 后台的 lsh::Thread 负责交换缓冲区，并把攒下来的整块数据顺序写入文件。
+     * 这样磁盘再慢也只会拖住后台线程，不会阻塞打日志的协程所在的 IOManager 线程。
+     *
+     * - 缓冲区个数有上限 max_buffers，内存占用有界
+     * - 所有缓冲区都写满时，按 OverflowPolicy 丢弃新日志或阻塞调用者
+     * - 后台线程每隔 flush_interval 毫秒把未写满的前台缓冲区也刷出去
+     * - stop()/析构时把剩余数据全部写完再退出
+     * - 文件打不开时（路径不存在、没有权限）限频打印错误，丢弃这一批日志并计入 getDropped()，
+     *   下一次刷盘时重新尝试打开
+     * - 可按大小和/或整点时间间隔滚动文件，rename/open/清理旧文件都在后台线程中完成
+     */
+    class AsyncLogWriter : Noncopyable {
     public:
-        DateTimeFormatItem(const std::string &format = "") {
-            if (format.empty()) {
-                m_format = "%Y-%m-%d %H:%M:%S";
-            } else {
-                m_format = format;
-            }
-        }
-        void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                    LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
+        typedef std::shared_ptr<AsyncLogWriter> ptr;
+        typedef Mutex MutexType;
+
+        enum OverflowPolicy {
+            DROP = 0, // 缓冲区满时丢弃新日志
+            BLOCK = 1 // 缓冲区满时阻塞调用者，直到后台线程腾出空间
+        };
+
+        AsyncLogWriter(const std::string &file_name, size_t buffer_size = 4 * 1024 * 1024,
+                       size_t max_buffers = 16, OverflowPolicy policy = BLOCK,
+                       uint64_t flush_interval_ms = 1000);
+        ~AsyncLogWriter();
+
+        /**
+         * @brief 追加一条已格式化的日志
+         * @return 写入缓冲区返回 true，被丢弃（或已经 stop）返回 false
+         */
+        bool append(const char *data, size_t len);
+
+        // 通知后台线程重新打开文件，真正的 close/open 在后台线程中完成
+        void reopen();
+
+        // 写完剩余数据并等待后台线程退出，可重复调用
+        void stop();
+
+        /**
+         * @brief 设置文件滚动策略，0 表示不启用对应的条件
+         * @param[in] max_size 文件超过该字节数时滚动
+         * @param[in] interval 按本地时间对齐的间隔（秒）滚动，如 3600 为每个整点
+         * @param[in] max_files 最多保留的历史文件个数，多余的从旧到新删除
+         *
+         * 当前文件被重命名为 file_name.YYYYmmdd-HHMMSS（打开该文件的时间），再打开新的 file_name
+         */
+        void setRotate(uint64_t max_size, uint64_t interval, uint32_t max_files);
+
+        // 被丢弃的日志条数：DROP 策略下缓冲区满，或文件打不开
+        uint64_t getDropped() const { return m_dropped; }
+        size_t getBufferSize() const { return m_buffer_size; }
+        size_t getMaxBuffers() const { return m_max_buffers; }
+        OverflowPolicy getPolicy() const { return m_policy; }
+        uint64_t getFlushInterval() const { return m_flush_interval; }
+        uint64_t getRotateSize() const { return m_rotate_size; }
+        uint64_t getRotateInterval() const { return m_rotate_interval; }
+        uint32_t getMaxFiles() const { return m_max_files; }
+
+        static OverflowPolicy PolicyFromString(const std::string &str);
+        static std::string PolicyToString(OverflowPolicy policy);
 
     private:
-        std::string m_format;
-    };
+        // 后台线程的主循环
+        void run();
+        // 以下只在后台线程中调用
+        // 打开失败时报告错误并返回 false
+        bool openFile();
+        void updateNextRotate();
+        // 写入文件，按策略在行边界处滚动
+        void write(const char *data, size_t len);
+        void rotate();
+        // 删除超过 max_files 的历史文件
+        void prune();
+        void reportError(const char *what, int err);
 
-    class LineFormatItem : public LogFormatter::FormatItem {
-    public:
-        LineFormatItem(const std::string &str = "") {}
-        void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                    LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
-    };
+    private:
+        std::string m_file_name;
+        std::ofstream m_file_stream; // 只在后台线程中访问
+        size_t m_buffer_size;
+        size_t m_max_buffers;
+        OverflowPolicy m_policy;
+        uint64_t m_flush_interval;
 
-    class FileNameFormatItem : public LogFormatter::FormatItem {
-    public:
-        FileNameFormatItem(const std::string &str = "") {}
-        void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                    LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
+        MutexType m_mutex;
+        std::string m_current;            // 前台缓冲区
+        std::vector<std::string> m_full;  // 已写满、等待落盘的缓冲区
+        std::vector<std::string> m_spare; // 落盘后回收的空缓冲区
+        size_t m_queued{0};               // 等待落盘（含正在写）的缓冲区个数
+        size_t m_waiters{0};              // BLOCK 策略下正在等待空间的调用者个数
+        bool m_reopen{false};
+        bool m_stopping{false};
+        std::atomic<uint64_t> m_dropped{0};
+
+        std::atomic<uint64_t> m_rotate_size{0};
+        std::atomic<uint64_t> m_rotate_interval{0};
+        std::atomic<uint32_t> m_max_files{0};
+        uint64_t m_file_size{0};    // 当前文件大小，只在后台线程中访问
+        time_t m_file_time{0};      // 当前文件打开的时间
+        time_t m_next_rotate{0};    // 下一次按时间滚动的时刻，0 表示不按时间滚动
+        LogRateLimiter m_error_limiter; // 出错信息每秒最多打印一次
+
+        Semaphore m_notify; // 唤醒后台线程
+        Semaphore m_space;  // 唤醒等待空间的调用者
+        Thread::ptr m_thread;
     };
 
-    class LevelFormatItem : public LogFormatter::FormatItem {
+    //=============== LogRing =================
+    /**
+     * @brief 单个线程的日志环形队列（单生产者单消费者）
+     *
+     * 槽位预先分配好 LogEvent，写入时把事件拷贝进槽位（内容走 LogStream 的内部数组，
+     * 一般不分配内存），生产者之间互不竞争。消费者只有 LogCollector 的后台线程。
+     */
+    class LogRing : Noncopyable {
     public:
-        LevelFormatItem(const std::string &str = "") {}
-        void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                    LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
-    };
+        typedef std::shared_ptr<LogRing> ptr;
 
-    class LoggerNameFormatItem : public LogFormatter::FormatItem {
-    public:
-        LoggerNameFormatItem(const std::string &str = "") {}
-        void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                    LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
-    };
+        struct Slot {
+            std::shared_ptr<Logger> logger;
+            LogLevel::Level level;
+            std::shared_ptr<LogEvent> event;
+        };
 
-    class NewLineFormatItem : public LogFormatter::FormatItem {
-    public:
-        NewLineFormatItem(const std::string &str = "") {}
-        void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                    LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
-    };
+        // capacity 会向上取整到 2 的幂
+        LogRing(size_t capacity);
 
-    class TabFormatItem : public LogFormatter::FormatItem {
-    public:
-        TabFormatItem(const std::string &str = "") {}
-        void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                    LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
+        // 生产者：拷贝一条日志进队列，满了返回 false
+        bool push(const std::shared_ptr<Logger> &logger, LogLevel::Level level, const LogEvent &event);
+
+        // 消费者：当前已发布的位置
+        uint64_t head() const { return m_head.load(std::memory_order_acquire); }
+        uint64_t tail() const { return m_tail.load(std::memory_order_relaxed); }
+        bool empty() const { return head() == tail(); }
+        Slot &slot(uint64_t pos) { return m_slots[pos & (m_slots.size() - 1)]; }
+        // 消费者：处理完 tail() 处的一条，把槽位还给生产者
+        void pop();
+
+    private:
+        std::vector<Slot> m_slots;
+        alignas(64) std::atomic<uint64_t> m_head{0}; // 生产者发布的位置
+        uint64_t m_cached_tail{0};                   // 生产者缓存的 m_tail
+        alignas(64) std::atomic<uint64_t> m_tail{0}; // 消费者释放的位置
     };
 
-    class StringFormatItem : public LogFormatter::FormatItem {
+    //=============== LogCollector =================
+    /**
+     * @brief 收集各线程 LogRing 的后台线程
+     *
+     * 打开 ring 的 logger，Logger::log 只把事件拷进当前线程的 LogRing 就返回，
+     * 不再在 Logger::m_mutex 和各 appender 的锁上互相自旋；
+     * 真正调用 appender 的只有 "log_collector" 一个线程。
+     *
+     * 每一轮先记下所有队列已发布的位置，再按时间戳做多路归并：
+     * 同一线程内保持写入顺序，不同线程之间按时间戳先后输出。
+     * 后台线程空闲时睡在信号量上，生产者只在它睡着时才 notify 一次。
+     * 队列满时生产者睡在另一个信号量上，后台线程每取完一轮叫醒它们。
+     * 每个线程在每个 collector 上各有一个队列；线程退出后，它的队列取空就回收。
+     */
+    class LogCollector : Noncopyable {
     public:
-        StringFormatItem(const std::string &str) : m_string(str) {}
-        void format(std::ostream &os, std::shared_ptr<Logger> logger,
-                    LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
+        typedef Mutex MutexType;
+
+        LogCollector();
+        ~LogCollector();
+
+        // 把一条日志交给当前线程的队列，队列满时等后台线程腾出空间
+        void push(const std::shared_ptr<Logger> &logger, LogLevel::Level level, const LogEvent &event);
+
+        // 在调用线程中立即处理掉所有已发布的日志
+        void flush();
+        // 处理完剩余日志并停止后台线程，可重复调用
+        void stop();
+        // 登记着的队列个数（每个往这个 collector 写过、还没回收的线程一个）
+        size_t getRingCount();
+
+    private:
+        void run();
+        void wakeup() {
+            if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false)) {
+                m_notify.notify();
+            }
+        }
+        // 叫醒在满队列上等待的生产者
+        void notifySpace() {
+            for (int n = m_space_waiters.exchange(0); n > 0; --n) {
+                m_space.notify();
+            }
+        }
+        LogRing *getThreadRing();
+        // 不经过队列，在调用线程里直接输出
+        void dispatchInline(const std::shared_ptr<Logger> &logger, LogLevel::Level level, const LogEvent &event);
 
     private:
-        std::string m_string;
+        const uint64_t m_id; // 线程局部的队列表按它区分不同的 collector
+        MutexType m_mutex;   // 保护 m_rings
+        std::vector<LogRing::ptr> m_rings;
+        MutexType m_drain_mutex; // 同一时刻只有一个线程在归并
+
+        std::atomic<bool> m_sleeping{false};
+        std::atomic<bool> m_stopping{false};
+        // 正在 push 的生产者个数，stop 的最后一次 flush 要等它归零
+        std::atomic<int> m_pushing{0};
+        Semaphore m_notify;
+        // 队列满时等后台线程腾出空间的生产者个数，以及它们等待的信号量
+        std::atomic<int> m_space_waiters{0};
+        Semaphore m_space;
+        Thread::ptr m_thread;
     };
 
+    typedef Singleton<LogCollector> LogCollectorMgr;
+
     //=============== LogAppender =================
     /**
      * @brief 日志输出地（Appender），可以是控制台或文件
@@ -300,7 +865,7 @@ namespace lsh {
         friend class Logger;
 
     public:
-        typedef Spinlock MutexType;
+        typedef AdaptiveLock MutexType;
         LogAppender(LogLevel::Level level = LogLevel::DEBUG) : m_level(level) {}
         virtual ~LogAppender() {}
         virtual void log(std::shared_ptr<class Logger> logger, LogLevel::Level level,
@@ -347,14 +912,145 @@ namespace lsh {
     class FileLogAppender : public LogAppender {
     public:
         FileLogAppender(const std::string &filename);
+        ~FileLogAppender();
         void log(std::shared_ptr<class Logger> logger, LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
         bool reopen();
 
+        /**
+         * @brief 切换为异步写入，需在加入 logger 之前调用
+         */
+        void setAsync(size_t buffer_size, size_t max_buffers,
+                      AsyncLogWriter::OverflowPolicy policy, uint64_t flush_interval_ms);
+        bool isAsync() const { return m_async != nullptr; }
+
+        /**
+         * @brief 设置文件滚动策略（见 AsyncLogWriter::setRotate）
+         *
+         * 滚动要在后台线程中 rename/open，未开启异步时先按默认参数切换为异步
+         */
+        void setRotate(uint64_t max_size, uint64_t interval, uint32_t max_files);
+
         std::string toYamlString() override;
 
     private:
         std::string m_file_name;
         std::ofstream m_file_stream;
+        AsyncLogWriter::ptr m_async; // 非空时表示异步模式，m_file_stream 不再使用
+    };
+
+    /**
+     * @brief 基于 mmap 的文件日志输出
+     *
+     * 文件按 segment_size 预先扩展并映射，写日志时用原子的 fetch_add 预留位置后直接 memcpy，
+     * 没有每行一次的 write() 系统调用，也不加锁。写进 MAP_SHARED 映射的数据已经在页缓存里，
+     * 进程崩溃也不会丢（机器掉电除外，需要配合 msync）。
+     *
+     * 写者把要写的段登记到本线程的 hazard 槽里（只写自己的缓存行），确认它仍是当前段后才写入；
+     * 段写满时换下一段：摘下旧段，等所有 hazard 槽都离开它再 msync/munmap，
+     * 有效数据截止在第一个写失败的位置，从该位置所在的页开始映射新的一段。
+     * 映射失败（比如磁盘满）时退化为 pwrite 追加，之后每秒重试一次映射；出错信息每秒最多输出一条。
+     * 打开文件时会去掉上次崩溃留下的末尾 '\0' 填充。
+     */
+    class MmapFileLogAppender : public LogAppender {
+    public:
+        typedef Mutex SwitchMutexType;
+
+        enum SyncPolicy {
+            SYNC_NONE = 0,  // 交给内核回写
+            SYNC_ASYNC = 1, // 换段/关闭时 msync(MS_ASYNC)
+            SYNC_SYNC = 2   // 换段/关闭时 msync(MS_SYNC)，等数据落盘
+        };
+
+        enum AdvisePolicy {
+            ADVISE_NORMAL = 0,
+            ADVISE_SEQUENTIAL = 1, // MADV_SEQUENTIAL
+            ADVISE_WILLNEED = 2    // MADV_WILLNEED，映射时预读整段
+        };
+
+        static constexpr size_t MIN_SEGMENT_SIZE = 1024 * 1024;
+        // 映射失败后重试的间隔，也是出错信息的最小间隔
+        static constexpr uint64_t RETRY_INTERVAL_MS = 1000;
+
+        MmapFileLogAppender(const std::string &file_name, size_t segment_size = 16 * 1024 * 1024,
+                            SyncPolicy sync = SYNC_NONE, AdvisePolicy advise = ADVISE_SEQUENTIAL);
+        ~MmapFileLogAppender();
+
+        void log(std::shared_ptr<class Logger> logger, LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
+        // 关闭并重新打开文件（配合外部的 logrotate）
+        bool reopen();
+        std::string toYamlString() override;
+
+        static SyncPolicy SyncFromString(const std::string &str);
+        static std::string SyncToString(SyncPolicy policy);
+        static AdvisePolicy AdviseFromString(const std::string &str);
+        static std::string AdviseToString(AdvisePolicy policy);
+
+    private:
+        // 一个映射段：写者在 hazard 槽的保护下访问，摘下后等没有写者引用才释放
+        struct Segment {
+            char *data{nullptr};
+            uint64_t base{0};                       // 在文件中的偏移（页对齐）
+            uint64_t generation{0};                 // 第几个段，防止同一段被重复换
+            std::atomic<uint64_t> tail{0};          // 下一次写入的位置，可能超过段大小
+            std::atomic<uint64_t> fail{UINT64_MAX}; // 第一次写失败的位置（预留的最小失败偏移）
+        };
+
+        // 以下调用者持有 m_switch_mutex
+        bool openFile();
+        void closeFile();
+        // 从文件偏移 end（有效数据的末尾）所在的页开始映射新的一段，文件扩展到段尾，并发布为当前段
+        bool mapSegment(uint64_t end);
+        // 摘下当前段，等写者离开后 msync/munmap，返回有效数据在文件中的末尾
+        uint64_t retireSegment();
+        // generation 对应的段仍是当前段时换下一段
+        void switchSegment(uint64_t generation);
+        // 没有映射段时到期重试映射，仍然没有就用 pwrite 追加；重新映射成功时返回 false，由调用者重写
+        bool writeFallback(const char *data, size_t len);
+        void reportError(const char *what, int err);
+
+        // 在 seg 里预留位置并写入，段满时记下失败位置并返回 false
+        bool writeSegment(Segment *seg, const char *data, size_t len, bool newline);
+        // 追加一条格式化好的日志，段满时换段
+        void append(const char *data, size_t len);
+
+    private:
+        std::string m_file_name;
+        size_t m_segment_size;
+        SyncPolicy m_sync;
+        AdvisePolicy m_advise;
+
+        SwitchMutexType m_switch_mutex;       // 换段、打开/关闭、退化写入
+        int m_fd{-1};
+        std::atomic<Segment *> m_segment{nullptr}; // 当前段，没有映射时为空
+        uint64_t m_generation{0};             // 已经映射过的段数
+        uint64_t m_end{0};                    // 没有映射段时有效数据在文件中的末尾（pwrite 的位置）
+        uint64_t m_retry_ms{0};               // 上次尝试映射的时间
+        LogRateLimiter m_error_limiter;
+    };
+
+    //=============== ShmLogAppender =================
+    class ShmLogRing;
+
+    /**
+     * @brief 把格式化好的日志写进 POSIX 共享内存环（见 shm_log.h），由另一个进程落盘
+     *
+     * 写日志只有格式化、一次 CAS 和 memcpy，没有任何系统调用；读者进程
+     * （tools/shm_log_reader）挂掉或跟不上时日志被丢弃并计数，不会拖慢服务线程。
+     */
+    class ShmLogAppender : public LogAppender {
+    public:
+        ShmLogAppender(const std::string &name, size_t size = 8 * 1024 * 1024);
+
+        void log(std::shared_ptr<class Logger> logger, LogLevel::Level level, std::shared_ptr<LogEvent> event) override;
+        std::string toYamlString() override;
+
+        // 因为环满被丢弃的条数（所有写进这个环的进程合计）
+        uint64_t getDropped() const;
+
+    private:
+        std::string m_name;
+        size_t m_size;
+        std::shared_ptr<ShmLogRing> m_ring;
     };
 
     //=============== Logger =================
@@ -366,10 +1062,16 @@ namespace lsh {
         // friend class LogAppender;
 
     public:
-        typedef Spinlock MutexType;
+        typedef AdaptiveLock MutexType;
+        // appender 列表的不可变快照：修改时复制一份再整体发布，写日志时无锁遍历
+        typedef std::vector<std::shared_ptr<LogAppender>> AppenderList;
         Logger(const std::string &name = "root");
 
         void log(LogLevel::Level level, std::shared_ptr<LogEvent> event);
+        // 和 log 一样交给 appender 或 LogRing，但不写飞行记录仪（二进制日志在调用线程上已经记录过）
+        void output(LogLevel::Level level, std::shared_ptr<LogEvent> event);
+        // 直接调用 appender（没有 appender 时交给 root），不经过 LogRing
+        void dispatch(LogLevel::Level level, const std::shared_ptr<LogEvent> &event);
         void debug(std::shared_ptr<LogEvent> event);
         void info(std::shared_ptr<LogEvent> event);
         void warn(std::shared_ptr<LogEvent> event);
@@ -379,10 +1081,15 @@ namespace lsh {
         void addAppender(std::shared_ptr<LogAppender> appender);
         void deleteAppender(std::shared_ptr<LogAppender> appender);
         void clearAppenders();
+        // 一次性替换全部 appender，中间不会出现空列表（配置重载用）
+        void setAppenders(const AppenderList &appenders);
+        std::shared_ptr<const AppenderList> getAppenders() const {
+            return m_appenders.load(std::memory_order_acquire);
+        }
 
         auto getLevel() const -> LogLevel::Level { return m_level; }
         void setLevel(LogLevel::Level level) { m_level = level; }
-        auto getName() -> std::string { return m_name; }
+        auto getName() const -> const std::string & { return m_name; }
         void setFormatter(std::shared_ptr<LogFormatter> val);
         void setFormatter(const std::string &val);
 
@@ -391,15 +1098,32 @@ namespace lsh {
             return m_formatter;
         }
 
+        /**
+         * @brief 打开/关闭二进制模式，只影响 LSH_LOG_FMT_*（见 binlog.h）
+         */
+        void setBinary(bool v);
+        bool isBinary() const { return m_binaryId >= 0; }
+        // 二进制模式下在 binlog 中的 id，未打开时为 -1
+        int32_t getBinaryId() const { return m_binaryId; }
+
+        /**
+         * @brief 打开后日志先进入当前线程的 LogRing，由 LogCollector 统一调用 appender
+         */
+        void setRing(bool v) { m_ring = v; }
+        bool isRing() const { return m_ring; }
+
         std::string toYamlString();
 
     private:
         std::string m_name; // 日志器名称
         LogLevel::Level m_level{LogLevel::DEBUG};
-        std::list<std::shared_ptr<LogAppender>> m_appenders;
+        int32_t m_binaryId{-1};
+        bool m_ring{false};
+        // 只在持有 m_mutex 时发布新快照；读者 acquire 读取后不加锁
+        std::atomic<std::shared_ptr<const AppenderList>> m_appenders{std::make_shared<const AppenderList>()};
         std::shared_ptr<LogFormatter> m_formatter;
         std::shared_ptr<Logger> m_root;
-        MutexType m_mutex;
+        MutexType m_mutex; // 保护 m_formatter，串行化对 m_appenders 的修改
     };
 
     // 这样使用 logger
@@ -408,7 +1132,7 @@ namespace lsh {
 
     class LoggerManager {
     public:
-        typedef Spinlock MutexType;
+        typedef AdaptiveLock MutexType;
         LoggerManager();
         std::shared_ptr<Logger> getLogger(const std::string &name);
 
@@ -428,4 +1152,9 @@ namespace lsh {
     typedef Singleton<LoggerManager> LoggerMgr;
 }
 
+// LSH_LOG_FMT_* 需要 BinLog，放在 Logger 定义之后
+#include "binlog.h"
+// LSH_LOG_FMTX_* 的 "{}" 格式化
+#include "log_format.h"
+
 #endif
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "log_format.h"
+#include "log.h"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+
+namespace lsh {
+    namespace log_format {
+        void format_string_error(const char *msg) {
+            // 只会在编译期被"调用"（让编译失败），运行时走不到这里
+            std::cerr << "log format string error: " << msg << std::endl;
+            abort();
+        }
+
+        static void WriteFill(LogStream &os, char fill, size_t n) {
+            char buf[64];
+            memset(buf, fill, std::min(n, sizeof(buf)));
+            while (n) {
+                size_t len = std::min(n, sizeof(buf));
+                os.append(buf, len);
+                n -= len;
+            }
+        }
+
+        // 按宽度和对齐方式补齐，align 为 0 时使用 def_align
+        static void WritePadded(LogStream &os, const FormatSpec &spec, const char *s, size_t n, char def_align) {
+            size_t width = spec.width;
+            if (width <= n) {
+                os.append(s, n);
+                return;
+            }
+            size_t pad = width - n;
+            char align = spec.align ? spec.align : def_align;
+            size_t left = align == '>' ? pad : (align == '^' ? pad / 2 : 0);
+            WriteFill(os, spec.fill, left);
+            os.append(s, n);
+            WriteFill(os, spec.fill, pad - left);
+        }
+
+        // 数字：前缀（符号、0x）和数字分开，'0' 标志时在两者之间补 0
+        static void WriteNumber(LogStream &os, const FormatSpec &spec, const char *prefix, size_t prefix_len,
+                                const char *digits, size_t digits_len) {
+            if (spec.zero && !spec.align && (size_t)spec.width > prefix_len + digits_len) {
+                os.append(prefix, prefix_len);
+                WriteFill(os, '0', spec.width - prefix_len - digits_len);
+                os.append(digits, digits_len);
+                return;
+            }
+            char buf[128];
+            memcpy(buf, prefix, prefix_len);
+            memcpy(buf + prefix_len, digits, digits_len);
+            WritePadded(os, spec, buf, prefix_len + digits_len, '>');
+        }
+
+        static size_t SignPrefix(char *prefix, const FormatSpec &spec, bool negative) {
+            if (negative) {
+                prefix[0] = '-';
+                return 1;
+            }
+            if (spec.sign == '+' || spec.sign == ' ') {
+                prefix[0] = spec.sign;
+                return 1;
+            }
+            return 0;
+        }
+
+        void WriteInt(LogStream &os, const FormatSpec &spec, uint64_t abs, bool negative) {
+            if (spec.type == 'c') {
+                WriteChar(os, spec, (char)abs);
+                return;
+            }
+            int base = 10;
+            const char *alt = "";
+            switch (spec.type) {
+            case 'x':
+                base = 16;
+                alt = "0x";
+                break;
+            case 'X':
+                base = 16;
+                alt = "0X";
+                break;
+            case 'o':
+                base = 8;
+                alt = abs ? "0" : "";
+                break;
+            case 'b':
+                base = 2;
+                alt = "0b";
+                break;
+            case 'B':
+                base = 2;
+                alt = "0B";
+                break;
+            }
+            char digits[64];
+            auto res = std::to_chars(digits, digits + sizeof(digits), abs, base);
+            size_t len = res.ptr - digits;
+            if (spec.type == 'X') {
+                for (size_t i = 0; i < len; ++i) {
+                    digits[i] = toupper(digits[i]);
+                }
+            }
+            char prefix[4];
+            size_t prefix_len = SignPrefix(prefix, spec, negative);
+            if (spec.alt) {
+                for (const char *p = alt; *p; ++p) {
+                    prefix[prefix_len++] = *p;
+                }
+            }
+            WriteNumber(os, spec, prefix, prefix_len, digits, len);
+        }
+
+        void WriteChar(LogStream &os, const FormatSpec &spec, char c) {
+            WritePadded(os, spec, &c, 1, '<');
+        }
+
+        void WriteDouble(LogStream &os, const FormatSpec &spec, double v) {
+            char buf[512];
+            std::to_chars_result res;
+            char type = spec.type;
+            int precision = spec.precision >= 0 ? spec.precision : 6;
+            switch (type) {
+            case 'f':
+            case 'F':
+                res = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::fixed, precision);
+                break;
+            case 'e':
+            case 'E':
+                res = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::scientific, precision);
+                break;
+            case 'g':
+            case 'G':
+                res = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::general, precision);
+                break;
+            default:
+                // 没有 type：最短表示，给了精度时按 general
+                res = spec.precision >= 0
+                          ? std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::general, spec.precision)
+                          : std::to_chars(buf, buf + sizeof(buf), v);
+                break;
+            }
+            if (res.ec != std::errc()) {
+                WriteLiteral(os, "<double>", 8);
+                return;
+            }
+            size_t len = res.ptr - buf;
+            if (type == 'F' || type == 'E' || type == 'G') {
+                for (size_t i = 0; i < len; ++i) {
+                    buf[i] = toupper(buf[i]);
+                }
+            }
+            // to_chars 已经写了负号，这里把它挪到前缀里，补 0 时才能放在符号后面
+            bool negative = buf[0] == '-';
+            char prefix[2];
+            size_t prefix_len = SignPrefix(prefix, spec, negative);
+            const char *digits = negative ? buf + 1 : buf;
+            size_t digits_len = negative ? len - 1 : len;
+            if (!std::isfinite(v)) {
+                FormatSpec no_zero = spec;
+                no_zero.zero = false;
+                WriteNumber(os, no_zero, prefix, prefix_len, digits, digits_len);
+                return;
+            }
+            if (prefix_len + digits_len > 128) {
+                os.append(prefix, prefix_len);
+                os.append(digits, digits_len);
+                return;
+            }
+            WriteNumber(os, spec, prefix, prefix_len, digits, digits_len);
+        }
+
+        void WriteString(LogStream &os, const FormatSpec &spec, std::string_view s) {
+            if (spec.precision >= 0 && (size_t)spec.precision < s.size()) {
+                s = s.substr(0, spec.precision);
+            }
+            WritePadded(os, spec, s.data(), s.size(), '<');
+        }
+
+        void WritePointer(LogStream &os, const FormatSpec &spec, const void *p) {
+            char digits[32];
+            auto res = std::to_chars(digits, digits + sizeof(digits), (uintptr_t)p, 16);
+            WriteNumber(os, spec, "0x", 2, digits, res.ptr - digits);
+        }
+
+        void WriteLiteral(LogStream &os, const char *s, size_t n) {
+            if (n) {
+                os.append(s, n);
+            }
+        }
+
+        void WriteOther(LogStream &os, const void *arg, void (*write)(LogStream &, const void *)) {
+            write(os, arg);
+        }
+    }
+}
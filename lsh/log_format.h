@@ -0,0 +1,323 @@
+#ifndef __LSH_LOG_FORMAT_H__
+#define __LSH_LOG_FORMAT_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief std::format 风格的 "{}" 格式化，直接写入 LogStream 的缓冲区
+ *
+ * GCC 12 的 libstdc++ 还没有 <format>，这里实现了日志需要的子集：
+ *  {} {:spec}，spec = [[fill]align][sign][#][0][width][.precision][type]
+ *  align: < > ^    sign: + - 空格    type: d x X o b c（整数）f F e E g G（浮点）s（字符串/bool）p（指针）
+ *  {{ 和 }} 输出花括号；不支持 {0} 这种按位置引用
+ * 格式串在编译期检查：占位符个数必须等于参数个数，type 必须和参数类型匹配，出错时编译失败。
+ * 其它类型使用 operator<<，只能写 {}。width 按字节计算。
+ */
+namespace lsh {
+    class LogStream;
+
+    namespace log_format {
+        // 参数的类别，决定可以使用哪些 type
+        enum ArgKind : uint8_t {
+            KIND_INT,
+            KIND_UINT,
+            KIND_CHAR,
+            KIND_BOOL,
+            KIND_FLOAT,
+            KIND_STRING,
+            KIND_POINTER,
+            KIND_OTHER // 使用 operator<<
+        };
+
+        template <class T>
+        constexpr ArgKind KindOf() {
+            using U = std::decay_t<T>;
+            if constexpr (std::is_same_v<U, bool>) {
+                return KIND_BOOL;
+            } else if constexpr (std::is_same_v<U, char>) {
+                return KIND_CHAR;
+            } else if constexpr (std::is_enum_v<U>) {
+                return std::is_signed_v<std::underlying_type_t<U>> ? KIND_INT : KIND_UINT;
+            } else if constexpr (std::is_integral_v<U>) {
+                return std::is_signed_v<U> ? KIND_INT : KIND_UINT;
+            } else if constexpr (std::is_floating_point_v<U>) {
+                return KIND_FLOAT;
+            } else if constexpr (std::is_null_pointer_v<U>) {
+                // nullptr_t 也能转换成 string_view，要先判断
+                return KIND_POINTER;
+            } else if constexpr (std::is_same_v<U, const char *> || std::is_same_v<U, char *> ||
+                                 std::is_convertible_v<const U &, std::string_view>) {
+                return KIND_STRING;
+            } else if constexpr (std::is_pointer_v<U>) {
+                return KIND_POINTER;
+            } else {
+                return KIND_OTHER;
+            }
+        }
+
+        struct FormatSpec {
+            char fill = ' ';
+            char align = 0; // '<' '>' '^'，0 表示按类型默认
+            char sign = 0;  // '+' '-' ' '
+            bool alt = false;
+            bool zero = false;
+            int width = 0;
+            int precision = -1;
+            char type = 0;
+        };
+
+        // 不是 constexpr 函数：在常量求值中被调用就会让编译失败，错误信息里带着函数名
+        void format_string_error(const char *msg);
+
+        /**
+         * @brief 解析 ':' 之后到 '}' 为止的格式说明，返回 '}' 之后的位置，格式错误返回 nullptr
+         */
+        constexpr const char *ParseSpec(const char *p, const char *end, FormatSpec &spec) {
+            auto is_align = [](char c) { return c == '<' || c == '>' || c == '^'; };
+            if (p == end) {
+                return nullptr;
+            }
+            if (p + 1 < end && is_align(p[1]) && *p != '{' && *p != '}') {
+                spec.fill = p[0];
+                spec.align = p[1];
+                p += 2;
+            } else if (is_align(*p)) {
+                spec.align = *p++;
+            }
+            if (p < end && (*p == '+' || *p == '-' || *p == ' ')) {
+                spec.sign = *p++;
+            }
+            if (p < end && *p == '#') {
+                spec.alt = true;
+                ++p;
+            }
+            if (p < end && *p == '0') {
+                spec.zero = true;
+                ++p;
+            }
+            while (p < end && *p >= '0' && *p <= '9') {
+                spec.width = spec.width * 10 + (*p++ - '0');
+                if (spec.width > 4096) {
+                    return nullptr;
+                }
+            }
+            if (p < end && *p == '.') {
+                ++p;
+                if (p == end || *p < '0' || *p > '9') {
+                    return nullptr;
+                }
+                spec.precision = 0;
+                while (p < end && *p >= '0' && *p <= '9') {
+                    spec.precision = spec.precision * 10 + (*p++ - '0');
+                    if (spec.precision > 100) {
+                        return nullptr;
+                    }
+                }
+            }
+            if (p < end && *p != '}') {
+                spec.type = *p++;
+            }
+            if (p == end || *p != '}') {
+                return nullptr;
+            }
+            return p + 1;
+        }
+
+        // 编译期检查一个占位符的说明是否适用于这种参数
+        constexpr bool SpecMatches(const FormatSpec &spec, ArgKind kind) {
+            auto is_int_type = [](char t) {
+                return t == 0 || t == 'd' || t == 'x' || t == 'X' || t == 'o' || t == 'b' || t == 'B' || t == 'c';
+            };
+            auto is_float_type = [](char t) {
+                return t == 0 || t == 'f' || t == 'F' || t == 'e' || t == 'E' || t == 'g' || t == 'G';
+            };
+            switch (kind) {
+            case KIND_INT:
+            case KIND_UINT:
+                return is_int_type(spec.type) && spec.precision < 0;
+            case KIND_CHAR:
+                return (is_int_type(spec.type) || spec.type == 's') && spec.precision < 0;
+            case KIND_BOOL:
+                return (is_int_type(spec.type) || spec.type == 's') && spec.type != 'c' && spec.precision < 0;
+            case KIND_FLOAT:
+                return is_float_type(spec.type) && !spec.alt;
+            case KIND_STRING:
+                return (spec.type == 0 || spec.type == 's') && !spec.sign && !spec.alt && !spec.zero;
+            case KIND_POINTER:
+                return (spec.type == 0 || spec.type == 'p') && !spec.sign && !spec.alt && spec.precision < 0;
+            case KIND_OTHER:
+                return spec.type == 0 && !spec.sign && !spec.alt && !spec.zero && spec.precision < 0 &&
+                       spec.width == 0 && spec.align == 0;
+            }
+            return false;
+        }
+
+        /**
+         * @brief 编译期检查格式串
+         */
+        constexpr void CheckFormat(std::string_view str, const ArgKind *kinds, size_t count) {
+            const char *p = str.data();
+            const char *end = p + str.size();
+            size_t index = 0;
+            while (p < end) {
+                char c = *p++;
+                if (c == '}') {
+                    if (p == end || *p != '}') {
+                        format_string_error("unmatched '}' in format string");
+                    }
+                    ++p;
+                    continue;
+                }
+                if (c != '{') {
+                    continue;
+                }
+                if (p < end && *p == '{') {
+                    ++p;
+                    continue;
+                }
+                FormatSpec spec;
+                if (p < end && *p == ':') {
+                    p = ParseSpec(p + 1, end, spec);
+                } else if (p < end && *p == '}') {
+                    ++p;
+                } else {
+                    // {0}、{name} 或者缺少 '}'
+                    p = nullptr;
+                }
+                if (!p) {
+                    format_string_error("invalid replacement field in format string");
+                    return;
+                }
+                if (index >= count) {
+                    format_string_error("more replacement fields than arguments");
+                    return;
+                }
+                if (!SpecMatches(spec, kinds[index])) {
+                    format_string_error("format spec does not match the argument type");
+                }
+                ++index;
+            }
+            if (index != count) {
+                format_string_error("more arguments than replacement fields");
+            }
+        }
+
+        /**
+         * @brief 在编译期检查过的格式串，只能由常量表达式构造
+         */
+        template <class... Args>
+        class FormatString {
+        public:
+            template <class S>
+                requires std::is_convertible_v<const S &, std::string_view>
+            consteval FormatString(const S &s) : m_str(s) {
+                constexpr ArgKind kinds[sizeof...(Args) + 1] = {KindOf<Args>()..., KIND_OTHER};
+                CheckFormat(m_str, kinds, sizeof...(Args));
+            }
+
+            std::string_view get() const { return m_str; }
+
+        private:
+            std::string_view m_str;
+        };
+
+        // 运行时各类参数的输出，直接写入 LogStream 的缓冲区
+        void WriteInt(LogStream &os, const FormatSpec &spec, uint64_t abs, bool negative);
+        void WriteChar(LogStream &os, const FormatSpec &spec, char c);
+        void WriteDouble(LogStream &os, const FormatSpec &spec, double v);
+        void WriteString(LogStream &os, const FormatSpec &spec, std::string_view s);
+        void WritePointer(LogStream &os, const FormatSpec &spec, const void *p);
+        void WriteLiteral(LogStream &os, const char *s, size_t n);
+        void WriteOther(LogStream &os, const void *arg, void (*write)(LogStream &, const void *));
+
+        template <class T>
+        void WriteArg(LogStream &os, const FormatSpec &spec, const T &arg) {
+            constexpr ArgKind kind = KindOf<T>();
+            if constexpr (kind == KIND_BOOL) {
+                if (spec.type == 0 || spec.type == 's') {
+                    WriteString(os, spec, arg ? "true" : "false");
+                } else {
+                    WriteInt(os, spec, arg ? 1 : 0, false);
+                }
+            } else if constexpr (kind == KIND_CHAR) {
+                if (spec.type == 0 || spec.type == 'c' || spec.type == 's') {
+                    WriteChar(os, spec, arg);
+                } else {
+                    WriteInt(os, spec, (unsigned char)arg, false);
+                }
+            } else if constexpr (kind == KIND_INT) {
+                int64_t v = (int64_t)arg;
+                WriteInt(os, spec, v < 0 ? 0 - (uint64_t)v : (uint64_t)v, v < 0);
+            } else if constexpr (kind == KIND_UINT) {
+                WriteInt(os, spec, (uint64_t)arg, false);
+            } else if constexpr (kind == KIND_FLOAT) {
+                WriteDouble(os, spec, (double)arg);
+            } else if constexpr (kind == KIND_STRING) {
+                // 只有真正的指针才可能为空，字符数组直接转成 string_view
+                if constexpr (std::is_pointer_v<T>) {
+                    WriteString(os, spec, arg ? std::string_view(arg) : std::string_view("(null)"));
+                } else {
+                    WriteString(os, spec, std::string_view(arg));
+                }
+            } else if constexpr (kind == KIND_POINTER) {
+                WritePointer(os, spec, (const void *)arg);
+            } else {
+                WriteOther(os, &arg, [](LogStream &s, const void *p) { s << *(const T *)p; });
+            }
+        }
+
+        // 把第 index 个参数写出去
+        template <class... Args, size_t... I>
+        void WriteArgAt(LogStream &os, const FormatSpec &spec, size_t index,
+                        std::index_sequence<I...>, const Args &...args) {
+            ((I == index ? WriteArg(os, spec, args) : void()), ...);
+        }
+    }
+
+    /**
+     * @brief 按 "{}" 格式串把参数写入日志流，返回流本身（可以继续 << 或 .kv()）
+     */
+    template <class... Args>
+    LogStream &LogFormatTo(LogStream &os, log_format::FormatString<std::type_identity_t<Args>...> fmt,
+                           const Args &...args) {
+        std::string_view str = fmt.get();
+        const char *p = str.data();
+        const char *end = p + str.size();
+        const char *literal = p;
+        size_t index = 0;
+        while (p < end) {
+            char c = *p;
+            if (c != '{' && c != '}') {
+                ++p;
+                continue;
+            }
+            // 先把前面的字面量整段写入
+            log_format::WriteLiteral(os, literal, p - literal);
+            if (p + 1 < end && p[1] == c) {
+                // {{ 或 }}
+                log_format::WriteLiteral(os, p, 1);
+                p += 2;
+                literal = p;
+                continue;
+            }
+            log_format::FormatSpec spec;
+            if (p[1] == ':') {
+                p = log_format::ParseSpec(p + 2, end, spec);
+            } else {
+                p += 2;
+            }
+            if constexpr (sizeof...(Args) > 0) {
+                log_format::WriteArgAt(os, spec, index++, std::index_sequence_for<Args...>(), args...);
+            }
+            literal = p;
+        }
+        log_format::WriteLiteral(os, literal, end - literal);
+        return os;
+    }
+}
+
+#endif
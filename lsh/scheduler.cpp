@@ -9,6 +9,16 @@ namespace lsh {
 
     static thread_local Scheduler *t_schedeluer = nullptr;
     static thread_local Fiber *t_schedeluer_fiber = nullptr;
+    // Park 留给调度协程执行的操作
+    static thread_local std::function<void()> t_after_park;
+
+    static void RunAfterPark() {
+        if (t_after_park) {
+            std::function<void()> after;
+            after.swap(t_after_park);
+            after();
+        }
+    }
 
     Scheduler::Scheduler(size_t threads, bool use_caller, const std::string &name) {
         m_name = name;
@@ -223,6 +233,7 @@ namespace lsh {
                 } else if (ft.fiber->getState() != Fiber::EXCEP && ft.fiber->getState() != Fiber::TERM) {
                     ft.fiber->m_state = Fiber::HOLD;
                 }
+                RunAfterPark();
 
                 ft.reset();
             } else if (ft.callback) {
@@ -246,6 +257,7 @@ namespace lsh {
                     cb_fiber->m_state = Fiber::HOLD;
                     cb_fiber.reset();
                 }
+                RunAfterPark();
             } else {
                 if (is_active) {
                     --m_active_thread_count;
@@ -266,6 +278,12 @@ namespace lsh {
         }
     }
 
+    void Scheduler::Park(std::function<void()> after) {
+        LSH_ASSERT(GetThis() && Fiber::GetThis().get() != t_schedeluer_fiber);
+        t_after_park.swap(after);
+        Fiber::YieldToHold();
+    }
+
     void Scheduler::tickle() {
         LSH_LOG_INFO(g_logger) << "tickle";
     }
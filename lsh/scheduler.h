@@ -35,6 +35,15 @@ namespace lsh {
         void start();
         void stop();
 
+        /**
+         * @brief 挂起当前协程（HOLD），切回调度协程之后再执行 after
+         *
+         * 执行 after 时当前协程的上下文已经保存好。协程把自己放进某个等待队列后，
+         * 在 after 里释放队列的锁：唤醒者拿到锁时协程一定已经挂起，
+         * 不会在切换完成之前就被别的线程 swapIn。只能在调度器的工作协程里调用。
+         */
+        static void Park(std::function<void()> after);
+
         template <class FiberOrCb>
         void schedule(FiberOrCb fc, int thread = -1) {
             bool need_tickle = false;
@@ -0,0 +1,232 @@
+#include "shm_log.h"
+#include "util.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lsh {
+    static const char SHM_LOG_MAGIC[8] = {'L', 'S', 'H', 'S', 'H', 'M', 'L', '1'};
+    static const size_t SHM_LOG_DATA_OFFSET = 4096; // 数据区从第二页开始
+    static const uint64_t SHM_RECORD_HEADER = 8;
+    static const uint64_t SHM_COMMIT_BIT = 0x80000000ull;
+    static const uint32_t SHM_PAD_SIZE = 0x7fffffff; // 填充记录：跳到数据区末尾
+
+    static_assert(sizeof(ShmLogHeader) <= SHM_LOG_DATA_OFFSET, "shm log header too large");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shm log needs lock-free 64-bit atomics");
+
+    static inline uint64_t Align8(uint64_t n) {
+        return (n + 7) & ~uint64_t(7);
+    }
+
+    // 记录头里的位置标记：同一个偏移上一圈的旧头不会和这一圈相等
+    static inline uint64_t RecordTag(uint64_t pos) {
+        return ((pos >> 3) & 0xffffffffull) << 32;
+    }
+
+    static inline std::atomic_ref<uint64_t> RecordHeader(char *data, uint64_t offset) {
+        return std::atomic_ref<uint64_t>(*reinterpret_cast<uint64_t *>(data + offset));
+    }
+
+    ShmLogRing::ShmLogRing(const std::string &name, int fd, void *base, size_t map_size)
+        : m_name(name), m_fd(fd), m_base(base), m_map_size(map_size),
+          m_header(static_cast<ShmLogHeader *>(base)),
+          m_data(static_cast<char *>(base) + SHM_LOG_DATA_OFFSET),
+          m_mask(map_size - SHM_LOG_DATA_OFFSET - 1) {}
+
+    ShmLogRing::~ShmLogRing() {
+        munmap(m_base, m_map_size);
+        close(m_fd);
+    }
+
+    ShmLogRing::ptr ShmLogRing::Create(const std::string &name, size_t capacity) {
+        uint64_t cap = MIN_CAPACITY;
+        while (cap < capacity) {
+            cap <<= 1;
+        }
+        size_t map_size = SHM_LOG_DATA_OFFSET + cap;
+
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::cout << "ShmLogRing shm_open " << name << " failed errno=" << errno << std::endl;
+            return nullptr;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size != 0 && (size_t)st.st_size != map_size) {
+            // 容量变了：换一个新的对象，还映射着旧对象的读者通过 isReplaced 发现
+            close(fd);
+            shm_unlink(name.c_str());
+            fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                std::cout << "ShmLogRing shm_open " << name << " failed errno=" << errno << std::endl;
+                return nullptr;
+            }
+            st.st_size = 0;
+        }
+        if ((size_t)st.st_size != map_size && ftruncate(fd, map_size) != 0) {
+            std::cout << "ShmLogRing ftruncate " << name << " failed errno=" << errno << std::endl;
+            close(fd);
+            return nullptr;
+        }
+        void *base = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            std::cout << "ShmLogRing mmap " << name << " failed errno=" << errno << std::endl;
+            close(fd);
+            return nullptr;
+        }
+
+        ShmLogRing::ptr ring(new ShmLogRing(name, fd, base, map_size));
+        ShmLogHeader *header = ring->m_header;
+        if (memcmp(header->magic, SHM_LOG_MAGIC, sizeof(SHM_LOG_MAGIC)) == 0 && header->capacity == cap) {
+            // 接管上一个写进程留下的环：它可能死在预留和提交之间，让读者在卡住时可以跳到这里
+            uint64_t write_pos = header->write_pos.load(std::memory_order_acquire);
+            if (header->read_pos.load(std::memory_order_acquire) != write_pos) {
+                header->resync_pos.store(write_pos, std::memory_order_release);
+            }
+        } else {
+            memset(base, 0, map_size);
+            header->capacity = cap;
+            std::atomic_thread_fence(std::memory_order_release);
+            memcpy(header->magic, SHM_LOG_MAGIC, sizeof(SHM_LOG_MAGIC));
+        }
+        header->owner_pid.store(getpid(), std::memory_order_release);
+        return ring;
+    }
+
+    ShmLogRing::ptr ShmLogRing::Open(const std::string &name) {
+        int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size <= SHM_LOG_DATA_OFFSET + MIN_CAPACITY - 1) {
+            close(fd);
+            return nullptr;
+        }
+        size_t map_size = st.st_size;
+        void *base = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            close(fd);
+            return nullptr;
+        }
+        ShmLogRing::ptr ring(new ShmLogRing(name, fd, base, map_size));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (memcmp(ring->m_header->magic, SHM_LOG_MAGIC, sizeof(SHM_LOG_MAGIC)) != 0 ||
+            ring->m_header->capacity + SHM_LOG_DATA_OFFSET != map_size) {
+            return nullptr;
+        }
+        return ring;
+    }
+
+    bool ShmLogRing::Unlink(const std::string &name) {
+        return shm_unlink(name.c_str()) == 0;
+    }
+
+    void ShmLogRing::commit(uint64_t pos, uint32_t size) {
+        RecordHeader(m_data, pos & m_mask).store(RecordTag(pos) | SHM_COMMIT_BIT | size, std::memory_order_release);
+    }
+
+    bool ShmLogRing::write(const char *data, size_t len) {
+        uint64_t cap = m_mask + 1;
+        len = std::min<size_t>(len, cap / 4);
+        uint64_t need = SHM_RECORD_HEADER + Align8(len);
+        uint64_t pos = m_header->write_pos.load(std::memory_order_relaxed);
+        uint64_t total;
+        do {
+            // 放不下到数据区末尾时，剩下的部分用一条填充记录占掉，从头开始写
+            uint64_t tail = cap - (pos & m_mask);
+            total = need <= tail ? need : tail + need;
+            // acquire：读者清零这段空间的写入对我们可见
+            if (pos + total - m_header->read_pos.load(std::memory_order_acquire) > cap) {
+                m_header->dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        } while (!m_header->write_pos.compare_exchange_weak(pos, pos + total, std::memory_order_relaxed));
+
+        if (total != need) {
+            commit(pos, SHM_PAD_SIZE);
+            pos += total - need;
+        }
+        memcpy(m_data + (pos & m_mask) + SHM_RECORD_HEADER, data, len);
+        commit(pos, len);
+        return true;
+    }
+
+    void ShmLogRing::zero(uint64_t begin, uint64_t end) {
+        while (begin < end) {
+            uint64_t offset = begin & m_mask;
+            uint64_t n = std::min(end - begin, m_mask + 1 - offset);
+            memset(m_data + offset, 0, n);
+            begin += n;
+        }
+    }
+
+    size_t ShmLogRing::consume(const std::function<void(const char *, size_t)> &cb) {
+        uint64_t start = m_header->read_pos.load(std::memory_order_relaxed);
+        uint64_t pos = start;
+        size_t count = 0;
+        while (true) {
+            uint64_t offset = pos & m_mask;
+            uint64_t h = RecordHeader(m_data, offset).load(std::memory_order_acquire);
+            if ((h & ~0xffffffffull) != RecordTag(pos) || !(h & SHM_COMMIT_BIT)) {
+                break;
+            }
+            uint32_t size = h & 0x7fffffff;
+            if (size == SHM_PAD_SIZE) {
+                pos += m_mask + 1 - offset;
+                continue;
+            }
+            cb(m_data + offset + SHM_RECORD_HEADER, size);
+            pos += SHM_RECORD_HEADER + Align8(size);
+            ++count;
+        }
+
+        if (pos == start && pos != m_header->write_pos.load(std::memory_order_acquire)) {
+            // 有预留但一直没有提交的记录：超时后如果写进程已经换了或者死了，跳过这一段
+            uint64_t now = GetCurrentMS();
+            if (m_stuck_pos != pos) {
+                m_stuck_pos = pos;
+                m_stuck_since = now;
+            } else if (now - m_stuck_since >= m_stall_ms) {
+                uint64_t resync = m_header->resync_pos.load(std::memory_order_acquire);
+                uint64_t next = resync > pos ? resync : (!ownerAlive() ? m_header->write_pos.load(std::memory_order_acquire) : pos);
+                if (next != pos) {
+                    m_skipped += next - pos;
+                    pos = next;
+                }
+            }
+        }
+
+        if (pos != start) {
+            // 清零之后再交还空间，下一圈的写者从干净的内存开始
+            zero(start, pos);
+            m_header->read_pos.store(pos, std::memory_order_release);
+        }
+        return count;
+    }
+
+    bool ShmLogRing::empty() const {
+        return m_header->read_pos.load(std::memory_order_acquire) == m_header->write_pos.load(std::memory_order_acquire);
+    }
+
+    bool ShmLogRing::ownerAlive() const {
+        pid_t pid = m_header->owner_pid.load(std::memory_order_acquire);
+        return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+    }
+
+    bool ShmLogRing::isReplaced() const {
+        int fd = shm_open(m_name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat now, mine;
+        bool replaced = fstat(fd, &now) == 0 && fstat(m_fd, &mine) == 0 && now.st_ino != mine.st_ino;
+        close(fd);
+        return replaced;
+    }
+}
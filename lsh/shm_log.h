@@ -0,0 +1,116 @@
+#ifndef __LSH_SHM_LOG_H__
+#define __LSH_SHM_LOG_H__
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace lsh {
+    /**
+     * @brief 共享内存中的日志环形缓冲区头部，生产者和读者进程共用
+     *
+     * 写位置和读位置分开放在不同的缓存行，都是单调递增的字节偏移。
+     */
+    struct ShmLogHeader {
+        char magic[8];                      // "LSHSHML1"，初始化完成后最后写入
+        uint64_t capacity;                  // 数据区大小，2 的幂
+        std::atomic<int32_t> owner_pid;     // 当前写日志的进程
+        char pad0[44];
+        std::atomic<uint64_t> write_pos;    // 生产者已预留到的位置
+        char pad1[56];
+        std::atomic<uint64_t> read_pos;     // 读者已消费并清零到的位置
+        char pad2[56];
+        std::atomic<uint64_t> resync_pos;   // 新的写进程接管时的写位置，读者卡住时可以跳到这里
+        std::atomic<uint64_t> dropped;      // 空间不够丢弃的条数
+        char pad3[48];
+    };
+
+    /**
+     * @brief 基于 POSIX 共享内存（shm_open + mmap）的多生产者日志环
+     *
+     * 记录格式：[8 字节头][内容，补齐到 8 字节]，头 = (位置/8 的低 32 位) << 32 | 提交位 | 长度。
+     * 生产者用 CAS 推进 write_pos 预留空间，拷贝内容后 release 写入记录头，整个过程没有系统调用和锁；
+     * 空间不够时丢弃并计数，不会等读者。
+     * 读者（通常是另一个进程，见 tools/shm_log_reader.cpp）按位置校验记录头，
+     * 消费后把这段清零再推进 read_pos，所以上一圈的旧数据不会被当成新记录。
+     * 写进程崩溃在预留和提交之间时，读者等待超时后跳过这段（见 consume）。
+     */
+    class ShmLogRing {
+    public:
+        typedef std::shared_ptr<ShmLogRing> ptr;
+
+        static constexpr size_t MIN_CAPACITY = 64 * 1024;
+
+        /**
+         * @brief 生产者：创建共享内存环，同名且容量相同的已有环会被接管（读者可以继续读）
+         */
+        static ShmLogRing::ptr Create(const std::string &name, size_t capacity);
+
+        /**
+         * @brief 读者：打开已存在的共享内存环，不存在或格式不对返回 nullptr
+         */
+        static ShmLogRing::ptr Open(const std::string &name);
+
+        // 删除共享内存对象（已经映射的进程不受影响）
+        static bool Unlink(const std::string &name);
+
+        ~ShmLogRing();
+
+        /**
+         * @brief 写入一条记录，空间不够时丢弃并返回 false，超过容量 1/4 的记录会被截断
+         */
+        bool write(const char *data, size_t len);
+
+        /**
+         * @brief 读者：依次取出所有已提交的记录，返回条数
+         *
+         * 记录内容只在回调期间有效。只能有一个读者。
+         */
+        size_t consume(const std::function<void(const char *, size_t)> &cb);
+
+        // 读者：还有没有消费的数据（包括未提交的）
+        bool empty() const;
+
+        // 写日志的进程是否还活着
+        bool ownerAlive() const;
+
+        // 同名的共享内存对象是否已经换成了另一个（写进程用不同容量重建了）
+        bool isReplaced() const;
+
+        uint64_t getCapacity() const { return m_header->capacity; }
+        uint64_t getDropped() const { return m_header->dropped.load(std::memory_order_relaxed); }
+        // 读者因为写进程崩溃而跳过的字节数
+        uint64_t getSkipped() const { return m_skipped; }
+        const std::string &getName() const { return m_name; }
+
+        // 读者卡在同一条未提交记录上超过这么久才认为写进程已经崩溃
+        void setStallTimeout(uint64_t ms) { m_stall_ms = ms; }
+
+    private:
+        ShmLogRing(const std::string &name, int fd, void *base, size_t map_size);
+
+        // 原子地写入 pos 处的记录头
+        void commit(uint64_t pos, uint32_t size);
+        // 读者：把 [begin, end) 清零
+        void zero(uint64_t begin, uint64_t end);
+
+    private:
+        std::string m_name;
+        int m_fd;
+        void *m_base;
+        size_t m_map_size;
+        ShmLogHeader *m_header;
+        char *m_data;
+        uint64_t m_mask;
+
+        // 只有读者使用
+        uint64_t m_stall_ms{1000};
+        uint64_t m_stuck_pos{UINT64_MAX};
+        uint64_t m_stuck_since{0};
+        uint64_t m_skipped{0};
+    };
+}
+
+#endif
@@ -1,7 +1,14 @@
 #include "thread.h"
+#include "flight_recorder.h"
 #include "log.h"
 #include "util.h"
+#include <algorithm>
+#include <ctime>
+#include <errno.h>
 #include <functional>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace lsh {
 
@@ -60,6 +67,33 @@ namespace lsh {
         }
     }
 
+    /**
+     * @brief 带超时的 P 操作
+     *
+     * - `sem_timedwait` 使用 CLOCK_REALTIME 的绝对时间，这里把相对的 ms 换算成截止时间。
+     * - 被信号打断（EINTR）时继续等待，超时（ETIMEDOUT）返回 false，其余错误抛出异常。
+     */
+    bool Semaphore::waitFor(uint64_t ms) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += ms / 1000;
+        ts.tv_nsec += (ms % 1000) * 1000 * 1000;
+        if (ts.tv_nsec >= 1000 * 1000 * 1000) {
+            ts.tv_sec += 1;
+            ts.tv_nsec -= 1000 * 1000 * 1000;
+        }
+        while (sem_timedwait(&m_semaphore, &ts)) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ETIMEDOUT) {
+                return false;
+            }
+            throw std::logic_error("sem_timedwait error");
+        }
+        return true;
+    }
+
     //==================================================================================
     /*
      * 声明一个静态的线程局部变量 t_thread，它是一个指向 Thread 类对象的指针。
@@ -186,6 +220,10 @@ namespace lsh {
         // 设置线程名称
         pthread_setname_np(pthread_self(), thread->m_name.substr(0, 15).c_str());
         t_thread_name = thread->m_name;
+        // 崩溃处理函数需要备用信号栈，线程栈溢出时才能导出飞行记录
+        if (FlightRecorder::CrashHandlerInstalled()) {
+            FlightRecorder::InstallAltStack();
+        }
 
         /*
          * 交换回调函数 m_call_back 到局部变量 cb
@@ -211,4 +249,59 @@ namespace lsh {
 
         return 0;
     }
+
+    //=================================================================================
+    // AdaptiveLock
+
+    // 单核机器上自旋只会浪费持有者的时间片
+    static const int32_t s_max_spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 100 : 0;
+    // 每轮最多 pause 的次数（指数退避的上限）
+    static const int32_t s_max_backoff = 64;
+
+    static long FutexWait(std::atomic<uint32_t> *addr, uint32_t val) {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT_PRIVATE, val, nullptr, nullptr, 0);
+    }
+
+    static long FutexWake(std::atomic<uint32_t> *addr, int count) {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+    }
+
+    void AdaptiveLock::lockSlow() {
+        // 自旋上限：最近成功时所用轮数的两倍再多给一点，最多 s_max_spins
+        int32_t avg = m_spins.load(std::memory_order_relaxed);
+        int32_t limit = std::min(s_max_spins, avg * 2 + 10);
+        int32_t backoff = 1;
+        uint32_t state = m_state.load(std::memory_order_relaxed);
+        for (int32_t spin = 0; spin < limit && s_max_spins > 0; spin++) {
+            // 已经有人在睡眠，说明持有时间长，直接去睡眠
+            if (state == 2) {
+                break;
+            }
+            if (state == 0 && m_state.compare_exchange_weak(state, 1, std::memory_order_acquire,
+                                                            std::memory_order_relaxed)) {
+                m_spins.store(avg + (spin - avg) / 8, std::memory_order_relaxed);
+                return;
+            }
+            for (int32_t i = 0; i < backoff; i++) {
+                CpuRelax();
+            }
+            backoff = std::min(backoff * 2, s_max_backoff);
+            state = m_state.load(std::memory_order_relaxed);
+        }
+        if (s_max_spins > 0) {
+            // 自旋没等到，下次少自旋一些
+            m_spins.store(std::max(0, avg - avg / 8 - 1), std::memory_order_relaxed);
+        }
+
+        // 置为 2 再睡眠：拿到锁的线程 unlock 时就知道需要唤醒
+        state = m_state.exchange(2, std::memory_order_acquire);
+        while (state != 0) {
+            FutexWait(&m_state, 2);
+            state = m_state.exchange(2, std::memory_order_acquire);
+        }
+    }
+
+    void AdaptiveLock::wake() {
+        FutexWake(&m_state, 1);
+    }
 }
\ No newline at end of file
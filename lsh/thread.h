@@ -9,6 +9,11 @@
 #include <semaphore.h>
 #include <string>
 #include <thread>
+#include <type_traits>
+
+#ifdef LSH_LOCK_PROFILE
+#include "lock_profile.h"
+#endif
 
 namespace lsh {
     //=================================================================================
@@ -60,6 +65,13 @@ namespace lsh {
          */
         void notify();
 
+        /**
+         * @brief 带超时的等待
+         * @param ms 最长等待的毫秒数
+         * @return 在超时前拿到信号量返回 true，超时返回 false
+         */
+        bool waitFor(uint64_t ms);
+
         // private:
         //     // 禁止拷贝和移动，保证信号量对象的唯一性
         //     Semaphore(const Semaphore &) = delete;
@@ -72,6 +84,13 @@ namespace lsh {
     };
 
     //====================================================================================
+    class NULLMutex;
+    class NULLRWMutex;
+
+    // 空锁不参与锁争用统计（LSH_LOCK_PROFILE）
+    template <class T>
+    inline constexpr bool LockProfiled = !std::is_same_v<T, NULLMutex> && !std::is_same_v<T, NULLRWMutex>;
+
     /**
      * @brief 通用互斥锁管理类（RAII 机制）
      *
@@ -80,6 +99,17 @@ namespace lsh {
     template <class T>
     struct ScopedLockImpl {
     public:
+#ifdef LSH_LOCK_PROFILE
+        /**
+         * @brief 构造函数，获取锁，并记录构造 Lock 的调用点用于锁争用统计
+         * @param mutex 传入锁的引用
+         */
+        ScopedLockImpl(T &mutex, const char *file = __builtin_FILE(), int line = __builtin_LINE())
+            : m_mutex(mutex), m_site{file, line} {
+            lock();
+            m_locked = true;
+        }
+#else
         /**
          * @brief 构造函数，获取锁
          * @param mutex 传入锁的引用
@@ -88,6 +118,7 @@ namespace lsh {
             lock();
             m_locked = true;
         }
+#endif
 
         /**
          * @brief 析构函数，释放锁
@@ -101,7 +132,15 @@ namespace lsh {
          */
         void lock() {
             if (!m_locked) {
+#ifdef LSH_LOCK_PROFILE
+                if constexpr (LockProfiled<T>) {
+                    m_site.lock(m_mutex);
+                } else {
+                    m_mutex.lock();
+                }
+#else
                 m_mutex.lock();
+#endif
                 m_locked = true;
             }
         }
@@ -111,7 +150,15 @@ namespace lsh {
          */
         void unlock() {
             if (m_locked) {
+#ifdef LSH_LOCK_PROFILE
+                if constexpr (LockProfiled<T>) {
+                    m_site.unlock(m_mutex, LockProfiler::MUTEX);
+                } else {
+                    m_mutex.unlock();
+                }
+#else
                 m_mutex.unlock();
+#endif
                 m_locked = false;
             }
         }
@@ -119,6 +166,9 @@ namespace lsh {
     private:
         T &m_mutex;            ///< 互斥锁的引用
         bool m_locked = false; ///< 标记当前是否持有锁
+#ifdef LSH_LOCK_PROFILE
+        LockSite m_site; ///< 调用点和本次加锁的等待/持有时间
+#endif
     };
 
     /**
@@ -141,6 +191,11 @@ namespace lsh {
             pthread_mutex_lock(&m_mutex);
         }
 
+        /** @brief 尝试加锁，锁被占用时立即返回 false */
+        bool tryLock() {
+            return pthread_mutex_trylock(&m_mutex) == 0;
+        }
+
         /** @brief 解锁 */
         void unlock() {
             pthread_mutex_unlock(&m_mutex);
@@ -182,6 +237,11 @@ namespace lsh {
             pthread_spin_lock(&m_mutex);
         }
 
+        /** @brief 尝试加锁，不自旋 */
+        bool tryLock() {
+            return pthread_spin_trylock(&m_mutex) == 0;
+        }
+
         /** @brief 解锁 */
         void unlock() {
             pthread_spin_unlock(&m_mutex);
@@ -209,6 +269,11 @@ namespace lsh {
                 ;
         }
 
+        /** @brief 尝试加锁，不自旋 */
+        bool tryLock() {
+            return !m_mutex.test_and_set(std::memory_order_acquire);
+        }
+
         /** @brief 解锁 */
         void unlock() {
             m_mutex.clear(std::memory_order_release);
@@ -218,16 +283,76 @@ namespace lsh {
         std::atomic_flag m_mutex = ATOMIC_FLAG_INIT; ///< 原子标志位
     };
 
+    /**
+     * @brief CPU 自旋等待提示（x86 pause / ARM yield），降低自旋时的功耗和对超线程兄弟的干扰
+     */
+    inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield" ::: "memory");
+#endif
+    }
+
+    /**
+     * @brief 自适应锁：先带指数退避自旋，超过自旋上限后在 futex 上睡眠
+     *
+     * 状态：0 未加锁，1 加锁无等待者，2 加锁且可能有等待者（unlock 需要 futex 唤醒）。
+     * 没有竞争时 lock/unlock 各一次原子操作，不进内核。
+     * 自旋上限按这把锁过去自旋成功所用的次数自适应（类似 glibc 的 PTHREAD_MUTEX_ADAPTIVE_NP）：
+     * 持有时间短的锁多自旋，持有时间长的锁很快去睡眠；单核机器上不自旋。
+     */
+    class AdaptiveLock : Noncopyable {
+    public:
+        typedef ScopedLockImpl<AdaptiveLock> Lock;
+
+        void lock() {
+            uint32_t expected = 0;
+            if (__builtin_expect(m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire), 1)) {
+                return;
+            }
+            lockSlow();
+        }
+
+        bool tryLock() {
+            uint32_t expected = 0;
+            return m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+        }
+
+        void unlock() {
+            if (__builtin_expect(m_state.exchange(0, std::memory_order_release) == 2, 0)) {
+                wake();
+            }
+        }
+
+    private:
+        void lockSlow();
+        void wake();
+
+    private:
+        std::atomic<uint32_t> m_state{0};
+        // 最近自旋成功所用轮数的滑动平均
+        std::atomic<int32_t> m_spins{0};
+    };
+
     /**
      * @brief 读写锁的 RAII 读锁封装
      */
     template <class T>
     struct ReadScopedLockImpl {
     public:
+#ifdef LSH_LOCK_PROFILE
+        ReadScopedLockImpl(T &mutex, const char *file = __builtin_FILE(), int line = __builtin_LINE())
+            : m_mutex(mutex), m_site{file, line} {
+            lock();
+            m_locked = true;
+        }
+#else
         ReadScopedLockImpl(T &mutex) : m_mutex(mutex) {
             lock();
             m_locked = true;
         }
+#endif
 
         ~ReadScopedLockImpl() {
             unlock();
@@ -235,14 +360,30 @@ namespace lsh {
 
         void lock() {
             if (!m_locked) {
+#ifdef LSH_LOCK_PROFILE
+                if constexpr (LockProfiled<T>) {
+                    m_site.rlock(m_mutex);
+                } else {
+                    m_mutex.rlock();
+                }
+#else
                 m_mutex.rlock();
+#endif
                 m_locked = true;
             }
         }
 
         void unlock() {
             if (m_locked) {
+#ifdef LSH_LOCK_PROFILE
+                if constexpr (LockProfiled<T>) {
+                    m_site.unlock(m_mutex, LockProfiler::READ);
+                } else {
+                    m_mutex.unlock();
+                }
+#else
                 m_mutex.unlock();
+#endif
                 m_locked = false;
             }
         }
@@ -250,6 +391,9 @@ namespace lsh {
     private:
         T &m_mutex;
         bool m_locked = false;
+#ifdef LSH_LOCK_PROFILE
+        LockSite m_site;
+#endif
     };
 
     /**
@@ -258,10 +402,18 @@ namespace lsh {
     template <class T>
     struct WriteScopedLockImpl {
     public:
+#ifdef LSH_LOCK_PROFILE
+        WriteScopedLockImpl(T &mutex, const char *file = __builtin_FILE(), int line = __builtin_LINE())
+            : m_mutex(mutex), m_site{file, line} {
+            lock();
+            m_locked = true;
+        }
+#else
         WriteScopedLockImpl(T &mutex) : m_mutex(mutex) {
             lock();
             m_locked = true;
         }
+#endif
 
         ~WriteScopedLockImpl() {
             unlock();
@@ -269,14 +421,30 @@ namespace lsh {
 
         void lock() {
             if (!m_locked) {
+#ifdef LSH_LOCK_PROFILE
+                if constexpr (LockProfiled<T>) {
+                    m_site.wlock(m_mutex);
+                } else {
+                    m_mutex.wlock();
+                }
+#else
                 m_mutex.wlock();
+#endif
                 m_locked = true;
             }
         }
 
         void unlock() {
             if (m_locked) {
+#ifdef LSH_LOCK_PROFILE
+                if constexpr (LockProfiled<T>) {
+                    m_site.unlock(m_mutex, LockProfiler::WRITE);
+                } else {
+                    m_mutex.unlock();
+                }
+#else
                 m_mutex.unlock();
+#endif
                 m_locked = false;
             }
         }
@@ -284,6 +452,9 @@ namespace lsh {
     private:
         T &m_mutex;
         bool m_locked = false;
+#ifdef LSH_LOCK_PROFILE
+        LockSite m_site;
+#endif
     };
 
     /**
@@ -326,6 +497,16 @@ namespace lsh {
             pthread_rwlock_wrlock(&m_rwlock);
         }
 
+        /** @brief 尝试加读锁 */
+        bool tryRlock() {
+            return pthread_rwlock_tryrdlock(&m_rwlock) == 0;
+        }
+
+        /** @brief 尝试加写锁 */
+        bool tryWlock() {
+            return pthread_rwlock_trywrlock(&m_rwlock) == 0;
+        }
+
         /** @brief 解锁（适用于读或写锁） */
         void unlock() {
             pthread_rwlock_unlock(&m_rwlock);
@@ -2,12 +2,23 @@
 #include "fiber.h"
 #include <execinfo.h> // backtrace, backtrace_symbols
 #include <filesystem>
+#include <pthread.h>
 #include <sys/time.h>
 
 namespace lsh {
+    // 当前线程的内核线程 id 缓存，0 表示还没取过
+    static thread_local pid_t t_tid = 0;
+
+    // fork 出的子进程里只剩调用 fork 的那个线程，它的 tid 变了，要清掉缓存重新取
+    [[maybe_unused]] static int s_tid_atfork = pthread_atfork(nullptr, nullptr, []() { t_tid = 0; });
+
     pid_t GetThreadId() {
         // 获取 Linux 下的内核线程 id，全局唯一
-        return syscall(SYS_gettid);
+        // 线程 id 在线程的生命周期内不变，缓存在线程局部变量中，只做一次系统调用
+        if (t_tid == 0) {
+            t_tid = syscall(SYS_gettid);
+        }
+        return t_tid;
     }
 
     u_int32_t GetFiberId() {
@@ -0,0 +1,113 @@
+#include "thread.h"
+#include "util.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+
+// thread.h 中各种锁在 1..64 个线程争用下的吞吐：
+//  - short：临界区只加一个计数器（日志里保护指针/列表的情况）
+//  - long：临界区里做一段计算，模拟持有时间较长的锁（比如写 stdout）
+// 每组固定跑 duration 毫秒，报告每秒完成的 lock/unlock 次数和锁外的空闲计算
+
+static uint64_t s_duration_ms = 200;
+// 所有计算结果汇总到这里并在最后打印，编译器不能把 Work 当成无用代码删掉
+static std::atomic<uint64_t> s_checksum{0};
+
+// 一段不会被优化掉的计算
+static uint64_t Work(int n) {
+    static thread_local uint64_t x = 88172645463325252ull;
+    for (int i = 0; i < n; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+    return x;
+}
+
+template <class LockType>
+static double Run(int threads, int inside, int outside) {
+    LockType lock;
+    uint64_t counter = 0;
+    std::atomic<bool> start{false};
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> total{0};
+    std::vector<lsh::Thread::ptr> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back(new lsh::Thread([&]() {
+            while (!start.load(std::memory_order_acquire)) {
+                lsh::CpuRelax();
+            }
+            uint64_t ops = 0;
+            uint64_t sink = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                {
+                    typename LockType::Lock guard(lock);
+                    ++counter;
+                    if (inside) {
+                        sink += Work(inside);
+                    }
+                }
+                if (outside) {
+                    sink += Work(outside);
+                }
+                ++ops;
+            }
+            total += ops;
+            s_checksum += sink;
+        }, "bench_lock_" + std::to_string(t)));
+    }
+    uint64_t begin = lsh::GetCurrentUS();
+    start.store(true, std::memory_order_release);
+    usleep(s_duration_ms * 1000);
+    stop = true;
+    for (auto &w : workers) {
+        w->join();
+    }
+    uint64_t elapsed = lsh::GetCurrentUS() - begin;
+    if (counter != total) {
+        std::cerr << "lock is broken: counter=" << counter << " ops=" << total << std::endl;
+        exit(1);
+    }
+    return total * 1e6 / elapsed;
+}
+
+static void Table(const char *name, int inside, int outside, int max_threads) {
+    std::cout << "\n[" << name << "] work inside=" << inside << " outside=" << outside
+              << " (Mops/s, higher is better)" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "Mutex" << std::setw(12) << "Spinlock"
+              << std::setw(12) << "CASLock" << std::setw(14) << "AdaptiveLock" << std::endl;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(3)
+                  << std::setw(12) << Run<lsh::Mutex>(threads, inside, outside) / 1e6
+                  << std::setw(12) << Run<lsh::Spinlock>(threads, inside, outside) / 1e6
+                  << std::setw(12) << Run<lsh::CASLock>(threads, inside, outside) / 1e6
+                  << std::setw(14) << Run<lsh::AdaptiveLock>(threads, inside, outside) / 1e6
+                  << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    int max_threads = 64;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:d:")) != -1) {
+        switch (opt) {
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        case 'd':
+            s_duration_ms = atoi(optarg);
+            break;
+        default:
+            std::cerr << "usage: " << argv[0] << " [-t max_threads] [-d duration_ms_per_case]" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "cpus=" << sysconf(_SC_NPROCESSORS_ONLN) << " duration=" << s_duration_ms << "ms/case" << std::endl;
+    Table("short", 0, 50, max_threads);
+    Table("long", 500, 50, max_threads);
+    std::cout << "\nchecksum=" << s_checksum << std::endl;
+    return 0;
+}
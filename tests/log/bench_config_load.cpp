@@ -0,0 +1,128 @@
+#include "config.h"
+#include "log.h"
+#include "util.h"
+#include <list>
+
+// Config::LoadFromYaml 的启动耗时：几千个配置项 + 大量没有注册的键，
+// 和原来"展开成列表、复杂节点序列化成字符串再重新解析"的做法对比
+
+static const int s_services = 500;
+
+static void Register() {
+    for (int i = 0; i < s_services; i++) {
+        std::string prefix = "bench.svc" + std::to_string(i);
+        lsh::Config::Creat(prefix + ".port", (int)0, "port");
+        lsh::Config::Creat(prefix + ".hosts", std::vector<std::string>(), "hosts");
+        lsh::Config::Creat(prefix + ".limits", std::map<std::string, std::vector<int>>(), "limits");
+        lsh::Config::Creat(prefix + ".tags", std::set<std::string>(), "tags");
+    }
+}
+
+// seed 不同，生成的值不同
+static std::string MakeYaml(int seed) {
+    std::stringstream ss;
+    ss << "bench:\n";
+    for (int i = 0; i < s_services; i++) {
+        ss << "  svc" << i << ":\n";
+        ss << "    port: " << 8000 + i + seed << "\n";
+        ss << "    hosts: [";
+        for (int h = 0; h < 8; h++) {
+            ss << (h ? ", " : "") << "host" << h << "-" << seed << ".example.com";
+        }
+        ss << "]\n    limits:\n";
+        for (int l = 0; l < 4; l++) {
+            ss << "      l" << l << ": [" << l << ", " << l + seed << ", " << l * 10 << "]\n";
+        }
+        ss << "    tags: [a" << seed << ", b, c, d]\n";
+        // 没有注册的子树
+        ss << "    extra:\n";
+        for (int e = 0; e < 4; e++) {
+            ss << "      e" << e << ": {x: " << e << ", y: [1, 2, 3]}\n";
+        }
+    }
+    ss << "unrelated:\n";
+    for (int u = 0; u < 3000; u++) {
+        ss << "  key" << u << ": {a: " << u << ", b: [x, y, z]}\n";
+    }
+    return ss.str();
+}
+
+// 原来的实现：所有节点展开成列表，非标量节点序列化成字符串交给 fromString
+static void ListAllMember(const std::string &prefix, const YAML::Node &node,
+                          std::list<std::pair<std::string, const YAML::Node>> &output) {
+    if (prefix.find_first_not_of("abcdefghijklmnopqrstuvwxyz._0123456789") != std::string::npos) {
+        return;
+    }
+    output.push_back(std::make_pair(prefix, node));
+    if (node.IsMap()) {
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            ListAllMember(prefix.empty() ? it->first.Scalar() : prefix + "." + it->first.Scalar(),
+                          it->second, output);
+        }
+    }
+}
+
+static void LegacyLoadFromYaml(const YAML::Node &root) {
+    std::list<std::pair<std::string, const YAML::Node>> all_nodes;
+    ListAllMember("", root, all_nodes);
+    for (auto &i : all_nodes) {
+        std::string key = i.first;
+        if (key.empty()) {
+            continue;
+        }
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        lsh::ConfigVarBase::ptr var = lsh::Config::LookupBase(key);
+        if (var) {
+            if (i.second.IsScalar()) {
+                var->fromString(i.second.Scalar());
+            } else {
+                std::stringstream ss;
+                ss << i.second;
+                var->fromString(ss.str());
+            }
+        }
+    }
+}
+
+static std::map<std::string, std::string> DumpAll() {
+    std::map<std::string, std::string> values;
+    lsh::Config::Visit([&values](lsh::ConfigVarBase::ptr var) {
+        values[var->getName()] = var->toString();
+    });
+    return values;
+}
+
+int main(int argc, char **argv) {
+    Register();
+    std::string text0 = MakeYaml(0);
+    std::string text1 = MakeYaml(1);
+
+    uint64_t begin = lsh::GetCurrentUS();
+    YAML::Node doc0 = YAML::Load(text0);
+    YAML::Node doc1 = YAML::Load(text1);
+    uint64_t parse_us = (lsh::GetCurrentUS() - begin) / 2;
+
+    lsh::Config::LoadFromYaml(doc0);
+    begin = lsh::GetCurrentUS();
+    LegacyLoadFromYaml(doc1);
+    uint64_t legacy_us = lsh::GetCurrentUS() - begin;
+    std::map<std::string, std::string> legacy = DumpAll();
+
+    lsh::Config::LoadFromYaml(doc0);
+    begin = lsh::GetCurrentUS();
+    lsh::Config::LoadFromYaml(doc1);
+    uint64_t single_us = lsh::GetCurrentUS() - begin;
+    std::map<std::string, std::string> single = DumpAll();
+
+    size_t vars = 0;
+    lsh::Config::Visit([&vars](lsh::ConfigVarBase::ptr) { ++vars; });
+    std::cout << "yaml " << text1.size() / 1024 << "KB, " << vars << " config vars" << std::endl;
+    std::cout << "YAML::Load:              " << parse_us / 1000.0 << " ms" << std::endl;
+    std::cout << "legacy LoadFromYaml:     " << legacy_us / 1000.0 << " ms" << std::endl;
+    std::cout << "single-pass LoadFromYaml: " << single_us / 1000.0 << " ms" << std::endl;
+
+    bool ok = legacy == single && lsh::Config::Lookup<int>("bench.svc7.port")->getValue() == 8008 &&
+              lsh::Config::Lookup<std::map<std::string, std::vector<int>>>("bench.svc3.limits")->getValue().at("l2")[1] == 3;
+    std::cout << (ok ? "OK" : "FAILED: results differ") << std::endl;
+    return ok ? 0 : 1;
+}
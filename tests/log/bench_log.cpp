@@ -0,0 +1,266 @@
+#include "fiber.h"
+#include "log.h"
+#include "log_test_appenders.h"
+#include "scheduler.h"
+#include "thread.h"
+#include "util.h"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+/**
+ * 日志子系统的吞吐和延迟基准
+ *
+ * 用法: bench_log [-n 每个线程的条数] [-t 最大线程数] [-f 每个线程的协程数] [-d 日志文件目录]
+ *                 [-s 只跑名字里包含这个子串的场景] [-j JSON 结果文件]
+ *
+ * 场景 = 写法（stream / printf / fmtx / filtered）× appender（null / stdout / file）
+ *       × 并发（1, 2, 4 ... 个线程，或者同样多线程上的协程）
+ * 每条日志单独计时，统计 p50/p99/p999/max；ns/op 是总耗时除以总条数（即吞吐的倒数）。
+ * 表格写到 stderr；stdout appender 的输出建议重定向到 /dev/null：bench_log > /dev/null
+ */
+
+struct BenchResult {
+    std::string api;
+    std::string appender;
+    std::string mode; // thread / fiber
+    int threads = 0;
+    int fibers = 0;
+    uint64_t ops = 0;
+    double ns_per_op = 0;
+    double ops_per_sec = 0;
+    uint64_t p50 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+
+    std::string name() const {
+        std::stringstream ss;
+        ss << api << "/" << appender << "/" << mode << "/" << threads;
+        return ss.str();
+    }
+};
+
+static uint64_t s_ops = 100000;
+static int s_max_threads = 4;
+static int s_fibers_per_thread = 4;
+static std::string s_dir = "/tmp";
+static std::string s_filter;
+static std::string s_json;
+
+static inline uint64_t NowNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// 把所有 worker 的延迟合并起来算分位数
+static void Summarize(BenchResult &r, std::vector<std::vector<uint32_t>> &latencies, uint64_t elapsed_ns) {
+    std::vector<uint32_t> all;
+    for (auto &v : latencies) {
+        all.insert(all.end(), v.begin(), v.end());
+    }
+    r.ops = all.size();
+    r.ns_per_op = r.ops ? (double)elapsed_ns / r.ops : 0;
+    r.ops_per_sec = elapsed_ns ? r.ops * 1e9 / elapsed_ns : 0;
+    auto percentile = [&all](double p) -> uint64_t {
+        if (all.empty()) {
+            return 0;
+        }
+        size_t k = std::min(all.size() - 1, (size_t)(p * all.size()));
+        std::nth_element(all.begin(), all.begin() + k, all.end());
+        return all[k];
+    };
+    r.p50 = percentile(0.5);
+    r.p99 = percentile(0.99);
+    r.p999 = percentile(0.999);
+    r.max = all.empty() ? 0 : *std::max_element(all.begin(), all.end());
+}
+
+// 单个 worker：连续写 count 条，每条单独计时；协程模式下每 64 条让出一次，让同一线程上的协程交替执行
+template <class F>
+static void RunWorker(F &f, std::vector<uint32_t> &lat, uint64_t count, bool yield) {
+    lat.resize(count);
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t begin = NowNS();
+        f(i);
+        lat[i] = std::min<uint64_t>(NowNS() - begin, UINT32_MAX);
+        if (yield && (i & 63) == 63) {
+            lsh::Fiber::YieldToReady();
+        }
+    }
+}
+
+template <class F>
+static BenchResult RunThreads(int threads, F f) {
+    BenchResult r;
+    r.mode = "thread";
+    r.threads = threads;
+    std::vector<std::vector<uint32_t>> latencies(threads);
+    uint64_t begin = NowNS();
+    std::vector<lsh::Thread::ptr> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back(new lsh::Thread([&, t]() {
+            RunWorker(f, latencies[t], s_ops, false);
+        }, "bench_" + std::to_string(t)));
+    }
+    for (auto &w : workers) {
+        w->join();
+    }
+    Summarize(r, latencies, NowNS() - begin);
+    return r;
+}
+
+template <class F>
+static BenchResult RunFibers(int threads, F f) {
+    BenchResult r;
+    r.mode = "fiber";
+    r.threads = threads;
+    r.fibers = threads * s_fibers_per_thread;
+    std::vector<std::vector<uint32_t>> latencies(r.fibers);
+    uint64_t per_fiber = s_ops / s_fibers_per_thread;
+    lsh::Scheduler sc(threads, false, "bench_log");
+    sc.start();
+    uint64_t begin = NowNS();
+    for (int k = 0; k < r.fibers; k++) {
+        sc.schedule(std::function<void()>([&, k]() {
+            RunWorker(f, latencies[k], per_fiber, true);
+        }));
+    }
+    sc.stop();
+    Summarize(r, latencies, NowNS() - begin);
+    return r;
+}
+
+static void PrintHeader() {
+    fprintf(stderr, "%-32s %10s %12s %14s %8s %8s %8s %10s\n",
+            "scenario", "ops", "ns/op", "ops/s", "p50", "p99", "p999", "max");
+}
+
+static void PrintResult(const BenchResult &r) {
+    fprintf(stderr, "%-32s %10lu %12.1f %14.0f %8lu %8lu %8lu %10lu\n", r.name().c_str(),
+            (unsigned long)r.ops, r.ns_per_op, r.ops_per_sec, (unsigned long)r.p50,
+            (unsigned long)r.p99, (unsigned long)r.p999, (unsigned long)r.max);
+}
+
+static void WriteJson(const std::vector<BenchResult> &results) {
+    std::ofstream out(s_json, std::ios::trunc);
+    if (!out) {
+        std::cerr << "open " << s_json << " failed" << std::endl;
+        return;
+    }
+    out << "{\"ops_per_thread\":" << s_ops << ",\"max_threads\":" << s_max_threads
+        << ",\"fibers_per_thread\":" << s_fibers_per_thread << ",\"results\":[";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+        out << (i ? "," : "") << "\n{\"name\":\"" << r.name() << "\",\"api\":\"" << r.api
+            << "\",\"appender\":\"" << r.appender << "\",\"mode\":\"" << r.mode
+            << "\",\"threads\":" << r.threads << ",\"fibers\":" << r.fibers << ",\"ops\":" << r.ops
+            << ",\"ns_per_op\":" << r.ns_per_op << ",\"ops_per_sec\":" << (uint64_t)r.ops_per_sec
+            << ",\"p50_ns\":" << r.p50 << ",\"p99_ns\":" << r.p99 << ",\"p999_ns\":" << r.p999
+            << ",\"max_ns\":" << r.max << "}";
+    }
+    out << "\n]}\n";
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:f:d:s:j:")) != -1) {
+        switch (opt) {
+        case 'n':
+            s_ops = std::max(1ul, strtoul(optarg, nullptr, 10));
+            break;
+        case 't':
+            s_max_threads = std::max(1, atoi(optarg));
+            break;
+        case 'f':
+            s_fibers_per_thread = std::max(1, atoi(optarg));
+            break;
+        case 'd':
+            s_dir = optarg;
+            break;
+        case 's':
+            s_filter = optarg;
+            break;
+        case 'j':
+            s_json = optarg;
+            break;
+        default:
+            std::cerr << "usage: " << argv[0] << " [-n ops_per_thread] [-t max_threads] [-f fibers_per_thread]"
+                      << " [-d log_dir] [-s scenario_filter] [-j json_file]" << std::endl;
+            return 1;
+        }
+    }
+    // 调度器自己的日志不计入结果
+    LSH_LOG_NAME("system")->setLevel(lsh::LogLevel::ERROR);
+
+    std::vector<int> thread_counts;
+    for (int t = 1; t < s_max_threads; t <<= 1) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(s_max_threads);
+
+    std::string file_path = s_dir + "/bench_log.log";
+    std::vector<BenchResult> results;
+    PrintHeader();
+
+    auto run = [&](const std::string &api, const std::string &appender_name, auto f) {
+        for (const char *mode : {"thread", "fiber"}) {
+            for (int threads : thread_counts) {
+                BenchResult probe;
+                probe.api = api;
+                probe.appender = appender_name;
+                probe.mode = mode;
+                probe.threads = threads;
+                if (!s_filter.empty() && probe.name().find(s_filter) == std::string::npos) {
+                    continue;
+                }
+                unlink(file_path.c_str());
+                std::shared_ptr<lsh::Logger> logger(new lsh::Logger("bench_log"));
+                if (appender_name == "stdout") {
+                    logger->addAppender(std::make_shared<lsh::StdoutLogAppender>());
+                } else if (appender_name == "file") {
+                    logger->addAppender(std::make_shared<lsh::FileLogAppender>(file_path));
+                } else {
+                    // 只测日志前端（构造事件 + 格式化 + 分发），格式化但不写出
+                    logger->addAppender(std::make_shared<NullLogAppender>(true));
+                }
+                if (api == "filtered") {
+                    logger->setLevel(lsh::LogLevel::WARN);
+                }
+                auto op = [&logger, &f](uint64_t i) { f(logger, i); };
+                BenchResult r = strcmp(mode, "thread") == 0 ? RunThreads(threads, op) : RunFibers(threads, op);
+                r.api = api;
+                r.appender = appender_name;
+                PrintResult(r);
+                results.push_back(r);
+            }
+        }
+    };
+
+    for (const char *appender : {"null", "stdout", "file"}) {
+        run("stream", appender, [](std::shared_ptr<lsh::Logger> &logger, uint64_t i) {
+            LSH_LOG_INFO(logger) << "bench log event i=" << i << " value=" << 3.14;
+        });
+        run("printf", appender, [](std::shared_ptr<lsh::Logger> &logger, uint64_t i) {
+            LSH_LOG_FMT_INFO(logger, "bench log event i=%lu value=%f", (unsigned long)i, 3.14);
+        });
+        run("fmtx", appender, [](std::shared_ptr<lsh::Logger> &logger, uint64_t i) {
+            LSH_LOG_FMTX_INFO(logger, "bench log event i={} value={}", i, 3.14);
+        });
+    }
+    // 被级别过滤掉的日志和 appender 无关，只跑一次
+    run("filtered", "null", [](std::shared_ptr<lsh::Logger> &logger, uint64_t i) {
+        LSH_LOG_DEBUG(logger) << "bench log event i=" << i;
+    });
+    unlink(file_path.c_str());
+
+    if (!s_json.empty()) {
+        WriteJson(results);
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "flight_recorder.h"
+#include "log.h"
+#include "log_test_appenders.h"
+#include "thread.h"
+#include "util.h"
+#include <cstdarg>
+#include <iostream>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const int s_count = 1000000;
+
+/**
+ * @brief 改造前的日志路径，作为对比
+ *
+ * 每条日志 make_shared 一个事件，线程 id 每次走 gettid 系统调用，拷贝线程名；
+ * 内容写进 std::stringstream，LSH_LOG_FMT 用 vasprintf 格式化后再拷一次；
+ * 分发时在 logger 的锁里把内容取成 std::string。
+ */
+struct LegacyLogEvent {
+    LegacyLogEvent(const char *file, int32_t line, uint32_t thread_id, uint32_t fiber_id, uint64_t time,
+                   lsh::LogLevel::Level level, std::string thread_name)
+        : file(file), line(line), thread_id(thread_id), fiber_id(fiber_id), time(time), level(level),
+          thread_name(std::move(thread_name)) {}
+
+    void format(const char *fmt, ...) {
+        va_list al;
+        va_start(al, fmt);
+        char *buf = nullptr;
+        int len = vasprintf(&buf, fmt, al);
+        va_end(al);
+        if (len != -1) {
+            ss << std::string(buf, len);
+            free(buf);
+        }
+    }
+
+    const char *file;
+    int32_t line;
+    uint32_t thread_id;
+    uint32_t fiber_id;
+    uint64_t time;
+    lsh::LogLevel::Level level;
+    std::string thread_name;
+    std::stringstream ss;
+};
+
+class LegacyLogger {
+public:
+    std::shared_ptr<LegacyLogEvent> newEvent(const char *file, int32_t line, lsh::LogLevel::Level level) {
+        return std::make_shared<LegacyLogEvent>(file, line, syscall(SYS_gettid), lsh::GetFiberId(), time(0),
+                                                level, lsh::Thread::GetName());
+    }
+
+    void log(const std::shared_ptr<LegacyLogEvent> &event) {
+        lsh::Mutex::Lock lock(m_mutex);
+        m_bytes += event->ss.str().size();
+    }
+
+    uint64_t m_bytes = 0;
+
+private:
+    lsh::Mutex m_mutex;
+};
+
+template <class F>
+void bench(const std::string &name, F f) {
+    uint64_t begin = lsh::GetCurrentUS();
+    for (int i = 0; i < s_count; i++) {
+        f(i);
+    }
+    uint64_t end = lsh::GetCurrentUS();
+    std::cout << name << ": " << (end - begin) * 1000.0 / s_count << " ns/op" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    std::shared_ptr<lsh::Logger> logger(new lsh::Logger("bench"));
+    std::shared_ptr<NullLogAppender> appender(new NullLogAppender);
+    logger->addAppender(appender);
+
+    // 只测日志路径本身，不算飞行记录仪（默认记录 DEBUG 及以上，被过滤的日志也会构造事件）
+    lsh::FlightRecorder::SetLevel(lsh::FlightRecorder::OFF);
+
+    // 改造前后对比：legacy 是原来的 make_shared + stringstream（+ vasprintf）路径
+    LegacyLogger legacy;
+    bench("legacy   stream", [&](int i) {
+        std::shared_ptr<LegacyLogEvent> event = legacy.newEvent(__FILE__, __LINE__, lsh::LogLevel::INFO);
+        event->ss << "bench log event i=" << i << " value=" << 3.14;
+        legacy.log(event);
+    });
+    bench("legacy   printf", [&](int i) {
+        std::shared_ptr<LegacyLogEvent> event = legacy.newEvent(__FILE__, __LINE__, lsh::LogLevel::INFO);
+        event->format("bench log event i=%d value=%f", i, 3.14);
+        legacy.log(event);
+    });
+    bench("stream   LSH_LOG_INFO", [&](int i) {
+        LSH_LOG_INFO(logger) << "bench log event i=" << i << " value=" << 3.14;
+    });
+    bench("printf   LSH_LOG_FMT_INFO", [&](int i) {
+        LSH_LOG_FMT_INFO(logger, "bench log event i=%d value=%f", i, 3.14);
+    });
+    // 二进制模式：调用点只拷贝参数，格式化交给后台线程，缓冲区满时丢弃
+    logger->setBinary(true);
+    bench("binary   LSH_LOG_FMT_INFO", [&](int i) {
+        LSH_LOG_FMT_INFO(logger, "bench log event i=%d value=%f", i, 3.14);
+    });
+    lsh::BinLogMgr::GetInstance()->flush();
+    std::cout << "binary dropped=" << lsh::BinLogMgr::GetInstance()->getDropped() << std::endl;
+    logger->setBinary(false);
+    logger->setLevel(lsh::LogLevel::WARN);
+    bench("filtered LSH_LOG_INFO", [&](int i) {
+        LSH_LOG_INFO(logger) << "bench log event i=" << i;
+    });
+    std::cout << "bytes=" << appender->m_bytes << " legacy bytes=" << legacy.m_bytes << std::endl;
+    return 0;
+}
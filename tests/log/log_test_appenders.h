@@ -0,0 +1,78 @@
+#ifndef __LSH_LOG_TEST_APPENDERS_H__
+#define __LSH_LOG_TEST_APPENDERS_H__
+
+#include "log.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 日志测试和基准共用的 appender
+ */
+
+// 把每条日志存下来；formatted 为 true 时保存 formatter 格式化后的整行，否则只保存内容
+class CaptureLogAppender : public lsh::LogAppender {
+public:
+    explicit CaptureLogAppender(bool formatted = false) : m_formatted(formatted) {}
+
+    void log(std::shared_ptr<lsh::Logger> logger, lsh::LogLevel::Level level,
+             std::shared_ptr<lsh::LogEvent> event) override {
+        if (m_formatted) {
+            std::string out;
+            getFormatter()->format(out, logger, level, event);
+            m_lines.push_back(std::move(out));
+        } else {
+            m_lines.push_back(event->getContent());
+        }
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::vector<std::string> m_lines;
+
+private:
+    bool m_formatted;
+};
+
+// 只统计条数
+class CountLogAppender : public lsh::LogAppender {
+public:
+    void log(std::shared_ptr<lsh::Logger> logger, lsh::LogLevel::Level level,
+             std::shared_ptr<lsh::LogEvent> event) override {
+        ++m_count;
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::atomic<uint64_t> m_count{0};
+};
+
+/**
+ * @brief 基准用的 appender，什么也不写出，自己不分配内存
+ *
+ * 默认只读一下内容的长度，测的是日志宏前端（构造事件 + 写入内容 + 分发）；
+ * format 为 true 时再用 formatter 格式化到线程局部的缓冲区里，测完整的格式化开销。
+ */
+class NullLogAppender : public lsh::LogAppender {
+public:
+    explicit NullLogAppender(bool format = false) : m_format(format) {}
+
+    void log(std::shared_ptr<lsh::Logger> logger, lsh::LogLevel::Level level,
+             std::shared_ptr<lsh::LogEvent> event) override {
+        if (m_format) {
+            static thread_local std::string t_buf;
+            t_buf.clear();
+            m_formatter->format(t_buf, logger, level, event);
+        } else {
+            // 不用原子加：多线程时计数不精确，只是为了让内容不被优化掉
+            m_bytes.store(m_bytes.load(std::memory_order_relaxed) + event->getContentSize(),
+                          std::memory_order_relaxed);
+        }
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::atomic<uint64_t> m_bytes{0};
+
+private:
+    bool m_format;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "config.h"
+#include "log.h"
+#include "thread.h"
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+#include <yaml-cpp/yaml.h>
+
+static const char *s_file = "async_test.txt";
+static const int s_threads = 4;
+static const int s_lines = 100000;
+static const char *s_missing_dir = "async_test_missing";
+
+static int count_lines(const std::string &file) {
+    std::ifstream in(file);
+    std::string line;
+    int count = 0;
+    while (std::getline(in, line)) {
+        ++count;
+    }
+    return count;
+}
+
+// 目录不存在时丢弃并计数，目录建好后下一次刷盘重新打开文件
+static bool test_open_retry() {
+    std::error_code ec;
+    std::filesystem::remove_all(s_missing_dir, ec);
+    std::string file = std::string(s_missing_dir) + "/async.txt";
+    lsh::AsyncLogWriter writer(file, 4096, 4, lsh::AsyncLogWriter::BLOCK, 20);
+    std::string line = "lost line\n";
+    for (int i = 0; i < 10; i++) {
+        writer.append(line.data(), line.size());
+    }
+    for (int i = 0; i < 100 && writer.getDropped() < 10; i++) {
+        usleep(10 * 1000);
+    }
+    bool ok = writer.getDropped() == 10;
+
+    std::filesystem::create_directory(s_missing_dir, ec);
+    line = "kept line\n";
+    for (int i = 0; i < 5; i++) {
+        writer.append(line.data(), line.size());
+    }
+    writer.stop();
+    ok = ok && writer.getDropped() == 10 && count_lines(file) == 5;
+    std::filesystem::remove_all(s_missing_dir, ec);
+    std::cout << "open retry " << (ok ? "ok" : "failed") << std::endl;
+    return ok;
+}
+
+void write_log() {
+    auto logger = LSH_LOG_NAME("async");
+    for (int i = 0; i < s_lines; i++) {
+        LSH_LOG_INFO(logger) << "async log line " << i;
+    }
+}
+
+int main(int argc, char **argv) {
+    remove(s_file);
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "    - name: async\n"
+        "      level: info\n"
+        "      formatter: \"%d%T%t%T%m%n\"\n"
+        "      appender:\n"
+        "          - type: FileLogAppender\n"
+        "            file: async_test.txt\n"
+        "            async: true\n"
+        "            buffer_size: 65536\n"
+        "            max_buffers: 4\n"
+        "            overflow: block\n"
+        "            flush_interval: 100\n");
+    lsh::Config::LoadFromYaml(root);
+    std::cout << LSH_LOG_NAME("async")->toYamlString() << std::endl;
+
+    uint64_t begin = lsh::GetCurrentMS();
+    std::vector<lsh::Thread::ptr> threads;
+    for (int i = 0; i < s_threads; i++) {
+        threads.push_back(std::make_shared<lsh::Thread>(&write_log, "async_" + std::to_string(i)));
+    }
+    for (auto &t : threads) {
+        t->join();
+    }
+    uint64_t end = lsh::GetCurrentMS();
+
+    // 清空 appender 会析构 FileLogAppender，把剩余的日志写完
+    LSH_LOG_NAME("async")->clearAppenders();
+
+    int count = count_lines(s_file);
+    std::cout << "write " << s_threads * s_lines << " lines in " << end - begin
+              << " ms, file has " << count << " lines" << std::endl;
+    bool ok = count == s_threads * s_lines;
+    ok = test_open_retry() && ok;
+    return ok ? 0 : 1;
+}
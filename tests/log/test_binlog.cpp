@@ -0,0 +1,146 @@
+#include "binlog.h"
+#include "config.h"
+#include "log.h"
+#include "thread.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <yaml-cpp/yaml.h>
+
+static const char *s_bin_file = "binlog_test.bin";
+static const char *s_text_file = "binlog_test.txt";
+static const int s_threads = 2;
+static const int s_lines = 10000;
+
+static lsh::Mutex s_mutex;
+static std::vector<std::string> s_expected;
+
+// 同样的参数用 snprintf 格式化一遍，作为期望的输出
+template <class... Args>
+static void expect(const char *fmt, Args... args) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), fmt, args...);
+    lsh::Mutex::Lock lock(s_mutex);
+    s_expected.push_back(buf);
+}
+
+#define LOG_AND_EXPECT(logger, fmt, ...)               \
+    do {                                               \
+        LSH_LOG_FMT_INFO(logger, fmt, __VA_ARGS__);    \
+        expect(fmt, __VA_ARGS__);                      \
+    } while (0)
+
+void write_log() {
+    auto logger = LSH_LOG_NAME("binlog");
+    const char *name = lsh::Thread::GetName().c_str();
+    for (int i = 0; i < s_lines; i++) {
+        LOG_AND_EXPECT(logger, "%s line %d value=%.3f hex=%#x", name, i, i * 0.5, i);
+        LOG_AND_EXPECT(logger, "[%-8s] %5u %c %lld %hhd %%", "pad", (unsigned)i, 'a' + i % 26, -1LL * i, i);
+        LOG_AND_EXPECT(logger, "%.*s|%*d|%p", 3, "truncate", 6, i, (void *)(uintptr_t)(i * 16));
+    }
+}
+
+static std::vector<std::string> read_lines(const std::string &text) {
+    std::vector<std::string> lines;
+    size_t begin = 0;
+    for (size_t pos; (pos = text.find('\n', begin)) != std::string::npos; begin = pos + 1) {
+        lines.push_back(text.substr(begin, pos - begin));
+    }
+    return lines;
+}
+
+static bool check(const char *what, std::vector<std::string> lines) {
+    std::vector<std::string> expected;
+    {
+        lsh::Mutex::Lock lock(s_mutex);
+        expected.swap(s_expected);
+    }
+    // 跨线程的记录不保证时间顺序，排序后比较
+    std::sort(lines.begin(), lines.end());
+    std::sort(expected.begin(), expected.end());
+    bool ok = lines == expected;
+    std::cout << what << ": " << lines.size() << " lines, expected " << expected.size()
+              << (ok ? " OK" : " MISMATCH") << std::endl;
+    return ok;
+}
+
+static void run_threads() {
+    std::vector<lsh::Thread::ptr> threads;
+    for (int i = 0; i < s_threads; i++) {
+        threads.push_back(std::make_shared<lsh::Thread>(&write_log, "binlog_" + std::to_string(i)));
+    }
+    for (auto &t : threads) {
+        t->join();
+    }
+    lsh::BinLogMgr::GetInstance()->flush();
+}
+
+int main(int argc, char **argv) {
+    // 环形缓冲区开得足够大，测试中不应该有丢弃
+    remove(s_bin_file);
+    remove(s_text_file);
+    YAML::Node root = YAML::Load(
+        "log:\n"
+        "    binary:\n"
+        "        file: binlog_test.bin\n"
+        "        ring_size: 8388608\n"
+        "logs:\n"
+        "    - name: binlog\n"
+        "      level: info\n"
+        "      binary: true\n"
+        "      formatter: \"%m%n\"\n"
+        "      appender:\n"
+        "          - type: FileLogAppender\n"
+        "            file: binlog_test.txt\n");
+    lsh::Config::LoadFromYaml(root);
+    std::cout << LSH_LOG_NAME("binlog")->toYamlString() << std::endl;
+
+    // 1. 写二进制文件，再用 BinLogDecoder 离线还原
+    run_threads();
+    std::ifstream in(s_bin_file, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    lsh::BinLogDecoder decoder;
+    lsh::LogFormatter formatter("%m%n");
+    std::string text;
+    for (size_t pos = 8; pos + sizeof(lsh::BinEntryHeader) <= data.size();) {
+        uint32_t size;
+        memcpy(&size, data.data() + pos, sizeof(size));
+        if (auto event = decoder.decode(data.data() + pos, size)) {
+            formatter.format(text, event->getLogger(), event->getLevel(), event);
+        }
+        pos += size;
+    }
+    bool ok = check("offline decode", read_lines(text));
+
+    // 2. 不写文件，由后台线程格式化后交给 logger 的 appender
+    lsh::Config::Lookup<std::string>("log.binary.file")->setValue("");
+    run_threads();
+    LSH_LOG_NAME("binlog")->clearAppenders();
+    std::ifstream txt(s_text_file);
+    text.assign((std::istreambuf_iterator<char>(txt)), std::istreambuf_iterator<char>());
+    ok = check("background format", read_lines(text)) && ok;
+
+    // 3. C 字符串对应 %s 以外的转换：二进制记录只有字符串内容，这样的调用点走文本路径，
+    //    输出和 printf 一致；宏放在不带花括号的 if/else 里
+    remove(s_text_file);
+    auto logger = LSH_LOG_NAME("binlog");
+    logger->addAppender(std::make_shared<lsh::FileLogAppender>(s_text_file));
+    const char *name = "mismatch";
+    for (int i = 0; i < 2; i++) {
+        if (i == 0)
+            LSH_LOG_FMT_INFO(logger, "addr=%p len=%d", name, i);
+        else
+            LSH_LOG_FMT_INFO(logger, "%s at %p", name, name);
+    }
+    expect("addr=%p len=%d", name, 0);
+    expect("%s at %p", name, name);
+    lsh::BinLogMgr::GetInstance()->flush();
+    logger->clearAppenders();
+    std::ifstream mismatch(s_text_file);
+    text.assign((std::istreambuf_iterator<char>(mismatch)), std::istreambuf_iterator<char>());
+    ok = check("string with non-%s conversion", read_lines(text)) && ok;
+
+    std::cout << "dropped " << lsh::BinLogMgr::GetInstance()->getDropped() << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+#include "config.h"
+#include "log.h"
+#include "thread.h"
+#include "util.h"
+
+static lsh::ConfigVar<int>::ptr g_port =
+    lsh::Config::Creat(LSH_CONFIG_KEY("key.server.port"), (int)8080, "port");
+static lsh::ConfigVar<std::vector<int>>::ptr g_list =
+    lsh::Config::Creat("key.server.list", std::vector<int>{1, 2, 3}, "list");
+
+static_assert(lsh::ConfigKeyHash("key.server.port") == decltype(LSH_CONFIG_KEY("key.server.port"))::hash);
+static_assert(!std::is_same_v<decltype(LSH_CONFIG_KEY("a.b")), decltype(LSH_CONFIG_KEY("a.c"))>);
+
+template <class F>
+static double bench(int n, F f) {
+    uint64_t begin = lsh::GetCurrentUS();
+    for (int i = 0; i < n; i++) {
+        f();
+    }
+    return (lsh::GetCurrentUS() - begin) * 1000.0 / n;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+
+    // 和按字符串查找得到的是同一个配置项，包括用字符串 Creat 的
+    ok = ok && lsh::Config::Lookup<int>(LSH_CONFIG_KEY("key.server.port")) == g_port;
+    ok = ok && lsh::Config::Lookup<std::vector<int>>(LSH_CONFIG_KEY("key.server.list")) == g_list;
+    ok = ok && lsh::Config::Lookup<int>(LSH_CONFIG_KEY("tcp.connect.timeout"))->getValue() == 5000;
+    g_port->setValue(9090);
+    ok = ok && lsh::Config::Lookup<int>(LSH_CONFIG_KEY("key.server.port"))->getValue() == 9090;
+
+    // 类型不对、还没有注册时返回空；注册之后能查到
+    ok = ok && !lsh::Config::Lookup<float>(LSH_CONFIG_KEY("key.server.port"));
+    ok = ok && !lsh::Config::Lookup<int>(LSH_CONFIG_KEY("key.late"));
+    lsh::Config::Creat("key.late", (int)7, "registered after first lookup");
+    ok = ok && lsh::Config::Lookup<int>(LSH_CONFIG_KEY("key.late"))->getValue() == 7;
+    std::cout << "lookup ok=" << ok << std::endl;
+
+    // 多个线程第一次同时查找
+    std::atomic<int> found{0};
+    std::vector<lsh::Thread::ptr> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back(new lsh::Thread([&found]() {
+            for (int i = 0; i < 1000; i++) {
+                if (lsh::Config::Lookup<std::string>(LSH_CONFIG_KEY("key.concurrent"))) {
+                    ++found;
+                    return;
+                }
+            }
+        }, "config_key_" + std::to_string(t)));
+    }
+    lsh::Config::Creat("key.concurrent", std::string("x"), "concurrent");
+    for (auto &t : threads) {
+        t->join();
+    }
+    ok = ok && lsh::Config::Lookup<std::string>(LSH_CONFIG_KEY("key.concurrent"))->getValue() == "x";
+    std::cout << "concurrent resolve found=" << found << " ok=" << ok << std::endl;
+
+    const int n = 1000000;
+    volatile int sink = 0;
+    std::cout << "Lookup<int>(string):         " << bench(n, [&]() {
+        sink = lsh::Config::Lookup<int>("key.server.port")->get();
+    }) << " ns/op" << std::endl;
+    std::cout << "Lookup<int>(LSH_CONFIG_KEY): " << bench(n, [&]() {
+        sink = lsh::Config::Lookup<int>(LSH_CONFIG_KEY("key.server.port"))->get();
+    }) << " ns/op" << std::endl;
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
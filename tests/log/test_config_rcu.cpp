@@ -0,0 +1,81 @@
+#include "config.h"
+#include "log.h"
+#include "thread.h"
+#include "util.h"
+
+static lsh::ConfigVar<int>::ptr g_int =
+    lsh::Config::Creat("test.rcu.int", (int)1, "rcu int");
+static lsh::ConfigVar<std::vector<int>>::ptr g_vec =
+    lsh::Config::Creat("test.rcu.vec", std::vector<int>(100, 0), "rcu vector");
+
+template <class F>
+static double bench(int n, F f) {
+    uint64_t begin = lsh::GetCurrentUS();
+    for (int i = 0; i < n; i++) {
+        f();
+    }
+    return (lsh::GetCurrentUS() - begin) * 1000.0 / n;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+
+    // 快照在值变化后仍然是旧值，get() 看到新值
+    std::shared_ptr<const std::vector<int>> snapshot = g_vec->getSnapshot();
+    const std::vector<int> &before = g_vec->get();
+    ok = ok && &before == snapshot.get();
+    g_vec->setValue(std::vector<int>(100, 7));
+    ok = ok && (*snapshot)[0] == 0 && g_vec->get()[99] == 7 && g_vec->getValue()[0] == 7;
+    ok = ok && g_vec->toString().find("7") != std::string::npos;
+
+    // 监听器看到旧值和新值（新值已经发布），相同的值不触发
+    int notified = 0;
+    g_int->addListener(1, [&](const int &old_value, const int &new_value) {
+        ok = ok && old_value == 1 && new_value == 2 && g_int->getValue() == 2;
+        ++notified;
+    });
+    g_int->setValue(2);
+    g_int->setValue(2);
+    ok = ok && notified == 1 && g_int->getValue() == 2;
+    g_int->clearListener();
+
+    // 多个线程不停读，一个线程不停写：每次读到的 vector 一定是某一次 setValue 的完整值
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<bool> torn{false};
+    std::vector<lsh::Thread::ptr> readers;
+    for (int t = 0; t < 3; t++) {
+        readers.emplace_back(new lsh::Thread([&]() {
+            uint64_t n = 0;
+            int last = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                const std::vector<int> &v = g_vec->get();
+                if (v.size() != 100 || v.front() != v.back() || v.front() < last) {
+                    torn = true;
+                }
+                last = v.front();
+                ++n;
+            }
+            reads += n;
+        }, "rcu_reader_" + std::to_string(t)));
+    }
+    for (int k = 8; k < 2000; k++) {
+        g_vec->setValue(std::vector<int>(100, k));
+    }
+    stop = true;
+    for (auto &r : readers) {
+        r->join();
+    }
+    std::cout << "concurrent reads=" << reads << " torn=" << torn << std::endl;
+    ok = ok && !torn && g_vec->get()[50] == 1999;
+
+    const int n = 1000000;
+    volatile int sink = 0;
+    std::cout << "int getValue:        " << bench(n, [&]() { sink = g_int->getValue(); }) << " ns/op" << std::endl;
+    std::cout << "vector get:          " << bench(n, [&]() { sink = g_vec->get()[1]; }) << " ns/op" << std::endl;
+    std::cout << "vector getSnapshot:  " << bench(n, [&]() { sink = (*g_vec->getSnapshot())[1]; }) << " ns/op" << std::endl;
+    std::cout << "vector getValue copy: " << bench(n, [&]() { sink = g_vec->getValue()[1]; }) << " ns/op" << std::endl;
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+#include "config.h"
+#include "log.h"
+#include "util.h"
+#include <filesystem>
+#include <fstream>
+
+// 大配置的冷启动：完整解析 YAML 和加载二进制快照的耗时对比，并检查两者结果一致
+
+static const int s_services = 500;
+
+static void Register() {
+    for (int i = 0; i < s_services; i++) {
+        std::string prefix = "snap.svc" + std::to_string(i);
+        lsh::Config::Creat(prefix + ".port", (int)0, "port");
+        lsh::Config::Creat(prefix + ".ratio", (double)0, "ratio");
+        lsh::Config::Creat(prefix + ".hosts", std::vector<std::string>(), "hosts");
+        lsh::Config::Creat(prefix + ".limits", std::map<std::string, std::vector<int>>(), "limits");
+        lsh::Config::Creat(prefix + ".tags", std::set<std::string>(), "tags");
+    }
+}
+
+// seed 不同，生成的值不同
+static std::string MakeYaml(int seed) {
+    std::stringstream ss;
+    ss << "snap:\n";
+    for (int i = 0; i < s_services; i++) {
+        ss << "  svc" << i << ":\n";
+        ss << "    port: " << 8000 + i + seed << "\n";
+        ss << "    ratio: " << i * 0.25 + seed << "\n";
+        ss << "    hosts: [";
+        for (int h = 0; h < 8; h++) {
+            ss << (h ? ", " : "") << "host" << h << "-" << seed << ".example.com";
+        }
+        ss << "]\n    limits:\n";
+        for (int l = 0; l < 4; l++) {
+            ss << "      l" << l << ": [" << l << ", " << l + seed << ", " << l * 10 << "]\n";
+        }
+        ss << "    tags: [a" << seed << ", b, c, d]\n";
+    }
+    ss << "logs:\n  - name: snap_logger\n    level: " << (seed ? "error" : "warn") << "\n";
+    ss << "    appender:\n      - type: StdoutLogAppender\n";
+    return ss.str();
+}
+
+static std::map<std::string, std::string> DumpAll() {
+    std::map<std::string, std::string> values;
+    lsh::Config::Visit([&values](lsh::ConfigVarBase::ptr var) {
+        values[var->getName()] = var->toString();
+    });
+    return values;
+}
+
+static void WriteFile(const std::string &path, const std::string &content) {
+    std::ofstream(path, std::ios::trunc) << content;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    LSH_LOG_NAME("system")->setLevel(lsh::LogLevel::WARN);
+    Register();
+    std::string dir = "/tmp/lsh_config_snapshot_" + std::to_string(getpid());
+    std::filesystem::create_directories(dir);
+    std::string file = dir + "/app.yml";
+    std::string snapshot = dir + "/app.snapshot";
+    WriteFile(file, MakeYaml(0));
+    YAML::Node other = YAML::Load(MakeYaml(1));
+
+    // 每次测量前先加载另一份值，保证被测的一次真的改变了所有配置项
+    auto measure = [&](auto f) {
+        lsh::Config::LoadFromYaml(other);
+        uint64_t begin = lsh::GetCurrentUS();
+        f();
+        return (lsh::GetCurrentUS() - begin) / 1000.0;
+    };
+
+    double yaml_ms = measure([&]() { lsh::Config::LoadFromYaml(YAML::LoadFile(file)); });
+    std::map<std::string, std::string> expected = DumpAll();
+
+    bool from_snapshot = true;
+    double first_ms = measure([&]() { ok = ok && lsh::Config::LoadFromYamlCached({file}, snapshot, &from_snapshot); });
+    ok = ok && !from_snapshot && DumpAll() == expected && std::filesystem::exists(snapshot);
+
+    double snapshot_ms = measure([&]() { ok = ok && lsh::Config::LoadFromYamlCached({file}, snapshot, &from_snapshot); });
+    ok = ok && from_snapshot && DumpAll() == expected;
+    ok = ok && lsh::Config::Lookup<int>("snap.svc7.port")->getValue() == 8007 &&
+         lsh::Config::Lookup<std::map<std::string, std::vector<int>>>("snap.svc3.limits")->getValue().at("l2")[1] == 2 &&
+         LSH_LOG_NAME("snap_logger")->getLevel() == lsh::LogLevel::WARN;
+    // 快照里的 logs 也要能还原出 appender
+    std::shared_ptr<const lsh::Logger::AppenderList> appenders = LSH_LOG_NAME("snap_logger")->getAppenders();
+    ok = ok && appenders->size() == 1 && std::dynamic_pointer_cast<lsh::StdoutLogAppender>(appenders->front());
+
+    std::cout << "config: " << std::filesystem::file_size(file) / 1024 << "KB yaml, "
+              << std::filesystem::file_size(snapshot) / 1024 << "KB snapshot" << std::endl;
+    std::cout << "YAML::LoadFile + LoadFromYaml: " << yaml_ms << " ms" << std::endl;
+    std::cout << "first boot (parse + save):     " << first_ms << " ms" << std::endl;
+    std::cout << "snapshot boot (mmap):          " << snapshot_ms << " ms" << std::endl;
+    std::cout << "snapshot ok=" << ok << std::endl;
+
+    // YAML 改了：快照过期，完整解析后重新生成
+    WriteFile(file, MakeYaml(2));
+    ok = ok && lsh::Config::LoadFromYamlCached({file}, snapshot, &from_snapshot) && !from_snapshot;
+    ok = ok && lsh::Config::Lookup<int>("snap.svc7.port")->getValue() == 8009;
+    ok = ok && lsh::Config::LoadFromYamlCached({file}, snapshot, &from_snapshot) && from_snapshot;
+    std::cout << "stale snapshot ok=" << ok << std::endl;
+
+    // YAML 里没有的配置项不进快照：新程序换了默认值（或者加载前被覆盖）不会被快照改回旧值
+    auto tuning = lsh::Config::Creat("snap.tuning", (int)5, "not mentioned by the yaml");
+    ok = ok && lsh::Config::LoadFromYamlCached({file}, snapshot, &from_snapshot) && !from_snapshot;
+    tuning->setValue(7);
+    ok = ok && lsh::Config::LoadFromYamlCached({file}, snapshot, &from_snapshot) && from_snapshot;
+    ok = ok && tuning->getValue() == 7 && lsh::Config::Lookup<int>("snap.svc7.port")->getValue() == 8009;
+    std::cout << "default not baked ok=" << ok << std::endl;
+
+    // 快照被截断：什么都不改，回退到完整解析
+    std::filesystem::resize_file(snapshot, std::filesystem::file_size(snapshot) / 2);
+    ok = ok && !lsh::Config::LoadSnapshot(snapshot, 0);
+    lsh::Config::LoadFromYaml(other);
+    ok = ok && lsh::Config::LoadFromYamlCached({file}, snapshot, &from_snapshot) && !from_snapshot;
+    ok = ok && lsh::Config::Lookup<int>("snap.svc7.port")->getValue() == 8009;
+    // 注册了新的配置项：旧快照不能再用
+    lsh::Config::Creat("snap.added", (int)1, "registered after the snapshot was taken");
+    ok = ok && lsh::Config::LoadFromYamlCached({file}, snapshot, &from_snapshot) && !from_snapshot;
+    // 文件不存在
+    ok = ok && !lsh::Config::LoadFromYamlCached({dir + "/missing.yml"}, snapshot);
+    std::cout << "fallback ok=" << ok << std::endl;
+
+    std::filesystem::remove_all(dir);
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,238 @@
+#include "config.h"
+#include "fiber.h"
+#include "log.h"
+#include "scheduler.h"
+#include "util.h"
+#include <unistd.h>
+
+static lsh::ConfigVar<int>::ptr g_port =
+    lsh::Config::Creat("txn.server.port", (int)80, "port");
+static lsh::ConfigVar<std::string>::ptr g_host =
+    lsh::Config::Creat("txn.server.host", std::string("localhost"), "host");
+static lsh::ConfigVar<std::vector<int>>::ptr g_backlog =
+    lsh::Config::Creat("txn.server.backlog", std::vector<int>{128}, "backlog");
+static lsh::ConfigVar<bool>::ptr g_keepalive =
+    lsh::Config::Creat("txn.server.keepalive", false, "keepalive");
+static lsh::ConfigVar<int>::ptr g_other =
+    lsh::Config::Creat("txn.other", (int)0, "outside of txn.server");
+static lsh::ConfigVar<int>::ptr g_thread_slow =
+    lsh::Config::Creat("txn.thread.slow", (int)0, "listener blocks another thread's commit");
+static lsh::ConfigVar<int>::ptr g_thread_fast =
+    lsh::Config::Creat("txn.thread.fast", (int)0, "committed while slow notifies");
+static lsh::ConfigVar<int>::ptr g_yield_a =
+    lsh::Config::Creat("txn.yield.a", (int)0, "listener yields");
+static lsh::ConfigVar<int>::ptr g_yield_b =
+    lsh::Config::Creat("txn.yield.b", (int)0, "committed while a yields");
+
+int main(int argc, char **argv) {
+    bool ok = true;
+
+    // 每个配置项的监听器在一次提交里只通知一次，回调里看到的其它配置项已经是新值
+    int port_notified = 0;
+    int host_notified = 0;
+    g_port->addListener(1, [&](const int &old_value, const int &new_value) {
+        ++port_notified;
+        ok = ok && old_value == 80 && new_value == 8082 && g_host->getValue() == "example.com";
+    });
+    g_host->addListener(1, [&](const std::string &, const std::string &) {
+        ++host_notified;
+        ok = ok && g_port->getValue() == 8082;
+    });
+    int batches = 0;
+    std::vector<std::string> last_batch;
+    lsh::Config::AddBatchListener(1, "txn.server.", [&](const std::vector<std::string> &changed) {
+        ++batches;
+        last_batch = changed;
+    });
+
+    {
+        lsh::Config::Transaction trx;
+        ok = ok && trx.set(g_port, 8080);
+        ok = ok && trx.set("txn.server.host", std::string("example.com"));
+        ok = ok && trx.setString("txn.server.port", "8081");
+        ok = ok && trx.setNode("txn.server.port", YAML::Load("8082"));
+        ok = ok && trx.set(g_other, 1);
+        ok = ok && trx.size() == 3;
+        // 提交前不可见
+        ok = ok && g_port->getValue() == 80 && g_host->getValue() == "localhost";
+        ok = ok && trx.commit() && trx.size() == 0;
+    }
+    ok = ok && port_notified == 1 && host_notified == 1 && batches == 1;
+    ok = ok && last_batch == std::vector<std::string>{"txn.server.port", "txn.server.host"};
+    g_host->deleteListener(1);
+    std::cout << "coalesced commit ok=" << ok << std::endl;
+
+    // 校验失败或者类型不对：整个事务作废，什么都不改，不通知
+    g_port->setValidator([](const int &v) { return v > 0 && v < 65536; });
+    {
+        lsh::Config::Transaction trx;
+        trx.set("txn.server.host", std::string("rejected.com"));
+        ok = ok && !trx.set(g_port, 70000) && trx.failed();
+        ok = ok && !trx.commit();
+    }
+    {
+        lsh::Config::Transaction trx;
+        trx.set(g_port, 9000);
+        ok = ok && !trx.set("txn.server.host", 1) && !trx.setString("txn.no.such", "1");
+        ok = ok && !trx.commit();
+    }
+    ok = ok && !g_port->setValue(0);
+    ok = ok && g_port->getValue() == 8082 && g_host->getValue() == "example.com";
+    ok = ok && port_notified == 1 && batches == 1;
+    std::cout << "rejected txn ok=" << ok << std::endl;
+
+    // 没有变化的值不通知；单独 setValue 相当于一个配置项的事务
+    {
+        lsh::Config::Transaction trx;
+        trx.set(g_port, 8082);
+        ok = ok && trx.commit();
+    }
+    ok = ok && g_backlog->setValue({256});
+    ok = ok && port_notified == 1 && batches == 2 && last_batch == std::vector<std::string>{"txn.server.backlog"};
+
+    // 回调里可以再修改别的配置项（嵌套提交）
+    g_other->addListener(1, [](const int &, const int &new_value) {
+        g_backlog->setValue({new_value});
+    });
+    g_other->setValue(512);
+    ok = ok && g_backlog->getValue() == std::vector<int>{512};
+    std::cout << "nested commit ok=" << ok << std::endl;
+
+    // 回调抛出非 std::exception 的异常：这一批的其它通知照常，之后的提交也照常通知
+    g_other->addListener(1, [](const int &, const int &) { throw 42; });
+    int after_throw = 0;
+    g_backlog->addListener(1, [&](const std::vector<int> &, const std::vector<int> &) { ++after_throw; });
+    {
+        lsh::Config::Transaction trx;
+        trx.set(g_other, 1);
+        trx.set(g_backlog, std::vector<int>{1});
+        ok = ok && trx.commit();
+    }
+    ok = ok && g_backlog->setValue({2}) && after_throw == 2;
+    g_other->deleteListener(1);
+    g_backlog->deleteListener(1);
+    std::cout << "throwing listener ok=" << ok << std::endl;
+
+    // 另一个线程正在通知时 setValue：排在它后面，但等自己的监听器跑完才返回
+    {
+        std::atomic<bool> slow_entered{false};
+        std::atomic<bool> fast_notified{false};
+        g_thread_slow->addListener(1, [&](const int &, const int &) {
+            slow_entered = true;
+            usleep(100 * 1000);
+        });
+        g_thread_fast->addListener(1, [&](const int &, const int &) { fast_notified = true; });
+        lsh::Thread slow([]() { g_thread_slow->setValue(1); }, "config_slow");
+        while (!slow_entered) {
+            usleep(1000);
+        }
+        g_thread_fast->setValue(1);
+        ok = ok && fast_notified;
+        slow.join();
+        g_thread_slow->deleteListener(1);
+        g_thread_fast->deleteListener(1);
+    }
+    std::cout << "other thread notifying ok=" << ok << std::endl;
+
+    // 多个文档里同一个配置项出现多次，只通知一次
+    port_notified = 0;
+    g_port->addListener(1, [&](const int &old_value, const int &new_value) {
+        ++port_notified;
+        ok = ok && old_value == 8082 && new_value == 9002;
+    });
+    std::vector<YAML::Node> docs{YAML::Load("txn: {server: {port: 9001}}"),
+                                 YAML::Load("txn: {server: {port: 9002, host: a.com}}")};
+    ok = ok && lsh::Config::LoadFromYamlAtomic(docs) && port_notified == 1 && g_port->getValue() == 9002;
+    // LoadFromYaml 跳过转换失败的项，其余照常提交
+    lsh::Config::LoadFromYaml(YAML::Load("txn: {server: {port: bad, host: b.com}}"));
+    ok = ok && g_port->getValue() == 9002 && g_host->getValue() == "b.com";
+    // bool 接受 YAML 的 true/false、yes/no、on/off，也接受 1/0
+    lsh::Config::LoadFromYaml(YAML::Load("txn: {server: {keepalive: true}}"));
+    ok = ok && g_keepalive->getValue();
+    lsh::Config::LoadFromYaml(YAML::Load("txn: {server: {keepalive: Off}}"));
+    ok = ok && !g_keepalive->getValue();
+    lsh::Config::LoadFromYaml(YAML::Load("txn: {server: {keepalive: 1}}"));
+    ok = ok && g_keepalive->getValue();
+    lsh::Config::LoadFromYaml(YAML::Load("txn: {server: {keepalive: maybe}}"));
+    ok = ok && g_keepalive->getValue();
+    std::cout << "yaml load ok=" << ok << std::endl;
+
+    // logs 重新加载时只重建变化了的 logger，没变化的保持原样
+    lsh::Config::LoadFromYaml(YAML::Load("logs: [{name: txn_a, level: info}, {name: txn_b, level: info}]"));
+    lsh::Config::LoadFromYaml(YAML::Load("logs: [{name: txn_a, level: info}, {name: txn_b, level: error}]"));
+    ok = ok && LSH_LOG_NAME("txn_a")->getLevel() == lsh::LogLevel::INFO &&
+         LSH_LOG_NAME("txn_b")->getLevel() == lsh::LogLevel::ERROR;
+    std::cout << "logs reload ok=" << ok << std::endl;
+
+    // 同步回调里让出协程：同一线程上的其它协程照常提交，新值立即可见，
+    // 它的通知排在正在执行的这一批之后，不会插进让出的回调中间
+    {
+        lsh::Scheduler sc(1, false, "config_yield");
+        sc.start();
+        std::vector<std::string> order;
+        lsh::Mutex order_mutex;
+        std::atomic<int> done{0};
+        g_yield_a->addListener(1, [&](const int &, const int &) {
+            {
+                lsh::Mutex::Lock lock(order_mutex);
+                order.push_back("a begin");
+            }
+            for (int i = 0; i < 10; i++) {
+                lsh::Fiber::YieldToReady();
+            }
+            lsh::Mutex::Lock lock(order_mutex);
+            order.push_back("a end");
+        });
+        g_yield_b->addListener(1, [&](const int &, const int &) {
+            lsh::Mutex::Lock lock(order_mutex);
+            order.push_back("b");
+        });
+        sc.schedule([&]() {
+            g_yield_a->setValue(1);
+            ++done;
+        });
+        sc.schedule([&]() {
+            g_yield_b->setValue(1);
+            ok = ok && g_yield_b->getValue() == 1;
+            ++done;
+        });
+        for (int i = 0; i < 300 && done != 2; i++) {
+            usleep(10 * 1000);
+        }
+        sc.stop();
+        ok = ok && done == 2 && order == std::vector<std::string>{"a begin", "a end", "b"};
+        g_yield_a->deleteListener(1);
+        g_yield_b->deleteListener(1);
+    }
+    std::cout << "yielding listener ok=" << ok << std::endl;
+
+    // 异步回调：放到调度器的线程上执行，提交者不等待
+    {
+        lsh::Scheduler sc(1, false, "config_txn");
+        sc.start();
+        std::atomic<int> async_notified{0};
+        std::atomic<int> async_batches{0};
+        std::atomic<bool> other_thread{false};
+        pid_t main_tid = lsh::GetThreadId();
+        g_host->addListener(2, [&](const std::string &old_value, const std::string &new_value) {
+            other_thread = lsh::GetThreadId() != main_tid && old_value == "b.com" && new_value == "async.com";
+            ++async_notified;
+        }, &sc);
+        lsh::Config::AddBatchListener(2, "txn.", [&](const std::vector<std::string> &changed) {
+            ++async_batches;
+        }, &sc);
+        g_host->setValue("async.com");
+        for (int i = 0; i < 300 && (async_notified == 0 || async_batches == 0); i++) {
+            usleep(10 * 1000);
+        }
+        ok = ok && async_notified == 1 && async_batches == 1 && other_thread;
+        g_host->deleteListener(2);
+        lsh::Config::DelBatchListener(2);
+        sc.stop();
+    }
+    std::cout << "async listener ok=" << ok << std::endl;
+
+    lsh::Config::DelBatchListener(1);
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+#include "IOManager.h"
+#include "config.h"
+#include "config_watcher.h"
+#include "log.h"
+#include "util.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+static lsh::ConfigVar<int>::ptr g_port =
+    lsh::Config::Creat("watch.port", (int)0, "watched port");
+static lsh::ConfigVar<std::string>::ptr g_name =
+    lsh::Config::Creat("watch.name", std::string(""), "watched name");
+static lsh::ConfigVar<std::vector<int>>::ptr g_list =
+    lsh::Config::Creat("watch.list", std::vector<int>(), "watched list");
+
+// 像编辑器一样先写临时文件再 rename
+static void write_file(const std::string &path, const std::string &content) {
+    std::string tmp = path + ".tmp";
+    std::ofstream(tmp, std::ios::trunc) << content;
+    rename(tmp.c_str(), path.c_str());
+}
+
+template <class F>
+static bool wait_for(F f, uint64_t ms = 3000) {
+    uint64_t deadline = lsh::GetCurrentMS() + ms;
+    while (!f()) {
+        if (lsh::GetCurrentMS() > deadline) {
+            return false;
+        }
+        usleep(10 * 1000);
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    LSH_LOG_NAME("system")->setLevel(lsh::LogLevel::WARN);
+    char dir_template[] = "/tmp/lsh_config_watch_XXXXXX";
+    std::string dir = mkdtemp(dir_template);
+    std::string file = dir + "/app.yml";
+    write_file(file, "watch:\n  port: 1\n  name: first\n  list: [1, 2]\n");
+
+    std::atomic<int> notified{0};
+    g_port->addListener(1, [&](const int &old_value, const int &new_value) {
+        ++notified;
+    });
+
+    lsh::IOManager iom(2, false, "config_watch");
+    lsh::ConfigWatcher::ptr watcher(new lsh::ConfigWatcher(&iom, 100));
+    ok = ok && watcher->addPath(dir) && watcher->start();
+    ok = ok && watcher->reload() && g_port->getValue() == 1 && g_name->getValue() == "first";
+    std::cout << "initial load ok=" << ok << std::endl;
+
+    // 修改后自动加载，回调照常触发
+    write_file(file, "watch:\n  port: 2\n  name: second\n  list: [3]\n");
+    ok = ok && wait_for([]() { return g_port->getValue() == 2; });
+    ok = ok && g_name->getValue() == "second" && g_list->getValue() == std::vector<int>{3} && notified == 2;
+    std::cout << "reload after change ok=" << ok << " reloads=" << watcher->getReloadCount() << std::endl;
+
+    // 连续快速保存：防抖之后只加载最后的内容
+    uint64_t reloads = watcher->getReloadCount();
+    for (int i = 3; i <= 10; i++) {
+        write_file(file, "watch:\n  port: " + std::to_string(i) + "\n  name: burst\n");
+        usleep(5 * 1000);
+    }
+    ok = ok && wait_for([]() { return g_port->getValue() == 10; });
+    usleep(300 * 1000);
+    std::cout << "burst of 8 writes -> " << watcher->getReloadCount() - reloads << " reload(s)" << std::endl;
+    ok = ok && watcher->getReloadCount() - reloads <= 2;
+
+    // 有一个配置项转换失败时整批拒绝：name 也不会变
+    uint64_t rejects = watcher->getRejectCount();
+    write_file(file, "watch:\n  port: not_a_number\n  name: rejected\n");
+    ok = ok && wait_for([&]() { return watcher->getRejectCount() > rejects; });
+    ok = ok && g_port->getValue() == 10 && g_name->getValue() == "burst";
+    // YAML 本身有语法错误也一样
+    write_file(file, "watch: [unclosed\n");
+    ok = ok && wait_for([&]() { return watcher->getRejectCount() > rejects + 1; });
+    ok = ok && g_port->getValue() == 10;
+    std::cout << "rejected bad config ok=" << ok << " rejects=" << watcher->getRejectCount() << std::endl;
+
+    // 目录里新增的 yml 文件按文件名排序加载，后面的覆盖前面的；无关文件不触发
+    uint64_t before = watcher->getReloadCount();
+    write_file(dir + "/notes.txt", "port: 99\n");
+    usleep(300 * 1000);
+    ok = ok && watcher->getReloadCount() == before;
+    write_file(file, "watch:\n  port: 11\n  name: base\n");
+    write_file(dir + "/zz_override.yaml", "watch:\n  name: override\n");
+    ok = ok && wait_for([]() { return g_port->getValue() == 11 && g_name->getValue() == "override"; });
+    std::cout << "directory ok=" << ok << std::endl;
+
+    watcher->stop();
+    iom.stop();
+    std::filesystem::remove_all(dir);
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#include "config.h"
+#include "log.h"
+#include "log_test_appenders.h"
+#include "util.h"
+
+static const int s_second_line = __LINE__ + 4;
+
+static void log_all(std::shared_ptr<lsh::Logger> logger) {
+    LSH_LOG_DEBUG(logger) << "first";
+    LSH_LOG_FMT_DEBUG(logger, "second %d", 2);
+    LSH_LOG_ERROR(logger) << "third";
+}
+
+static void set_rules(const std::vector<std::string> &rules) {
+    lsh::Config::Lookup<std::vector<std::string>>("log.dynamic_debug")->setValue(rules);
+}
+
+int main(int argc, char **argv) {
+    std::shared_ptr<lsh::Logger> logger(new lsh::Logger("dynamic"));
+    std::shared_ptr<CaptureLogAppender> appender(new CaptureLogAppender);
+    logger->addAppender(appender);
+    logger->setLevel(lsh::LogLevel::ERROR);
+    bool ok = true;
+    bool debug_compiled = LSH_LOG_COMPILED(lsh::LogLevel::DEBUG);
+    std::cout << "LSH_MIN_LOG_LEVEL=" << LSH_MIN_LOG_LEVEL << std::endl;
+
+    // 默认由 logger 的级别决定
+    log_all(logger);
+    std::cout << "default: " << appender->m_lines.size() << " lines" << std::endl;
+    ok = ok && appender->m_lines.size() == 1 && appender->m_lines[0] == "third";
+
+    // 打开整个文件，DEBUG 无视 logger 的 ERROR 级别输出
+    appender->m_lines.clear();
+    set_rules({"test_dynamic_debug.cpp"});
+    log_all(logger);
+    std::cout << "file on: " << appender->m_lines.size() << " lines" << std::endl;
+    ok = ok && appender->m_lines.size() == (debug_compiled ? 3 : 1);
+
+    // 只打开一行
+    appender->m_lines.clear();
+    set_rules({"log/test_dynamic_debug.cpp:" + std::to_string(s_second_line)});
+    log_all(logger);
+    std::cout << "line on: " << appender->m_lines.size() << " lines" << std::endl;
+    ok = ok && appender->m_lines.size() == (debug_compiled ? 2 : 1);
+    ok = ok && (!debug_compiled || appender->m_lines[0] == "second 2");
+
+    // 后面的规则覆盖前面的：全部打开，再关掉这个文件
+    appender->m_lines.clear();
+    set_rules({"*", "-test_dynamic_debug.cpp"});
+    log_all(logger);
+    std::cout << "file off: " << appender->m_lines.size() << " lines" << std::endl;
+    ok = ok && appender->m_lines.empty();
+
+    // 路径后缀必须以 '/' 为边界
+    appender->m_lines.clear();
+    set_rules({"dynamic_debug.cpp"});
+    log_all(logger);
+    ok = ok && appender->m_lines.size() == 1;
+
+    // 宏展开后调用方的 else 必须绑定到自己的 if 上，而不是调用点的级别判断
+    appender->m_lines.clear();
+    set_rules({});
+    int else_calls = 0;
+    for (int i = 0; i < 4; i++) {
+        if (i >= 0)
+            LSH_LOG_DEBUG(logger) << "dangling else " << i;
+        else
+            ++else_calls;
+    }
+    std::cout << "dangling else: " << appender->m_lines.size() << " lines, else " << else_calls << std::endl;
+    ok = ok && appender->m_lines.empty() && else_calls == 0;
+
+    std::cout << "registered sites: " << lsh::LogCallSite::GetSiteCount() << std::endl;
+
+    // 被过滤时的开销
+    set_rules({});
+    logger->clearAppenders();
+    const int count = 10000000;
+    uint64_t begin = lsh::GetCurrentUS();
+    for (int i = 0; i < count; i++) {
+        LSH_LOG_DEBUG(logger) << "filtered " << i;
+    }
+    std::cout << "filtered DEBUG: " << (lsh::GetCurrentUS() - begin) * 1000.0 / count << " ns/op" << std::endl;
+    return ok ? 0 : 1;
+}
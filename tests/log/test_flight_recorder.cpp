@@ -0,0 +1,213 @@
+#include "binlog.h"
+#include "config.h"
+#include "log.h"
+#include "log_test_appenders.h"
+#include "thread.h"
+#include "util.h"
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int s_previous_fd = -1;
+
+static void PreviousAbortHandler(int) {
+    write(s_previous_fd, "previous handler\n", 17);
+    _exit(3);
+}
+
+static std::string read_file(const std::string &path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static std::string dump_to_string(const std::string &path) {
+    int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    lsh::FlightRecorder::Dump(fd);
+    close(fd);
+    return read_file(path);
+}
+
+// 递归直到撞上线程栈的保护页；上限放在 volatile 里，编译器看不出它是无限递归
+static volatile int s_recurse_limit = 1 << 30;
+static int Recurse(int depth) {
+    volatile char pad[256];
+    pad[0] = (char)depth;
+    if (depth >= s_recurse_limit) {
+        return pad[0];
+    }
+    return Recurse(depth + 1) + pad[0];
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    std::shared_ptr<lsh::Logger> logger(new lsh::Logger("flight"));
+    std::shared_ptr<CountLogAppender> counter(new CountLogAppender);
+    logger->addAppender(counter);
+    logger->setLevel(lsh::LogLevel::WARN);
+
+    // 默认记录 DEBUG 及以上并安装了崩溃处理函数；被过滤的 DEBUG 只进飞行记录仪，不进 appender
+    LSH_LOG_DEBUG(logger) << "recorded by default";
+    ok = ok && lsh::FlightRecorder::GetLevel() == lsh::LogLevel::DEBUG && counter->m_count == 0;
+    ok = ok && lsh::FlightRecorder::CrashHandlerInstalled();
+
+    // 通过配置打开：DEBUG 只进飞行记录仪，WARN 照常交给 appender
+    YAML::Node root = YAML::Load("log:\n  flight_recorder:\n    level: DEBUG\n    records: 16\n");
+    lsh::Config::LoadFromYaml(root);
+    ok = ok && lsh::FlightRecorder::GetLevel() == lsh::LogLevel::DEBUG && lsh::FlightRecorder::GetCapacity() == 16;
+
+    lsh::Thread::ptr worker(new lsh::Thread([&]() {
+        for (int i = 0; i < 100; i++) {
+            LSH_LOG_DEBUG(logger) << "worker debug " << i;
+        }
+        LSH_LOG_FMT_INFO(logger, "worker info %d", 100);
+        LSH_LOG_WARN(logger) << "worker warn";
+    }, "fr_worker"));
+    worker->join();
+    ok = ok && counter->m_count == 1;
+
+    std::string dump = dump_to_string("/tmp/test_flight_recorder.dump");
+    std::cout << dump;
+    // 每个线程只保留最近 16 条
+    ok = ok && dump.find("fr_worker (exited), last 16 of 102 records") != std::string::npos;
+    ok = ok && dump.find("worker debug 85\n") == std::string::npos;
+    ok = ok && dump.find("[DEBUG] ") != std::string::npos && dump.find("worker debug 86\n") != std::string::npos;
+    ok = ok && dump.find("[INFO] ") != std::string::npos && dump.find("worker info 100\n") != std::string::npos;
+    ok = ok && dump.find("[WARN] ") != std::string::npos && dump.find("test_flight_recorder.cpp:") != std::string::npos;
+
+    // 二进制模式的 logger：记录在调用线程上只保存参数字节，导出时格式化；后台还原时不再重复记录
+    std::shared_ptr<lsh::Logger> bin_logger(new lsh::Logger("flight_binary"));
+    bin_logger->addAppender(counter);
+    bin_logger->setLevel(lsh::LogLevel::INFO);
+    bin_logger->setBinary(true);
+    lsh::Thread::ptr bin_worker(new lsh::Thread([&]() {
+        LSH_LOG_FMT_WARN(bin_logger, "binary warn %d %s [%-4u] %.2f %#x %p %c", -7, "str", 5u, 3.14159, 255,
+                         (void *)0x10, 'z');
+        LSH_LOG_FMT_ERROR(bin_logger, "binary long %s", std::string(400, 'y').c_str());
+    }, "fr_binary"));
+    bin_worker->join();
+    lsh::BinLogMgr::GetInstance()->flush();
+    dump = dump_to_string("/tmp/test_flight_recorder.dump");
+    std::cout << dump;
+    const std::string bin_line = "binary warn -7 str [5   ] 3.14 0xff 0x10 z\n";
+    size_t bin_pos = dump.find(bin_line);
+    ok = ok && bin_pos != std::string::npos && dump.find(bin_line, bin_pos + 1) == std::string::npos;
+    ok = ok && dump.rfind("fr_binary", bin_pos) != std::string::npos && dump.find("[WARN] ") != std::string::npos;
+    ok = ok && dump.find("yyy...\n") != std::string::npos;
+    ok = ok && counter->m_count == 3;
+    std::cout << "binary record ok=" << ok << std::endl;
+
+    // 记录一条 DEBUG 的开销，和 logger 过滤掉（记录仪关闭）时对比
+    const int n = 200000;
+    uint64_t begin = lsh::GetCurrentUS();
+    for (int i = 0; i < n; i++) {
+        LSH_LOG_DEBUG(logger) << "bench " << i;
+    }
+    uint64_t recorded = lsh::GetCurrentUS() - begin;
+    lsh::FlightRecorder::SetLevel(lsh::FlightRecorder::OFF);
+    begin = lsh::GetCurrentUS();
+    for (int i = 0; i < n; i++) {
+        LSH_LOG_DEBUG(logger) << "bench " << i;
+    }
+    uint64_t filtered = lsh::GetCurrentUS() - begin;
+    std::cout << "debug into flight recorder " << recorded * 1000.0 / n << " ns/op, filtered "
+              << filtered * 1000.0 / n << " ns/op" << std::endl;
+    ok = ok && counter->m_count == 3;
+
+    // 崩溃：子进程把调用栈和最近的 DEBUG 日志写到文件后按 SIGSEGV 退出
+    const char *crash_path = "/tmp/test_flight_recorder.crash";
+    pid_t pid = fork();
+    if (pid == 0) {
+        int fd = open(crash_path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        lsh::FlightRecorder::SetLevel(lsh::LogLevel::DEBUG);
+        lsh::FlightRecorder::InstallCrashHandler(fd);
+        for (int i = 0; i < 10; i++) {
+            LSH_LOG_DEBUG(logger) << "before crash " << i;
+        }
+        volatile int *p = nullptr;
+        *p = 1;
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    std::string crash = read_file(crash_path);
+    std::cout << crash;
+    ok = ok && WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV;
+    ok = ok && crash.find("*** SIGSEGV (11)") != std::string::npos && crash.find("addr 0x0 ***") != std::string::npos;
+    ok = ok && crash.find("backtrace:\n") != std::string::npos && crash.find("before crash 9\n") != std::string::npos;
+    ok = ok && crash.find("*** end of flight recorder ***") != std::string::npos;
+
+    // 栈溢出：处理函数在备用信号栈上执行，照样能导出
+    pid = fork();
+    if (pid == 0) {
+        int fd = open(crash_path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        lsh::FlightRecorder::SetLevel(lsh::LogLevel::DEBUG);
+        lsh::FlightRecorder::InstallCrashHandler(fd);
+        lsh::Thread thread([&]() {
+            LSH_LOG_DEBUG(logger) << "before overflow";
+            Recurse(0);
+        }, "overflow");
+        thread.join();
+        _exit(0);
+    }
+    status = 0;
+    waitpid(pid, &status, 0);
+    crash = read_file(crash_path);
+    ok = ok && WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV;
+    ok = ok && crash.find("*** SIGSEGV (11)") != std::string::npos && crash.find("before overflow\n") != std::string::npos;
+    ok = ok && crash.find("*** end of flight recorder ***") != std::string::npos;
+    std::cout << "stack overflow ok=" << ok << std::endl;
+
+    // 默认安装的处理函数写到 stderr；二进制日志在崩溃时还在环里，也能在导出里看到
+    pid = fork();
+    if (pid == 0) {
+        int fd = open(crash_path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        dup2(fd, STDERR_FILENO);
+        lsh::FlightRecorder::SetLevel(lsh::LogLevel::INFO);
+        LSH_LOG_FMT_ERROR(bin_logger, "binary before abort %d", 42);
+        abort();
+    }
+    status = 0;
+    waitpid(pid, &status, 0);
+    crash = read_file(crash_path);
+    ok = ok && WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+    ok = ok && crash.find("*** SIGABRT (6)") != std::string::npos && crash.find("binary before abort 42\n") != std::string::npos;
+
+    // 安装前已有的处理函数（比如别的崩溃上报工具）在导出之后照样被调用
+    pid = fork();
+    if (pid == 0) {
+        int fd = open(crash_path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        lsh::FlightRecorder::UninstallCrashHandler();
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = PreviousAbortHandler;
+        sigaction(SIGABRT, &sa, nullptr);
+        s_previous_fd = fd;
+        lsh::FlightRecorder::SetLevel(lsh::LogLevel::DEBUG);
+        lsh::FlightRecorder::InstallCrashHandler(fd);
+        LSH_LOG_ERROR(logger) << "before chained abort";
+        abort();
+    }
+    status = 0;
+    waitpid(pid, &status, 0);
+    crash = read_file(crash_path);
+    ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 3;
+    ok = ok && crash.find("before chained abort\n") != std::string::npos &&
+         crash.find("*** end of flight recorder ***\nprevious handler\n") != std::string::npos;
+    std::cout << "chained handler ok=" << ok << std::endl;
+
+    // log.flight_recorder.crash_handler: false 卸载处理函数；记录仪关闭时打开开关也不安装
+    lsh::Config::LoadFromYaml(YAML::Load("log:\n  flight_recorder:\n    crash_handler: false\n"));
+    ok = ok && !lsh::FlightRecorder::CrashHandlerInstalled();
+    lsh::Config::LoadFromYaml(YAML::Load("log:\n  flight_recorder:\n    crash_handler: true\n"));
+    ok = ok && !lsh::FlightRecorder::CrashHandlerInstalled();
+    lsh::Config::LoadFromYaml(YAML::Load("log:\n  flight_recorder:\n    level: INFO\n"));
+    ok = ok && lsh::FlightRecorder::GetLevel() == lsh::LogLevel::INFO && lsh::FlightRecorder::CrashHandlerInstalled();
+    std::cout << "default crash handler ok=" << ok << std::endl;
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
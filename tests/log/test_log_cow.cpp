@@ -0,0 +1,70 @@
+#include "log.h"
+#include "log_test_appenders.h"
+#include "thread.h"
+#include "util.h"
+#include <unistd.h>
+
+// 每条日志都要睡一会儿，模拟阻塞在 stdout 或磁盘上的 appender
+class SlowLogAppender : public lsh::LogAppender {
+public:
+    void log(std::shared_ptr<lsh::Logger> logger, lsh::LogLevel::Level level,
+             std::shared_ptr<lsh::LogEvent> event) override {
+        usleep(20 * 1000);
+        ++m_count;
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::atomic<uint64_t> m_count{0};
+};
+
+int main(int argc, char **argv) {
+    std::shared_ptr<lsh::Logger> logger(new lsh::Logger("cow"));
+    std::shared_ptr<SlowLogAppender> slow(new SlowLogAppender);
+    std::shared_ptr<CountLogAppender> counter(new CountLogAppender);
+    logger->addAppender(slow);
+    logger->addAppender(counter);
+    bool ok = true;
+
+    // 一个线程卡在慢 appender 里时，修改 appender 列表不需要等它
+    std::atomic<bool> stop{false};
+    lsh::Thread::ptr writer(new lsh::Thread([&]() {
+        while (!stop) {
+            LSH_LOG_INFO(logger) << "slow";
+        }
+    }, "slow_writer"));
+    usleep(5 * 1000);
+
+    uint64_t max_us = 0;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t begin = lsh::GetCurrentUS();
+        if (i % 2) {
+            logger->setAppenders({slow, counter});
+        } else {
+            logger->deleteAppender(counter);
+        }
+        max_us = std::max(max_us, lsh::GetCurrentUS() - begin);
+    }
+    logger->setAppenders({slow, counter});
+    std::cout << "max appender update while logging: " << max_us << " us" << std::endl;
+    ok = ok && max_us < 10 * 1000;
+
+    // 其它线程写日志也不会被慢 appender 所在线程的锁挡住
+    logger->deleteAppender(slow);
+    uint64_t before = counter->m_count;
+    uint64_t begin = lsh::GetCurrentUS();
+    for (int i = 0; i < 1000; i++) {
+        LSH_LOG_INFO(logger) << "fast " << i;
+    }
+    uint64_t used = lsh::GetCurrentUS() - begin;
+    std::cout << "1000 lines next to a blocked appender: " << used << " us" << std::endl;
+    ok = ok && counter->m_count - before == 1000 && used < 20 * 1000;
+
+    stop = true;
+    writer->join();
+
+    // 快照发布之后，旧快照仍被正在写日志的线程持有也没关系
+    logger->clearAppenders();
+    ok = ok && logger->getAppenders()->empty();
+    std::cout << "slow appender wrote " << slow->m_count << " lines" << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+#include "log.h"
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+// %d 的线程内缓存和 %3N/%6N 亚秒数字：同一秒内只换亚秒部分，跨秒时整段日期重新渲染
+
+static std::shared_ptr<lsh::Logger> s_logger = std::make_shared<lsh::Logger>("datetime");
+
+static std::string Format(lsh::LogFormatter &formatter, time_t sec, uint32_t usec) {
+    auto event = std::make_shared<lsh::LogEvent>(__FILE__, __LINE__, 0, 0, 0, sec, s_logger,
+                                                 lsh::LogLevel::INFO, "main");
+    event->setMicroSecond(usec);
+    return formatter.format(s_logger, lsh::LogLevel::INFO, event);
+}
+
+static bool Expect(const std::string &got, const std::string &want) {
+    if (got != want) {
+        std::cout << "got \"" << got << "\", want \"" << want << "\"" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    setenv("TZ", "UTC", 1);
+    tzset();
+    // 2023-11-14 22:13:20 UTC
+    const time_t sec = 1700000000;
+    bool ok = true;
+
+    // 同一秒内两条：日期部分命中缓存，毫秒/微秒各自不同
+    lsh::LogFormatter ms("%d{%Y-%m-%d %H:%M:%S.%3N}");
+    lsh::LogFormatter us("%d{%H:%M:%S.%6N %%N}");
+    ok = ok && Expect(Format(ms, sec, 5000), "2023-11-14 22:13:20.005");
+    ok = ok && Expect(Format(ms, sec, 123456), "2023-11-14 22:13:20.123");
+    ok = ok && Expect(Format(us, sec, 7), "22:13:20.000007 %N");
+    ok = ok && Expect(Format(us, sec, 123456), "22:13:20.123456 %N");
+    std::cout << "same second ok=" << ok << std::endl;
+
+    // 跨秒：缓存的日期前缀必须刷新，回到前一秒也一样
+    ok = ok && Expect(Format(ms, sec, 999999), "2023-11-14 22:13:20.999");
+    ok = ok && Expect(Format(ms, sec + 1, 1000), "2023-11-14 22:13:21.001");
+    ok = ok && Expect(Format(us, sec + 1, 999999), "22:13:21.999999 %N");
+    ok = ok && Expect(Format(ms, sec, 0), "2023-11-14 22:13:20.000");
+    // 跨天
+    ok = ok && Expect(Format(ms, sec + 6400, 42000), "2023-11-15 00:00:00.042");
+    std::cout << "second boundary ok=" << ok << std::endl;
+
+    // 多个时间格式落到同一个缓存槽（槽位按格式 id 取模）：互相替换后结果仍然正确
+    std::vector<std::shared_ptr<lsh::LogFormatter>> others;
+    for (int i = 0; i < 16; i++) {
+        others.push_back(std::make_shared<lsh::LogFormatter>("%d{%S.%3N}"));
+    }
+    for (int round = 0; round < 2; round++) {
+        for (auto &f : others) {
+            ok = ok && Expect(Format(*f, sec + round, 250000), round ? "21.250" : "20.250");
+            ok = ok && Expect(Format(ms, sec + round, 1000), round ? "2023-11-14 22:13:21.001"
+                                                                   : "2023-11-14 22:13:20.001");
+        }
+    }
+    std::cout << "shared slot ok=" << ok << std::endl;
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#include "log.h"
+#include "log_test_appenders.h"
+#include "util.h"
+#include <cmath>
+
+enum Color { RED = 1, GREEN = 2 };
+
+struct Point {
+    int x, y;
+};
+
+std::ostream &operator<<(std::ostream &os, const Point &p) {
+    return os << "(" << p.x << "," << p.y << ")";
+}
+
+static const int s_count = 1000000;
+
+template <class F>
+static void bench(const std::string &name, F f) {
+    uint64_t begin = lsh::GetCurrentUS();
+    for (int i = 0; i < s_count; i++) {
+        f(i);
+    }
+    std::cout << name << ": " << (lsh::GetCurrentUS() - begin) * 1000.0 / s_count << " ns/op" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    std::shared_ptr<lsh::Logger> logger(new lsh::Logger("fmtx"));
+    std::shared_ptr<CaptureLogAppender> appender(new CaptureLogAppender);
+    logger->addAppender(appender);
+    bool ok = true;
+    int failed = 0;
+
+    auto expect = [&](const std::string &want) {
+        if (appender->m_lines.back() != want) {
+            std::cout << "FAIL: got [" << appender->m_lines.back() << "] want [" << want << "]" << std::endl;
+            ok = false;
+            ++failed;
+        }
+    };
+
+    LSH_LOG_FMTX_INFO(logger, "plain text");
+    expect("plain text");
+    LSH_LOG_FMTX_INFO(logger, "{} {} {} {}", 42, -7, 3u, (int64_t)1 << 40);
+    expect("42 -7 3 1099511627776");
+    LSH_LOG_FMTX_INFO(logger, "{{}} {{{}}}", 1);
+    expect("{} {1}");
+    LSH_LOG_FMTX_INFO(logger, "[{:5}] [{:<5}] [{:^5}] [{:*>6}] [{:05}] [{:+}] [{: }]", 42, 42, 42, 42, -42, 42, 42);
+    expect("[   42] [42   ] [ 42  ] [****42] [-0042] [+42] [ 42]");
+    LSH_LOG_FMTX_INFO(logger, "{:x} {:X} {:#x} {:o} {:#o} {:b} {:#010b} {:c}", 255, 255, 255, 8, 8, 5, 5, 65);
+    expect("ff FF 0xff 10 010 101 0b00000101 A");
+    LSH_LOG_FMTX_INFO(logger, "{} {} {:.2f} {:8.3f} {:e} {:g} {:+.1f} {:08.2f}", 0.5, 3.14159, 3.14159, 2.5, 1234.5, 0.0001, 1.0, -3.14159);
+    expect("0.5 3.14159 3.14    2.500 1.234500e+03 0.0001 +1.0 -0003.14");
+    LSH_LOG_FMTX_INFO(logger, "{} {} {:F}", INFINITY, -NAN, INFINITY);
+    expect("inf -nan INF");
+    std::string name = "server";
+    std::string_view view = "view";
+    const char *null_str = nullptr;
+    LSH_LOG_FMTX_INFO(logger, "{} {:>8} [{:.3}] {} {} {}", name, view, "abcdef", 'c', null_str, true);
+    expect("server     view [abc] c (null) true");
+    LSH_LOG_FMTX_INFO(logger, "{:d} {:>5} {}", false, true, RED);
+    expect("0  true 1");
+    LSH_LOG_FMTX_INFO(logger, "{} {}", (void *)0x1234, nullptr);
+    expect("0x1234 0x0");
+    LSH_LOG_FMTX_INFO(logger, "p={} done", Point{1, 2});
+    expect("p=(1,2) done");
+
+    // 展开后是日志流，可以继续写内容和字段
+    LSH_LOG_FMTX_WARN(logger, "fd={}", 5) << " closed";
+    expect("fd=5 closed");
+
+    // 格式串错误在编译期报告，例如（打开任一行都会编译失败）：
+    //  LSH_LOG_FMTX_INFO(logger, "{} {}", 1);       参数不够
+    //  LSH_LOG_FMTX_INFO(logger, "{}", 1, 2);       参数多了
+    //  LSH_LOG_FMTX_INFO(logger, "{:d}", "str");    d 不能用于字符串
+    //  LSH_LOG_FMTX_INFO(logger, "{:.2f}", 1);      f 不能用于整数
+    //  LSH_LOG_FMTX_INFO(logger, "{0}", 1);         不支持按位置引用
+#ifdef TEST_FMTX_COMPILE_ERROR
+    LSH_LOG_FMTX_INFO(logger, "{:.2f}", 1);
+#endif
+
+    std::cout << (ok ? "all format checks passed" : "format checks failed: " + std::to_string(failed)) << std::endl;
+
+    // 基准不保存内容，只测前端
+    logger->clearAppenders();
+    logger->addAppender(std::make_shared<NullLogAppender>());
+
+    bench("stream LSH_LOG_INFO ", [&](int i) {
+        LSH_LOG_INFO(logger) << "bench log event i=" << i << " value=" << 3.14 << " name=" << name;
+    });
+    bench("printf LSH_LOG_FMT_INFO ", [&](int i) {
+        LSH_LOG_FMT_INFO(logger, "bench log event i=%d value=%f name=%s", i, 3.14, name.c_str());
+    });
+    bench("format LSH_LOG_FMTX_INFO", [&](int i) {
+        LSH_LOG_FMTX_INFO(logger, "bench log event i={} value={:f} name={}", i, 3.14, name);
+    });
+    return ok ? 0 : 1;
+}
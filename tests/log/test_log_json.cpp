@@ -0,0 +1,84 @@
+#include "config.h"
+#include "log.h"
+#include "log_test_appenders.h"
+#include "util.h"
+#include <yaml-cpp/yaml.h>
+
+static bool contains(const std::string &s, const std::string &sub) {
+    return s.find(sub) != std::string::npos;
+}
+
+// 同一个事件分别用文本和 json 格式化，比较每条的耗时
+static double bench_format(lsh::LogFormatter &formatter, const std::shared_ptr<lsh::Logger> &logger,
+                           const lsh::LogEvent::ptr &event) {
+    const int count = 1000000;
+    std::string out;
+    uint64_t bytes = 0;
+    uint64_t begin = lsh::GetCurrentUS();
+    for (int i = 0; i < count; i++) {
+        out.clear();
+        formatter.format(out, logger, lsh::LogLevel::INFO, event);
+        bytes += out.size();
+    }
+    double ns = (lsh::GetCurrentUS() - begin) * 1000.0 / count;
+    std::cout << "  " << formatter.getPattern() << ": " << ns << " ns/op, " << bytes / count << " bytes" << std::endl;
+    return ns;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+
+    // 通过 logs 配置选择 json formatter
+    YAML::Node root = YAML::Load(R"(
+logs:
+  - name: json
+    level: debug
+    formatter: json
+)");
+    lsh::Config::LoadFromYaml(root);
+    std::shared_ptr<lsh::Logger> logger = LSH_LOG_NAME("json");
+    std::shared_ptr<CaptureLogAppender> appender(new CaptureLogAppender(true));
+    logger->setAppenders({appender});
+    ok = ok && logger->getFormatter()->isJson();
+
+    int fd = 7;
+    LSH_LOG_INFO(logger).kv("fd", fd).kv("peer", "10.0.0.1:80").kv("ratio", 0.5).kv("closed", true).kv("bytes", uint64_t(1) << 40)
+        << "say \"hi\"\tto\\" << '\n' << "next\x01";
+    std::cout << appender->m_lines.back();
+    const std::string &line = appender->m_lines.back();
+    ok = ok && line.front() == '{' && line.compare(line.size() - 2, 2, "}\n") == 0;
+    ok = ok && contains(line, R"("level":"INFO","logger":"json",)");
+    ok = ok && contains(line, R"("message":"say \"hi\"\tto\\\nnext\u0001")");
+    ok = ok && contains(line, R"("fd":7,"peer":"10.0.0.1:80","ratio":0.5,"closed":true,"bytes":1099511627776})");
+
+    // 流式宏之外的字段和格式化宏同样可用；字段不会遗留到下一条
+    LSH_LOG_FMT_WARN(logger, "plain %d", 1);
+    ok = ok && contains(appender->m_lines.back(), R"("message":"plain 1"})");
+
+    // 自定义时间格式
+    logger->setFormatter("json{%Y}");
+    LSH_LOG_ERROR(logger).kv("neg", -3) << "custom";
+    std::cout << appender->m_lines.back();
+    ok = ok && appender->m_lines.back().size() > 15 && appender->m_lines.back()[13] == '"' &&
+         isdigit(appender->m_lines.back()[12]);
+    ok = ok && contains(appender->m_lines.back(), R"("neg":-3})");
+
+    // 文本格式下字段追加在消息后面
+    logger->setFormatter("%p %m%n");
+    LSH_LOG_INFO(logger).kv("fd", fd).kv("op", "read") << "closed";
+    std::cout << appender->m_lines.back();
+    ok = ok && appender->m_lines.back() == "INFO closed fd=7 op=read\n";
+
+    // 格式化耗时：json 应当和文本格式相差不大
+    lsh::LogEvent::ptr event = lsh::LogEvent::Acquire(__FILE__, __LINE__, logger, lsh::LogLevel::INFO);
+    event->getSS() << "accept client fd=" << fd << " from 10.0.0.1:80";
+    lsh::LogFormatter text("%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n");
+    lsh::LogFormatter json("json{%Y-%m-%d %H:%M:%S}");
+    lsh::LogFormatter iso("json");
+    std::cout << "format:" << std::endl;
+    double text_ns = bench_format(text, logger, event);
+    double json_ns = bench_format(json, logger, event);
+    bench_format(iso, logger, event);
+    std::cout << "json/text (same time format) = " << json_ns / text_ns << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#include "log.h"
+#include "log_test_appenders.h"
+#include "util.h"
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+    std::shared_ptr<lsh::Logger> logger(new lsh::Logger("limit"));
+    std::shared_ptr<CaptureLogAppender> appender(new CaptureLogAppender);
+    logger->addAppender(appender);
+    bool ok = true;
+
+    // 每 100 条输出 1 条
+    for (int i = 0; i < 1000; i++) {
+        LSH_LOG_ERROR_EVERY_N(logger, 100) << "every n " << i;
+    }
+    std::cout << "EVERY_N: " << appender->m_lines.size() << " lines, last: " << appender->m_lines.back() << std::endl;
+    ok = ok && appender->m_lines.size() == 10 && appender->m_lines.back() == "[suppressed 99 messages] every n 900";
+
+    // 宏展开后调用方的 else 必须绑定到自己的 if 上，而不是限流判断
+    appender->m_lines.clear();
+    int else_calls = 0;
+    for (int i = 0; i < 10; i++) {
+        if (i >= 0)
+            LSH_LOG_ERROR_EVERY_N(logger, 5) << "dangling else " << i;
+        else
+            ++else_calls;
+    }
+    std::cout << "dangling else: " << appender->m_lines.size() << " lines, else " << else_calls << std::endl;
+    ok = ok && appender->m_lines.size() == 2 && else_calls == 0;
+
+    // 每 100ms 最多 1 条，持续约 550ms
+    appender->m_lines.clear();
+    uint64_t begin = lsh::GetCurrentMS();
+    while (lsh::GetCurrentMS() - begin < 550) {
+        LSH_LOG_ERROR_EVERY_MS(logger, 100) << "every ms";
+        usleep(100);
+    }
+    std::cout << "EVERY_MS: " << appender->m_lines.size() << " lines, last: " << appender->m_lines.back() << std::endl;
+    // 只检查上限：机器繁忙时 sleep 可能远超预期，下限没法保证
+    ok = ok && appender->m_lines.size() >= 1 && appender->m_lines.size() <= 7;
+
+    // 令牌桶：每秒 20 条，突发 10 条
+    appender->m_lines.clear();
+    begin = lsh::GetCurrentMS();
+    while (lsh::GetCurrentMS() - begin < 500) {
+        LSH_LOG_ERROR_RATE(logger, 20, 10) << "rate";
+        usleep(100);
+    }
+    std::cout << "RATE: " << appender->m_lines.size() << " lines (expect ~20)" << std::endl;
+    // 突发 10 条 + 500ms 内补充的 10 个令牌，最多 20 条左右
+    ok = ok && appender->m_lines.size() >= 1 && appender->m_lines.size() <= 22;
+
+    // 被限流时的开销
+    logger->clearAppenders();
+    const int count = 10000000;
+    begin = lsh::GetCurrentUS();
+    for (int i = 0; i < count; i++) {
+        LSH_LOG_ERROR_EVERY_N(logger, 1000000000) << "suppressed " << i;
+    }
+    std::cout << "suppressed EVERY_N: " << (lsh::GetCurrentUS() - begin) * 1000.0 / count << " ns/op" << std::endl;
+    return ok ? 0 : 1;
+}
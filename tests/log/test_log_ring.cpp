@@ -0,0 +1,78 @@
+#include "config.h"
+#include "log.h"
+#include "thread.h"
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <yaml-cpp/yaml.h>
+
+static const char *s_file = "log_ring_test.txt";
+static const int s_threads = 8;
+static const int s_lines = 50000;
+
+void write_log() {
+    auto logger = LSH_LOG_NAME("ring");
+    for (int i = 0; i < s_lines; i++) {
+        LSH_LOG_INFO(logger) << i;
+    }
+}
+
+static uint64_t run_threads() {
+    uint64_t begin = lsh::GetCurrentMS();
+    std::vector<lsh::Thread::ptr> threads;
+    for (int i = 0; i < s_threads; i++) {
+        threads.push_back(std::make_shared<lsh::Thread>(&write_log, "ring_" + std::to_string(i)));
+    }
+    for (auto &t : threads) {
+        t->join();
+    }
+    return lsh::GetCurrentMS() - begin;
+}
+
+int main(int argc, char **argv) {
+    remove(s_file);
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "    - name: ring\n"
+        "      level: info\n"
+        "      ring: true\n"
+        "      formatter: \"%t %m%n\"\n"
+        "      appender:\n"
+        "          - type: FileLogAppender\n"
+        "            file: log_ring_test.txt\n");
+    lsh::Config::LoadFromYaml(root);
+    std::cout << LSH_LOG_NAME("ring")->toYamlString() << std::endl;
+
+    uint64_t ring_ms = run_threads();
+    lsh::LogCollectorMgr::GetInstance()->flush();
+    // 析构 FileLogAppender，把 ofstream 里缓存的内容写到文件
+    LSH_LOG_NAME("ring")->clearAppenders();
+
+    // 每个线程的序号必须连续递增：同一线程内的顺序不能被归并打乱
+    std::ifstream in(s_file);
+    std::map<uint32_t, int> next;
+    std::string line;
+    int count = 0;
+    bool ordered = true;
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        uint32_t tid;
+        int seq;
+        ss >> tid >> seq;
+        if (next[tid] != seq) {
+            ordered = false;
+        }
+        next[tid] = seq + 1;
+        ++count;
+    }
+
+    // 对比：关掉 ring，所有线程直接竞争 Logger 和 appender 的锁
+    auto logger = LSH_LOG_NAME("ring");
+    logger->setRing(false);
+    logger->addAppender(std::make_shared<lsh::FileLogAppender>("log_ring_sync.txt"));
+    uint64_t sync_ms = run_threads();
+
+    std::cout << "ring: " << ring_ms << " ms, sync: " << sync_ms << " ms, "
+              << count << " lines" << (ordered ? " in order" : " OUT OF ORDER") << std::endl;
+    return count == s_threads * s_lines && ordered ? 0 : 1;
+}
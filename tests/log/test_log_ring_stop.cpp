@@ -0,0 +1,77 @@
+#include "config.h"
+#include "log.h"
+#include "log_test_appenders.h"
+#include "thread.h"
+#include <unistd.h>
+
+// LogCollector::stop 和 push 并发：用很小的队列，stop 之前、之中、之后写入的日志都不能丢，
+// 生产者也不能卡在满的队列上。同一批线程每轮写一个新的 collector，各自的队列互不影响
+
+static const int s_rounds = 50;
+static const int s_threads = 4;
+static const int s_lines = 2000;
+
+int main(int argc, char **argv) {
+    lsh::Config::Lookup<uint32_t>("log.ring.capacity")->setValue(4);
+    auto logger = std::make_shared<lsh::Logger>("ring_stop");
+    auto appender = std::make_shared<CountLogAppender>();
+    logger->addAppender(appender);
+
+    std::atomic<lsh::LogCollector *> current{nullptr};
+    lsh::Semaphore start;
+    lsh::Semaphore done;
+    std::vector<lsh::Thread::ptr> threads;
+    for (int t = 0; t < s_threads; t++) {
+        threads.push_back(std::make_shared<lsh::Thread>([&]() {
+            lsh::LogEvent event;
+            for (int round = 0; round < s_rounds; round++) {
+                start.wait();
+                lsh::LogCollector *collector = current.load();
+                for (int i = 0; i < s_lines; i++) {
+                    collector->push(logger, lsh::LogLevel::INFO, event);
+                }
+                done.notify();
+            }
+        }, "ring_stop_" + std::to_string(t)));
+    }
+
+    bool ok = true;
+    for (int round = 0; round < s_rounds; round++) {
+        appender->m_count = 0;
+        lsh::LogCollector collector;
+        current = &collector;
+        for (int t = 0; t < s_threads; t++) {
+            start.notify();
+        }
+        // 在写入进行到不同阶段时停止
+        usleep(round * 100);
+        collector.stop();
+        for (int t = 0; t < s_threads; t++) {
+            done.wait();
+        }
+        if (appender->m_count != (uint64_t)s_threads * s_lines) {
+            std::cout << "round " << round << ": " << appender->m_count << " of " << s_threads * s_lines
+                      << " lines" << std::endl;
+            ok = false;
+        }
+    }
+    for (auto &t : threads) {
+        t->join();
+    }
+
+    // 线程退出后，它们的队列在取空之后回收
+    lsh::LogCollector collector;
+    for (int t = 0; t < s_threads; t++) {
+        lsh::Thread thread([&]() {
+            lsh::LogEvent event;
+            collector.push(logger, lsh::LogLevel::INFO, event);
+        }, "ring_exit_" + std::to_string(t));
+        thread.join();
+    }
+    collector.flush();
+    std::cout << "rings after threads exited: " << collector.getRingCount() << std::endl;
+    ok = ok && collector.getRingCount() == 0;
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
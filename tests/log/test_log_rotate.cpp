@@ -0,0 +1,71 @@
+#include "config.h"
+#include "log.h"
+#include <filesystem>
+#include <unistd.h>
+#include <yaml-cpp/yaml.h>
+
+static const char *s_dir = "log_rotate_test";
+
+// 统计 file_name 滚动出来的历史文件，检查每个都不超过 max_size
+static int count_rotated(const std::string &file_name, uint64_t max_size, bool &ok) {
+    int count = 0;
+    for (auto &entry : std::filesystem::directory_iterator(s_dir)) {
+        std::string name = entry.path().filename().string();
+        if (name.compare(0, file_name.size() + 1, file_name + ".") == 0) {
+            ++count;
+            if (max_size && entry.file_size() > max_size) {
+                std::cout << name << " size " << entry.file_size() << " > " << max_size << std::endl;
+                ok = false;
+            }
+        }
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    std::filesystem::remove_all(s_dir);
+    std::filesystem::create_directory(s_dir);
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "    - name: rotate_size\n"
+        "      level: info\n"
+        "      formatter: \"%d%T%m%n\"\n"
+        "      appender:\n"
+        "          - type: FileLogAppender\n"
+        "            file: log_rotate_test/size.log\n"
+        "            buffer_size: 4096\n"
+        "            flush_interval: 10\n"
+        "            rotate_size: 65536\n"
+        "            max_files: 3\n"
+        "    - name: rotate_time\n"
+        "      level: info\n"
+        "      formatter: \"%d%T%m%n\"\n"
+        "      appender:\n"
+        "          - type: FileLogAppender\n"
+        "            file: log_rotate_test/time.log\n"
+        "            flush_interval: 10\n"
+        "            rotate_interval: 1\n");
+    lsh::Config::LoadFromYaml(root);
+    std::cout << LSH_LOG_NAME("rotate_size")->toYamlString() << std::endl;
+    std::cout << LSH_LOG_NAME("rotate_time")->toYamlString() << std::endl;
+
+    auto size_logger = LSH_LOG_NAME("rotate_size");
+    auto time_logger = LSH_LOG_NAME("rotate_time");
+    for (int i = 0; i < 30; i++) {
+        for (int j = 0; j < 1000; j++) {
+            LSH_LOG_INFO(size_logger) << "rotate by size " << i << " " << j;
+        }
+        LSH_LOG_INFO(time_logger) << "rotate by time " << i;
+        usleep(100 * 1000);
+    }
+    // 析构 appender，写完剩余数据
+    size_logger->clearAppenders();
+    time_logger->clearAppenders();
+
+    bool ok = true;
+    int size_files = count_rotated("size.log", 65536, ok);
+    int time_files = count_rotated("time.log", 0, ok);
+    std::cout << "size rotated files: " << size_files << " (max_files 3), "
+              << "time rotated files: " << time_files << std::endl;
+    return ok && size_files == 3 && time_files >= 2 ? 0 : 1;
+}
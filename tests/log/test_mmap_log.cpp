@@ -0,0 +1,152 @@
+#include "config.h"
+#include "log.h"
+#include "thread.h"
+#include <fstream>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <yaml-cpp/yaml.h>
+
+static const char *s_file = "mmap_test.txt";
+static const int s_threads = 4;
+static const int s_lines = 100000;
+
+void write_log() {
+    auto logger = LSH_LOG_NAME("mmap");
+    for (int i = 0; i < s_lines; i++) {
+        LSH_LOG_INFO(logger) << "mmap log line " << i;
+    }
+}
+
+// 数行数，同时检查没有残留的 '\0' 和被拆开的行
+static int count_lines(const char *file, bool &ok) {
+    std::ifstream in(file);
+    std::string line;
+    int count = 0;
+    while (std::getline(in, line)) {
+        if (line.find('\0') != std::string::npos || line.find("mmap log line ") == std::string::npos) {
+            ok = false;
+        }
+        ++count;
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    remove(s_file);
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "    - name: mmap\n"
+        "      level: info\n"
+        "      formatter: \"%d%T%t%T%m%n\"\n"
+        "      appender:\n"
+        "          - type: MmapFileLogAppender\n"
+        "            file: mmap_test.txt\n"
+        "            segment_size: 1048576\n"
+        "            msync: none\n"
+        "            advise: sequential\n");
+    lsh::Config::LoadFromYaml(root);
+    std::cout << LSH_LOG_NAME("mmap")->toYamlString() << std::endl;
+
+    // 1. 多线程写，段大小 1MB，中间会换很多次段
+    uint64_t begin = lsh::GetCurrentMS();
+    std::vector<lsh::Thread::ptr> threads;
+    for (int i = 0; i < s_threads; i++) {
+        threads.push_back(std::make_shared<lsh::Thread>(&write_log, "mmap_" + std::to_string(i)));
+    }
+    for (auto &t : threads) {
+        t->join();
+    }
+    uint64_t end = lsh::GetCurrentMS();
+    // 析构 appender，截掉预分配的部分
+    LSH_LOG_NAME("mmap")->clearAppenders();
+
+    bool ok = true;
+    int count = count_lines(s_file, ok);
+    std::cout << "write " << s_threads * s_lines << " lines in " << end - begin
+              << " ms, file has " << count << " lines" << std::endl;
+    ok = ok && count == s_threads * s_lines;
+
+    // 2. 子进程写完直接被 SIGKILL，已经 memcpy 进映射的日志仍然在页缓存里
+    remove(s_file);
+    pid_t pid = fork();
+    if (pid == 0) {
+        auto appender = std::make_shared<lsh::MmapFileLogAppender>(s_file, 1024 * 1024);
+        auto logger = std::make_shared<lsh::Logger>("crash");
+        logger->addAppender(appender);
+        for (int i = 0; i < 1000; i++) {
+            LSH_LOG_INFO(logger) << "mmap log line " << i;
+        }
+        kill(getpid(), SIGKILL);
+    }
+    waitpid(pid, nullptr, 0);
+    {
+        // 重新打开时去掉末尾的 '\0' 填充
+        lsh::MmapFileLogAppender reopened(s_file, 1024 * 1024);
+    }
+    count = count_lines(s_file, ok);
+    std::cout << "after SIGKILL file has " << count << " lines" << std::endl;
+    ok = ok && count == 1000;
+
+    // 3. 接近段大小的一行：新段页对齐后开头已经用掉一部分，过长的行被截断（保留换行）而不是一直换段
+    remove(s_file);
+    alarm(10);
+    {
+        const size_t segment = lsh::MmapFileLogAppender::MIN_SEGMENT_SIZE;
+        const size_t page = sysconf(_SC_PAGESIZE);
+        auto appender = std::make_shared<lsh::MmapFileLogAppender>(s_file, segment);
+        appender->setFormatter(std::make_shared<lsh::LogFormatter>("%m%n"));
+        auto logger = std::make_shared<lsh::Logger>("long");
+        logger->addAppender(appender);
+        LSH_LOG_INFO(logger) << "short";
+        LSH_LOG_INFO(logger) << std::string(segment - 10, 'x');
+        LSH_LOG_INFO(logger) << "after";
+        logger->clearAppenders();
+        appender.reset();
+
+        std::ifstream in(s_file, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::string expect = "short\n" + std::string(segment - page - 1, 'x') + "\nafter\n";
+        std::cout << "long line: file has " << content.size() << " bytes, expect " << expect.size() << std::endl;
+        ok = ok && content == expect;
+    }
+    alarm(0);
+
+    // 4. 映射失败（文件大小超过 RLIMIT_FSIZE）时退化为 pwrite，放开限制后重新映射
+    remove(s_file);
+    pid = fork();
+    if (pid == 0) {
+        signal(SIGXFSZ, SIG_IGN);
+        struct rlimit limit;
+        getrlimit(RLIMIT_FSIZE, &limit);
+        struct rlimit small = limit;
+        small.rlim_cur = 512 * 1024;
+        setrlimit(RLIMIT_FSIZE, &small);
+        auto appender = std::make_shared<lsh::MmapFileLogAppender>(s_file, 1024 * 1024);
+        auto logger = std::make_shared<lsh::Logger>("fallback");
+        logger->addAppender(appender);
+        for (int i = 0; i < 500; i++) {
+            LSH_LOG_INFO(logger) << "mmap log line " << i;
+        }
+        setrlimit(RLIMIT_FSIZE, &limit);
+        sleep(lsh::MmapFileLogAppender::RETRY_INTERVAL_MS / 1000 + 1);
+        for (int i = 500; i < 1000; i++) {
+            LSH_LOG_INFO(logger) << "mmap log line " << i;
+        }
+        struct stat st;
+        // 重新映射后文件被扩展到段尾
+        bool remapped = stat(s_file, &st) == 0 && st.st_size >= 1024 * 1024;
+        logger->clearAppenders();
+        appender.reset();
+        _exit(remapped ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    count = count_lines(s_file, ok);
+    std::cout << "fallback: file has " << count << " lines, remapped " << (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+              << std::endl;
+    ok = ok && count == 1000 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#include "log.h"
+#include "shm_log.h"
+#include "thread.h"
+#include "util.h"
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const char *s_shm_name = "/lsh_test_shm_log";
+static const int s_threads = 4;
+static const int s_lines = 50000;
+
+// 检查每个线程的日志按顺序到达，返回收到的条数，格式不对返回 -1
+static int64_t check_lines(const std::vector<std::string> &lines) {
+    std::vector<int> last(s_threads, -1);
+    for (auto &line : lines) {
+        int t, i;
+        if (sscanf(line.c_str(), "thread %d line %d\n", &t, &i) != 2 || t < 0 || t >= s_threads || i <= last[t]) {
+            std::cout << "bad line: " << line << std::endl;
+            return -1;
+        }
+        last[t] = i;
+    }
+    return lines.size();
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    lsh::ShmLogRing::Unlink(s_shm_name);
+
+    // 进程内：多个线程写，另一个线程像读者进程一样消费
+    std::shared_ptr<lsh::Logger> logger(new lsh::Logger("shm"));
+    std::shared_ptr<lsh::ShmLogAppender> appender(new lsh::ShmLogAppender(s_shm_name, 1024 * 1024));
+    appender->setFormatter(std::make_shared<lsh::LogFormatter>("%m%n"));
+    logger->addAppender(appender);
+
+    lsh::ShmLogRing::ptr reader = lsh::ShmLogRing::Open(s_shm_name);
+    ok = ok && reader;
+    std::vector<std::string> lines;
+    std::atomic<bool> stop{false};
+    lsh::Thread::ptr consumer(new lsh::Thread([&]() {
+        auto cb = [&](const char *data, size_t len) { lines.emplace_back(data, len); };
+        while (!stop) {
+            if (!reader->consume(cb)) {
+                usleep(100);
+            }
+        }
+        reader->consume(cb);
+    }, "shm_reader"));
+
+    uint64_t begin = lsh::GetCurrentUS();
+    std::vector<lsh::Thread::ptr> writers;
+    for (int t = 0; t < s_threads; t++) {
+        writers.emplace_back(new lsh::Thread([&, t]() {
+            for (int i = 0; i < s_lines; i++) {
+                LSH_LOG_FMT_INFO(logger, "thread %d line %d", t, i);
+            }
+        }, "shm_writer_" + std::to_string(t)));
+    }
+    for (auto &w : writers) {
+        w->join();
+    }
+    uint64_t used = lsh::GetCurrentUS() - begin;
+    stop = true;
+    consumer->join();
+
+    int64_t received = check_lines(lines);
+    uint64_t dropped = appender->getDropped();
+    std::cout << "in-process: received=" << received << " dropped=" << dropped
+              << " producer " << used * 1000.0 / (s_threads * s_lines) << " ns/line" << std::endl;
+    ok = ok && received >= 0 && (uint64_t)received + dropped == (uint64_t)s_threads * s_lines;
+
+    // 跨进程：子进程写完直接退出，读者照样能取出全部日志
+    lines.clear();
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::shared_ptr<lsh::Logger> child(new lsh::Logger("shm_child"));
+        std::shared_ptr<lsh::ShmLogAppender> child_appender(new lsh::ShmLogAppender(s_shm_name, 1024 * 1024));
+        child_appender->setFormatter(std::make_shared<lsh::LogFormatter>("%m%n"));
+        child->addAppender(child_appender);
+        for (int i = 0; i < 1000; i++) {
+            LSH_LOG_FMT_INFO(child, "thread %d line %d", 0, i);
+        }
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    reader->consume([&](const char *data, size_t len) { lines.emplace_back(data, len); });
+    received = check_lines(lines);
+    std::cout << "child process: received=" << received << " owner alive=" << reader->ownerAlive() << std::endl;
+    ok = ok && received == 1000 && reader->empty() && !reader->ownerAlive();
+
+    std::cout << appender->toYamlString() << std::endl;
+    lsh::ShmLogRing::Unlink(s_shm_name);
+    return ok ? 0 : 1;
+}
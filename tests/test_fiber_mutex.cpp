@@ -0,0 +1,223 @@
+#include "IOManager.h"
+#include "fiber_mutex.h"
+#include "log.h"
+#include "util.h"
+#include <unistd.h>
+
+static std::shared_ptr<lsh::Logger> g_logger = LSH_LOG_ROOT;
+
+template <class F>
+static bool wait_for(F f, uint64_t ms = 5000) {
+    uint64_t deadline = lsh::GetCurrentMS() + ms;
+    while (!f()) {
+        if (lsh::GetCurrentMS() > deadline) {
+            return false;
+        }
+        usleep(1000);
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    LSH_LOG_NAME("system")->setLevel(lsh::LogLevel::WARN);
+    g_logger->setLevel(lsh::LogLevel::INFO);
+
+    // 多个线程上的协程抢同一把锁，临界区里主动让出
+    {
+        lsh::FiberMutex mutex;
+        int counter = 0;
+        int inside = 0;
+        std::atomic<bool> overlap{false};
+        std::atomic<int> done{0};
+        // iom 最后声明、最先析构：析构时等所有协程结束，之后才析构它们用到的对象
+        lsh::IOManager iom(3, false, "fiber_mutex");
+        for (int f = 0; f < 20; f++) {
+            iom.schedule([&]() {
+                for (int i = 0; i < 200; i++) {
+                    lsh::FiberMutex::Lock lock(mutex);
+                    if (++inside != 1) {
+                        overlap = true;
+                    }
+                    lsh::Fiber::YieldToReady();
+                    ++counter;
+                    --inside;
+                }
+                ++done;
+            });
+        }
+        ok = ok && wait_for([&]() { return done == 20; });
+        lsh::FiberMutex::Lock lock(mutex);
+        ok = ok && counter == 20 * 200 && !overlap;
+        LSH_LOG_INFO(g_logger) << "mutex counter=" << counter << " overlap=" << overlap << " ok=" << ok;
+    }
+
+    // 单线程调度器：一个协程等锁时，同一个线程上的其它协程照常运行
+    {
+        lsh::FiberMutex mutex;
+        std::atomic<int> ticks{0};
+        std::atomic<int> ticks_while_waiting{-1};
+        std::atomic<bool> got{false};
+        lsh::IOManager iom(1, false, "fiber_mutex_1");
+        iom.schedule([&]() {
+            mutex.lock();
+            usleep(100 * 1000); // hook 之后只挂起协程
+            mutex.unlock();
+        });
+        iom.schedule([&]() {
+            int before = ticks;
+            mutex.lock();
+            ticks_while_waiting = ticks - before;
+            got = true;
+            mutex.unlock();
+        });
+        iom.schedule([&]() {
+            for (int i = 0; i < 10; i++) {
+                ++ticks;
+                usleep(5 * 1000);
+            }
+        });
+        ok = ok && wait_for([&]() { return got.load(); });
+        ok = ok && ticks_while_waiting > 0;
+        LSH_LOG_INFO(g_logger) << "other fibers ran " << ticks_while_waiting << " times while waiting ok=" << ok;
+    }
+
+    // 条件变量：生产者消费者，唤醒在另一个线程上
+    {
+        lsh::FiberMutex mutex;
+        lsh::FiberCondition cond;
+        std::list<int> queue;
+        std::atomic<int> consumed{0};
+        long sum = 0;
+        lsh::IOManager iom(2, false, "fiber_cond");
+        for (int c = 0; c < 4; c++) {
+            iom.schedule([&]() {
+                while (true) {
+                    lsh::FiberMutex::Lock lock(mutex);
+                    while (queue.empty()) {
+                        cond.wait(mutex);
+                    }
+                    int v = queue.front();
+                    queue.pop_front();
+                    if (v < 0) {
+                        break;
+                    }
+                    sum += v;
+                    ++consumed;
+                }
+            });
+        }
+        iom.schedule([&]() {
+            for (int i = 1; i <= 1000; i++) {
+                {
+                    lsh::FiberMutex::Lock lock(mutex);
+                    queue.push_back(i);
+                }
+                cond.notifyOne();
+            }
+            lsh::FiberMutex::Lock lock(mutex);
+            for (int c = 0; c < 4; c++) {
+                queue.push_back(-1);
+            }
+            cond.notifyAll();
+        });
+        ok = ok && wait_for([&]() { return consumed == 1000; });
+        ok = ok && sum == 1000 * 1001 / 2;
+        LSH_LOG_INFO(g_logger) << "condition consumed=" << consumed << " sum=" << sum << " ok=" << ok;
+    }
+
+    // 信号量限制并发数；读写锁：读者可以并发，写者独占
+    {
+        lsh::FiberSemaphore sem(3);
+        lsh::FiberRWMutex rwmutex;
+        std::atomic<int> running{0};
+        std::atomic<int> max_running{0};
+        std::atomic<int> readers{0};
+        std::atomic<int> max_readers{0};
+        std::atomic<bool> writer_overlap{false};
+        std::atomic<int> done{0};
+        lsh::IOManager iom(2, false, "fiber_sem");
+        for (int f = 0; f < 10; f++) {
+            iom.schedule([&]() {
+                sem.wait();
+                int n = ++running;
+                for (int m = max_running; n > m && !max_running.compare_exchange_weak(m, n);) {
+                }
+                usleep(10 * 1000);
+                --running;
+                sem.notify();
+                ++done;
+            });
+        }
+        for (int f = 0; f < 10; f++) {
+            iom.schedule([&, f]() {
+                if (f % 4 == 0) {
+                    lsh::FiberRWMutex::WriteLock lock(rwmutex);
+                    if (readers != 0) {
+                        writer_overlap = true;
+                    }
+                    usleep(5 * 1000);
+                } else {
+                    lsh::FiberRWMutex::ReadLock lock(rwmutex);
+                    int n = ++readers;
+                    for (int m = max_readers; n > m && !max_readers.compare_exchange_weak(m, n);) {
+                    }
+                    usleep(10 * 1000);
+                    --readers;
+                }
+                ++done;
+            });
+        }
+        ok = ok && wait_for([&]() { return done == 20; });
+        ok = ok && max_running <= 3 && max_running > 1 && sem.getCount() == 3;
+        ok = ok && max_readers > 1 && !writer_overlap;
+        LSH_LOG_INFO(g_logger) << "semaphore max_running=" << max_running << " rwmutex max_readers="
+                               << max_readers << " ok=" << ok;
+    }
+
+    // 超时，以及在非协程的线程里释放
+    {
+        lsh::FiberMutex mutex;
+        lsh::FiberCondition cond;
+        lsh::FiberSemaphore sem;
+        lsh::FiberRWMutex rwmutex;
+        std::atomic<bool> done{false};
+        std::atomic<bool> reader_in{false};
+        lsh::IOManager iom(2, false, "fiber_timeout");
+        mutex.lock();
+        iom.schedule([&]() {
+            uint64_t begin = lsh::GetCurrentMS();
+            bool timed_out = !mutex.timedLock(50);
+            uint64_t elapsed = lsh::GetCurrentMS() - begin;
+            ok = ok && timed_out && elapsed >= 45;
+            ok = ok && !sem.timedWait(20);
+            // 没有写者时读锁直接拿到
+            lsh::FiberRWMutex::ReadLock rlock(rwmutex);
+            rlock.unlock();
+            // 锁被主线程释放后拿到
+            ok = ok && mutex.timedLock(5000);
+            ok = ok && !cond.wait(mutex, 20);
+            mutex.unlock();
+            done = true;
+        });
+        usleep(150 * 1000);
+        mutex.unlock();
+        ok = ok && wait_for([&]() { return done.load(); });
+        LSH_LOG_INFO(g_logger) << "timeouts ok=" << ok;
+
+        // 写者超时退出后，被它挡住的读者要能进来
+        rwmutex.rlock();
+        iom.schedule([&]() { ok = ok && !rwmutex.timedWlock(30); });
+        usleep(5 * 1000);
+        iom.schedule([&]() {
+            lsh::FiberRWMutex::ReadLock lock(rwmutex);
+            reader_in = true;
+        });
+        ok = ok && wait_for([&]() { return reader_in.load(); });
+        rwmutex.unlock();
+        LSH_LOG_INFO(g_logger) << "rwmutex writer timeout ok=" << ok;
+    }
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
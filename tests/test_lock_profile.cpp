@@ -0,0 +1,100 @@
+#include "lock_profile.h"
+#include "thread.h"
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <vector>
+
+// 锁争用统计：用 -DLSH_LOCK_PROFILE=ON 构建时检查计数和调用点，否则只检查接口可用
+
+static lsh::Mutex s_hot;
+static lsh::RWMutex s_rw;
+static lsh::NULLMutex s_null;
+static int s_hot_line = 0;
+static int s_write_line = 0;
+
+static void Hot(int i) {
+    s_hot_line = __LINE__ + 1;
+    lsh::Mutex::Lock lock(s_hot);
+    // 偶尔在锁里睡一下，让其它线程一定等得到
+    if (i % 10 == 0) {
+        usleep(200);
+    }
+}
+
+static void ReadWrite(int i) {
+    if (i % 5 == 0) {
+        s_write_line = __LINE__ + 1;
+        lsh::RWMutex::WriteLock lock(s_rw);
+        usleep(100);
+    } else {
+        lsh::RWMutex::ReadLock lock(s_rw);
+    }
+    lsh::NULLMutex::Lock lock(s_null);
+}
+
+// 在 Dump 的输出里找调用点那一行，取出 count 和 contended
+static bool FindSite(const std::string &dump, int line, const char *kind, unsigned long &count,
+                     unsigned long &contended) {
+    std::string key = "test_lock_profile.cpp:" + std::to_string(line) + " " + kind;
+    size_t pos = dump.find(key);
+    if (pos == std::string::npos) {
+        return false;
+    }
+    return sscanf(dump.c_str() + pos + key.size(), " count=%lu contended=%lu", &count, &contended) == 2;
+}
+
+int main(int argc, char **argv) {
+    const int threads = 4;
+    const int loops = 200;
+    std::vector<lsh::Thread::ptr> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back(new lsh::Thread([]() {
+            for (int i = 0; i < loops; i++) {
+                Hot(i);
+                ReadWrite(i);
+            }
+        }, "lock_prof_" + std::to_string(t)));
+    }
+    for (auto &w : workers) {
+        w->join();
+    }
+
+    std::stringstream ss;
+    lsh::LockProfiler::Dump(ss, 100);
+    std::cout << ss.str();
+
+    bool ok = true;
+    if (!lsh::LockProfiler::Enabled()) {
+        ok = ss.str().find("0 locks") != std::string::npos;
+        std::cout << "disabled (configure with -DLSH_LOCK_PROFILE=ON)" << std::endl;
+        std::cout << (ok ? "OK" : "FAILED") << std::endl;
+        return ok ? 0 : 1;
+    }
+
+    unsigned long count = 0;
+    unsigned long contended = 0;
+    ok = ok && FindSite(ss.str(), s_hot_line, "mutex", count, contended);
+    ok = ok && count == threads * loops && contended > 0;
+    std::cout << "hot mutex count=" << count << " contended=" << contended << " ok=" << ok << std::endl;
+    ok = ok && FindSite(ss.str(), s_write_line, "write", count, contended);
+    ok = ok && count == threads * loops / 5;
+    std::cout << "rwmutex write count=" << count << " ok=" << ok << std::endl;
+    // 每个锁有一行汇总，空锁不出现
+    std::stringstream hot_addr;
+    hot_addr << (const void *)&s_hot;
+    ok = ok && ss.str().find("lock=" + hot_addr.str()) != std::string::npos;
+    std::stringstream null_addr;
+    null_addr << (const void *)&s_null;
+    ok = ok && ss.str().find("lock=" + null_addr.str()) == std::string::npos;
+
+    lsh::LockProfiler::Reset();
+    std::stringstream after;
+    lsh::LockProfiler::Dump(after, 5);
+    ok = ok && after.str().find("0 locks") != std::string::npos;
+    std::cout << "reset ok=" << ok << std::endl;
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
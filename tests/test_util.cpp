@@ -2,6 +2,7 @@
 #include "macro.h"
 #include "util.h"
 #include <assert.h>
+#include <sys/wait.h>
 
 std::shared_ptr<lsh::Logger> g_logger = LSH_LOG_ROOT;
 
@@ -13,7 +14,21 @@ void test_aasert() {
     LSH_ASSERT_MSG(false, "xxxxxx");
 }
 
+// fork 之后子进程的主线程要拿到自己的 tid，而不是父进程缓存下来的
+void test_thread_id_fork() {
+    pid_t parent_tid = lsh::GetThreadId();
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(lsh::GetThreadId() == getpid() && lsh::GetThreadId() != parent_tid ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    LSH_LOG_INFO(g_logger) << "GetThreadId after fork: " << (WEXITSTATUS(status) == 0 ? "ok" : "FAIL");
+    LSH_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
 int main(int argc, char **argv) {
+    test_thread_id_fork();
     test_aasert();
     return 0;
 }
\ No newline at end of file
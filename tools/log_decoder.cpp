@@ -0,0 +1,53 @@
+#include "binlog.h"
+#include "log.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+// 把 log.binary.file 写出的二进制日志还原成文本
+// 用法: log_decoder <binlog 文件> [formatter pattern]
+// 不指定 pattern 时使用 Logger 的默认格式
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <binlog file> [pattern]" << std::endl;
+        return 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "open " << argv[1] << " failed" << std::endl;
+        return 1;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < 8 || memcmp(data.data(), "LSHBLOG1", 8) != 0) {
+        std::cerr << argv[1] << " is not a binlog file" << std::endl;
+        return 1;
+    }
+
+    lsh::LogFormatter formatter(argc > 2 ? argv[2] : "%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n");
+    if (formatter.isError()) {
+        std::cerr << "invalid pattern " << argv[2] << std::endl;
+        return 1;
+    }
+
+    lsh::BinLogDecoder decoder;
+    std::string out;
+    size_t pos = 8;
+    while (pos + sizeof(lsh::BinEntryHeader) <= data.size()) {
+        uint32_t size;
+        memcpy(&size, data.data() + pos, sizeof(size));
+        if (size < sizeof(lsh::BinEntryHeader) || pos + size > data.size()) {
+            std::cerr << "truncated entry at offset " << pos << std::endl;
+            break;
+        }
+        lsh::LogEvent::ptr event = decoder.decode(data.data() + pos, size);
+        if (event) {
+            out.clear();
+            formatter.format(out, event->getLogger(), event->getLevel(), event);
+            fwrite(out.data(), 1, out.size(), stdout);
+        }
+        pos += size;
+    }
+    return 0;
+}
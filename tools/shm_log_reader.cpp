@@ -0,0 +1,102 @@
+#include "shm_log.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+// 把 ShmLogAppender 写进共享内存环的日志取出来，追加到文件或者标准输出
+// 用法: shm_log_reader [-e] <shm 名称，如 /lsh_server> [输出文件]
+//   -e  写日志的进程退出并且环已经读空之后退出（默认一直等待，写进程重启后继续读）
+// 收到 SIGINT/SIGTERM 时读完已提交的日志再退出
+
+static volatile sig_atomic_t s_stop = 0;
+
+static void on_signal(int) {
+    s_stop = 1;
+}
+
+int main(int argc, char **argv) {
+    bool exit_with_owner = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "e")) != -1) {
+        if (opt == 'e') {
+            exit_with_owner = true;
+        } else {
+            std::cerr << "usage: " << argv[0] << " [-e] <shm name> [output file]" << std::endl;
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        std::cerr << "usage: " << argv[0] << " [-e] <shm name> [output file]" << std::endl;
+        return 1;
+    }
+    std::string name = argv[optind];
+    FILE *out = stdout;
+    if (optind + 1 < argc) {
+        out = fopen(argv[optind + 1], "ae");
+        if (!out) {
+            std::cerr << "open " << argv[optind + 1] << " failed errno=" << errno << std::endl;
+            return 1;
+        }
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    auto write_record = [out](const char *data, size_t len) {
+        fwrite(data, 1, len, out);
+    };
+
+    lsh::ShmLogRing::ptr ring;
+    uint64_t idle_us = 1000;
+    uint64_t idle_rounds = 0;
+    while (true) {
+        if (!ring) {
+            ring = lsh::ShmLogRing::Open(name);
+            if (!ring) {
+                if (s_stop) {
+                    break;
+                }
+                usleep(100 * 1000);
+                continue;
+            }
+        }
+
+        size_t n = ring->consume(write_record);
+        if (n) {
+            idle_us = 1000;
+            idle_rounds = 0;
+            continue;
+        }
+        fflush(out);
+        if (s_stop) {
+            break;
+        }
+        if (ring->empty() && !ring->ownerAlive()) {
+            if (exit_with_owner) {
+                break;
+            }
+        }
+        // 空闲时逐渐放慢轮询，最长 50ms；大约每秒检查一次写进程是否重建了共享内存
+        if (++idle_rounds % 20 == 0 && ring->empty() && ring->isReplaced()) {
+            ring.reset();
+            continue;
+        }
+        usleep(idle_us);
+        idle_us = std::min<uint64_t>(idle_us * 2, 50 * 1000);
+    }
+
+    if (ring) {
+        ring->consume(write_record);
+        if (ring->getDropped() || ring->getSkipped()) {
+            std::cerr << "shm log " << name << " dropped=" << ring->getDropped()
+                      << " skipped_bytes=" << ring->getSkipped() << std::endl;
+        }
+    }
+    fflush(out);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}